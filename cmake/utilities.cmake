@@ -13,6 +13,7 @@ macro(glex_add_executable name sources)
         glfw
         ${GLFW_LIBRARIES}
         ${GLAD_LIBRARIES}
+        Threads::Threads
     )
 
     set_target_properties (
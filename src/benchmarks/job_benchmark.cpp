@@ -0,0 +1,173 @@
+// Scaling of the job system from one thread up to many, on the work it
+// was written for.
+//
+// Each workload runs on a JobSystem of 1, 2, ... up to --threads threads,
+// counting the thread that waits, and we report the best of a few runs
+// and its speedup over one thread:
+//
+//  - Building a 2048x2048 mip chain on the CPU, which never touches GL.
+//  - Importing the backpack: texture decode and mesh building on jobs,
+//    uploads on this thread. Its mips come from the mip cache after a
+//    warm-up import, so every run does the same work. Skipped with
+//    --no-gl, as on hosts with no GPU.
+//
+// Usage: job_benchmark [repeats] [--threads <n>] [--no-gl]
+
+// clang-format off
+#include "lib/model_viewer.h"
+
+#include <fmt/core.h>
+#include <tools/gl_resources.h>
+#include <tools/job_system.h>
+#include <tools/mip_chain.h>
+#include <tools/model_data.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+// clang-format on
+
+// --------------
+// Configuration.
+
+static constexpr Config CONFIG{
+    .wireframe = false,
+    .constantRotation = false,
+};
+
+static const auto modelPath = std::string(project_root) + "/resources/learnopengl/backpack.obj";
+
+static constexpr int MIP_BASE_SIZE = 2048;
+
+struct JobBenchOptions {
+  int repeats = 5;
+  // Most threads to try; 0 for one per hardware thread.
+  unsigned threads = 0;
+  bool gl = true;
+};
+
+JobBenchOptions parseJobBenchOptions(int argc, char **argv) {
+  JobBenchOptions options;
+
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+
+    if (arg == "--threads" && i + 1 < argc) {
+      options.threads = static_cast<unsigned>(std::stoi(argv[++i]));
+    } else if (arg == "--no-gl") {
+      options.gl = false;
+    } else if (!arg.starts_with("--")) {
+      options.repeats = std::max(1, std::stoi(argv[i]));
+    }
+  }
+
+  if (options.threads == 0) {
+    options.threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  return options;
+}
+
+// --------
+// Helpers.
+
+// A base level with detail at every scale, so no filter tap is wasted.
+MipLevel makeMipBase() {
+  MipLevel base;
+  base.width = MIP_BASE_SIZE;
+  base.height = MIP_BASE_SIZE;
+  base.pixels.resize(static_cast<std::size_t>(MIP_BASE_SIZE) * MIP_BASE_SIZE * 4);
+
+  std::uint32_t state = 12345;
+  for (auto &channel : base.pixels) {
+    state = state * 1664525u + 1013904223u;
+    channel = static_cast<std::uint8_t>(state >> 24);
+  }
+  return base;
+}
+
+using Clock = std::chrono::steady_clock;
+
+double msSince(Clock::time_point start) {
+  const std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+  return elapsed.count();
+}
+
+// Runs work, which returns the milliseconds it timed, repeatedly on a
+// system of each size, printing the best times against one thread's.
+void runScaling(const char *name, const JobBenchOptions &options, const std::function<double(JobSystem &)> &work) {
+  fmt::print("{}:\n", name);
+  double baseline = 0.0;
+
+  for (unsigned threads = 1; threads <= options.threads; threads++) {
+    JobSystem jobs{threads};
+    double ms = std::numeric_limits<double>::max();
+    for (int i = 0; i < options.repeats; i++) {
+      ms = std::min(ms, work(jobs));
+    }
+    if (threads == 1) {
+      baseline = ms;
+    }
+
+    const JobSystem::Stats stats = jobs.stats();
+    fmt::print("  {:>2} threads {:9.2f} ms  {:5.2f}x  ({} jobs, {} stolen)\n", threads, ms, baseline / ms,
+               stats.executed, stats.stolen);
+  }
+}
+
+// -------------
+// Program main.
+
+int main(int argc, char **argv) {
+  const JobBenchOptions options = parseJobBenchOptions(argc, argv);
+  fmt::print("Best of {} runs, 1 to {} threads.\n", options.repeats, options.threads);
+
+  const MipLevel base = makeMipBase();
+  runScaling("Mip chain, 2048x2048 Kaiser", options, [&](JobSystem &jobs) {
+    MipOptions mipOptions;
+    mipOptions.jobs = &jobs;
+
+    MipLevel copy = base;
+    const auto start = Clock::now();
+    buildMipChain(std::move(copy), mipOptions);
+    return msSince(start);
+  });
+
+  if (!options.gl) {
+    return 0;
+  }
+
+  GLFWWrapper window;
+
+  if (!window.init(true) || !configureGL(CONFIG)) {
+    return -1;
+  }
+
+  // Fills the mip cache, so timed imports only decode.
+  { Model warmUp{modelPath}; }
+
+  runScaling("Backpack import", options, [&](JobSystem &jobs) {
+    ModelOptions modelOptions;
+    modelOptions.jobs = &jobs;
+
+    double ms = 0.0;
+    {
+      const auto start = Clock::now();
+      Model model{modelPath, modelOptions};
+      // Uploads are part of an import; freeing its objects isn't.
+      glFinish();
+      ms = msSince(start);
+    }
+    glResources().collect();
+    return ms;
+  });
+
+  return 0;
+}
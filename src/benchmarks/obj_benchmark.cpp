@@ -0,0 +1,163 @@
+// Our OBJ loader against Assimp's, from file to the Vertex and index
+// arrays Mesh uploads.
+//
+// Assimp reads with the flags Model uses, and we copy its meshes into
+// Vertex arrays as Model does; that's timed once, as it runs on one
+// thread. Ours runs on a JobSystem of 1, 2, ... up to --threads threads.
+// Both report the best of a few runs, and what they built, which should
+// be the same triangles, in fewer vertices for ours, as it welds them.
+// Neither touches GL, or textures.
+//
+// Usage: obj_benchmark [repeats] [--model <path>] [--threads <n>]
+
+// clang-format off
+#include "glad/glad.h"
+
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <fmt/core.h>
+#include <tools/job_system.h>
+#include <tools/mesh_data.h>
+#include <tools/obj_loader.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+// clang-format on
+
+// --------------
+// Configuration.
+
+struct ObjBenchOptions {
+  int repeats = 5;
+  std::string model = std::string(PROJECT_SOURCE_DIR) + "/resources/learnopengl/backpack.obj";
+  // Most threads to try; 0 for one per hardware thread.
+  unsigned threads = 0;
+};
+
+ObjBenchOptions parseObjBenchOptions(int argc, char **argv) {
+  ObjBenchOptions options;
+
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+
+    if (arg == "--model" && i + 1 < argc) {
+      options.model = argv[++i];
+    } else if (arg == "--threads" && i + 1 < argc) {
+      options.threads = static_cast<unsigned>(std::stoi(argv[++i]));
+    } else if (!arg.starts_with("--")) {
+      options.repeats = std::max(1, std::stoi(argv[i]));
+    }
+  }
+
+  if (options.threads == 0) {
+    options.threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  return options;
+}
+
+// --------
+// Helpers.
+
+using Clock = std::chrono::steady_clock;
+
+double msSince(Clock::time_point start) {
+  const std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+  return elapsed.count();
+}
+
+// What a load built.
+struct LoadResult {
+  std::size_t meshes = 0;
+  std::size_t triangles = 0;
+  std::size_t vertices = 0;
+};
+
+// As Model::loadWithAssimp() reads a file, then builds its geometry.
+LoadResult loadWithAssimp(const std::string &path) {
+  Assimp::Importer importer;
+  const aiScene *scene = importer.ReadFile(path.c_str(), aiProcess_Triangulate | aiProcess_FlipUVs);
+  if (!scene || !scene->mRootNode || (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE)) {
+    throw std::runtime_error("Assimp failed to read " + path + ".");
+  }
+
+  LoadResult result;
+  for (unsigned int m = 0; m < scene->mNumMeshes; m++) {
+    const aiMesh &mesh = *scene->mMeshes[m];
+
+    std::vector<Vertex> vertices;
+    vertices.reserve(mesh.mNumVertices);
+    for (unsigned int i = 0; i < mesh.mNumVertices; i++) {
+      Vertex vertex = {};
+      vertex.mPosition = {mesh.mVertices[i].x, mesh.mVertices[i].y, mesh.mVertices[i].z};
+      if (mesh.mTextureCoords[0]) {
+        vertex.mTextureCoords = {mesh.mTextureCoords[0][i].x, mesh.mTextureCoords[0][i].y};
+      }
+      vertices.push_back(vertex);
+    }
+
+    std::vector<unsigned int> indices;
+    indices.reserve(static_cast<std::size_t>(mesh.mNumFaces) * 3);
+    for (unsigned int i = 0; i < mesh.mNumFaces; i++) {
+      indices.insert(indices.end(), mesh.mFaces[i].mIndices, mesh.mFaces[i].mIndices + mesh.mFaces[i].mNumIndices);
+    }
+
+    result.meshes++;
+    result.triangles += indices.size() / 3;
+    result.vertices += vertices.size();
+  }
+
+  return result;
+}
+
+LoadResult loadWithOurs(const std::string &path, JobSystem &jobs) {
+  const ObjModel model = loadObjModel(path, jobs);
+  return {model.meshes.size(), model.stats.triangles, model.stats.vertices};
+}
+
+// The best time of repeats runs of load.
+template <typename Load> double bestOf(int repeats, LoadResult &result, Load load) {
+  double best = std::numeric_limits<double>::max();
+  for (int i = 0; i < repeats; i++) {
+    const auto start = Clock::now();
+    result = load();
+    best = std::min(best, msSince(start));
+  }
+  return best;
+}
+
+// -------------
+// Program main.
+
+int main(int argc, char **argv) {
+  const ObjBenchOptions options = parseObjBenchOptions(argc, argv);
+  fmt::print("{}: best of {} runs.\n", options.model, options.repeats);
+
+  LoadResult assimp;
+  const double assimpMs = bestOf(options.repeats, assimp, [&]() { return loadWithAssimp(options.model); });
+  fmt::print("  Assimp          {:9.2f} ms  {} meshes, {} triangles, {} vertices\n", assimpMs, assimp.meshes,
+             assimp.triangles, assimp.vertices);
+
+  for (unsigned threads = 1; threads <= options.threads; threads++) {
+    JobSystem jobs{threads};
+    LoadResult ours;
+    const double ms = bestOf(options.repeats, ours, [&]() { return loadWithOurs(options.model, jobs); });
+    fmt::print("  Ours, {:>2} threads {:9.2f} ms  {} meshes, {} triangles, {} vertices  {:5.2f}x Assimp\n", threads,
+               ms, ours.meshes, ours.triangles, ours.vertices, assimpMs / ms);
+
+    if (ours.triangles != assimp.triangles) {
+      fmt::print("  Triangle counts differ!\n");
+      return 1;
+    }
+  }
+
+  return 0;
+}
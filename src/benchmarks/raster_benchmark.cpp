@@ -0,0 +1,317 @@
+// Throughput of the software rasterizer, and of the GL path where there
+// is one, drawing the same scene along the same camera path.
+//
+// The software path never touches GL: the backpack is imported straight
+// from Assimp, with the post-processing Model uses, and its textures are
+// decoded for sampling on the CPU. With --no-gl, we don't even create a
+// context, as on hosts with no GPU.
+//
+// Usage: raster_benchmark [numFrames] [--scene cubes|backpack] [--size <w>x<h>]
+//                         [--threads <n>] [--no-gl]
+
+// clang-format off
+#include "lib/model_viewer.h"
+
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <fmt/core.h>
+#include <learnopengl/filesystem.h>
+#include <tools/job_system.h>
+#include <tools/model_data.h>
+#include <tools/offscreen_target.h>
+#include <tools/percentiles.h>
+#include <tools/software_rasterizer.h>
+#include <model_viewer/models/models.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <numbers>
+#include <string>
+#include <string_view>
+#include <vector>
+// clang-format on
+
+// --------------
+// Configuration.
+
+static constexpr Config CONFIG{
+    .wireframe = false,
+    .constantRotation = false,
+};
+
+static const auto modelPath = std::string(project_root) + "/resources/learnopengl/backpack.obj";
+
+struct RasterBenchOptions {
+  int frames = 300;
+  std::string scene = "backpack";
+  int width = 1280;
+  int height = 720;
+  // Software rasterizer threads; 0 for one per hardware thread.
+  unsigned threads = 0;
+  bool gl = true;
+};
+
+RasterBenchOptions parseRasterBenchOptions(int argc, char **argv) {
+  RasterBenchOptions options;
+
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+
+    if (arg == "--scene" && i + 1 < argc) {
+      options.scene = argv[++i];
+    } else if (arg == "--size" && i + 1 < argc) {
+      std::sscanf(argv[++i], "%dx%d", &options.width, &options.height);
+    } else if (arg == "--threads" && i + 1 < argc) {
+      options.threads = static_cast<unsigned>(std::stoi(argv[++i]));
+    } else if (arg == "--no-gl") {
+      options.gl = false;
+    } else if (!arg.starts_with("--")) {
+      options.frames = std::stoi(argv[i]);
+    }
+  }
+
+  return options;
+}
+
+// ---------------
+// Software scene.
+
+// Meshes with the texture each is drawn with, if any.
+struct SoftwareScene {
+  std::vector<SoftwareMesh> meshes;
+  std::vector<const SoftwareTexture *> textures;
+  std::map<std::string, SoftwareTexture> loadedTextures;
+
+  [[nodiscard]] std::size_t triangles() const {
+    std::size_t count = 0;
+    for (const auto &mesh : meshes) {
+      count += (mesh.indices.empty() ? mesh.positions.size() : mesh.indices.size()) / 3;
+    }
+    return count;
+  }
+
+  const SoftwareTexture *texture(const std::string &path, bool flipVertically) {
+    auto it = loadedTextures.find(path);
+    if (it == loadedTextures.end()) {
+      it = loadedTextures.emplace(path, SoftwareTexture::load(path, flipVertically)).first;
+    }
+    return &it->second;
+  }
+};
+
+// The cube and plane of model_viewer, with their textures.
+SoftwareScene loadSoftwareCubes() {
+  SoftwareScene scene;
+  scene.meshes.push_back(SoftwareMesh::fromInterleaved(models::cubeModel));
+  scene.textures.push_back(scene.texture(FileSystem::getPath("resources/learnopengl/textures/container.jpg"), true));
+  scene.meshes.push_back(SoftwareMesh::fromInterleaved(models::planeModel));
+  scene.textures.push_back(scene.texture(FileSystem::getPath("resources/textures/Bricks098_2K-JPG_Color.jpg"), true));
+  return scene;
+}
+
+// Each mesh of the model at path, with its first diffuse texture.
+SoftwareScene loadSoftwareModel(const std::string &path) {
+  Assimp::Importer importer;
+  const aiScene *model = importer.ReadFile(path.c_str(), aiProcess_Triangulate | aiProcess_FlipUVs);
+  if (!model || !model->mRootNode || (model->mFlags & AI_SCENE_FLAGS_INCOMPLETE)) {
+    throw std::runtime_error("Failed to load model.");
+  }
+
+  const std::string directory = path.substr(0, path.find_last_of('/'));
+  SoftwareScene scene;
+
+  for (unsigned int m = 0; m < model->mNumMeshes; m++) {
+    const aiMesh *source = model->mMeshes[m];
+    SoftwareMesh mesh;
+
+    for (unsigned int i = 0; i < source->mNumVertices; i++) {
+      const aiVector3D &position = source->mVertices[i];
+      mesh.positions.emplace_back(position.x, position.y, position.z);
+      if (source->mTextureCoords[0]) {
+        mesh.textureCoords.emplace_back(source->mTextureCoords[0][i].x, source->mTextureCoords[0][i].y);
+      } else {
+        mesh.textureCoords.emplace_back(0.0f, 0.0f);
+      }
+    }
+    for (unsigned int f = 0; f < source->mNumFaces; f++) {
+      const aiFace &face = source->mFaces[f];
+      mesh.indices.insert(mesh.indices.end(), face.mIndices, face.mIndices + face.mNumIndices);
+    }
+
+    const SoftwareTexture *texture = nullptr;
+    const aiMaterial *material = model->mMaterials[source->mMaterialIndex];
+    if (material->GetTextureCount(aiTextureType_DIFFUSE) > 0) {
+      aiString name;
+      material->GetTexture(aiTextureType_DIFFUSE, 0, &name);
+      // As Model loads them, unflipped, since the UVs are flipped instead.
+      texture = scene.texture(textureFilePath(name.C_Str(), directory), false);
+    }
+
+    scene.meshes.push_back(std::move(mesh));
+    scene.textures.push_back(texture);
+  }
+
+  return scene;
+}
+
+// --------
+// Helpers.
+
+// The per-frame camera path of runBenchmark.
+class CameraPath {
+public:
+  CameraPath(int frames, float aspectRatio)
+      : mTurnStep(2.0f * std::numbers::pi_v<float> / static_cast<float>(frames)), mAspectRatio(aspectRatio) {}
+
+  void advance(Transformations &transformations, int frame) const {
+    const float phase = static_cast<float>(frame) * mTurnStep;
+    transformations.rotateViewTransformation(0.25f * mTurnStep, mTurnStep);
+    transformations.updateViewTransformation();
+    transformations.updateFoV(0.2 * std::cos(phase));
+    transformations.updateProjectionTransformation(mAspectRatio);
+  }
+
+private:
+  float mTurnStep;
+  float mAspectRatio;
+};
+
+struct Timings {
+  std::vector<double> frameMs;
+
+  [[nodiscard]] double mean() const { return Percentiles{frameMs}.mean(); }
+};
+
+void printTimings(const char *name, const Timings &timings, std::size_t triangles) {
+  const Percentiles percentiles{timings.frameMs};
+  const double mean = percentiles.mean();
+  fmt::print("{:<9} {:8.3f} ms/frame (p50 {:.3f}, p95 {:.3f}), {:8.2f} Mtri/s\n", name, mean, percentiles.at(50),
+             percentiles.at(95), mean > 0.0 ? static_cast<double>(triangles) / (mean * 1000.0) : 0.0);
+}
+
+// -------------
+// Program main.
+
+int main(int argc, char **argv) {
+  const RasterBenchOptions options = parseRasterBenchOptions(argc, argv);
+  const float aspectRatio = static_cast<float>(options.width) / static_cast<float>(options.height);
+  const CameraPath cameraPath{options.frames, aspectRatio};
+  const bool backpack = options.scene == "backpack";
+
+  // Software path.
+
+  SoftwareScene softwareScene = backpack ? loadSoftwareModel(modelPath) : loadSoftwareCubes();
+  JobSystem jobs{options.threads};
+  SoftwareRasterizer rasterizer{options.width, options.height, &jobs};
+  const std::size_t triangles = softwareScene.triangles();
+
+  fmt::print("Scene: {}, {} triangles, {}x{}, {} frames, {} rasterizer threads\n", options.scene, triangles,
+             options.width, options.height, options.frames, rasterizer.threads());
+
+  Timings softwareTimings;
+  SoftwareRasterizer::Stats totals;
+  {
+    Transformations transformations{aspectRatio};
+
+    for (int frame = 0; frame < options.frames; frame++) {
+      cameraPath.advance(transformations, frame);
+      const glm::mat4 mvp =
+          transformations.projectionMatrix() * transformations.viewMatrix() * transformations.modelMatrix();
+
+      const auto start = std::chrono::steady_clock::now();
+      rasterizer.beginFrame(glm::vec4{0.0f, 0.0f, 0.0f, 1.0f});
+      for (std::size_t i = 0; i < softwareScene.meshes.size(); i++) {
+        rasterizer.draw(softwareScene.meshes[i], mvp, softwareScene.textures[i]);
+      }
+      rasterizer.endFrame();
+      const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+      softwareTimings.frameMs.push_back(elapsed.count());
+
+      const SoftwareRasterizer::Stats stats = rasterizer.stats();
+      totals.culled += stats.culled;
+      totals.clipped += stats.clipped;
+      totals.binned += stats.binned;
+      totals.blocks += stats.blocks;
+      totals.blocksHidden += stats.blocksHidden;
+      totals.blocksCovered += stats.blocksCovered;
+      totals.pixels += stats.pixels;
+    }
+  }
+
+  printTimings("Software", softwareTimings, triangles);
+
+  const auto perFrame = [&](std::uint64_t total) { return total / static_cast<std::uint64_t>(options.frames); };
+  fmt::print("  per frame: {} culled, {} clipped, {} binned, {} blocks ({} fully covered), {} hidden, {} pixels\n",
+             perFrame(totals.culled), perFrame(totals.clipped), perFrame(totals.binned), perFrame(totals.blocks),
+             perFrame(totals.blocksCovered), perFrame(totals.blocksHidden), perFrame(totals.pixels));
+
+  if (!options.gl) {
+    return 0;
+  }
+
+  // GL path, into an offscreen target of the same size.
+
+  GLFWWrapper window;
+
+  if (!window.init(true) || !configureGL(CONFIG)) {
+    return -1;
+  }
+
+  OffscreenTarget target{options.width, options.height};
+  target.bind();
+
+  std::shared_ptr<Shader> shader;
+  std::unique_ptr<Model> model;
+  TexturedModels cubes;
+
+  if (backpack) {
+    std::string vertexShaderPath = FileSystem::getPath("src/model_viewer/shaders/model_viewer_assimp.vs");
+    std::string fragmentShaderPath = FileSystem::getPath("src/model_viewer/shaders/model_viewer_assimp.fs");
+    shader = std::make_shared<Shader>(vertexShaderPath.c_str(), fragmentShaderPath.c_str());
+    model = std::make_unique<Model>(modelPath);
+  } else {
+    cubes = loadModels();
+    if (!cubes.isOkay()) {
+      return -1;
+    }
+    shader = makeModelViewerShaders().get(0);
+  }
+
+  Transformations transformations{aspectRatio};
+  Transformations::attachShader(*shader);
+  RenderQueue renderQueue;
+
+  Timings glTimings;
+  glFinish();
+
+  for (int frame = 0; frame < options.frames; frame++) {
+    cameraPath.advance(transformations, frame);
+
+    // Timed to the GPU finishing, to compare like with like.
+    const auto start = std::chrono::steady_clock::now();
+    clearBuffers();
+    transformations.flushUniforms();
+    resetRenderQueue(renderQueue, transformations);
+    if (model) {
+      model->submit(renderQueue, *shader);
+    } else {
+      cubes.mModel1->submit(renderQueue, *shader);
+      cubes.mModel2->submit(renderQueue, *shader);
+    }
+    renderQueue.execute();
+    glFinish();
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    glTimings.frameMs.push_back(elapsed.count());
+  }
+
+  printTimings("GL", glTimings, triangles);
+  fmt::print("GL renderer: {}\n", reinterpret_cast<const char *>(glGetString(GL_RENDERER)));
+  fmt::print("Software speedup: {:.2f}x\n", glTimings.mean() / softwareTimings.mean());
+
+  return 0;
+}
@@ -0,0 +1,129 @@
+// Microbenchmark comparing per-frame uniform updates done the way Mesh::draw
+// used to do them (building uniform names and asking GL for their locations
+// every frame) with two ways we avoid that: sampler units assigned once per
+// shader and matrices set through cached uniform handles, and camera
+// matrices uploaded through the shared uniform buffer.
+//
+// Our model shaders read the camera from the uniform block, so the name and
+// handle updates set the plain mat4 uniforms of the coordinate_systems
+// example's shader.
+//
+// Usage: uniform_benchmark [numFrames]
+
+// clang-format off
+#include "lib/model_viewer.h"
+
+#include <fmt/core.h>
+#include <learnopengl/filesystem.h>
+#include <tools/camera_uniforms.h>
+#include <tools/model_data.h>
+
+#include <chrono>
+#include <string>
+// clang-format on
+
+// --------------
+// Configuration.
+
+static constexpr Config CONFIG{
+    .wireframe = false,
+    .constantRotation = false,
+};
+
+static const auto modelPath = std::string(project_root) + "/resources/learnopengl/backpack.obj";
+
+// --------
+// Helpers.
+
+// Runs frameWork numFrames times and returns the average time per frame in microseconds.
+template <typename F>
+double microsecondsPerFrame(int numFrames, F frameWork) {
+  glFinish();
+  auto start = std::chrono::steady_clock::now();
+
+  for (int frame = 0; frame < numFrames; frame++) {
+    frameWork();
+  }
+
+  glFinish();
+  std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+
+  return elapsed.count() / numFrames;
+}
+
+// -------------
+// Program main.
+
+int main(int argc, char **argv) {
+  const int numFrames = argc > 1 ? std::stoi(argv[1]) : 1000;
+
+  GLFWWrapper window;
+
+  if (!window.init() || !configureGL(CONFIG)) {
+    return -1;
+  }
+
+  std::string vertexShaderPath = FileSystem::getPath("src/model_viewer/shaders/model_viewer_assimp.vs");
+  std::string fragmentShaderPath = FileSystem::getPath("src/model_viewer/shaders/model_viewer_assimp.fs");
+  Shader shader{vertexShaderPath.c_str(), fragmentShaderPath.c_str()};
+
+  // A shader with its matrices in plain uniforms.
+  std::string matrixVertexPath = FileSystem::getPath("src/examples/coordinate_systems/shaders/coordinate_systems.vs");
+  std::string matrixFragmentPath = FileSystem::getPath("src/examples/coordinate_systems/shaders/coordinate_systems.fs");
+  Shader matrixShader{matrixVertexPath.c_str(), matrixFragmentPath.c_str()};
+
+  Model model{modelPath};
+  const glm::mat4 matrix{1.0f};
+
+  // What each frame cost before: a string built and a location queried per
+  // texture per mesh, and per matrix.
+  double byName = microsecondsPerFrame(numFrames, [&]() {
+    shader.use();
+    for (const auto &mesh : model.meshes()) {
+      unsigned int diffuseNr = 1;
+      for (unsigned int i = 0; i < mesh.textures().size(); i++) {
+        std::string name = mesh.textures()[i].type + std::to_string(diffuseNr++);
+        glUniform1i(glGetUniformLocation(shader.ID, name.c_str()), static_cast<GLint>(i));
+      }
+    }
+
+    matrixShader.use();
+    glUniformMatrix4fv(glGetUniformLocation(matrixShader.ID, "projection"), 1, GL_FALSE, &matrix[0][0]);
+    glUniformMatrix4fv(glGetUniformLocation(matrixShader.ID, "view"), 1, GL_FALSE, &matrix[0][0]);
+    glUniformMatrix4fv(glGetUniformLocation(matrixShader.ID, "model"), 1, GL_FALSE, &matrix[0][0]);
+  });
+
+  // With cached locations: samplers are assigned once per shader, and
+  // matrices are set through handles resolved up front.
+  const auto projection = matrixShader.uniform("projection");
+  const auto view = matrixShader.uniform("view");
+  const auto modelUniform = matrixShader.uniform("model");
+
+  double byHandle = microsecondsPerFrame(numFrames, [&]() {
+    shader.use();
+    matrixShader.use();
+    matrixShader.setMat4(projection, matrix);
+    matrixShader.setMat4(view, matrix);
+    matrixShader.setMat4(modelUniform, matrix);
+  });
+
+  // What each frame costs now: the matrices go up in a single uniform
+  // buffer update, shared by every program.
+  CameraUniformBuffer cameraUniforms;
+  CameraUniformBuffer::attach(shader);
+
+  double byBlock = microsecondsPerFrame(numFrames, [&]() {
+    shader.use();
+    cameraUniforms.setProjection(matrix);
+    cameraUniforms.setView(matrix);
+    cameraUniforms.setModel(matrix);
+    cameraUniforms.flush();
+  });
+
+  fmt::print("Meshes: {}, frames: {}\n", model.meshes().size(), numFrames);
+  fmt::print("Uniform updates by name:   {:8.2f} us/frame\n", byName);
+  fmt::print("Uniform updates by handle: {:8.2f} us/frame  (saves {:.2f} us)\n", byHandle, byName - byHandle);
+  fmt::print("Camera uniform buffer:     {:8.2f} us/frame  (saves {:.2f} us)\n", byBlock, byName - byBlock);
+
+  return 0;
+}
@@ -95,14 +95,14 @@ int main() {
   // ------------------------
   // texture 1
   // ---------
-  GLTexture texture1("resources/learnopengl/textures/container.jpg", GL_RGB);
+  GLTexture texture1("resources/learnopengl/textures/container.jpg");
   if(!texture1.isLoaded()) {
     std::cout << "Failed to load texture" << std::endl;
     return -1;
   }
   // // texture 2
   // // ---------
-  GLTexture texture2("resources/learnopengl/textures/awesomeface.png", GL_RGBA);
+  GLTexture texture2("resources/learnopengl/textures/awesomeface.png");
   if(!texture2.isLoaded()) {
     std::cout << "Failed to load texture" << std::endl;
     return -1;
@@ -118,6 +118,8 @@ int main() {
   // -----------
   while (!window.shouldClose()) {
     window.processInput();
+    // applies any resize to the viewport
+    window.dispatchInput();
 
     // render
     // ------
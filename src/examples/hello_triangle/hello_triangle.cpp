@@ -62,8 +62,12 @@ int main() {
   // build and compile our shader program
   // ------------------------------------
 
-  // vertex shader
+  // issue every compile before checking any, so the driver can overlap them
   GLuint vertexShader = makeShader(vertexShaderSource, GL_VERTEX_SHADER);
+  GLuint fragmentShaderOne = makeShader(fragmentShaderSourceOne, GL_FRAGMENT_SHADER);
+  GLuint fragmentShaderTwo = makeShader(fragmentShaderSourceTwo, GL_FRAGMENT_SHADER);
+
+  // vertex shader
   if (auto error = checkShaderCompile(vertexShader); error) {
     std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << error.value() << std::endl;
     glfwTerminate();
@@ -71,31 +75,29 @@ int main() {
   }
 
   // fragment shader one
-  GLuint fragmentShaderOne = makeShader(fragmentShaderSourceOne, GL_FRAGMENT_SHADER);
   if (auto error = checkShaderCompile(fragmentShaderOne); error) {
     std::cout << "ERROR::SHADER::FRAGMENT_ONE::COMPILATION_FAILED\n" << error.value() << std::endl;
     glfwTerminate();
     return -1;
   }
 
-  // fragment shader one
-  GLuint fragmentShaderTwo = makeShader(fragmentShaderSourceTwo, GL_FRAGMENT_SHADER);
+  // fragment shader two
   if (auto error = checkShaderCompile(fragmentShaderTwo); error) {
     std::cout << "ERROR::SHADER::FRAGMENT_TWO::COMPILATION_FAILED\n" << error.value() << std::endl;
     glfwTerminate();
     return -1;
   }
 
-  // link shaders
+  // link shaders, again issuing both before checking
   GLuint shaderProgramOne = makeProgram({vertexShader, fragmentShaderOne});
+  GLuint shaderProgramTwo = makeProgram({vertexShader, fragmentShaderTwo});
+
   if (auto error = checkProgramLink(shaderProgramOne); error) {
-    std::cout << "ERROR::SHADER::PROGRAM_TWO::LINKING_FAILED\n" << error.value() << std::endl;
+    std::cout << "ERROR::SHADER::PROGRAM_ONE::LINKING_FAILED\n" << error.value() << std::endl;
     glfwTerminate();
     return -1;
   }
 
-  // link shaders
-  GLuint shaderProgramTwo = makeProgram({vertexShader, fragmentShaderTwo});
   if (auto error = checkProgramLink(shaderProgramTwo); error) {
     std::cout << "ERROR::SHADER::PROGRAM_TWO::LINKING_FAILED\n" << error.value() << std::endl;
     glfwTerminate();
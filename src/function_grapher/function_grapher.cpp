@@ -6,21 +6,25 @@
 // clang-format off
 #include "lib/function_grapher.h"
 
-// We need this for the model viewer code we're using.
-//
-// TODO: It would be nice to isolate this dependency,
-// since we're not actually using it here.
-//
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
-
 #include <fmt/core.h>
+
+#include <cmath>
+#include <memory>
+#include <string_view>
 // clang-format on
 
 // --------------------
 // Helper declarations.
 
-std::shared_ptr<Shader> loadShader();
+struct GrapherOptions {
+  // Graph animatedFunc, streaming its vertices each frame.
+  bool animate = false;
+};
+
+// Recognizes `--animate`.
+GrapherOptions parseGrapherOptions(int argc, char **argv);
+
+ShaderVariants makeShaderVariants();
 
 // --------------
 // Configuration.
@@ -33,16 +37,27 @@ static constexpr Config CONFIG{
 // A simple function to graph for testing mesh generation.
 static auto func = [](double x, double y) -> double { return 0.5 * (x * x + y * y); };
 
+// The same bowl, with ripples running across it over time t.
+static auto animatedFunc = [](double x, double y, double t) -> double {
+  return 0.5 * (x * x + y * y) + 0.05 * std::sin(8.0 * (x + y) - 2.0 * t);
+};
+
 // -------------
 // Program main.
 
-int main() {
+int main(int argc, char **argv) {
+  const BenchOptions benchOptions = parseBenchOptions(argc, argv);
+  const BatchOptions batchOptions = parseBatchOptions(argc, argv);
+  const GrapherOptions grapherOptions = parseGrapherOptions(argc, argv);
+  // Enables profiling, and writes the trace on exit, if asked to.
+  ProfileSession profileSession{parseProfileOptions(argc, argv)};
+
   fmt::print("Starting function grapher.\n");
 
   // Initialize GLFW window.
   GLFWWrapper window;
 
-  if (!window.init()) {
+  if (!window.init(benchOptions.headless)) {
     return -1;
   }
 
@@ -53,13 +68,18 @@ int main() {
     return -1;
   }
 
-  // Load shader.
-  auto ourShader = loadShader();
+  // Frame pacing and the fixed-timestep simulation clock. Benchmarks
+  // default to unlimited so vsync doesn't quantize their timings.
+  const PacingMode defaultPacing = benchOptions.enabled ? PacingMode::Unlimited : PacingMode::VSync;
+  FrameLoop frameLoop{parseFrameLoopOptions(argc, argv, defaultPacing)};
+  frameLoop.applyPacing();
 
-  if (!ourShader) {
-    return -1;
-  }
-  ourShader->use();
+  // Start compiling our shader, and let the driver work on it while we
+  // generate meshes.
+  ShaderVariants shaderVariants = makeShaderVariants();
+  ShaderBatch shaderBatch;
+  shaderVariants.request(0, shaderBatch);
+  shaderBatch.submit();
 
   // Generate meshes for function graph.
   FunctionMesh mesh{func};
@@ -67,22 +87,103 @@ int main() {
   mesh.printMeshData();
 
   // Set uo transformations.
-  Transformations transformations{ourShader, window.aspectRatio()};
+  Transformations transformations{window.aspectRatio()};
 
   // Set our standard resize and mouse event callbacks.
-  setCallbacks(window, transformations);
+  setCallbacks(window, transformations, frameLoop);
+
+  // With --watch-shaders, shader edits are picked up without a restart.
+  ShaderWatcher shaderWatcher{parseShaderWatchOptions(argc, argv), [&frameLoop]() { frameLoop.requestRedraw(); }};
+
+  // Draws are recorded here each frame, then sorted and submitted together.
+  RenderQueue renderQueue;
+
+  // The interactive loop picks our shader up once it's compiled; the
+  // scripted runs and the render thread wait for it here.
+  std::shared_ptr<Shader> ourShader;
+  if (benchOptions.enabled || batchOptions.enabled || frameLoop.usesRenderThread()) {
+    ourShader = collectShader(shaderVariants, 0, shaderWatcher, true);
+  }
+
+  // With --animate, the graph is rewritten every frame through a stream buffer.
+  std::unique_ptr<AnimatedFunctionMesh> animatedMesh;
+  if (grapherOptions.animate) {
+    animatedMesh = std::make_unique<AnimatedFunctionMesh>(animatedFunc, mesh.floorVertices());
+  }
+
+  auto submitGraph = [&]() {
+    if (!ourShader) {
+      return;
+    }
+    if (!animatedMesh) {
+      mesh.submit(renderQueue, *ourShader);
+      return;
+    }
+
+    mesh.submitFloor(renderQueue, *ourShader);
+    animatedMesh->submit(renderQueue, *ourShader, frameLoop.simulationTime());
+    // Always moving, so always due another frame.
+    frameLoop.requestRedraw();
+  };
+
+  // Scripted benchmark run, in place of the interactive loop.
+  if (benchOptions.enabled) {
+    return runBenchmark(benchOptions, "function_grapher", window, frameLoop, transformations, renderQueue, [&]() {
+      submitGraph();
+    });
+  }
+
+  // Render a turntable or list of poses to image files, and exit.
+  if (batchOptions.enabled) {
+    return runBatchRender(batchOptions, window, transformations, renderQueue, [&]() {
+      submitGraph();
+    });
+  }
+
+  // Events on this thread, rendering on another.
+  if (frameLoop.usesRenderThread()) {
+    return runWithRenderThread(window, frameLoop, transformations, renderQueue, CONFIG, [&]() {
+      shaderWatcher.applyPending();
+      submitGraph();
+    });
+  }
 
   // -----------------
   // Main render loop.
 
   while (!window.shouldClose()) {
+    // With --on-demand, sleep until something changes the picture.
+    if (!frameLoop.waitForRedraw()) {
+      window.processInput();
+      continue;
+    }
+
+    beginFrame(frameLoop);
     window.processInput();
+    // Apply camera changes from this frame's input in one go.
+    window.dispatchInput();
+    // Swap in shaders edited since last frame.
+    shaderWatcher.applyPending();
+    // Draw nothing until our shader has compiled, but keep checking.
+    if (!ourShader) {
+      ourShader = collectShader(shaderVariants, 0, shaderWatcher);
+      frameLoop.requestRedraw();
+    }
+
+    // Advance animation in fixed steps, independent of frame rate.
+    runSimulation(frameLoop, transformations, CONFIG);
 
     clearBuffers();
-    mesh.draw(ourShader.get());
+    // Upload camera matrices changed since last frame.
+    transformations.flushUniforms();
+
+    resetRenderQueue(renderQueue, transformations);
+    submitGraph();
+    renderQueue.execute();
 
     window.swapBuffers();
     GLFWWrapper::pollEvents();
+    endFrame(frameLoop);
   }
 
   // -----
@@ -94,10 +195,21 @@ int main() {
 // -------------------
 // Helper definitions.
 
-std::shared_ptr<Shader> loadShader() {
+GrapherOptions parseGrapherOptions(int argc, char **argv) {
+  GrapherOptions options;
+
+  for (int i = 1; i < argc; i++) {
+    if (std::string_view(argv[i]) == "--animate") {
+      options.animate = true;
+    }
+  }
+
+  return options;
+}
+
+ShaderVariants makeShaderVariants() {
   std::string vertexShaderPath = FileSystem::getPath("src/function_grapher/shaders/function_grapher.vs");
   std::string fragmentShaderPath = FileSystem::getPath("src/function_grapher/shaders/function_grapher.fs");
 
-  // Load shaders.
-  return std::make_shared<Shader>(vertexShaderPath.c_str(), fragmentShaderPath.c_str());
+  return ShaderVariants{vertexShaderPath, fragmentShaderPath, {}};
 }
@@ -0,0 +1,120 @@
+// Graph of a function z = f(x, y, t) that changes every frame.
+//
+// Rather than rebuild a static mesh each frame, we stream the graph's
+// vertices: each frame evaluates the function over the floor grid and
+// writes the results straight into mapped memory of a StreamBuffer, which
+// our VAO reads from. Nothing is copied or reallocated along the way.
+
+#ifndef ANIMATED_FUNCTION_MESH_H
+#define ANIMATED_FUNCTION_MESH_H
+
+// clang-format off
+#include "glad/glad.h"
+
+#include "lib/function_mesh.h"
+
+#include <fmt/core.h>
+
+#include <learnopengl/shader_m.h>
+#include <tools/gl_resources.h>
+#include <tools/gl_state.h>
+#include <tools/render_queue.h>
+#include <tools/stream_buffer.h>
+
+#include <vector>
+// clang-format on
+
+class AnimatedFunctionMesh {
+  using F = double (*)(double, double, double);
+
+  // x, y, z, u, v, as FunctionMesh lays its vertices out.
+  static constexpr std::size_t FLOATS_PER_VERTEX = 5;
+  static constexpr std::size_t STRIDE = FLOATS_PER_VERTEX * sizeof(float);
+
+public:
+  // Graphs func over the grid of floorVertices, as FunctionMesh builds it.
+  AnimatedFunctionMesh(const F func, const std::vector<float> &floorVertices)
+      : mFunc(func), mStream(floorVertices.size() * sizeof(float)) {
+    // Only x and z vary over the grid; height comes from the function.
+    mGrid.reserve(floorVertices.size() / FLOATS_PER_VERTEX * 2);
+    for (std::size_t i = 0; i < floorVertices.size(); i += FLOATS_PER_VERTEX) {
+      mGrid.push_back(floorVertices[i + 0]);
+      mGrid.push_back(floorVertices[i + 2]);
+    }
+    mCount = static_cast<GLsizei>(mGrid.size() / 2);
+
+    // Attributes read from offset 0; each frame's draw starts at the
+    // vertex its data was written to.
+    mVAO = GLVertexArrayHandle::create();
+    glState().bindVertexArray(mVAO.get());
+    glState().bindBuffer(GL_ARRAY_BUFFER, mStream.buffer());
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, STRIDE, (void *)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, STRIDE, (void *)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+  }
+
+  AnimatedFunctionMesh(const AnimatedFunctionMesh &) = delete;
+
+  ~AnimatedFunctionMesh() {
+    const auto &stats = mStream.stats();
+    fmt::print("Streamed {} frames of {} KiB ({} mapping): {} stalls, {:.2f} ms waiting.\n", stats.frames,
+               stats.highWater / 1024, mStream.persistent() ? "persistent" : "unsynchronized", stats.stalls.waits,
+               stats.stalls.waitMs);
+  }
+
+  // Writes the graph at time t into this frame's stream region, then
+  // records a draw of it.
+  void submit(RenderQueue &queue, const Shader &shader, double t) {
+    mStream.beginFrame();
+
+    const StreamBuffer::Allocation allocation = mStream.allocate(mCount * STRIDE, STRIDE);
+    // Written in order, never read: mapped memory may be write-combined.
+    auto *vertex = static_cast<float *>(allocation.data);
+    for (std::size_t i = 0; i < mGrid.size(); i += 2) {
+      const float x = mGrid[i];
+      const float z = mGrid[i + 1];
+      vertex[0] = x;
+      vertex[1] = static_cast<float>(mFunc(x, z, t));
+      vertex[2] = z;
+      vertex[3] = 0.0f;
+      vertex[4] = 0.0f;
+      vertex += FLOATS_PER_VERTEX;
+    }
+
+    mStream.flush();
+
+    if (shader.ID != mColorProgram) {
+      mColorUniform = shader.uniform("rgbaColor");
+      mColorProgram = shader.ID;
+    }
+    const UniformValue color =
+        UniformValue::makeVec4(shader.location(mColorUniform), FunctionMesh::FUNCTION_COLOR);
+
+    const auto first = static_cast<GLint>(allocation.offset / STRIDE);
+    DrawCall call{shader.ID, mVAO.get(), GL_TRIANGLES, first, mCount, false};
+    queue.submit(RenderPass::Opaque, call, CENTER, {}, {&color, 1});
+  }
+
+  [[nodiscard]] const StreamBuffer &stream() const { return mStream; }
+
+private:
+  // Middle of the unit square we graph over, for depth sorting.
+  static inline const glm::vec3 CENTER{0.5f, 0.0f, 0.5f};
+
+  F mFunc;
+  StreamBuffer mStream;
+
+  // x and z of each vertex.
+  std::vector<float> mGrid;
+  GLsizei mCount = 0;
+
+  GLVertexArrayHandle mVAO;
+
+  // Cached color uniform handle, and the program it belongs to.
+  Shader::Uniform mColorUniform{};
+  unsigned int mColorProgram = 0;
+};
+
+#endif // ANIMATED_FUNCTION_MESH_H
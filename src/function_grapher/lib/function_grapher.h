@@ -7,6 +7,7 @@
 
 #include "model_viewer/lib/model_viewer.h"
 
+#include "lib/animated_function_mesh.h"
 #include "lib/function_mesh.h"
 
 #endif //FUNCTION_GRAPHER_H
@@ -11,6 +11,8 @@
 #include <fmt/core.h>
 
 #include <learnopengl/shader_m.h>
+#include <tools/alloc_tracker.h>
+#include <tools/job_system.h>
 #include <tools/textured_mesh.h>
 // clang-format on
 
@@ -32,9 +34,14 @@ class FunctionMesh {
   using F = double (*)(double, double);
 
 public:
+  static inline const glm::vec4 FLOOR_COLOR{0.5f, 0.5f, 0.0f, 1.0f};
+  static inline const glm::vec4 FUNCTION_COLOR{1.0f, 0.0f, 0.0f, 1.0f};
+
   explicit FunctionMesh(const F func) : mFunc(func) { generateMesh(); }
 
   void generateMesh() {
+    AllocScope scope{AllocTag::Grapher};
+
     buildFloorMesh();
     computeFloorMeshVertices();
     computeFunctionMeshVertices();
@@ -51,20 +58,46 @@ public:
   }
 
   void draw(Shader *shader) const {
+    GLEX_PROFILE_SCOPE("FunctionMesh::draw");
+
     // NOTE: This makes assumptions about the shader it's used with.
-    shader->setVec4("rgbaColor", glm::vec4(0.5f, 0.5f, 0.0f, 1.0f));
+    shader->setVec4(colorUniform(*shader), FLOOR_COLOR);
     mFloorMesh->draw(shader);
-    shader->setVec4("rgbaColor", glm::vec4(1.0f, 0.0f, 0.0f, 1.0f));
+    shader->setVec4(colorUniform(*shader), FUNCTION_COLOR);
     mFunctionMesh->draw(shader);
   }
 
+  // Record draws of the floor and the graph, each with its color.
+  void submit(RenderQueue &queue, const Shader &shader) const {
+    submitFloor(queue, shader);
+
+    const UniformValue functionColor = UniformValue::makeVec4(shader.location(colorUniform(shader)), FUNCTION_COLOR);
+    mFunctionMesh->submit(queue, shader, {&functionColor, 1});
+  }
+
+  // Record a draw of just the floor, for when the graph is drawn elsewhere.
+  void submitFloor(RenderQueue &queue, const Shader &shader) const {
+    const UniformValue floorColor = UniformValue::makeVec4(shader.location(colorUniform(shader)), FLOOR_COLOR);
+    mFloorMesh->submit(queue, shader, {&floorColor, 1});
+  }
+
   std::vector<float> &floorVertices() { return mFloorMeshVertices; }
+  [[nodiscard]] const std::vector<float> &floorVertices() const { return mFloorMeshVertices; }
   std::vector<float> &functionVertices() { return mFunctionMeshVertices; }
 
   TexturedMesh &floorMesh() { return *mFloorMesh; }
   TexturedMesh &functionMesh() { return *mFunctionMesh; }
 
 private:
+  // Look up our color uniform only when the shader changes.
+  Shader::Uniform colorUniform(const Shader &shader) const {
+    if (shader.ID != mColorProgram) {
+      mColorUniform = shader.uniform("rgbaColor");
+      mColorProgram = shader.ID;
+    }
+    return mColorUniform;
+  }
+
   void buildFloorMesh() {
     mFloorMeshSquares.reserve(mNumCells * mNumCells);
     const double width = 1.0 / mNumCells;
@@ -147,18 +180,25 @@ private:
   }
 
   void computeFunctionMeshVertices() {
-    auto vertices = std::vector<float>{};
-    vertices.reserve(mFloorMeshVertices.size());
-
-    // Now update y-coordinates w/ function values.
-    for (std::size_t i = 0; i < mFloorMeshVertices.size(); i += 5) {
-      float x = mFloorMeshVertices[i + 0];
-      float z = mFloorMeshVertices[i + 2];
-
-      auto y = static_cast<float>(mFunc(x, z));
-
-      vertices.insert(vertices.end(), {x, y, z, 0.0, 0.0});
-    }
+    auto vertices = std::vector<float>(mFloorMeshVertices.size());
+
+    // Now update y-coordinates w/ function values. Each vertex is
+    // independent, so we sample them in parallel.
+    jobSystem().parallelFor(
+        0, mFloorMeshVertices.size() / 5,
+        [&](std::size_t first, std::size_t last) {
+          for (std::size_t i = first * 5; i < last * 5; i += 5) {
+            float x = mFloorMeshVertices[i + 0];
+            float z = mFloorMeshVertices[i + 2];
+
+            auto y = static_cast<float>(mFunc(x, z));
+
+            vertices[i + 0] = x;
+            vertices[i + 1] = y;
+            vertices[i + 2] = z;
+          }
+        },
+        MIN_SAMPLE_BATCH);
 
     mFunctionMeshVertices = std::move(vertices);
   }
@@ -170,6 +210,9 @@ private:
   // Number of subdivisions of x,y axes when creating cells.
   static constexpr int mNumCells = 100;
 
+  // Fewest vertices sampled per job.
+  static constexpr std::size_t MIN_SAMPLE_BATCH = 4096;
+
   // Squares that make up x,y-plane mesh.
   std::vector<Square> mFloorMeshSquares = {};
   // Vertices of triangular tessellation built from squares.
@@ -181,6 +224,10 @@ private:
   std::shared_ptr<TexturedMesh> mFloorMesh{};
   // Default is uninitialized.
   std::shared_ptr<TexturedMesh> mFunctionMesh{};
+
+  // Cached color uniform handle, and the program it belongs to.
+  mutable Shader::Uniform mColorUniform{};
+  mutable unsigned int mColorProgram = 0;
 };
 
 #endif // FUNCTION_MESH_H
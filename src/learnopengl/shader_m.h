@@ -5,46 +5,185 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <tools/gl_resources.h>
+#include <tools/gl_state.h>
+#include <tools/program_cache.h>
+#include <tools/shader_preprocessor.h>
 
-#include <fstream>
+#include <chrono>
+#include <filesystem>
+#include <functional>
 #include <iostream>
-#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 class Shader {
 public:
+  // Pre-resolved handle to a uniform. Get one with uniform(name) outside
+  // the render loop and pass it to the set functions to skip name lookups.
+  struct Uniform {
+    int slot = -1;
+  };
+
+  // Where a program's code came from, so it can be rebuilt when they change.
+  struct Sources {
+    std::filesystem::path vertexPath;
+    std::filesystem::path fragmentPath;
+    std::string defines;
+  };
+
   unsigned int ID;
-  // constructor generates the shader on the fly
-  // ------------------------------------------------------------------------
-  Shader(const char *vertexPath, const char *fragmentPath) {
-    // 1. retrieve the vertex/fragment source code from filePath
-    std::string vertexCode;
-    std::string fragmentCode;
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
-    // ensure ifstream objects can throw exceptions:
-    vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+  // constructor generates the shader on the fly, resolving #includes
+  // ------------------------------------------------------------------------
+  Shader(const char *vertexPath, const char *fragmentPath)
+      : Shader(readSource(vertexPath), readSource(fragmentPath),
+               std::filesystem::path(vertexPath).filename().string() + " + " +
+                   std::filesystem::path(fragmentPath).filename().string()) {
+    mSources = {vertexPath, fragmentPath, ""};
+  }
+  // constructor from preprocessed source code; defines only feed the cache key,
+  // since they're expected to be in the code already
+  // ------------------------------------------------------------------------
+  Shader(const std::string &vertexCode, const std::string &fragmentCode, const std::string &label,
+         const std::string &defines = "") {
+    // load the program from our binary cache, or compile it from source
+    const auto start = std::chrono::steady_clock::now();
+    ProgramCache &cache = ProgramCache::instance();
+    const ProgramCache::Key key = cache.makeKey(vertexCode, fragmentCode, defines);
+    ID = cache.load(key);
+    const bool cached = ID != 0;
+    if (!cached) {
+      ID = compileProgram(vertexCode.c_str(), fragmentCode.c_str());
+      cache.store(key, ID);
+    }
+    mProgram = GLProgramHandle::adopt(ID);
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    cache.report(label, cached, elapsed.count());
+    // resolve all active uniform locations once, up front
+    cacheActiveUniforms();
+  }
+  // constructor adopting a program that's already linked, e.g. by ShaderBatch
+  // ------------------------------------------------------------------------
+  explicit Shader(GLuint linkedProgram) : ID(linkedProgram), mProgram(GLProgramHandle::adopt(linkedProgram)) {
+    cacheActiveUniforms();
+  }
+  // activate the shader
+  // ------------------------------------------------------------------------
+  void use() const { glState().useProgram(ID); }
+  // uniform handle lookup
+  // ------------------------------------------------------------------------
+  Uniform uniform(std::string_view name) const {
+    if (auto it = mUniformSlots.find(name); it != mUniformSlots.end()) {
+      return {it->second};
+    }
+    // Not an active uniform; remember the name so later lookups stay cheap.
+    return {addSlot(name, glGetUniformLocation(ID, std::string(name).c_str()))};
+  }
+  // point the named uniform block, if this program has it, at a binding point
+  // ------------------------------------------------------------------------
+  void bindUniformBlock(const char *name, GLuint binding) const {
+    // remembered so a reloaded program gets the same bindings
+    mBlockBindings.emplace_back(name, binding);
+    applyBlockBinding(name, binding);
+  }
+  // source files, if we know them; empty paths for code handed to us directly
+  // ------------------------------------------------------------------------
+  const Sources &sources() const { return mSources; }
+  void setSources(Sources sources) { mSources = std::move(sources); }
+  // swap in a program built from new code, keeping handed-out uniform handles
+  // and block bindings valid; on failure, errors are printed and we keep the
+  // current program. Needs the GL context, like everything else here.
+  // ------------------------------------------------------------------------
+  bool reload(const std::string &vertexCode, const std::string &fragmentCode) {
+    ProgramCache &cache = ProgramCache::instance();
+    const ProgramCache::Key key = cache.makeKey(vertexCode, fragmentCode, mSources.defines);
+    GLuint program = cache.load(key);
+    if (program == 0) {
+      program = compileProgram(vertexCode.c_str(), fragmentCode.c_str());
+      GLint linked = GL_FALSE;
+      glGetProgramiv(program, GL_LINK_STATUS, &linked);
+      if (!linked) {
+        glDeleteProgram(program);
+        return false;
+      }
+      cache.store(key, program);
+    }
+
+    // the previous program is deleted at the next safe point
+    mProgram = GLProgramHandle::adopt(program);
+    ID = program;
+    for (const auto &[name, binding] : mBlockBindings) {
+      applyBlockBinding(name.c_str(), binding);
+    }
+    // existing slots point at their new locations, and new uniforms get slots
+    for (const auto &[name, slot] : mUniformSlots) {
+      mUniformLocations[slot] = glGetUniformLocation(ID, name.c_str());
+    }
+    cacheActiveUniforms();
+    return true;
+  }
+  // ------------------------------------------------------------------------
+  GLint location(Uniform uniform) const { return uniform.slot < 0 ? -1 : mUniformLocations[uniform.slot]; }
+  // utility uniform functions
+  // ------------------------------------------------------------------------
+  void setBool(Uniform uniform, bool value) const { glUniform1i(location(uniform), (int)value); }
+  void setBool(std::string_view name, bool value) const { setBool(uniform(name), value); }
+  // ------------------------------------------------------------------------
+  void setInt(Uniform uniform, int value) const { glUniform1i(location(uniform), value); }
+  void setInt(std::string_view name, int value) const { setInt(uniform(name), value); }
+  // ------------------------------------------------------------------------
+  void setFloat(Uniform uniform, float value) const { glUniform1f(location(uniform), value); }
+  void setFloat(std::string_view name, float value) const { setFloat(uniform(name), value); }
+  // ------------------------------------------------------------------------
+  void setVec2(Uniform uniform, const glm::vec2 &value) const { glUniform2fv(location(uniform), 1, &value[0]); }
+  void setVec2(std::string_view name, const glm::vec2 &value) const { setVec2(uniform(name), value); }
+  void setVec2(std::string_view name, float x, float y) const { glUniform2f(location(uniform(name)), x, y); }
+  // ------------------------------------------------------------------------
+  void setVec3(Uniform uniform, const glm::vec3 &value) const { glUniform3fv(location(uniform), 1, &value[0]); }
+  void setVec3(std::string_view name, const glm::vec3 &value) const { setVec3(uniform(name), value); }
+  void setVec3(std::string_view name, float x, float y, float z) const {
+    glUniform3f(location(uniform(name)), x, y, z);
+  }
+  // ------------------------------------------------------------------------
+  void setVec4(Uniform uniform, const glm::vec4 &value) const { glUniform4fv(location(uniform), 1, &value[0]); }
+  void setVec4(std::string_view name, const glm::vec4 &value) const { setVec4(uniform(name), value); }
+  void setVec4(std::string_view name, float x, float y, float z, float w) const {
+    glUniform4f(location(uniform(name)), x, y, z, w);
+  }
+  // ------------------------------------------------------------------------
+  void setMat2(Uniform uniform, const glm::mat2 &mat) const {
+    glUniformMatrix2fv(location(uniform), 1, GL_FALSE, &mat[0][0]);
+  }
+  void setMat2(std::string_view name, const glm::mat2 &mat) const { setMat2(uniform(name), mat); }
+  // ------------------------------------------------------------------------
+  void setMat3(Uniform uniform, const glm::mat3 &mat) const {
+    glUniformMatrix3fv(location(uniform), 1, GL_FALSE, &mat[0][0]);
+  }
+  void setMat3(std::string_view name, const glm::mat3 &mat) const { setMat3(uniform(name), mat); }
+  // ------------------------------------------------------------------------
+  void setMat4(Uniform uniform, const glm::mat4 &mat) const {
+    glUniformMatrix4fv(location(uniform), 1, GL_FALSE, &mat[0][0]);
+  }
+  void setMat4(std::string_view name, const glm::mat4 &mat) const { setMat4(uniform(name), mat); }
+
+private:
+  // retrieve a shader's source code from its file, with includes resolved
+  // ------------------------------------------------------------------------
+  static std::string readSource(const char *path) {
     try {
-      // open files
-      vShaderFile.open(vertexPath);
-      fShaderFile.open(fragmentPath);
-      std::stringstream vShaderStream, fShaderStream;
-      // read file's buffer contents into streams
-      vShaderStream << vShaderFile.rdbuf();
-      fShaderStream << fShaderFile.rdbuf();
-      // close file handlers
-      vShaderFile.close();
-      fShaderFile.close();
-      // convert stream into string
-      vertexCode = vShaderStream.str();
-      fragmentCode = fShaderStream.str();
-    } catch (std::ifstream::failure &e) {
+      return ShaderPreprocessor::process(path).code;
+    } catch (const std::runtime_error &e) {
       std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
+      return {};
     }
-    const char *vShaderCode = vertexCode.c_str();
-    const char *fShaderCode = fragmentCode.c_str();
-    // 2. compile shaders
+  }
+  // compile and link a program from source
+  // ------------------------------------------------------------------------
+  static GLuint compileProgram(const char *vShaderCode, const char *fShaderCode) {
     unsigned int vertex, fragment;
     // vertex shader
     vertex = glCreateShader(GL_VERTEX_SHADER);
@@ -57,66 +196,80 @@ public:
     glCompileShader(fragment);
     checkCompileErrors(fragment, "FRAGMENT");
     // shader Program
-    ID = glCreateProgram();
-    glAttachShader(ID, vertex);
-    glAttachShader(ID, fragment);
-    glLinkProgram(ID);
-    checkCompileErrors(ID, "PROGRAM");
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragment);
+    // ask the driver to keep the binary, for our cache
+    ProgramCache::instance().prepareForStore(program);
+    glLinkProgram(program);
+    checkCompileErrors(program, "PROGRAM");
     // delete the shaders as they're linked into our program now and no longer necessary
     glDeleteShader(vertex);
     glDeleteShader(fragment);
-  }
-  // activate the shader
-  // ------------------------------------------------------------------------
-  void use() const { glUseProgram(ID); }
-  // utility uniform functions
-  // ------------------------------------------------------------------------
-  void setBool(const std::string &name, bool value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
-  }
-  // ------------------------------------------------------------------------
-  void setInt(const std::string &name, int value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
-  }
-  // ------------------------------------------------------------------------
-  void setFloat(const std::string &name, float value) const {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    return program;
   }
   // ------------------------------------------------------------------------
-  void setVec2(const std::string &name, const glm::vec2 &value) const {
-    glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
-  }
-  void setVec2(const std::string &name, float x, float y) const {
-    glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
-  }
-  // ------------------------------------------------------------------------
-  void setVec3(const std::string &name, const glm::vec3 &value) const {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
-  }
-  void setVec3(const std::string &name, float x, float y, float z) const {
-    glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
-  }
-  // ------------------------------------------------------------------------
-  void setVec4(const std::string &name, const glm::vec4 &value) const {
-    glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
-  }
-  void setVec4(const std::string &name, float x, float y, float z, float w) const {
-    glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+  void applyBlockBinding(const char *name, GLuint binding) const {
+    GLuint blockIndex = glGetUniformBlockIndex(ID, name);
+    if (blockIndex != GL_INVALID_INDEX) {
+      glUniformBlockBinding(ID, blockIndex, binding);
+    }
   }
+  // query the linked program for its active uniforms and cache their locations
   // ------------------------------------------------------------------------
-  void setMat2(const std::string &name, const glm::mat2 &mat) const {
-    glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+  void cacheActiveUniforms() {
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    std::string name(maxLength, '\0');
+    for (GLint i = 0; i < count; i++) {
+      GLsizei length = 0;
+      GLint size = 0;
+      GLenum type = 0;
+      glGetActiveUniform(ID, i, maxLength, &length, &size, &type, name.data());
+
+      const std::string uniformName = name.substr(0, length);
+      GLint uniformLocation = glGetUniformLocation(ID, uniformName.c_str());
+      // members of uniform blocks have no location of their own
+      if (uniformLocation < 0) {
+        continue;
+      }
+      addSlot(uniformName, uniformLocation);
+      // arrays are reported as "name[0]", but we also want to find them by "name"
+      if (uniformName.ends_with("[0]")) {
+        addSlot(std::string_view(uniformName).substr(0, length - 3), uniformLocation);
+      }
+    }
   }
   // ------------------------------------------------------------------------
-  void setMat3(const std::string &name, const glm::mat3 &mat) const {
-    glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+  int addSlot(std::string_view name, GLint uniformLocation) const {
+    // names keep their slot across reloads
+    if (auto it = mUniformSlots.find(name); it != mUniformSlots.end()) {
+      mUniformLocations[it->second] = uniformLocation;
+      return it->second;
+    }
+    const int slot = static_cast<int>(mUniformLocations.size());
+    mUniformLocations.push_back(uniformLocation);
+    mUniformSlots.emplace(std::string(name), slot);
+    return slot;
   }
+  // transparent hash so lookups by string_view don't allocate
   // ------------------------------------------------------------------------
-  void setMat4(const std::string &name, const glm::mat4 &mat) const {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
-  }
+  struct NameHash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+  };
+
+  mutable std::unordered_map<std::string, int, NameHash, std::equal_to<>> mUniformSlots;
+  mutable std::vector<GLint> mUniformLocations;
+  mutable std::vector<std::pair<std::string, GLuint>> mBlockBindings;
+
+  // owns the program ID names
+  GLProgramHandle mProgram;
+  Sources mSources;
 
-private:
   // utility function for checking shader compilation/linking errors.
   // ------------------------------------------------------------------------
   static void checkCompileErrors(GLuint shader, std::string type) {
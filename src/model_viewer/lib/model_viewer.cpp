@@ -11,7 +11,18 @@
 
 #include "models/models.h"
 
+#include <fmt/core.h>
 #include <learnopengl/filesystem.h>
+#include <tools/alloc_tracker.h>
+#include <tools/offscreen_target.h>
+#include <tools/render_thread.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <numbers>
 // clang-format on
 
 // -------------------
@@ -24,10 +35,13 @@ bool configureGL(const Config& config) {
     return false; // Early return.
   }
 
+  // Route our state changes through the cache from here on.
+  glState().setFunctions(GLFunctions::fromGlad());
+
   if (config.wireframe) {
-    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    glState().polygonMode(GL_LINE);
   } else {
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glState().polygonMode(GL_FILL);
   }
 
   glEnable(GL_DEPTH_TEST);
@@ -35,24 +49,24 @@ bool configureGL(const Config& config) {
   return true;
 }
 
-ShaderAndModels loadShaderAndModels() {
+ShaderVariants makeModelViewerShaders() {
   std::string vertexShaderPath = FileSystem::getPath("src/model_viewer/shaders/model_viewer.vs");
   std::string fragmentShaderPath = FileSystem::getPath("src/model_viewer/shaders/model_viewer.fs");
 
-  // Load shaders.
-  auto ourShader = std::make_shared<Shader>(vertexShaderPath.c_str(), fragmentShaderPath.c_str());
+  return ShaderVariants{vertexShaderPath, fragmentShaderPath, {}};
+}
 
+TexturedModels loadModels() {
   // Load textures.
-  auto texture1 = std::make_shared<GLTexture>("resources/textures/Bricks098_2K-JPG_Color.jpg", GL_RGB);
-  auto texture2 = std::make_shared<GLTexture>("resources/learnopengl/textures/container.jpg", GL_RGB);
+  auto texture1 = std::make_shared<GLTexture>("resources/textures/Bricks098_2K-JPG_Color.jpg");
+  auto texture2 = std::make_shared<GLTexture>("resources/learnopengl/textures/container.jpg");
 
   if (!texture1->isLoaded() || !texture2->isLoaded()) {
     std::cout << "Failed to load texture" << std::endl;
 
-    return {nullptr, nullptr, nullptr}; // Early return.
+    return {nullptr, nullptr}; // Early return.
   }
 
-  ourShader->use();
   // Load model
   auto model1 = std::make_shared<TexturedMesh>(texture2, models::cubeModel);
   auto model2 = std::make_shared<TexturedMesh>(texture1, models::planeModel);
@@ -61,13 +75,33 @@ ShaderAndModels loadShaderAndModels() {
   model1->bindTexture(0);
   model2->bindTexture(1);
 
-  return {ourShader, model1, model2};
+  return {model1, model2};
 }
 
-void setCallbacks(GLFWWrapper &window, Transformations &transformations) {
-  // Set our resize callback that updates the projection.
-  window.callbackInterface().mUserResizeCallback = [&window, &transformations](float, float) {
-    transformations.updateProjectionTransformation(window.aspectRatio());
+std::shared_ptr<Shader> collectShader(ShaderVariants &shaders, ShaderVariants::FeatureMask mask,
+                                      ShaderWatcher &watcher, bool wait) {
+  auto shader = wait ? shaders.get(mask) : shaders.tryGet(mask);
+
+  if (shader) {
+    shader->use();
+    Transformations::attachShader(*shader);
+    watcher.watch(shader);
+  }
+
+  return shader;
+}
+
+void setCallbacks(GLFWWrapper &window, Transformations &transformations, FrameLoop &frameLoop) {
+  // Redraw on demand whenever the callbacks below change the view.
+  window.callbackInterface().mRedrawCallback = [&frameLoop]() { frameLoop.requestRedraw(); };
+
+  // Set our resize callback that updates the projection. This only uses
+  // its arguments, since it may run on a render thread.
+  window.callbackInterface().mUserResizeCallback = [&transformations](float width, float height) {
+    // Skip the zero-size framebuffer of a minimized window.
+    if (width > 0.0f && height > 0.0f) {
+      transformations.updateProjectionTransformation(width / height);
+    }
   };
 
   // Set the click-and-drag rotation callback.
@@ -77,19 +111,56 @@ void setCallbacks(GLFWWrapper &window, Transformations &transformations) {
   };
 
   // Set mouse wheel zoom callback.
-  window.callbackInterface().mUserMouseScrollCallback = [&window, &transformations](double, double yDelta) {
+  window.callbackInterface().mUserMouseScrollCallback = [&transformations](double, double yDelta) {
     transformations.updateFoV(yDelta);
-    transformations.updateProjectionTransformation(window.aspectRatio());
+    transformations.updateProjectionTransformation();
   };
 }
 
-void constantRotation(Transformations &transformations) {
-  // Rotates the model by a fixed amount on each call.
-  // Right now this is not tied to a clock, so the rotation
-  // speed will be different on each system. (We'll fix that.)
-  transformations.updateModelTransformation();
-  // Rotate by constant amount around x- and y-axes.
-  transformations.rotateViewTransformation(0.01, 0.0);
+void beginFrame(FrameLoop &frameLoop) {
+  allocationTracker().beginFrame();
+  frameLoop.beginFrame();
+  if (frameLoop.printedStats()) {
+    glResources().printReport("live");
+    allocationTracker().printFrameSummary();
+  }
+  glState().beginFrame();
+  glResources().collect();
+  // Upload this frame's share of textures still streaming in.
+  if (textureStreamer().update()) {
+    frameLoop.requestRedraw();
+  }
+  Profiler::instance().beginFrame();
+}
+
+void endFrame(FrameLoop &frameLoop) {
+  Profiler::instance().endFrame();
+  frameLoop.endFrame();
+}
+
+void runSimulation(FrameLoop &frameLoop, Transformations &transformations, const Config &config) {
+  while (frameLoop.stepSimulation()) {
+    if (config.constantRotation) {
+      constantRotation(transformations, frameLoop.timestep());
+    }
+  }
+
+  if (config.constantRotation) {
+    transformations.interpolateModelTransformation(frameLoop.interpolationAlpha());
+    // The scene is never static, so we always want the next frame.
+    frameLoop.requestRedraw();
+  }
+}
+
+void constantRotation(Transformations &transformations, double dt) {
+  // Camera tilt rate, in radians per second.
+  constexpr double VIEW_SPIN_RATE = 0.6;
+
+  // Spin the model, which is interpolated when drawn.
+  transformations.advanceModelAnimation(dt);
+  // Rotate the camera around the x-axis. This one changes at the
+  // simulation rate, since user drags also accumulate into it.
+  transformations.rotateViewTransformation(static_cast<float>(VIEW_SPIN_RATE * dt), 0.0f);
   transformations.updateViewTransformation();
 }
 
@@ -101,3 +172,216 @@ void clearBuffers() {
   glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
+
+void resetRenderQueue(RenderQueue &queue, const Transformations &transformations) {
+  queue.reset(transformations.viewMatrix() * transformations.modelMatrix(), Transformations::NEAR_PLANE,
+              Transformations::FAR_PLANE);
+}
+
+// --------------
+// Render thread.
+
+int runWithRenderThread(GLFWWrapper &window, FrameLoop &frameLoop, Transformations &transformations,
+                        RenderQueue &queue, const Config &config, const std::function<void()> &submitFrame) {
+  RenderThread renderThread{window, frameLoop};
+
+  renderThread.start([&](const InputSnapshot &input) {
+    beginFrame(frameLoop);
+    window.applyInput(input);
+    runSimulation(frameLoop, transformations, config);
+
+    clearBuffers();
+    transformations.flushUniforms();
+    resetRenderQueue(queue, transformations);
+    submitFrame();
+    queue.execute();
+
+    window.swapBuffers();
+    endFrame(frameLoop);
+  });
+
+  // Only handle events here, passing input along as it arrives.
+  while (!window.shouldClose() && !renderThread.failed()) {
+    GLFWWrapper::waitEvents();
+    window.processInput();
+    renderThread.pushInput(window.takeInput());
+  }
+
+  try {
+    renderThread.stop();
+  } catch (const std::exception &e) {
+    fmt::print("Render thread failed: {}\n", e.what());
+    return -1;
+  }
+
+  const auto &latency = renderThread.latency();
+  fmt::print("Input to swap latency over {} frames ({} events): mean {:.2f} ms, max {:.2f} ms, queue full {} times.\n",
+             latency.frames, latency.events, latency.meanMs, latency.maxMs, latency.queueFull);
+
+  return 0;
+}
+
+// ----------------------
+// Scripted benchmarking.
+
+int runBenchmark(const BenchOptions &options, const std::string &app, GLFWWrapper &window, FrameLoop &frameLoop,
+                 Transformations &transformations, RenderQueue &queue, const std::function<void()> &submitFrame) {
+  // With no window system there's no default framebuffer worth drawing to.
+  std::unique_ptr<OffscreenTarget> offscreen;
+  if (window.isHeadless()) {
+    const auto [width, height] = window.dimensions();
+    offscreen = std::make_unique<OffscreenTarget>(static_cast<int>(width), static_cast<int>(height));
+    offscreen->bind();
+  }
+
+  // Time full resolution frames, not streaming.
+  textureStreamer().finish();
+
+  FrameBenchmark benchmark{options.frames};
+
+  // Per-frame steps of our camera path: one full turn around the
+  // y-axis with a slow tilt, while zooming in and back out.
+  const float turnStep = 2.0f * std::numbers::pi_v<float> / static_cast<float>(options.frames);
+  const float tiltStep = 0.25f * turnStep;
+
+  while (!benchmark.done()) {
+    beginFrame(frameLoop);
+    // Keep simulated time moving, for animation that reads it.
+    while (frameLoop.stepSimulation()) {
+    }
+
+    const float phase = static_cast<float>(benchmark.frame()) * turnStep;
+    transformations.rotateViewTransformation(tiltStep, turnStep);
+    transformations.updateViewTransformation();
+    transformations.updateFoV(0.2 * std::cos(phase));
+    transformations.updateProjectionTransformation(window.aspectRatio());
+
+    benchmark.beginFrame();
+
+    clearBuffers();
+    transformations.flushUniforms();
+    resetRenderQueue(queue, transformations);
+    submitFrame();
+    queue.execute();
+
+    const auto &calls = glState().frameCounters();
+    benchmark.endSubmission(queue.stats().draws, calls.issued, calls.elided);
+
+    window.swapBuffers();
+    GLFWWrapper::pollEvents();
+
+    benchmark.endFrame();
+    endFrame(frameLoop);
+  }
+
+  const std::string report = benchmark.report(app, window.isHeadless());
+
+  if (options.outputPath.empty()) {
+    fmt::print("{}", report);
+  } else {
+    std::ofstream file{options.outputPath};
+    file << report;
+
+    if (!file) {
+      fmt::print("Failed to write benchmark report to {}.\n", options.outputPath);
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+// ----------------
+// Batch rendering.
+
+int runBatchRender(const BatchOptions &options, GLFWWrapper &window, Transformations &transformations,
+                   RenderQueue &queue, const std::function<void()> &submitFrame) {
+  std::vector<CameraPose> poses;
+  try {
+    poses = options.posesPath.empty() ? turntablePoses(options.turntableFrames) : loadPoses(options.posesPath);
+  } catch (const std::runtime_error &e) {
+    fmt::print("{}\n", e.what());
+    return -1;
+  }
+
+  std::error_code error;
+  std::filesystem::create_directories(options.outputDirectory, error);
+  if (error) {
+    fmt::print("Can't create {}: {}\n", options.outputDirectory.string(), error.message());
+    return -1;
+  }
+
+  const auto [windowWidth, windowHeight] = window.dimensions();
+  const int width = options.width > 0 ? options.width : static_cast<int>(windowWidth);
+  const int height = options.height > 0 ? options.height : static_cast<int>(windowHeight);
+  const std::size_t rowBytes = static_cast<std::size_t>(width) * 4;
+
+  // Always offscreen, so the image size needn't match the window's.
+  OffscreenTarget target{width, height};
+  target.bind();
+  transformations.updateProjectionTransformation(static_cast<float>(width) / static_cast<float>(height));
+
+  // Every image should show textures at full resolution.
+  textureStreamer().finish();
+
+  ImageEncoderPool encoders{options.format};
+  ReadbackRing readback{width, height};
+  const char *extension = options.format == ImageFormat::Png ? "png" : "rgba";
+
+  // Copy each finished frame out of its mapped buffer, top row first, and
+  // let it encode while we carry on rendering.
+  auto onReady = [&](std::size_t frame, const std::uint8_t *pixels) {
+    EncodeJob job{options.outputDirectory / fmt::format("frame_{:05}.{}", frame, extension), width, height,
+                  encoders.acquireBuffer(rowBytes * height)};
+    for (int row = 0; row < height; row++) {
+      std::memcpy(job.pixels.data() + row * rowBytes, pixels + (height - 1 - row) * rowBytes, rowBytes);
+    }
+    encoders.submit(std::move(job));
+  };
+
+  const auto start = std::chrono::steady_clock::now();
+
+  for (std::size_t frame = 0; frame < poses.size(); frame++) {
+    const CameraPose &pose = poses[frame];
+    glState().beginFrame();
+    glResources().collect();
+
+    transformations.setViewOrientation(pose.yaw, pose.pitch);
+    transformations.updateViewTransformation();
+    transformations.setFoV(pose.fov);
+    transformations.updateProjectionTransformation();
+
+    clearBuffers();
+    transformations.flushUniforms();
+    resetRenderQueue(queue, transformations);
+    submitFrame();
+    queue.execute();
+
+    readback.read(frame, onReady);
+    // Take whatever earlier reads have landed, without waiting.
+    readback.collect(onReady, false);
+
+    GLFWWrapper::pollEvents();
+  }
+
+  readback.waitAll(onReady);
+  const std::chrono::duration<double> renderTime = std::chrono::steady_clock::now() - start;
+  encoders.finish();
+  const std::chrono::duration<double> totalTime = std::chrono::steady_clock::now() - start;
+
+  const auto stats = encoders.stats();
+  const double frames = static_cast<double>(poses.size());
+  fmt::print("Wrote {} {}x{} images to {} in {:.2f} s: {:.1f} images/s ({:.1f} rendered/s).\n", stats.written, width,
+             height, options.outputDirectory.string(), totalTime.count(), frames / totalTime.count(),
+             frames / renderTime.count());
+  fmt::print("{} job threads at {:.2f} ms/image, queue full {} times; waited on readback {} times ({:.2f} ms).\n",
+             jobSystem().threads(), stats.written > 0 ? stats.encodeMs / static_cast<double>(stats.written) : 0.0,
+             stats.stalls, readback.waits().waits, readback.waits().waitMs);
+
+  if (stats.written != poses.size()) {
+    fmt::print("Only {} of {} images were written.\n", stats.written, poses.size());
+    return -1;
+  }
+
+  return 0;
+}
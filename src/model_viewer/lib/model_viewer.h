@@ -9,8 +9,18 @@
 #include "tools/textured_mesh.h"
 
 #include <learnopengl/shader_m.h>
+#include <tools/batch_render.h>
+#include <tools/frame_benchmark.h>
+#include <tools/frame_loop.h>
 #include <tools/glfw_wrapper.h>
+#include <tools/render_queue.h>
+#include <tools/shader_variants.h>
+#include <tools/shader_watcher.h>
+#include <tools/texture_streamer.h>
 #include <tools/transformations.h>
+
+#include <functional>
+#include <string>
 // clang-format on
 
 // ---------------------
@@ -19,6 +29,8 @@
 struct Config {
   bool wireframe = true;
   bool constantRotation = false;
+  // Assimp viewer only: pack model textures into array textures.
+  bool packTextureArrays = false;
 };
 
 // --------------------
@@ -26,22 +38,70 @@ struct Config {
 
 class TexturedMesh;
 
-struct ShaderAndModels {
-  std::shared_ptr<Shader> mShader;
-
+struct TexturedModels {
   std::shared_ptr<TexturedMesh> mModel1;
   std::shared_ptr<TexturedMesh> mModel2;
 
-  [[nodiscard]] bool isOkay() const { return mShader && mModel1 && mModel2; }
+  [[nodiscard]] bool isOkay() const { return mModel1 && mModel2; }
 };
 
-ShaderAndModels loadShaderAndModels();
+// The model_viewer shader, which has no optional features.
+ShaderVariants makeModelViewerShaders();
+
+TexturedModels loadModels();
 
-void setCallbacks(GLFWWrapper &window, Transformations &transformations);
+// The mask variant of shaders, attached to our camera uniforms and
+// watched for edits, once its batch is done with it; null until then.
+// Polls without blocking, unless wait is set.
+std::shared_ptr<Shader> collectShader(ShaderVariants &shaders, ShaderVariants::FeatureMask mask,
+                                      ShaderWatcher &watcher, bool wait = false);
+
+// Sets camera controls, and has any change they make request a redraw.
+void setCallbacks(GLFWWrapper &window, Transformations &transformations, FrameLoop &frameLoop);
 
 bool configureGL(const Config &config);
 void clearBuffers();
 
-void constantRotation(Transformations &transformations);
+// Starts recording a frame, sorting by depth from the current camera.
+void resetRenderQueue(RenderQueue &queue, const Transformations &transformations);
+
+// Renders options.frames frames along a scripted camera path, calling
+// submitFrame to record each one, and reports timings as JSON. Headless
+// runs render into an offscreen framebuffer. The camera path advances per
+// frame rather than by the clock, so runs are repeatable; frameLoop only
+// paces them. Returns the exit code.
+int runBenchmark(const BenchOptions &options, const std::string &app, GLFWWrapper &window, FrameLoop &frameLoop,
+                 Transformations &transformations, RenderQueue &queue, const std::function<void()> &submitFrame);
+
+// Renders each pose of a turntable or pose file into an offscreen
+// framebuffer, calling submitFrame to record each one, and writes them to
+// numbered image files. Reports images per second. Returns the exit code.
+int runBatchRender(const BatchOptions &options, GLFWWrapper &window, Transformations &transformations,
+                   RenderQueue &queue, const std::function<void()> &submitFrame);
+
+// Runs the interactive loop with rendering on a render thread, while this
+// thread only handles events, until the window closes. submitFrame records
+// each frame, on the render thread. Returns the exit code.
+int runWithRenderThread(GLFWWrapper &window, FrameLoop &frameLoop, Transformations &transformations,
+                        RenderQueue &queue, const Config &config, const std::function<void()> &submitFrame);
+
+// Starts a frame on the GL thread: begins frameLoop's frame and the
+// profiler's, ends the last frame's allocation count, resets the state
+// cache's counters, deletes released GL objects and uploads this frame's
+// share of streaming textures, asking for another frame while any are
+// still coming in. With frameLoop's stats it also prints live GL memory
+// and frame allocations.
+void beginFrame(FrameLoop &frameLoop);
+
+// Ends a frame begun with beginFrame(), waiting out a capped frame.
+void endFrame(FrameLoop &frameLoop);
+
+// Takes the fixed simulation steps due this frame, then interpolates
+// animated transformations for rendering. While animating, this keeps
+// requesting redraws.
+void runSimulation(FrameLoop &frameLoop, Transformations &transformations, const Config &config);
+
+// Advances constant rotation by one simulation step of dt seconds.
+void constantRotation(Transformations &transformations, double dt);
 
 #endif // MODEL_VIEWER_H
@@ -8,10 +8,6 @@
 // clang-format off
 #include "lib/model_viewer.h"
 
-// We need this define and include combination exactly once.
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
-
 #include <learnopengl/filesystem.h>
 #include <tools/model_data.h>
 // clang-format on
@@ -22,6 +18,7 @@
 static constexpr Config CONFIG{
     .wireframe = true,
     .constantRotation = false,
+    .packTextureArrays = false,
 };
 
 static const auto modelPath = std::string(project_root) + "/resources/learnopengl/backpack.obj";
@@ -29,16 +26,21 @@ static const auto modelPath = std::string(project_root) + "/resources/learnopeng
 // ---------------------
 // Helpers declarations.
 
-std::shared_ptr<Shader> loadShader();
+ShaderVariants makeShaderVariants();
 
 // -------------
 // Program main.
 
-int main() {
+int main(int argc, char **argv) {
+  const BenchOptions benchOptions = parseBenchOptions(argc, argv);
+  const BatchOptions batchOptions = parseBatchOptions(argc, argv);
+  // Enables profiling, and writes the trace on exit, if asked to.
+  ProfileSession profileSession{parseProfileOptions(argc, argv)};
+
   // Initialize GLFW window.
   GLFWWrapper window;
 
-  if (!window.init()) {
+  if (!window.init(benchOptions.headless)) {
     return -1;
   }
 
@@ -49,38 +51,107 @@ int main() {
     return -1;
   }
 
-  // Load shader.
-  auto ourShader = loadShader();
+  // With --stream-textures, textures load progressively over the first frames.
+  textureStreamer().configure(parseTextureStreamOptions(argc, argv));
 
-  if (!ourShader) {
-    return -1;
-  }
-  ourShader->use();
+  // Frame pacing and the fixed-timestep simulation clock. Benchmarks
+  // default to unlimited so vsync doesn't quantize their timings.
+  const PacingMode defaultPacing = benchOptions.enabled ? PacingMode::Unlimited : PacingMode::VSync;
+  FrameLoop frameLoop{parseFrameLoopOptions(argc, argv, defaultPacing)};
+  frameLoop.applyPacing();
+
+  // Start compiling just the shader variant for our texture layout, and
+  // let the driver work on it while we import the model.
+  ShaderVariants shaderVariants = makeShaderVariants();
+  const auto shaderFeatures = CONFIG.packTextureArrays ? shaderVariants.feature("TEXTURE_ARRAY") : 0;
+  ShaderBatch shaderBatch;
+  shaderVariants.request(shaderFeatures, shaderBatch);
+  shaderBatch.submit();
 
-  // Load model with Assimp.
-  Model model{modelPath};
+  // Load model, with Assimp if --assimp is given.
+  ModelOptions modelOptions = parseModelOptions(argc, argv);
+  modelOptions.packTextureArrays = CONFIG.packTextureArrays;
+  Model model{modelPath, modelOptions};
 
   // Set uo transformations.
-  Transformations transformations{ourShader, window.aspectRatio()};
+  Transformations transformations{window.aspectRatio()};
 
   // Set our resize callback that updates the projection.
-  setCallbacks(window, transformations);
+  setCallbacks(window, transformations, frameLoop);
+
+  // With --watch-shaders, shader edits are picked up without a restart.
+  ShaderWatcher shaderWatcher{parseShaderWatchOptions(argc, argv), [&frameLoop]() { frameLoop.requestRedraw(); }};
+
+  // Draws are recorded here each frame, then sorted and submitted together.
+  RenderQueue renderQueue;
+
+  // The interactive loop picks our shader up once it's compiled; the
+  // scripted runs and the render thread wait for it here.
+  std::shared_ptr<Shader> ourShader;
+  if (benchOptions.enabled || batchOptions.enabled || frameLoop.usesRenderThread()) {
+    ourShader = collectShader(shaderVariants, shaderFeatures, shaderWatcher, true);
+  }
+
+  // Scripted benchmark run, in place of the interactive loop.
+  if (benchOptions.enabled) {
+    return runBenchmark(benchOptions, "model_viewer_assimp", window, frameLoop, transformations, renderQueue, [&]() {
+      model.submit(renderQueue, *ourShader);
+    });
+  }
+
+  // Render a turntable or list of poses to image files, and exit.
+  if (batchOptions.enabled) {
+    return runBatchRender(batchOptions, window, transformations, renderQueue, [&]() {
+      model.submit(renderQueue, *ourShader);
+    });
+  }
+
+  // Events on this thread, rendering on another.
+  if (frameLoop.usesRenderThread()) {
+    return runWithRenderThread(window, frameLoop, transformations, renderQueue, CONFIG, [&]() {
+      shaderWatcher.applyPending();
+      model.submit(renderQueue, *ourShader);
+    });
+  }
 
   // -----------------
   // Main render loop.
 
   while (!window.shouldClose()) {
+    // With --on-demand, sleep until something changes the picture.
+    if (!frameLoop.waitForRedraw()) {
+      window.processInput();
+      continue;
+    }
+
+    beginFrame(frameLoop);
     window.processInput();
+    // Apply camera changes from this frame's input in one go.
+    window.dispatchInput();
+    // Swap in shaders edited since last frame.
+    shaderWatcher.applyPending();
+    // Draw nothing until our shader has compiled, but keep checking.
+    if (!ourShader) {
+      ourShader = collectShader(shaderVariants, shaderFeatures, shaderWatcher);
+      frameLoop.requestRedraw();
+    }
+
+    // Advance animation in fixed steps, independent of frame rate.
+    runSimulation(frameLoop, transformations, CONFIG);
 
     clearBuffers();
-    model.draw(*ourShader);
+    // Upload camera matrices changed since last frame.
+    transformations.flushUniforms();
+
+    resetRenderQueue(renderQueue, transformations);
+    if (ourShader) {
+      model.submit(renderQueue, *ourShader);
+    }
+    renderQueue.execute();
 
     window.swapBuffers();
     GLFWWrapper::pollEvents();
-
-    if constexpr (CONFIG.constantRotation) {
-      constantRotation(transformations);
-    }
+    endFrame(frameLoop);
   }
 
   return 0;
@@ -89,10 +160,10 @@ int main() {
 // -------------------
 // Helper definitions.
 
-std::shared_ptr<Shader> loadShader() {
+ShaderVariants makeShaderVariants() {
   std::string vertexShaderPath = FileSystem::getPath("src/model_viewer/shaders/model_viewer_assimp.vs");
   std::string fragmentShaderPath = FileSystem::getPath("src/model_viewer/shaders/model_viewer_assimp.fs");
 
-  // Load shaders.
-  return std::make_shared<Shader>(vertexShaderPath.c_str(), fragmentShaderPath.c_str());
+  // Packed textures are sampled from arrays, in the TEXTURE_ARRAY variant.
+  return ShaderVariants{vertexShaderPath, fragmentShaderPath, {"TEXTURE_ARRAY"}};
 }
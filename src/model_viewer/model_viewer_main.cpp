@@ -8,10 +8,6 @@
 // clang-format off
 #include "lib/model_viewer.h"
 
-// We need this define and include combination exactly once.
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
-
 #include <fmt/core.h>
 
 #include <memory>
@@ -28,11 +24,16 @@ static constexpr Config CONFIG{
 // -------------
 // Program main.
 
-int main() {
+int main(int argc, char **argv) {
+  const BenchOptions benchOptions = parseBenchOptions(argc, argv);
+  const BatchOptions batchOptions = parseBatchOptions(argc, argv);
+  // Enables profiling, and writes the trace on exit, if asked to.
+  ProfileSession profileSession{parseProfileOptions(argc, argv)};
+
   // Initialize GLFW window.
   GLFWWrapper window;
 
-  if (!window.init()) {
+  if (!window.init(benchOptions.headless)) {
     return -1;
   }
 
@@ -43,41 +44,117 @@ int main() {
     return -1;
   }
 
-  // Load shader and model.
-  auto shaderAndModels = loadShaderAndModels();
+  // With --stream-textures, textures load progressively over the first frames.
+  textureStreamer().configure(parseTextureStreamOptions(argc, argv));
+
+  // Frame pacing and the fixed-timestep simulation clock. Benchmarks
+  // default to unlimited so vsync doesn't quantize their timings.
+  const PacingMode defaultPacing = benchOptions.enabled ? PacingMode::Unlimited : PacingMode::VSync;
+  FrameLoop frameLoop{parseFrameLoopOptions(argc, argv, defaultPacing)};
+  frameLoop.applyPacing();
 
-  if (!shaderAndModels.isOkay()) {
-    fmt::print("Failed to load shaders and models.\n");
+  // Start compiling our shader, and let the driver work on it while we
+  // load textures and meshes.
+  ShaderVariants shaderVariants = makeModelViewerShaders();
+  ShaderBatch shaderBatch;
+  shaderVariants.request(0, shaderBatch);
+  shaderBatch.submit();
+
+  // Load models.
+  auto models = loadModels();
+
+  if (!models.isOkay()) {
+    fmt::print("Failed to load models.\n");
 
     return -1;
   }
 
-  auto ourShader = shaderAndModels.mShader;
-  auto model1 = shaderAndModels.mModel1;
-  auto model2 = shaderAndModels.mModel2;
+  auto model1 = models.mModel1;
+  auto model2 = models.mModel2;
 
   // Set uo transformations.
-  Transformations transformations{ourShader, window.aspectRatio()};
+  Transformations transformations{window.aspectRatio()};
 
   // Set GLFW event callbacks for window size and mouse interaction.
-  setCallbacks(window, transformations);
+  setCallbacks(window, transformations, frameLoop);
+
+  // With --watch-shaders, shader edits are picked up without a restart.
+  ShaderWatcher shaderWatcher{parseShaderWatchOptions(argc, argv), [&frameLoop]() { frameLoop.requestRedraw(); }};
+
+  // Draws are recorded here each frame, then sorted and submitted together.
+  RenderQueue renderQueue;
+
+  // The interactive loop picks our shader up once it's compiled; the
+  // scripted runs and the render thread wait for it here.
+  std::shared_ptr<Shader> ourShader;
+  if (benchOptions.enabled || batchOptions.enabled || frameLoop.usesRenderThread()) {
+    ourShader = collectShader(shaderVariants, 0, shaderWatcher, true);
+  }
+
+  // Scripted benchmark run, in place of the interactive loop.
+  if (benchOptions.enabled) {
+    return runBenchmark(benchOptions, "model_viewer", window, frameLoop, transformations, renderQueue, [&]() {
+      model1->submit(renderQueue, *ourShader);
+      model2->submit(renderQueue, *ourShader);
+    });
+  }
+
+  // Render a turntable or list of poses to image files, and exit.
+  if (batchOptions.enabled) {
+    return runBatchRender(batchOptions, window, transformations, renderQueue, [&]() {
+      model1->submit(renderQueue, *ourShader);
+      model2->submit(renderQueue, *ourShader);
+    });
+  }
+
+  // Events on this thread, rendering on another.
+  if (frameLoop.usesRenderThread()) {
+    return runWithRenderThread(window, frameLoop, transformations, renderQueue, CONFIG, [&]() {
+      shaderWatcher.applyPending();
+      model1->submit(renderQueue, *ourShader);
+      model2->submit(renderQueue, *ourShader);
+    });
+  }
 
   // -----------------
   // Main render loop.
 
   while (!window.shouldClose()) {
+    // With --on-demand, sleep until something changes the picture.
+    if (!frameLoop.waitForRedraw()) {
+      window.processInput();
+      continue;
+    }
+
+    beginFrame(frameLoop);
     window.processInput();
+    // Apply camera changes from this frame's input in one go.
+    window.dispatchInput();
+    // Swap in shaders edited since last frame.
+    shaderWatcher.applyPending();
+    // Draw nothing until our shader has compiled, but keep checking.
+    if (!ourShader) {
+      ourShader = collectShader(shaderVariants, 0, shaderWatcher);
+      frameLoop.requestRedraw();
+    }
+
+    // Advance animation in fixed steps, independent of frame rate.
+    runSimulation(frameLoop, transformations, CONFIG);
 
     clearBuffers();
-    model1->draw(ourShader.get());
-    model2->draw(ourShader.get());
+    // Upload camera matrices changed since last frame.
+    transformations.flushUniforms();
+
+    resetRenderQueue(renderQueue, transformations);
+    if (ourShader) {
+      model1->submit(renderQueue, *ourShader);
+      model2->submit(renderQueue, *ourShader);
+    }
+    renderQueue.execute();
 
     window.swapBuffers();
     GLFWWrapper::pollEvents();
-
-    if constexpr (CONFIG.constantRotation) {
-      constantRotation(transformations);
-    }
+    endFrame(frameLoop);
   }
 
   return 0;
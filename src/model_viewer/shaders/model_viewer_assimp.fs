@@ -3,10 +3,21 @@ out vec4 FragColor;
 
 in vec2 TexCoords;
 
+// With TEXTURE_ARRAY, textures are packed into array textures and each
+// mesh says which layer to sample.
+#ifdef TEXTURE_ARRAY
+flat in float DiffuseLayer;
+
+uniform sampler2DArray texture_diffuse1;
+#else
 uniform sampler2D texture_diffuse1;
+#endif
 
 void main()
 {
-    // FragColor = vec4(0.5, 0.0, 0.0, 1.0);
+#ifdef TEXTURE_ARRAY
+    FragColor = texture(texture_diffuse1, vec3(TexCoords, DiffuseLayer));
+#else
     FragColor = texture(texture_diffuse1, TexCoords);
+#endif
 }
@@ -2,15 +2,22 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoords;
 //layout (location = 2) in vec3 aNormal;
+#ifdef TEXTURE_ARRAY
+layout (location = 3) in vec4 aTextureLayers;
+#endif
 
 out vec2 TexCoords;
+#ifdef TEXTURE_ARRAY
+flat out float DiffuseLayer;
+#endif
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "camera.glsl"
 
 void main()
 {
     TexCoords = aTexCoords;
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+#ifdef TEXTURE_ARRAY
+    DiffuseLayer = aTextureLayers.x;
+#endif
+    gl_Position = toClipSpace(aPos);
 }
@@ -0,0 +1,14 @@
+// Camera matrices, shared by all our programs through one uniform buffer.
+// See tools/camera_uniforms.h for the matching C++ side.
+
+layout (std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    mat4 model;
+};
+
+vec4 toClipSpace(vec3 position)
+{
+    return projection * view * model * vec4(position, 1.0);
+}
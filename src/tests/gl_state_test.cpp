@@ -0,0 +1,206 @@
+// Exercises GLStateCache against a table of mock GL functions, which
+// count the calls that reach them. Needs no GPU or context.
+//
+// Usage: gl_state_test
+
+// clang-format off
+#include "glad/glad.h"
+
+#include <fmt/core.h>
+#include <tools/gl_state.h>
+
+#include <string_view>
+// clang-format on
+
+// --------------------
+// Mock GL functions.
+
+struct MockCalls {
+  int useProgram = 0;
+  int bindVertexArray = 0;
+  int bindBuffer = 0;
+  int bindBufferBase = 0;
+  int activeTexture = 0;
+  int bindTexture = 0;
+  int polygonMode = 0;
+
+  GLenum lastActiveTexture = 0;
+};
+
+MockCalls calls;
+
+void APIENTRY mockUseProgram(GLuint) { calls.useProgram++; }
+void APIENTRY mockBindVertexArray(GLuint) { calls.bindVertexArray++; }
+void APIENTRY mockBindBuffer(GLenum, GLuint) { calls.bindBuffer++; }
+void APIENTRY mockBindBufferBase(GLenum, GLuint, GLuint) { calls.bindBufferBase++; }
+void APIENTRY mockActiveTexture(GLenum unit) {
+  calls.activeTexture++;
+  calls.lastActiveTexture = unit;
+}
+void APIENTRY mockBindTexture(GLenum, GLuint) { calls.bindTexture++; }
+void APIENTRY mockPolygonMode(GLenum, GLenum) { calls.polygonMode++; }
+
+GLFunctions mockFunctions() {
+  return {
+      .useProgram = mockUseProgram,
+      .bindVertexArray = mockBindVertexArray,
+      .bindBuffer = mockBindBuffer,
+      .bindBufferBase = mockBindBufferBase,
+      .activeTexture = mockActiveTexture,
+      .bindTexture = mockBindTexture,
+      .polygonMode = mockPolygonMode,
+  };
+}
+
+// --------
+// Helpers.
+
+int failures = 0;
+
+void check(bool condition, std::string_view what) {
+  if (!condition) {
+    fmt::print("FAILED: {}\n", what);
+    failures++;
+  }
+}
+
+// A fresh cache over the mocks, with the call counts reset.
+GLStateCache freshCache() {
+  calls = {};
+  return GLStateCache{mockFunctions()};
+}
+
+// ------
+// Tests.
+
+void testRedundantCallsAreElided() {
+  GLStateCache cache = freshCache();
+
+  cache.useProgram(3);
+  cache.useProgram(3);
+  cache.useProgram(4);
+  cache.polygonMode(GL_LINE);
+  cache.polygonMode(GL_LINE);
+
+  check(calls.useProgram == 2, "repeated useProgram is elided");
+  check(calls.polygonMode == 1, "repeated polygonMode is elided");
+  check(cache.frameCounters().issued == 3, "issued count");
+  check(cache.frameCounters().elided == 2, "elided count");
+}
+
+void testVertexArrayForgetsElementBuffer() {
+  GLStateCache cache = freshCache();
+
+  cache.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 5);
+  cache.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 5);
+  check(calls.bindBuffer == 1, "repeated element buffer bind is elided");
+
+  // The element buffer binding belongs to the VAO, so it's reissued.
+  cache.bindVertexArray(2);
+  cache.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 5);
+  check(calls.bindBuffer == 2, "element buffer is rebound after a VAO change");
+
+  // Other buffer targets aren't VAO state.
+  cache.bindBuffer(GL_ARRAY_BUFFER, 6);
+  cache.bindVertexArray(7);
+  cache.bindBuffer(GL_ARRAY_BUFFER, 6);
+  check(calls.bindBuffer == 3, "array buffer survives a VAO change");
+}
+
+void testBufferBaseTracksGenericTarget() {
+  GLStateCache cache = freshCache();
+
+  cache.bindBufferBase(GL_UNIFORM_BUFFER, 0, 9);
+  cache.bindBufferBase(GL_UNIFORM_BUFFER, 0, 9);
+  check(calls.bindBufferBase == 2, "bindBufferBase is always issued");
+
+  cache.bindBuffer(GL_UNIFORM_BUFFER, 9);
+  check(calls.bindBuffer == 0, "bindBufferBase binds the generic target too");
+}
+
+void testTexturesAreTrackedPerUnit() {
+  GLStateCache cache = freshCache();
+
+  cache.bindTexture(0, GL_TEXTURE_2D, 7);
+  cache.bindTexture(1, GL_TEXTURE_2D, 7);
+  check(calls.bindTexture == 2, "the same texture on two units is bound twice");
+  check(calls.lastActiveTexture == GL_TEXTURE0 + 1, "activeTexture takes a GL_TEXTUREi enum");
+
+  cache.bindTexture(0, GL_TEXTURE_2D, 7);
+  check(calls.bindTexture == 2, "a texture already on its unit is elided");
+  check(calls.activeTexture == 2, "an elided bind doesn't switch units");
+
+  // 2D and array targets on one unit are separate bindings.
+  cache.bindTexture(0, GL_TEXTURE_2D_ARRAY, 7);
+  check(calls.bindTexture == 3, "targets are tracked separately");
+}
+
+void testForgetAndInvalidate() {
+  GLStateCache cache = freshCache();
+
+  cache.useProgram(3);
+  cache.bindTexture(2, GL_TEXTURE_2D, 8);
+
+  // A deleted name can come back from glGen*, so it's forgotten.
+  cache.forgetProgram(3);
+  cache.forgetTexture(8);
+  cache.useProgram(3);
+  cache.bindTexture(2, GL_TEXTURE_2D, 8);
+  check(calls.useProgram == 2, "a forgotten program is rebound");
+  check(calls.bindTexture == 2, "a forgotten texture is rebound");
+
+  cache.invalidate();
+  cache.useProgram(3);
+  cache.bindVertexArray(0);
+  check(calls.useProgram == 3, "invalidate() forgets the program");
+  check(calls.bindVertexArray == 1, "invalidate() forgets the VAO, even 0");
+}
+
+void testFrameCounters() {
+  GLStateCache cache = freshCache();
+
+  cache.useProgram(1);
+  cache.useProgram(1);
+  cache.beginFrame();
+  cache.useProgram(2);
+
+  check(cache.lastFrameCounters().issued == 1 && cache.lastFrameCounters().elided == 1,
+        "beginFrame() keeps the last frame's counts");
+  check(cache.frameCounters().issued == 1 && cache.frameCounters().elided == 0,
+        "beginFrame() starts new counts");
+}
+
+void testPartialTableIsKept() {
+  // A table without useProgram mustn't be swapped for glad's, which
+  // isn't loaded here.
+  GLFunctions functions;
+  functions.bindVertexArray = mockBindVertexArray;
+
+  calls = {};
+  GLStateCache cache;
+  cache.setFunctions(functions);
+  cache.bindVertexArray(4);
+
+  check(calls.bindVertexArray == 1, "an installed table with null entries is used as given");
+}
+
+// -------------
+// Program main.
+
+int main() {
+  testRedundantCallsAreElided();
+  testVertexArrayForgetsElementBuffer();
+  testBufferBaseTracksGenericTarget();
+  testTexturesAreTrackedPerUnit();
+  testForgetAndInvalidate();
+  testFrameCounters();
+  testPartialTableIsKept();
+
+  if (failures > 0) {
+    fmt::print("gl_state_test: {} checks failed.\n", failures);
+    return 1;
+  }
+
+  fmt::print("gl_state_test: all checks passed.\n");
+  return 0;
+}
@@ -0,0 +1,157 @@
+// Exercises StreamBuffer's unpersistent path against mock GL buffer
+// functions, which keep the buffer's contents in memory and, like a
+// driver may, hand out garbage for an invalidated mapping. Needs no GPU or
+// context.
+//
+// Usage: stream_buffer_test
+
+// clang-format off
+#include "glad/glad.h"
+
+#include <fmt/core.h>
+#include <tools/gl_state.h>
+#include <tools/stream_buffer.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+#include <vector>
+// clang-format on
+
+// --------------------
+// Mock GL functions.
+
+struct MockBuffer {
+  std::vector<std::uint8_t> contents;
+
+  // The mapped range, written back on unmap.
+  std::vector<std::uint8_t> mapped;
+  GLintptr mappedOffset = 0;
+  bool isMapped = false;
+};
+
+MockBuffer buffer;
+
+// What an invalidated range reads as.
+constexpr std::uint8_t GARBAGE = 0xcd;
+
+void APIENTRY mockGenBuffers(GLsizei count, GLuint *names) {
+  for (GLsizei i = 0; i < count; i++) {
+    names[i] = static_cast<GLuint>(i + 1);
+  }
+}
+
+void APIENTRY mockBufferData(GLenum, GLsizeiptr size, const void *, GLenum) {
+  buffer.contents.assign(static_cast<std::size_t>(size), 0);
+}
+
+void *APIENTRY mockMapBufferRange(GLenum, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+  if (buffer.isMapped || length <= 0) {
+    return nullptr;
+  }
+
+  const auto first = buffer.contents.begin() + offset;
+  if (access & GL_MAP_INVALIDATE_RANGE_BIT) {
+    buffer.mapped.assign(static_cast<std::size_t>(length), GARBAGE);
+  } else {
+    buffer.mapped.assign(first, first + length);
+  }
+
+  buffer.mappedOffset = offset;
+  buffer.isMapped = true;
+  return buffer.mapped.data();
+}
+
+GLboolean APIENTRY mockUnmapBuffer(GLenum) {
+  std::copy(buffer.mapped.begin(), buffer.mapped.end(), buffer.contents.begin() + buffer.mappedOffset);
+  buffer.isMapped = false;
+  return GL_TRUE;
+}
+
+void APIENTRY mockBindBuffer(GLenum, GLuint) {}
+
+void installMocks() {
+  glad_glGenBuffers = mockGenBuffers;
+  glad_glBufferData = mockBufferData;
+  glad_glMapBufferRange = mockMapBufferRange;
+  glad_glUnmapBuffer = mockUnmapBuffer;
+
+  GLFunctions functions;
+  functions.bindBuffer = mockBindBuffer;
+  glState().setFunctions(functions);
+}
+
+// --------
+// Helpers.
+
+int failures = 0;
+
+void check(bool condition, std::string_view what) {
+  if (!condition) {
+    fmt::print("FAILED: {}\n", what);
+    failures++;
+  }
+}
+
+// Whether bytes at offset in the buffer all read value.
+bool holds(std::size_t offset, std::size_t bytes, std::uint8_t value) {
+  const auto first = buffer.contents.begin() + static_cast<std::ptrdiff_t>(offset);
+  return std::all_of(first, first + static_cast<std::ptrdiff_t>(bytes), [=](std::uint8_t b) { return b == value; });
+}
+
+// ------
+// Tests.
+
+void testFlushKeepsEarlierWrites() {
+  StreamBuffer stream{256};
+  stream.beginFrame();
+
+  // One producer writes and draws...
+  const StreamBuffer::Allocation first = stream.allocate(16);
+  std::memset(first.data, 0x11, 16);
+  stream.flush();
+
+  // ...then another writes after it, in the same frame.
+  const StreamBuffer::Allocation second = stream.allocate(16);
+  std::memset(second.data, 0x22, 16);
+  stream.flush();
+
+  check(second.offset >= first.offset + 16, "allocations in one frame don't overlap");
+  check(holds(first.offset, 16, 0x11), "allocating after a flush keeps the bytes flushed before it");
+  check(holds(second.offset, 16, 0x22), "bytes written after a flush reach the buffer");
+}
+
+void testOffsetsAreAligned() {
+  StreamBuffer stream{256};
+  stream.beginFrame();
+
+  stream.allocate(3);
+  const StreamBuffer::Allocation vertices = stream.allocate(24, 12);
+  std::memset(vertices.data, 0x33, 24);
+  stream.flush();
+
+  check(vertices.offset % 12 == 0, "an allocation's offset is a multiple of its alignment");
+  check(holds(vertices.offset, 24, 0x33), "an aligned allocation writes where its offset says");
+}
+
+// -------------
+// Program main.
+
+int main() {
+  // The mocks only cover mapping without persistence.
+  setenv("GLEX_PERSISTENT_MAPPING", "off", 1);
+  installMocks();
+
+  testFlushKeepsEarlierWrites();
+  testOffsetsAreAligned();
+
+  if (failures > 0) {
+    fmt::print("stream_buffer_test: {} checks failed.\n", failures);
+    return 1;
+  }
+
+  fmt::print("stream_buffer_test: all checks passed.\n");
+  return 0;
+}
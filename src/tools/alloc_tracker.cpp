@@ -0,0 +1,133 @@
+// clang-format off
+#include "alloc_tracker.h"
+
+#include <cstdlib>
+#include <new>
+// clang-format on
+
+#ifdef GLEX_TRACK_ALLOCATIONS
+
+namespace {
+
+// Just before each block we hand out, so its free is charged to the tag
+// that allocated it, whichever thread frees it.
+struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) BlockHeader {
+  std::size_t size;
+  // From the start of what malloc gave us to the block.
+  std::uint32_t offset;
+  AllocTag tag;
+};
+
+constexpr std::size_t HEADER_BYTES = sizeof(BlockHeader);
+
+BlockHeader *headerOf(void *p) { return static_cast<BlockHeader *>(p) - 1; }
+
+// Room for the header, at a multiple of alignment, before the block.
+std::size_t headerOffset(std::size_t alignment) {
+  return (HEADER_BYTES + alignment - 1) / alignment * alignment;
+}
+
+void *allocateBlock(std::size_t size, std::size_t alignment) noexcept {
+  const std::size_t offset = headerOffset(alignment);
+
+  void *raw = nullptr;
+  if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+    raw = std::malloc(offset + size);
+  } else {
+    // aligned_alloc wants a multiple of the alignment.
+    raw = std::aligned_alloc(alignment, (offset + size + alignment - 1) / alignment * alignment);
+  }
+  if (raw == nullptr) {
+    return nullptr;
+  }
+
+  void *p = static_cast<char *>(raw) + offset;
+  const AllocTag tag = AllocScope::current();
+  *headerOf(p) = {size, static_cast<std::uint32_t>(offset), tag};
+  allocationTracker().recordAllocation(tag, size);
+
+  return p;
+}
+
+void freeBlock(void *p) noexcept {
+  if (p == nullptr) {
+    return;
+  }
+
+  const BlockHeader header = *headerOf(p);
+  allocationTracker().recordFree(header.tag, header.size);
+  std::free(static_cast<char *>(p) - header.offset);
+}
+
+// Retries through the new handler, as operator new must.
+void *allocateOrThrow(std::size_t size, std::size_t alignment) {
+  for (;;) {
+    if (void *p = allocateBlock(size, alignment)) {
+      return p;
+    }
+    std::new_handler handler = std::get_new_handler();
+    if (handler == nullptr) {
+      throw std::bad_alloc();
+    }
+    handler();
+  }
+}
+
+void *allocateOrNull(std::size_t size, std::size_t alignment) noexcept {
+  try {
+    return allocateOrThrow(size, alignment);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+struct ExitReport {
+  ~ExitReport() { allocationTracker().printReport("at exit"); }
+} exitReport;
+
+} // namespace
+
+// ----------------------------
+// Global new and delete.
+
+void *operator new(std::size_t size) { return allocateOrThrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void *operator new[](std::size_t size) { return allocateOrThrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+
+void *operator new(std::size_t size, std::align_val_t alignment) {
+  return allocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+  return allocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  return allocateOrNull(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return allocateOrNull(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+  return allocateOrNull(size, static_cast<std::size_t>(alignment));
+}
+void *operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+  return allocateOrNull(size, static_cast<std::size_t>(alignment));
+}
+
+// Every block records how to free it, so the sized and aligned forms
+// don't need their extra arguments.
+
+void operator delete(void *p) noexcept { freeBlock(p); }
+void operator delete[](void *p) noexcept { freeBlock(p); }
+void operator delete(void *p, std::size_t) noexcept { freeBlock(p); }
+void operator delete[](void *p, std::size_t) noexcept { freeBlock(p); }
+void operator delete(void *p, std::align_val_t) noexcept { freeBlock(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { freeBlock(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { freeBlock(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { freeBlock(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { freeBlock(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { freeBlock(p); }
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept { freeBlock(p); }
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept { freeBlock(p); }
+
+#endif // GLEX_TRACK_ALLOCATIONS
@@ -0,0 +1,245 @@
+// Heap allocation tracking, by subsystem.
+//
+// Built with GLEX_TRACK_ALLOCATIONS (cmake -DGLEX_TRACK_ALLOCATIONS=ON),
+// alloc_tracker.cpp replaces the global operator new and delete, and
+// every allocation is counted, with its size, under the tag of the thread
+// that made it. Code tags its thread for a scope with an AllocScope, jobs
+// run under the tag of the thread that submitted them, and a
+// TaggedResource tags what std::pmr containers allocate through it. Each
+// block remembers its tag, so frees are counted against the tag that
+// allocated it, and live and peak bytes per tag are exact.
+//
+// The render thread marks each frame, so --frame-stats also shows how many
+// allocations its frames make, which should be none once a scene is
+// loaded. Only that thread's own allocations count toward a frame; job
+// threads allocate on their own schedule, so theirs would only add noise.
+// The full report is printed at exit, or on F9.
+//
+// Without the define nothing is replaced and the counters stay at zero.
+
+#ifndef ALLOC_TRACKER_H
+#define ALLOC_TRACKER_H
+
+#include <fmt/core.h>
+
+#include <array>
+#include <iterator>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <type_traits>
+
+// -----------------
+// Subsystem tags.
+
+enum class AllocTag : std::uint8_t {
+  Untagged,
+  // Scene import, e.g. Assimp's own data.
+  Import,
+  // Decoded images and their mips.
+  Textures,
+  // Mesh geometry.
+  Meshes,
+  // The function grapher's grids and vertices.
+  Grapher,
+  Count,
+};
+
+inline constexpr const char *ALLOC_TAG_NAMES[] = {"untagged", "import", "textures", "meshes", "grapher"};
+static_assert(std::size(ALLOC_TAG_NAMES) == static_cast<std::size_t>(AllocTag::Count));
+
+// Tags the calling thread's allocations until destroyed.
+class AllocScope {
+public:
+  explicit AllocScope(AllocTag tag) : mPrevious(sCurrent) { sCurrent = tag; }
+  ~AllocScope() { sCurrent = mPrevious; }
+
+  AllocScope(const AllocScope &) = delete;
+  AllocScope &operator=(const AllocScope &) = delete;
+
+  static AllocTag current() { return sCurrent; }
+
+private:
+  AllocTag mPrevious;
+
+  static inline thread_local AllocTag sCurrent = AllocTag::Untagged;
+};
+
+// ----------------------
+// Allocation tracker.
+
+class AllocationTracker {
+public:
+  struct TagStats {
+    std::uint64_t allocations = 0;
+    std::uint64_t frees = 0;
+    // Ever allocated.
+    std::uint64_t bytes = 0;
+    std::int64_t liveBytes = 0;
+    std::int64_t peakBytes = 0;
+  };
+
+  struct FrameStats {
+    std::uint64_t frames = 0;
+    // Frames that allocated at all.
+    std::uint64_t allocatingFrames = 0;
+    std::uint64_t lastFrame = 0;
+    std::uint64_t maxFrame = 0;
+  };
+
+  static constexpr bool enabled() {
+#ifdef GLEX_TRACK_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  // From operator new and delete; these mustn't allocate.
+  void recordAllocation(AllocTag tag, std::size_t bytes) noexcept {
+    Counters &counters = mTags[static_cast<std::size_t>(tag)];
+    counters.allocations.fetch_add(1, std::memory_order_relaxed);
+    counters.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    const std::int64_t live =
+        counters.liveBytes.fetch_add(static_cast<std::int64_t>(bytes), std::memory_order_relaxed) +
+        static_cast<std::int64_t>(bytes);
+
+    std::int64_t peak = counters.peakBytes.load(std::memory_order_relaxed);
+    while (live > peak && !counters.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+
+    mAllocations.fetch_add(1, std::memory_order_relaxed);
+    sThreadAllocations++;
+  }
+
+  void recordFree(AllocTag tag, std::size_t bytes) noexcept {
+    Counters &counters = mTags[static_cast<std::size_t>(tag)];
+    counters.frees.fetch_add(1, std::memory_order_relaxed);
+    counters.liveBytes.fetch_sub(static_cast<std::int64_t>(bytes), std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] TagStats stats(AllocTag tag) const {
+    const Counters &counters = mTags[static_cast<std::size_t>(tag)];
+    return {counters.allocations.load(std::memory_order_relaxed), counters.frees.load(std::memory_order_relaxed),
+            counters.bytes.load(std::memory_order_relaxed), counters.liveBytes.load(std::memory_order_relaxed),
+            counters.peakBytes.load(std::memory_order_relaxed)};
+  }
+
+  [[nodiscard]] std::uint64_t allocations() const { return mAllocations.load(std::memory_order_relaxed); }
+  // Allocations made by the calling thread.
+  [[nodiscard]] static std::uint64_t threadAllocations() { return sThreadAllocations; }
+
+  // Render thread, at the start of each frame: ends the last frame's count
+  // of that thread's allocations. Call it from one thread only.
+  void beginFrame() {
+    const std::uint64_t now = threadAllocations();
+    const std::uint64_t count = now - mFrameStart.exchange(now, std::memory_order_relaxed);
+    if (!mFrameStarted.exchange(true, std::memory_order_relaxed)) {
+      return;
+    }
+
+    mFrames.fetch_add(1, std::memory_order_relaxed);
+    mLastFrame.store(count, std::memory_order_relaxed);
+    if (count > 0) {
+      mAllocatingFrames.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (count > mMaxFrame.load(std::memory_order_relaxed)) {
+      mMaxFrame.store(count, std::memory_order_relaxed);
+    }
+  }
+
+  [[nodiscard]] FrameStats frameStats() const {
+    return {mFrames.load(std::memory_order_relaxed), mAllocatingFrames.load(std::memory_order_relaxed),
+            mLastFrame.load(std::memory_order_relaxed), mMaxFrame.load(std::memory_order_relaxed)};
+  }
+
+  // One line on frame allocations, for --frame-stats.
+  void printFrameSummary() const {
+    if (!enabled()) {
+      return;
+    }
+    const FrameStats f = frameStats();
+    fmt::print("[alloc] {} of {} frames allocated; last frame {}, most {}\n", f.allocatingFrames, f.frames,
+               f.lastFrame, f.maxFrame);
+  }
+
+  void printReport(std::string_view when) const {
+    if (!enabled()) {
+      fmt::print("[alloc] Built without GLEX_TRACK_ALLOCATIONS; nothing was tracked.\n");
+      return;
+    }
+
+    fmt::print("[alloc] Heap by subsystem, {}:\n", when);
+    fmt::print("  {:<10} {:>10} {:>10} {:>12} {:>12} {:>12}\n", "tag", "allocs", "frees", "live KiB", "peak KiB",
+               "total KiB");
+    for (std::size_t i = 0; i < static_cast<std::size_t>(AllocTag::Count); i++) {
+      const TagStats s = stats(static_cast<AllocTag>(i));
+      fmt::print("  {:<10} {:>10} {:>10} {:>12.1f} {:>12.1f} {:>12.1f}\n", ALLOC_TAG_NAMES[i], s.allocations, s.frees,
+                 static_cast<double>(s.liveBytes) / 1024.0, static_cast<double>(s.peakBytes) / 1024.0,
+                 static_cast<double>(s.bytes) / 1024.0);
+    }
+    printFrameSummary();
+  }
+
+private:
+  struct Counters {
+    std::atomic<std::uint64_t> allocations{0};
+    std::atomic<std::uint64_t> frees{0};
+    std::atomic<std::uint64_t> bytes{0};
+    std::atomic<std::int64_t> liveBytes{0};
+    std::atomic<std::int64_t> peakBytes{0};
+  };
+
+  std::array<Counters, static_cast<std::size_t>(AllocTag::Count)> mTags{};
+  std::atomic<std::uint64_t> mAllocations{0};
+
+  std::atomic<bool> mFrameStarted{false};
+  std::atomic<std::uint64_t> mFrameStart{0};
+  std::atomic<std::uint64_t> mFrames{0};
+  std::atomic<std::uint64_t> mAllocatingFrames{0};
+  std::atomic<std::uint64_t> mLastFrame{0};
+  std::atomic<std::uint64_t> mMaxFrame{0};
+
+  static inline thread_local std::uint64_t sThreadAllocations = 0;
+};
+
+// Usable from operator new at any point in the program's life: it's
+// constant-initialized, and has nothing to destroy.
+static_assert(std::is_trivially_destructible_v<AllocationTracker>);
+
+inline AllocationTracker &allocationTracker() {
+  static AllocationTracker tracker;
+  return tracker;
+}
+
+// -------------------
+// Tagged pmr memory.
+
+// Allocates from upstream under tag, whatever the calling thread's tag.
+class TaggedResource : public std::pmr::memory_resource {
+public:
+  explicit TaggedResource(AllocTag tag, std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+      : mTag(tag), mUpstream(upstream) {}
+
+private:
+  void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+    AllocScope scope{mTag};
+    return mUpstream->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override {
+    mUpstream->deallocate(p, bytes, alignment);
+  }
+
+  [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+
+private:
+  AllocTag mTag;
+  std::pmr::memory_resource *mUpstream;
+};
+
+#endif // ALLOC_TRACKER_H
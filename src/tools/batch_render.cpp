@@ -0,0 +1,253 @@
+// clang-format off
+#include "batch_render.h"
+
+#include "tools/gl_state.h"
+
+// We need this define and include combination exactly once.
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+// clang-format on
+
+// ------------------------------
+// Command line option parsing.
+
+BatchOptions parseBatchOptions(int argc, char **argv) {
+  BatchOptions options;
+
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+
+    if (arg == "--turntable" && i + 1 < argc) {
+      options.turntableFrames = std::max(1, std::atoi(argv[++i]));
+      options.enabled = true;
+    } else if (arg == "--poses" && i + 1 < argc) {
+      options.posesPath = argv[++i];
+      options.enabled = true;
+    } else if (arg == "--batch-out" && i + 1 < argc) {
+      options.outputDirectory = argv[++i];
+    } else if (arg == "--batch-format" && i + 1 < argc) {
+      options.format = std::string_view(argv[++i]) == "raw" ? ImageFormat::Raw : ImageFormat::Png;
+    } else if (arg == "--batch-size" && i + 1 < argc) {
+      std::sscanf(argv[++i], "%dx%d", &options.width, &options.height);
+    }
+  }
+
+  return options;
+}
+
+// -------------
+// Camera poses.
+
+std::vector<CameraPose> turntablePoses(int frames, float pitch) {
+  std::vector<CameraPose> poses;
+  poses.reserve(frames);
+
+  for (int i = 0; i < frames; i++) {
+    poses.push_back({360.0f * static_cast<float>(i) / static_cast<float>(frames), pitch});
+  }
+
+  return poses;
+}
+
+std::vector<CameraPose> loadPoses(const std::string &path) {
+  std::ifstream file{path};
+  if (!file) {
+    throw std::runtime_error("Can't open pose file " + path + ".");
+  }
+
+  std::vector<CameraPose> poses;
+  std::string line;
+  int lineNumber = 0;
+
+  while (std::getline(file, line)) {
+    lineNumber++;
+    line = line.substr(0, line.find('#'));
+    if (line.find_first_not_of(" \t\r") == std::string::npos) {
+      continue;
+    }
+
+    std::istringstream fields{line};
+    CameraPose pose;
+    if (!(fields >> pose.yaw >> pose.pitch)) {
+      throw std::runtime_error(fmt::format("{}:{}: expected \"yaw pitch [fov]\".", path, lineNumber));
+    }
+    fields >> pose.fov;
+    poses.push_back(pose);
+  }
+
+  if (poses.empty()) {
+    throw std::runtime_error("Pose file " + path + " has no poses.");
+  }
+
+  return poses;
+}
+
+// ----------------------------
+// ImageEncoderPool definitions.
+
+ImageEncoderPool::ImageEncoderPool(ImageFormat format, std::size_t maxQueued)
+    : mFormat(format), mMaxQueued(maxQueued > 0 ? maxQueued : 4 * jobSystem().threads()) {}
+
+ImageEncoderPool::~ImageEncoderPool() { finish(); }
+
+std::vector<std::uint8_t> ImageEncoderPool::acquireBuffer(std::size_t size) {
+  std::vector<std::uint8_t> buffer;
+  {
+    std::lock_guard lock{mMutex};
+    if (!mFreeBuffers.empty()) {
+      buffer = std::move(mFreeBuffers.back());
+      mFreeBuffers.pop_back();
+    }
+  }
+
+  buffer.resize(size);
+  return buffer;
+}
+
+void ImageEncoderPool::submit(EncodeJob job) {
+  while (!mQueued.empty() && mQueued.front().done()) {
+    mQueued.pop_front();
+  }
+
+  if (mQueued.size() >= mMaxQueued) {
+    {
+      std::lock_guard lock{mMutex};
+      mStats.stalls++;
+    }
+    // Helps encode while it waits.
+    jobSystem().wait(mQueued.front());
+    mQueued.pop_front();
+  }
+
+  // Shared, so the job's function can be copied without copying pixels.
+  auto queued = std::make_shared<EncodeJob>(std::move(job));
+  mQueued.push_back(jobSystem().submit([this, queued]() { run(*queued); }));
+}
+
+void ImageEncoderPool::finish() {
+  for (const JobHandle &queued : mQueued) {
+    jobSystem().wait(queued);
+  }
+  mQueued.clear();
+}
+
+ImageEncoderPool::Stats ImageEncoderPool::stats() const {
+  std::lock_guard lock{mMutex};
+  return mStats;
+}
+
+void ImageEncoderPool::run(EncodeJob &job) {
+  const auto start = std::chrono::steady_clock::now();
+  const bool written = encode(job);
+  const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+  if (!written) {
+    fmt::print("[batch] Failed to write {}\n", job.path.string());
+  }
+
+  std::lock_guard lock{mMutex};
+  (written ? mStats.written : mStats.failed)++;
+  mStats.encodeMs += elapsed.count();
+  mFreeBuffers.push_back(std::move(job.pixels));
+}
+
+bool ImageEncoderPool::encode(const EncodeJob &job) const {
+  if (mFormat == ImageFormat::Png) {
+    return stbi_write_png(job.path.c_str(), job.width, job.height, 4, job.pixels.data(), job.width * 4) != 0;
+  }
+
+  std::ofstream file{job.path, std::ios::binary};
+  file.write(reinterpret_cast<const char *>(job.pixels.data()), static_cast<std::streamsize>(job.pixels.size()));
+  return static_cast<bool>(file);
+}
+
+// ------------------------
+// ReadbackRing definitions.
+
+ReadbackRing::ReadbackRing(int width, int height)
+    : mWidth(width), mHeight(height), mBytes(static_cast<std::size_t>(width) * height * 4) {
+  for (Slot &slot : mSlots) {
+    slot.buffer = GLBufferHandle::create();
+    glState().bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer.get());
+    // Read by us, written by GL.
+    glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(mBytes), nullptr, GL_STREAM_READ);
+    slot.buffer.setBytes(mBytes);
+  }
+  glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+ReadbackRing::~ReadbackRing() {
+  for (Slot &slot : mSlots) {
+    if (slot.fence) {
+      glDeleteSync(slot.fence);
+    }
+  }
+}
+
+void ReadbackRing::read(std::size_t tag, const ReadyFunction &onReady) {
+  // Free the slot we're about to reuse.
+  while (mIssued - mCompleted >= RING_SIZE) {
+    collect(onReady, true);
+  }
+
+  Slot &slot = mSlots[mIssued % RING_SIZE];
+  slot.tag = tag;
+
+  glState().bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer.get());
+  // With a pack buffer bound, the last argument is an offset into it, and
+  // this returns once the copy is queued.
+  glReadPixels(0, 0, mWidth, mHeight, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  mIssued++;
+}
+
+void ReadbackRing::collect(const ReadyFunction &onReady, bool wait) {
+  while (mCompleted < mIssued) {
+    if (!complete(mSlots[mCompleted % RING_SIZE], onReady, wait)) {
+      return;
+    }
+    mCompleted++;
+    // One wait is enough to free a slot.
+    wait = false;
+  }
+}
+
+void ReadbackRing::waitAll(const ReadyFunction &onReady) {
+  while (mCompleted < mIssued) {
+    collect(onReady, true);
+  }
+}
+
+bool ReadbackRing::complete(Slot &slot, const ReadyFunction &onReady, bool wait) {
+  if (!waitForFence(slot.fence, mWaits, wait)) {
+    return false;
+  }
+
+  glState().bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer.get());
+  const auto *pixels = static_cast<const std::uint8_t *>(
+      glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(mBytes), GL_MAP_READ_BIT));
+  if (!pixels) {
+    glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    throw std::runtime_error("Mapping a pixel readback buffer failed.");
+  }
+
+  onReady(slot.tag, pixels);
+
+  glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  return true;
+}
@@ -0,0 +1,191 @@
+// Batch rendering of camera poses to image files, for thumbnails and
+// turntable sequences.
+//
+// Frames render into an offscreen framebuffer and come back through a
+// ring of pixel buffer objects. glReadPixels into a bound PBO only queues
+// a copy, so we fence each read and map its buffer a few frames later,
+// once the fence has signaled; neither the GPU nor this thread waits on
+// the other unless the ring fills. Mapped pixels are copied out, flipped
+// to top row first, into recycled buffers that encoder jobs on the job
+// system write out as PNG or raw RGBA. Encoding is the slow part, so with
+// enough cores a sequence renders at GPU speed.
+
+#ifndef BATCH_RENDER_H
+#define BATCH_RENDER_H
+
+#include "glad/glad.h"
+
+#include <tools/gl_resources.h>
+#include <tools/helpers.h>
+#include <tools/job_system.h>
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// -----------------------------
+// Command line batch options.
+
+enum class ImageFormat { Png, Raw };
+
+struct BatchOptions {
+  bool enabled = false;
+  // Frames of a full turn around the model, if no pose file is given.
+  int turntableFrames = 0;
+  // File of poses, one "yaw pitch [fov]" per line, in degrees.
+  std::string posesPath;
+  std::filesystem::path outputDirectory = "batch_output";
+  ImageFormat format = ImageFormat::Png;
+  // Image size; the window's if 0.
+  int width = 0;
+  int height = 0;
+};
+
+// Recognizes `--turntable <frames>`, `--poses <path>`, `--batch-out <dir>`,
+// `--batch-format png|raw` and `--batch-size <w>x<h>`. Either of the first
+// two turns batch mode on.
+BatchOptions parseBatchOptions(int argc, char **argv);
+
+// -------------
+// Camera poses.
+
+struct CameraPose {
+  // Degrees about the y-axis, then the x-axis.
+  float yaw = 0.0f;
+  float pitch = 0.0f;
+  // Vertical field of view, in degrees.
+  double fov = 45.0;
+};
+
+// One full turn in frames equal steps, tilted by pitch.
+std::vector<CameraPose> turntablePoses(int frames, float pitch = 15.0f);
+
+// Reads poses from a file as described for BatchOptions, skipping blank
+// lines and '#' comments. Throws std::runtime_error on failure.
+std::vector<CameraPose> loadPoses(const std::string &path);
+
+// ------------------
+// Image encoder pool.
+
+struct EncodeJob {
+  std::filesystem::path path;
+  int width = 0;
+  int height = 0;
+  // Tightly packed RGBA, top row first.
+  std::vector<std::uint8_t> pixels;
+};
+
+class ImageEncoderPool {
+public:
+  struct Stats {
+    std::size_t written = 0;
+    std::size_t failed = 0;
+    // Times submit() found the queue full and waited for an encode.
+    std::size_t stalls = 0;
+    // Summed over encodes.
+    double encodeMs = 0.0;
+  };
+
+  // Lets at most maxQueued images wait to be encoded, or four per job
+  // system thread if 0, bounding memory when we render faster than we
+  // encode.
+  explicit ImageEncoderPool(ImageFormat format, std::size_t maxQueued = 0);
+
+  ImageEncoderPool(const ImageEncoderPool &) = delete;
+  ImageEncoderPool &operator=(const ImageEncoderPool &) = delete;
+
+  // Finishes queued jobs first.
+  ~ImageEncoderPool();
+
+  // A buffer of size bytes, reusing one from a written image if we can.
+  std::vector<std::uint8_t> acquireBuffer(std::size_t size);
+
+  // Queues job to encode, first waiting on the oldest if the queue is full.
+  void submit(EncodeJob job);
+
+  // Waits until every submitted job is written.
+  void finish();
+
+  [[nodiscard]] Stats stats() const;
+
+private:
+  // Encodes job, on a job system thread.
+  void run(EncodeJob &job);
+  bool encode(const EncodeJob &job) const;
+
+private:
+  ImageFormat mFormat;
+  std::size_t mMaxQueued;
+
+  // Encodes submitted and not yet known to be done, oldest first. Only
+  // the submitting thread touches these.
+  std::deque<JobHandle> mQueued;
+
+  // Guards what encodes update.
+  mutable std::mutex mMutex;
+  std::vector<std::vector<std::uint8_t>> mFreeBuffers;
+  Stats mStats;
+};
+
+// --------------
+// Readback ring.
+
+class ReadbackRing {
+public:
+  // Called with a finished read's tag and its mapped pixels, RGBA and
+  // bottom row first. The pointer is only valid during the call.
+  using ReadyFunction = std::function<void(std::size_t tag, const std::uint8_t *pixels)>;
+
+  static constexpr std::size_t RING_SIZE = 3;
+
+  ReadbackRing(int width, int height);
+
+  ReadbackRing(const ReadbackRing &) = delete;
+  ReadbackRing &operator=(const ReadbackRing &) = delete;
+
+  ~ReadbackRing();
+
+  // Queues a read of the bound read framebuffer's color. If the next
+  // buffer still holds an earlier read, that one is finished first,
+  // waiting on it if need be.
+  void read(std::size_t tag, const ReadyFunction &onReady);
+
+  // Finishes reads, oldest first, stopping at the first still in flight
+  // unless wait is set.
+  void collect(const ReadyFunction &onReady, bool wait);
+
+  // Finishes every read still in flight, waiting on each as need be.
+  void waitAll(const ReadyFunction &onReady);
+
+  // Times we had to wait for a copy to finish.
+  [[nodiscard]] const FenceWaitStats &waits() const { return mWaits; }
+
+private:
+  struct Slot {
+    GLBufferHandle buffer;
+    GLsync fence = nullptr;
+    std::size_t tag = 0;
+  };
+
+  // Maps and hands off slot's pixels, if its copy is done or wait is set.
+  bool complete(Slot &slot, const ReadyFunction &onReady, bool wait);
+
+private:
+  int mWidth;
+  int mHeight;
+  std::size_t mBytes;
+
+  std::array<Slot, RING_SIZE> mSlots;
+  // Reads issued and finished; slot n % RING_SIZE holds read n.
+  std::size_t mIssued = 0;
+  std::size_t mCompleted = 0;
+
+  FenceWaitStats mWaits;
+};
+
+#endif // BATCH_RENDER_H
@@ -0,0 +1,108 @@
+// Uniform buffer holding the camera matrices, shared by all of our
+// shader programs through the "Camera" uniform block.
+//
+// Matrices are only copied to the CPU-side block when they change, and
+// the block is uploaded at most once per frame, in flush(). The buffer
+// itself is created on the first flush, so the matrices can also be kept
+// without a GL context, e.g. for the software rasterizer. Each flush also
+// binds the buffer, so several instances can share the binding point.
+
+#ifndef CAMERA_UNIFORMS_H
+#define CAMERA_UNIFORMS_H
+
+#include "glad/glad.h"
+
+#include <glm/glm.hpp>
+#include <learnopengl/shader_m.h>
+#include <tools/gl_resources.h>
+#include <tools/gl_state.h>
+
+// -------------------------------------------------
+// CPU-side copy of the block, in std140 layout.
+
+// Must match the Camera block in src/shaders/camera.glsl, which our vertex
+// shaders include:
+//
+//   layout (std140) uniform Camera {
+//       mat4 projection;
+//       mat4 view;
+//       mat4 model;
+//   };
+//
+struct CameraBlock {
+  glm::mat4 projection;
+  glm::mat4 view;
+  glm::mat4 model;
+};
+
+// Under std140 each mat4 is four vec4 columns, so there is no padding.
+static_assert(sizeof(CameraBlock) == 3 * 16 * sizeof(float));
+
+// ---------------------
+// Camera uniform buffer.
+
+class CameraUniformBuffer {
+public:
+  static constexpr GLuint BINDING_POINT = 0;
+  static constexpr const char *BLOCK_NAME = "Camera";
+
+  CameraUniformBuffer() = default;
+
+  CameraUniformBuffer(const CameraUniformBuffer &) = delete;
+  CameraUniformBuffer &operator=(const CameraUniformBuffer &) = delete;
+
+  // Point a shader's Camera block at our binding point.
+  static void attach(const Shader &shader) { shader.bindUniformBlock(BLOCK_NAME, BINDING_POINT); }
+
+  void setProjection(const glm::mat4 &projection) {
+    mBlock.projection = projection;
+    mDirty = true;
+  }
+
+  void setView(const glm::mat4 &view) {
+    mBlock.view = view;
+    mDirty = true;
+  }
+
+  void setModel(const glm::mat4 &model) {
+    mBlock.model = model;
+    mDirty = true;
+  }
+
+  // Uploads the block if anything changed since the last flush, and binds
+  // it to BINDING_POINT, which another instance may have taken since.
+  // Returns whether an upload happened.
+  bool flush() {
+    if (!mUBO) {
+      create();
+    }
+
+    const bool upload = mDirty;
+    if (upload) {
+      glState().bindBuffer(GL_UNIFORM_BUFFER, mUBO.get());
+      glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraBlock), &mBlock);
+      mDirty = false;
+    }
+
+    // Every program reads the camera from this binding point.
+    glState().bindBufferBase(GL_UNIFORM_BUFFER, BINDING_POINT, mUBO.get());
+    return upload;
+  }
+
+private:
+  void create() {
+    mUBO = GLBufferHandle::create();
+    glState().bindBuffer(GL_UNIFORM_BUFFER, mUBO.get());
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), nullptr, GL_DYNAMIC_DRAW);
+    mUBO.setBytes(sizeof(CameraBlock));
+  }
+
+private:
+  // Made on the first flush, so there's no GL work until then.
+  GLBufferHandle mUBO;
+
+  CameraBlock mBlock = {glm::mat4(1.0f), glm::mat4(1.0f), glm::mat4(1.0f)};
+  bool mDirty = true;
+};
+
+#endif // CAMERA_UNIFORMS_H
@@ -0,0 +1,27 @@
+// clang-format off
+#include "disk_cache.h"
+
+#include <fmt/core.h>
+#include <learnopengl/filesystem.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <system_error>
+// clang-format on
+
+std::optional<std::filesystem::path> cacheDirectory(const char *variable, const char *defaultPath,
+                                                    std::string_view label) {
+  const char *setting = std::getenv(variable);
+  if (setting != nullptr && std::strcmp(setting, "off") == 0) {
+    return std::nullopt;
+  }
+
+  std::filesystem::path path = setting != nullptr ? setting : FileSystem::getPath(defaultPath);
+  std::error_code error;
+  std::filesystem::create_directories(path, error);
+  if (error) {
+    fmt::print("[{}] Can't create {}: {}\n", label, path.string(), error.message());
+    return std::nullopt;
+  }
+  return path;
+}
@@ -0,0 +1,29 @@
+// Pieces shared by our on-disk caches, of program binaries (see
+// program_cache.h) and of mip chains (see mip_chain.h).
+
+#ifndef DISK_CACHE_H
+#define DISK_CACHE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+// 64-bit FNV-1a, continuing from hash. Cache keys use it for being fast
+// and stable across runs and platforms, unlike std::hash.
+inline std::uint64_t fnv1a(std::string_view data, std::uint64_t hash = 14695981039346656037ull) {
+  for (unsigned char c : data) {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+// The directory named by the environment variable, or defaultPath under
+// the project root if it's unset, created if need be. Nothing if the
+// variable is "off", or if the directory can't be made, which is
+// reported under label.
+std::optional<std::filesystem::path> cacheDirectory(const char *variable, const char *defaultPath,
+                                                    std::string_view label);
+
+#endif // DISK_CACHE_H
@@ -0,0 +1,93 @@
+// Linear allocator for data that only lives for one frame. Memory is
+// reserved once up front; allocating bumps a pointer and reset() frees
+// everything at once, so steady-state frames never touch the heap.
+//
+// It's also a std::pmr::memory_resource, so standard containers can keep
+// transient draw data in it. Deallocating does nothing, and running out
+// of space throws rather than falling back to the heap, so a container
+// on the arena can't quietly allocate. Counters show how many
+// allocations each frame makes, and their sizes.
+
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+class FrameArena : public std::pmr::memory_resource {
+public:
+  explicit FrameArena(std::size_t capacity) : mBuffer(new std::byte[capacity]), mCapacity(capacity) {}
+
+  FrameArena(const FrameArena &) = delete;
+  FrameArena &operator=(const FrameArena &) = delete;
+
+  // allocate(bytes, alignment) comes from memory_resource, and throws if
+  // the arena is out of space.
+
+  // Uninitialized storage for count objects of a trivial type.
+  template <typename T>
+  T *allocateArray(std::size_t count) {
+    static_assert(std::is_trivially_destructible_v<T>, "FrameArena never runs destructors.");
+    return static_cast<T *>(allocate(count * sizeof(T), alignof(T)));
+  }
+
+  // Frees everything allocated since the last reset.
+  void reset() {
+    mUsed = 0;
+    mAllocations = 0;
+    mResets++;
+  }
+
+  [[nodiscard]] std::size_t used() const { return mUsed; }
+  [[nodiscard]] std::size_t capacity() const { return mCapacity; }
+  // Most ever used between resets, for sizing the arena.
+  [[nodiscard]] std::size_t highWater() const { return mHighWater; }
+
+  // Allocations since the last reset, and ever.
+  [[nodiscard]] std::size_t allocations() const { return mAllocations; }
+  [[nodiscard]] std::uint64_t totalAllocations() const { return mTotalAllocations; }
+  // Frames, counted by resets.
+  [[nodiscard]] std::uint64_t resets() const { return mResets; }
+
+private:
+  void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+    // Align the address, not the offset: the buffer itself is only aligned
+    // for std::max_align_t, and callers may ask for more.
+    const auto base = reinterpret_cast<std::uintptr_t>(mBuffer.get());
+    const std::size_t start = ((base + mUsed + alignment - 1) & ~(alignment - 1)) - base;
+
+    if (start > mCapacity || bytes > mCapacity - start) {
+      throw std::runtime_error("FrameArena is out of space.");
+    }
+
+    mUsed = start + bytes;
+    mHighWater = mUsed > mHighWater ? mUsed : mHighWater;
+    mAllocations++;
+    mTotalAllocations++;
+
+    return mBuffer.get() + start;
+  }
+
+  // Everything goes at once, in reset().
+  void do_deallocate(void *, std::size_t, std::size_t) override {}
+
+  [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+
+private:
+  std::unique_ptr<std::byte[]> mBuffer;
+  std::size_t mCapacity;
+  std::size_t mUsed = 0;
+  std::size_t mHighWater = 0;
+  std::size_t mAllocations = 0;
+  std::uint64_t mTotalAllocations = 0;
+  std::uint64_t mResets = 0;
+};
+
+#endif // FRAME_ARENA_H
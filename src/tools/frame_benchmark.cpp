@@ -0,0 +1,160 @@
+// clang-format off
+#include "frame_benchmark.h"
+#include "percentiles.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+// clang-format on
+
+namespace {
+
+struct Summary {
+  double mean = 0.0;
+  double p50 = 0.0;
+  double p90 = 0.0;
+  double p99 = 0.0;
+  double max = 0.0;
+};
+
+Summary summarize(const std::vector<double> &values) {
+  const Percentiles percentiles{values};
+  return {percentiles.mean(), percentiles.at(50), percentiles.at(90), percentiles.at(99), percentiles.max()};
+}
+
+std::string toJson(const Summary &summary) {
+  return fmt::format(R"({{"mean": {:.4f}, "p50": {:.4f}, "p90": {:.4f}, "p99": {:.4f}, "max": {:.4f}}})",
+                     summary.mean, summary.p50, summary.p90, summary.p99, summary.max);
+}
+
+} // namespace
+
+// -------------------
+// Option definitions.
+
+BenchOptions parseBenchOptions(int argc, char **argv) {
+  BenchOptions options;
+
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+
+    if (arg == "--bench") {
+      options.enabled = true;
+      // Optional frame count.
+      if (i + 1 < argc && std::strspn(argv[i + 1], "0123456789") == std::strlen(argv[i + 1])) {
+        options.frames = std::max(1, std::atoi(argv[++i]));
+      }
+    } else if (arg == "--bench-out" && i + 1 < argc) {
+      options.outputPath = argv[++i];
+    } else if (arg == "--headless") {
+      options.headless = true;
+    }
+  }
+
+  return options;
+}
+
+// --------------------------
+// FrameBenchmark definitions.
+
+FrameBenchmark::FrameBenchmark(int numFrames) : mNumFrames(numFrames) {
+  mRecords.resize(numFrames);
+
+  glGenQueries(QUERY_RING_SIZE, mQueries.data());
+  mQueryFrames.fill(-1);
+}
+
+FrameBenchmark::~FrameBenchmark() { glDeleteQueries(QUERY_RING_SIZE, mQueries.data()); }
+
+void FrameBenchmark::beginFrame() {
+  // Make room in the ring by taking finished results, waiting only if
+  // the slot we need is still in flight.
+  collectGpuTimes(false);
+  const std::size_t slot = mFrame % QUERY_RING_SIZE;
+  if (mQueryFrames[slot] >= 0) {
+    collectGpuTimes(true);
+  }
+
+  mFrameStart = std::chrono::steady_clock::now();
+
+  glBeginQuery(GL_TIME_ELAPSED, mQueries[slot]);
+  mQueryFrames[slot] = mFrame;
+}
+
+void FrameBenchmark::endSubmission(std::uint32_t draws, std::uint64_t glCallsIssued, std::uint64_t glCallsElided) {
+  glEndQuery(GL_TIME_ELAPSED);
+
+  std::chrono::duration<double, std::milli> cpu = std::chrono::steady_clock::now() - mFrameStart;
+
+  FrameRecord &record = mRecords[mFrame];
+  record.cpuMs = cpu.count();
+  record.draws = draws;
+  record.glCallsIssued = glCallsIssued;
+  record.glCallsElided = glCallsElided;
+}
+
+void FrameBenchmark::endFrame() {
+  std::chrono::duration<double, std::milli> frame = std::chrono::steady_clock::now() - mFrameStart;
+  mRecords[mFrame].frameMs = frame.count();
+
+  mFrame++;
+}
+
+void FrameBenchmark::collectGpuTimes(bool wait) {
+  for (std::size_t slot = 0; slot < QUERY_RING_SIZE; slot++) {
+    if (mQueryFrames[slot] < 0) {
+      continue;
+    }
+
+    if (!wait) {
+      GLint available = 0;
+      glGetQueryObjectiv(mQueries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available) {
+        continue;
+      }
+    }
+
+    GLuint64 elapsedNs = 0;
+    glGetQueryObjectui64v(mQueries[slot], GL_QUERY_RESULT, &elapsedNs);
+
+    mRecords[mQueryFrames[slot]].gpuMs = static_cast<double>(elapsedNs) / 1.0e6;
+    mQueryFrames[slot] = -1;
+  }
+}
+
+std::string FrameBenchmark::report(const std::string &app, bool headless) {
+  collectGpuTimes(true);
+
+  std::vector<double> cpu, frame, gpu;
+  std::string perFrame;
+
+  for (int i = 0; i < mFrame; i++) {
+    const FrameRecord &record = mRecords[i];
+
+    cpu.push_back(record.cpuMs);
+    frame.push_back(record.frameMs);
+    gpu.push_back(record.gpuMs);
+
+    perFrame += fmt::format(
+        R"({}    {{"cpu_ms": {:.4f}, "frame_ms": {:.4f}, "gpu_ms": {:.4f}, "draws": {}, "gl_calls_issued": {}, "gl_calls_elided": {}}})",
+        i == 0 ? "" : ",\n", record.cpuMs, record.frameMs, record.gpuMs, record.draws, record.glCallsIssued,
+        record.glCallsElided);
+  }
+
+  return fmt::format("{{\n"
+                     "  \"app\": \"{}\",\n"
+                     "  \"headless\": {},\n"
+                     "  \"frames\": {},\n"
+                     "  \"summary\": {{\n"
+                     "    \"cpu_ms\": {},\n"
+                     "    \"frame_ms\": {},\n"
+                     "    \"gpu_ms\": {}\n"
+                     "  }},\n"
+                     "  \"per_frame\": [\n{}\n  ]\n"
+                     "}}\n",
+                     app, headless, mFrame, toJson(summarize(cpu)), toJson(summarize(frame)),
+                     toJson(summarize(gpu)), perFrame);
+}
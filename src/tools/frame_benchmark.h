@@ -0,0 +1,87 @@
+// Records per-frame timings over a fixed number of frames and reports
+// them, with percentile summaries, as JSON.
+//
+// CPU time covers recording and submitting a frame. GPU time comes from
+// GL_TIME_ELAPSED queries, which are read back a few frames late so
+// that waiting on them never stalls the pipeline.
+
+#ifndef FRAME_BENCHMARK_H
+#define FRAME_BENCHMARK_H
+
+#include "glad/glad.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ------------------------------
+// Command line benchmark options.
+
+struct BenchOptions {
+  bool enabled = false;
+  // Render into an offscreen framebuffer with no window system.
+  bool headless = false;
+  int frames = 300;
+  // Where to write the JSON report; stdout if empty.
+  std::string outputPath;
+};
+
+// Recognizes `--bench [frames]`, `--bench-out <path>` and `--headless`.
+BenchOptions parseBenchOptions(int argc, char **argv);
+
+// ----------------
+// Frame benchmark.
+
+class FrameBenchmark {
+public:
+  struct FrameRecord {
+    double cpuMs = 0.0;
+    double frameMs = 0.0;
+    double gpuMs = 0.0;
+    std::uint32_t draws = 0;
+    std::uint64_t glCallsIssued = 0;
+    std::uint64_t glCallsElided = 0;
+  };
+
+  explicit FrameBenchmark(int numFrames);
+
+  FrameBenchmark(const FrameBenchmark &) = delete;
+  FrameBenchmark &operator=(const FrameBenchmark &) = delete;
+
+  ~FrameBenchmark();
+
+  [[nodiscard]] bool done() const { return mFrame >= mNumFrames; }
+  [[nodiscard]] int frame() const { return mFrame; }
+  [[nodiscard]] int numFrames() const { return mNumFrames; }
+
+  // Bracket the CPU work of recording and submitting a frame.
+  void beginFrame();
+  void endSubmission(std::uint32_t draws, std::uint64_t glCallsIssued, std::uint64_t glCallsElided);
+  // Call after the frame is presented.
+  void endFrame();
+
+  // Waits for outstanding GPU timings, then formats everything as JSON.
+  std::string report(const std::string &app, bool headless);
+
+private:
+  void collectGpuTimes(bool wait);
+
+private:
+  // Frames of latency before we read a query back.
+  static constexpr std::size_t QUERY_RING_SIZE = 4;
+
+  int mNumFrames;
+  int mFrame = 0;
+
+  std::vector<FrameRecord> mRecords;
+
+  std::array<GLuint, QUERY_RING_SIZE> mQueries = {};
+  // Frame whose result each query holds, or -1 if it's free.
+  std::array<int, QUERY_RING_SIZE> mQueryFrames = {};
+
+  std::chrono::steady_clock::time_point mFrameStart;
+};
+
+#endif // FRAME_BENCHMARK_H
@@ -0,0 +1,172 @@
+// clang-format off
+#include "frame_loop.h"
+#include "percentiles.h"
+
+#include <GLFW/glfw3.h>
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <string_view>
+#include <thread>
+#include <vector>
+// clang-format on
+
+// -------------------
+// Option definitions.
+
+FrameLoopOptions parseFrameLoopOptions(int argc, char **argv, PacingMode defaultPacing) {
+  FrameLoopOptions options;
+  options.pacing = defaultPacing;
+
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+
+    if (arg == "--vsync") {
+      options.pacing = PacingMode::VSync;
+    } else if (arg == "--no-vsync") {
+      options.pacing = PacingMode::Unlimited;
+    } else if (arg == "--fps-cap" && i + 1 < argc) {
+      const double hz = std::atof(argv[++i]);
+      if (hz > 0.0) {
+        options.pacing = PacingMode::Capped;
+        options.frameCapHz = hz;
+      }
+    } else if (arg == "--sim-hz" && i + 1 < argc) {
+      const double hz = std::atof(argv[++i]);
+      if (hz > 0.0) {
+        options.simulationHz = hz;
+      }
+    } else if (arg == "--frame-stats") {
+      options.printStats = true;
+    } else if (arg == "--on-demand") {
+      options.onDemand = true;
+    } else if (arg == "--render-thread") {
+      options.renderThread = true;
+    }
+  }
+
+  return options;
+}
+
+// ---------------------
+// FrameLoop definitions.
+
+FrameLoop::FrameLoop(const FrameLoopOptions &options)
+    : mOptions(options), mTimestep(1.0 / options.simulationHz) {}
+
+void FrameLoop::applyPacing() const { glfwSwapInterval(mOptions.pacing == PacingMode::VSync ? 1 : 0); }
+
+void FrameLoop::requestRedraw() {
+  // Only the first request needs to wake anyone.
+  if (!mRedrawRequested.exchange(true) && mOptions.onDemand) {
+    mRedrawRequested.notify_all();
+    glfwPostEmptyEvent();
+  }
+}
+
+bool FrameLoop::waitForRedraw() {
+  if (!mOptions.onDemand || mRedrawRequested.exchange(false)) {
+    return true;
+  }
+
+  glfwWaitEvents();
+  mStarted = false;
+
+  return mRedrawRequested.exchange(false);
+}
+
+void FrameLoop::awaitRedrawRequest() {
+  if (!mOptions.onDemand || mRedrawRequested.exchange(false)) {
+    return;
+  }
+
+  mRedrawRequested.wait(false);
+  mRedrawRequested.store(false);
+  mStarted = false;
+}
+
+void FrameLoop::beginFrame() {
+  const Clock::time_point now = Clock::now();
+  mStatsPrinted = false;
+
+  // The first frame has nothing to measure or simulate.
+  if (mStarted) {
+    const double frameMs = std::chrono::duration<double, std::milli>(now - mFrameStart).count();
+    mFrameMs[mFrames % STATS_WINDOW] = frameMs;
+    mFrames++;
+
+    mAccumulator += frameMs / 1000.0;
+
+    const double maxBanked = MAX_STEPS_PER_FRAME * mTimestep;
+    if (mAccumulator > maxBanked) {
+      mDroppedMs += (mAccumulator - maxBanked) * 1000.0;
+      mAccumulator = maxBanked;
+    }
+
+    if (mOptions.printStats && mFrames % STATS_WINDOW == 0) {
+      printStats();
+      mStatsPrinted = true;
+    }
+  }
+
+  mFrameStart = now;
+  mStarted = true;
+}
+
+bool FrameLoop::stepSimulation() {
+  if (mAccumulator < mTimestep) {
+    return false;
+  }
+
+  mAccumulator -= mTimestep;
+  mSteps++;
+
+  return true;
+}
+
+void FrameLoop::endFrame() {
+  if (mOptions.pacing != PacingMode::Capped) {
+    return;
+  }
+
+  const auto target = mFrameStart + std::chrono::duration_cast<Clock::duration>(
+                                        std::chrono::duration<double>(1.0 / mOptions.frameCapHz));
+
+  // Sleep most of the way, since sleeps tend to overshoot, then yield
+  // for the remainder.
+  constexpr auto SPIN_MARGIN = std::chrono::milliseconds(1);
+  if (Clock::now() + SPIN_MARGIN < target) {
+    std::this_thread::sleep_until(target - SPIN_MARGIN);
+  }
+  while (Clock::now() < target) {
+    std::this_thread::yield();
+  }
+}
+
+FrameLoop::FrameStats FrameLoop::stats() const {
+  FrameStats stats;
+  stats.frames = mFrames;
+  stats.droppedMs = mDroppedMs;
+
+  const std::size_t count = std::min<std::uint64_t>(mFrames, STATS_WINDOW);
+  if (count == 0) {
+    return stats;
+  }
+
+  stats.lastMs = mFrameMs[(mFrames - 1) % STATS_WINDOW];
+
+  const Percentiles window{std::span(mFrameMs).first(count)};
+  stats.meanMs = window.mean();
+  stats.p50Ms = window.at(50);
+  stats.p99Ms = window.at(99);
+  stats.maxMs = window.max();
+
+  return stats;
+}
+
+void FrameLoop::printStats() const {
+  const FrameStats s = stats();
+  fmt::print("[frame loop] {} frames  mean {:.2f} ms ({:.1f} fps)  p50 {:.2f}  p99 {:.2f}  max {:.2f}  dropped {:.1f} ms\n",
+             s.frames, s.meanMs, s.meanMs > 0.0 ? 1000.0 / s.meanMs : 0.0, s.p50Ms, s.p99Ms, s.maxMs, s.droppedMs);
+}
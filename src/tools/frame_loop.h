@@ -0,0 +1,153 @@
+// Frame loop with a fixed-timestep simulation clock and frame pacing.
+//
+// Simulation (animation) advances in fixed steps of simulated time, as
+// many per frame as the elapsed wall time calls for, so its speed no
+// longer depends on the frame rate. Rendering then interpolates between
+// the last two simulation states using interpolationAlpha().
+//
+// Pacing is either vsync (swap interval 1), a frame cap we enforce by
+// sleeping, or unlimited. Frame times are kept over a rolling window.
+//
+// In on-demand mode we only render when something has requested a redraw
+// (input that moves the camera, a resize, running animation, a finished
+// load) and otherwise sleep in glfwWaitEvents, so a static scene costs
+// next to nothing.
+
+#ifndef FRAME_LOOP_H
+#define FRAME_LOOP_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// ------------------------------
+// Command line frame loop options.
+
+enum class PacingMode {
+  // Wait for vertical blank on swap.
+  VSync,
+  // Sleep so frames take at least 1 / frameCapHz.
+  Capped,
+  // Render as fast as we can.
+  Unlimited,
+};
+
+struct FrameLoopOptions {
+  PacingMode pacing = PacingMode::VSync;
+  double frameCapHz = 60.0;
+  // Rate of fixed simulation steps.
+  double simulationHz = 120.0;
+  // Print frame-time statistics every STATS_WINDOW frames.
+  bool printStats = false;
+  // Render only when a redraw is requested.
+  bool onDemand = false;
+  // Render on a thread of its own, leaving the main thread to handle events.
+  bool renderThread = false;
+};
+
+// Recognizes `--vsync`, `--fps-cap <hz>`, `--no-vsync`, `--sim-hz <hz>`,
+// `--frame-stats`, `--on-demand` and `--render-thread`. Pacing is
+// defaultPacing if none is given.
+FrameLoopOptions parseFrameLoopOptions(int argc, char **argv, PacingMode defaultPacing = PacingMode::VSync);
+
+// -----------
+// Frame loop.
+
+class FrameLoop {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // Frames summarized by stats().
+  static constexpr std::size_t STATS_WINDOW = 240;
+
+  struct FrameStats {
+    std::uint64_t frames = 0;
+    double lastMs = 0.0;
+    double meanMs = 0.0;
+    double p50Ms = 0.0;
+    double p99Ms = 0.0;
+    double maxMs = 0.0;
+    // Simulated time dropped because we fell too far behind.
+    double droppedMs = 0.0;
+  };
+
+  explicit FrameLoop(const FrameLoopOptions &options);
+
+  // Sets the swap interval for our pacing mode. Needs a current GL context.
+  void applyPacing() const;
+
+  // Marks the frame dirty. Safe to call from any thread; wakes whichever
+  // thread is waiting for a redraw.
+  void requestRedraw();
+
+  // Call at the top of each loop iteration. Returns whether to render a
+  // frame; in on-demand mode with nothing to draw, first blocks until an
+  // event arrives, and returns true only if handling it requested a redraw.
+  bool waitForRedraw();
+
+  // Like waitForRedraw(), for a render thread that doesn't handle events:
+  // in on-demand mode, blocks until someone requests a redraw.
+  void awaitRedrawRequest();
+
+  // Measures the time since the previous frame and banks it for simulation.
+  void beginFrame();
+
+  // Returns true while there's a whole simulation step left to take this
+  // frame, consuming it; call update(timestep()) for each one.
+  bool stepSimulation();
+
+  // Fraction of a step between the last simulation state and now.
+  [[nodiscard]] double interpolationAlpha() const { return mAccumulator / mTimestep; }
+
+  // Simulated seconds so far: the steps taken, plus interpolationAlpha() of
+  // the next. Unlike the wall clock, this skips idle and dropped time.
+  [[nodiscard]] double simulationTime() const {
+    return (static_cast<double>(mSteps) + interpolationAlpha()) * mTimestep;
+  }
+
+  // Fixed simulation step, in seconds.
+  [[nodiscard]] double timestep() const { return mTimestep; }
+
+  // Waits out the rest of a capped frame.
+  void endFrame();
+
+  [[nodiscard]] FrameStats stats() const;
+  void printStats() const;
+  // Whether this frame's beginFrame() printed stats, for callers to print
+  // their own alongside.
+  [[nodiscard]] bool printedStats() const { return mStatsPrinted; }
+
+  [[nodiscard]] PacingMode pacing() const { return mOptions.pacing; }
+  [[nodiscard]] bool onDemand() const { return mOptions.onDemand; }
+  [[nodiscard]] bool usesRenderThread() const { return mOptions.renderThread; }
+
+private:
+  // Most steps we'll take in one frame, so that a long stall (say, a
+  // breakpoint or window drag) doesn't turn into a burst of catch-up.
+  static constexpr int MAX_STEPS_PER_FRAME = 8;
+
+  FrameLoopOptions mOptions;
+
+  double mTimestep;
+  // Wall time not yet simulated, in seconds.
+  double mAccumulator = 0.0;
+  // Simulation steps taken.
+  std::uint64_t mSteps = 0;
+
+  Clock::time_point mFrameStart;
+  // False until the first frame, and again after idling, so that time
+  // spent waiting isn't counted as frame time or simulated.
+  bool mStarted = false;
+  bool mStatsPrinted = false;
+
+  // Start dirty, to draw the first frame.
+  std::atomic<bool> mRedrawRequested = true;
+
+  // Rolling window of frame times.
+  std::array<double, STATS_WINDOW> mFrameMs = {};
+  std::uint64_t mFrames = 0;
+  double mDroppedMs = 0.0;
+};
+
+#endif // FRAME_LOOP_H
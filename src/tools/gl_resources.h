@@ -0,0 +1,338 @@
+// Ownership and accounting of GL objects.
+//
+// GLHandle is a move-only owner of one GL object name. Destroying or
+// resetting it doesn't call GL: the name goes on a deletion queue, which
+// the GL thread drains with glResources().collect() at a safe point, the
+// start of each frame. So handles can be dropped from any thread, or after
+// a render thread has released the context, and GL objects still only
+// ever die where the context is current. Whatever is queued when the
+// window closes is deleted then, while the context still exists.
+//
+// The registry also tracks every live object and an estimate of the GPU
+// memory behind it, by kind, for finding leaks and holding a memory budget
+// in long sessions. Objects still alive when the window closes are
+// reported as leaks. Each object also gets a generation, unique across
+// the session, so code holding a bare name can tell whether it still
+// refers to the same object once GL may have reused it.
+
+#ifndef GL_RESOURCES_H
+#define GL_RESOURCES_H
+
+#include "glad/glad.h"
+
+#include <tools/gl_state.h>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// ------------------
+// GL resource kinds.
+
+enum class GLResourceKind : std::uint8_t {
+  Buffer,
+  Texture,
+  VertexArray,
+  Program,
+  Framebuffer,
+  Renderbuffer,
+  Count,
+};
+
+inline const char *resourceKindName(GLResourceKind kind) {
+  constexpr const char *NAMES[] = {"buffers", "textures", "vertex arrays", "programs", "framebuffers",
+                                   "renderbuffers"};
+  return NAMES[static_cast<std::size_t>(kind)];
+}
+
+// Bytes for a width x height image of bytesPerTexel, times layers, with a
+// full mip chain adding a third.
+inline std::size_t estimateTextureBytes(int width, int height, int bytesPerTexel, bool mipmapped, int layers = 1) {
+  const std::size_t base = static_cast<std::size_t>(width) * height * bytesPerTexel * layers;
+  return mipmapped ? base + base / 3 : base;
+}
+
+// ----------------------
+// GL resource registry.
+
+class GLResourceRegistry {
+public:
+  struct Usage {
+    std::size_t live = 0;
+    std::size_t bytes = 0;
+  };
+
+  static constexpr std::size_t NUM_KINDS = static_cast<std::size_t>(GLResourceKind::Count);
+
+  void add(GLResourceKind kind, GLuint name, std::size_t bytes = 0) {
+    std::lock_guard lock{mMutex};
+    auto [it, added] = mEntries[index(kind)].try_emplace(name);
+    if (added) {
+      it->second.generation = ++mGenerations;
+    }
+    mBytes[index(kind)] -= it->second.bytes;
+    it->second.bytes = bytes;
+    mBytes[index(kind)] += bytes;
+    mPeakBytes = std::max(mPeakBytes, totalBytesLocked());
+  }
+
+  // Updates the estimate for a live object, e.g. once its storage is made.
+  void setBytes(GLResourceKind kind, GLuint name, std::size_t bytes) { add(kind, name, bytes); }
+
+  // Forgets name and queues it for deletion. Safe from any thread.
+  void release(GLResourceKind kind, GLuint name) {
+    std::lock_guard lock{mMutex};
+    Entries &entries = mEntries[index(kind)];
+    if (auto it = entries.find(name); it != entries.end()) {
+      mBytes[index(kind)] -= it->second.bytes;
+      entries.erase(it);
+    }
+    mPending.emplace_back(kind, name);
+  }
+
+  // GL thread: deletes everything released since the last call. Returns
+  // how many objects were deleted.
+  std::size_t collect() {
+    std::vector<std::pair<GLResourceKind, GLuint>> pending;
+    {
+      std::lock_guard lock{mMutex};
+      if (mPending.empty()) {
+        return 0;
+      }
+      pending.swap(mPending);
+    }
+
+    for (const auto &[kind, name] : pending) {
+      destroy(kind, name);
+    }
+
+    return pending.size();
+  }
+
+  // Whether name is a live object, i.e. made and not yet released.
+  [[nodiscard]] bool contains(GLResourceKind kind, GLuint name) const {
+    std::lock_guard lock{mMutex};
+    return mEntries[index(kind)].contains(name);
+  }
+
+  // The generation of the live object called name, or 0 if there is none.
+  // A name deleted and made again gets a new generation.
+  [[nodiscard]] std::uint64_t generation(GLResourceKind kind, GLuint name) const {
+    std::lock_guard lock{mMutex};
+    const Entries &entries = mEntries[index(kind)];
+    const auto it = entries.find(name);
+    return it != entries.end() ? it->second.generation : 0;
+  }
+
+  [[nodiscard]] Usage usage(GLResourceKind kind) const {
+    std::lock_guard lock{mMutex};
+    return {mEntries[index(kind)].size(), mBytes[index(kind)]};
+  }
+
+  [[nodiscard]] std::size_t totalBytes() const {
+    std::lock_guard lock{mMutex};
+    return totalBytesLocked();
+  }
+
+  [[nodiscard]] std::size_t peakBytes() const {
+    std::lock_guard lock{mMutex};
+    return mPeakBytes;
+  }
+
+  [[nodiscard]] std::size_t pending() const {
+    std::lock_guard lock{mMutex};
+    return mPending.size();
+  }
+
+  // Budget for totalBytes(), in bytes; 0 for none.
+  void setBudget(std::size_t bytes) {
+    std::lock_guard lock{mMutex};
+    mBudget = bytes;
+  }
+
+  // Whether bytes more would stay within the budget, if there is one.
+  [[nodiscard]] bool fitsBudget(std::size_t bytes) const {
+    std::lock_guard lock{mMutex};
+    return mBudget == 0 || totalBytesLocked() + bytes <= mBudget;
+  }
+
+  [[nodiscard]] std::size_t liveObjects() const {
+    std::lock_guard lock{mMutex};
+    std::size_t live = 0;
+    for (const auto &entries : mEntries) {
+      live += entries.size();
+    }
+    return live;
+  }
+
+  // One line per kind with live objects.
+  void printReport(const char *title) const {
+    std::lock_guard lock{mMutex};
+    fmt::print("[gpu memory] {}: {:.1f} MiB (peak {:.1f} MiB)\n", title, mebibytes(totalBytesLocked()),
+               mebibytes(mPeakBytes));
+    for (std::size_t i = 0; i < NUM_KINDS; i++) {
+      if (!mEntries[i].empty()) {
+        fmt::print("[gpu memory]   {:>14}: {:5} live, {:8.1f} MiB\n", resourceKindName(static_cast<GLResourceKind>(i)),
+                   mEntries[i].size(), mebibytes(mBytes[i]));
+      }
+    }
+  }
+
+private:
+  struct Entry {
+    std::size_t bytes = 0;
+    std::uint64_t generation = 0;
+  };
+
+  using Entries = std::unordered_map<GLuint, Entry>;
+
+  static std::size_t index(GLResourceKind kind) { return static_cast<std::size_t>(kind); }
+
+  static double mebibytes(std::size_t bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); }
+
+  [[nodiscard]] std::size_t totalBytesLocked() const {
+    std::size_t total = 0;
+    for (std::size_t bytes : mBytes) {
+      total += bytes;
+    }
+    return total;
+  }
+
+  // Deleted names can be reused, so the state cache must forget them too.
+  static void destroy(GLResourceKind kind, GLuint name) {
+    switch (kind) {
+    case GLResourceKind::Buffer:
+      glDeleteBuffers(1, &name);
+      glState().forgetBuffer(name);
+      break;
+    case GLResourceKind::Texture:
+      glDeleteTextures(1, &name);
+      glState().forgetTexture(name);
+      break;
+    case GLResourceKind::VertexArray:
+      glDeleteVertexArrays(1, &name);
+      glState().forgetVertexArray(name);
+      break;
+    case GLResourceKind::Program:
+      glDeleteProgram(name);
+      glState().forgetProgram(name);
+      break;
+    case GLResourceKind::Framebuffer:
+      glDeleteFramebuffers(1, &name);
+      break;
+    case GLResourceKind::Renderbuffer:
+      glDeleteRenderbuffers(1, &name);
+      break;
+    case GLResourceKind::Count:
+      break;
+    }
+  }
+
+private:
+  mutable std::mutex mMutex;
+  std::array<Entries, NUM_KINDS> mEntries;
+  std::array<std::size_t, NUM_KINDS> mBytes{};
+  std::size_t mPeakBytes = 0;
+  std::size_t mBudget = 0;
+  // Generations handed out so far.
+  std::uint64_t mGenerations = 0;
+
+  std::vector<std::pair<GLResourceKind, GLuint>> mPending;
+};
+
+// The registry for our one GL context.
+inline GLResourceRegistry &glResources() {
+  static GLResourceRegistry registry;
+  return registry;
+}
+
+// ----------
+// GL handle.
+
+template <GLResourceKind Kind>
+class GLHandle {
+public:
+  GLHandle() = default;
+
+  // Makes a new object with glGen* (or glCreateProgram).
+  static GLHandle create() {
+    GLuint name = 0;
+    if constexpr (Kind == GLResourceKind::Buffer) {
+      glGenBuffers(1, &name);
+    } else if constexpr (Kind == GLResourceKind::Texture) {
+      glGenTextures(1, &name);
+    } else if constexpr (Kind == GLResourceKind::VertexArray) {
+      glGenVertexArrays(1, &name);
+    } else if constexpr (Kind == GLResourceKind::Program) {
+      name = glCreateProgram();
+    } else if constexpr (Kind == GLResourceKind::Framebuffer) {
+      glGenFramebuffers(1, &name);
+    } else if constexpr (Kind == GLResourceKind::Renderbuffer) {
+      glGenRenderbuffers(1, &name);
+    }
+    return adopt(name);
+  }
+
+  // Takes ownership of a name made elsewhere, e.g. a program linked by
+  // the program cache. Adopting 0 gives an empty handle.
+  static GLHandle adopt(GLuint name, std::size_t bytes = 0) {
+    GLHandle handle;
+    handle.mName = name;
+    if (name != 0) {
+      glResources().add(Kind, name, bytes);
+    }
+    return handle;
+  }
+
+  GLHandle(const GLHandle &) = delete;
+  GLHandle &operator=(const GLHandle &) = delete;
+
+  GLHandle(GLHandle &&other) noexcept : mName(std::exchange(other.mName, 0)) {}
+
+  GLHandle &operator=(GLHandle &&other) noexcept {
+    if (this != &other) {
+      reset();
+      mName = std::exchange(other.mName, 0);
+    }
+    return *this;
+  }
+
+  ~GLHandle() { reset(); }
+
+  // Queues our object for deletion, leaving us empty.
+  void reset() {
+    if (mName != 0) {
+      glResources().release(Kind, mName);
+      mName = 0;
+    }
+  }
+
+  // Records the GPU memory we estimate is behind the object.
+  void setBytes(std::size_t bytes) const {
+    if (mName != 0) {
+      glResources().setBytes(Kind, mName, bytes);
+    }
+  }
+
+  [[nodiscard]] GLuint get() const { return mName; }
+  explicit operator bool() const { return mName != 0; }
+
+private:
+  GLuint mName = 0;
+};
+
+using GLBufferHandle = GLHandle<GLResourceKind::Buffer>;
+using GLTextureHandle = GLHandle<GLResourceKind::Texture>;
+using GLVertexArrayHandle = GLHandle<GLResourceKind::VertexArray>;
+using GLProgramHandle = GLHandle<GLResourceKind::Program>;
+using GLFramebufferHandle = GLHandle<GLResourceKind::Framebuffer>;
+using GLRenderbufferHandle = GLHandle<GLResourceKind::Renderbuffer>;
+
+#endif // GL_RESOURCES_H
@@ -0,0 +1,267 @@
+// Thin state-tracking layer over the GL binding calls used in our draw
+// paths. It shadows the bound program, VAO, buffers, textures per unit
+// and polygon mode, skips calls that wouldn't change anything, and
+// counts issued versus elided calls per frame.
+//
+// GL entry points are called through a GLFunctions table. By default it
+// is filled from glad the first time it's needed, but a table of mock
+// functions can be installed instead to exercise the cache without a GPU.
+//
+// NOTE: Any code that binds these objects behind the cache's back should
+// call invalidate() afterward.
+
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include "glad/glad.h"
+
+#include <array>
+#include <cstdint>
+
+// ------------------------
+// Table of GL entry points.
+
+struct GLFunctions {
+  PFNGLUSEPROGRAMPROC useProgram = nullptr;
+  PFNGLBINDVERTEXARRAYPROC bindVertexArray = nullptr;
+  PFNGLBINDBUFFERPROC bindBuffer = nullptr;
+  PFNGLBINDBUFFERBASEPROC bindBufferBase = nullptr;
+  PFNGLACTIVETEXTUREPROC activeTexture = nullptr;
+  PFNGLBINDTEXTUREPROC bindTexture = nullptr;
+  PFNGLPOLYGONMODEPROC polygonMode = nullptr;
+
+  // Must be called after glad has loaded the GL functions.
+  static GLFunctions fromGlad() {
+    return {
+        .useProgram = glUseProgram,
+        .bindVertexArray = glBindVertexArray,
+        .bindBuffer = glBindBuffer,
+        .bindBufferBase = glBindBufferBase,
+        .activeTexture = glActiveTexture,
+        .bindTexture = glBindTexture,
+        .polygonMode = glPolygonMode,
+    };
+  }
+};
+
+// --------------
+// GL state cache.
+
+class GLStateCache {
+public:
+  // Calls made through the cache.
+  struct Counters {
+    std::uint64_t issued = 0;
+    std::uint64_t elided = 0;
+  };
+
+  // Texture units we shadow.
+  static constexpr unsigned int MAX_TEXTURE_UNITS = 32;
+
+  GLStateCache() { invalidate(); }
+
+  explicit GLStateCache(const GLFunctions &functions) : mFunctions(functions), mInstalled(true) { invalidate(); }
+
+  // Installs a new function table; nothing is assumed about current state.
+  void setFunctions(const GLFunctions &functions) {
+    mFunctions = functions;
+    mInstalled = true;
+    invalidate();
+  }
+
+  // Forget everything we know, so the next call of each kind is issued.
+  void invalidate() {
+    mProgram = UNKNOWN;
+    mVertexArray = UNKNOWN;
+    mBuffers.fill(UNKNOWN);
+    mActiveUnit = UNKNOWN;
+    for (auto &unit : mTextures) {
+      unit.fill(UNKNOWN);
+    }
+    mPolygonMode = UNKNOWN;
+  }
+
+  // Starts a new frame's counters, keeping the last frame's for reporting.
+  void beginFrame() {
+    mLastFrameCounters = mFrameCounters;
+    mFrameCounters = {};
+  }
+
+  [[nodiscard]] const Counters &frameCounters() const { return mFrameCounters; }
+  [[nodiscard]] const Counters &lastFrameCounters() const { return mLastFrameCounters; }
+
+  // ---------------
+  // Cached binding.
+
+  void useProgram(GLuint program) {
+    if (update(mProgram, program)) {
+      functions().useProgram(program);
+    }
+  }
+
+  void bindVertexArray(GLuint vertexArray) {
+    if (update(mVertexArray, vertexArray)) {
+      functions().bindVertexArray(vertexArray);
+      // The element buffer binding is part of VAO state.
+      mBuffers[bufferIndex(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+    }
+  }
+
+  void bindBuffer(GLenum target, GLuint buffer) {
+    int index = bufferIndex(target);
+    if (index < 0) {
+      issue();
+      functions().bindBuffer(target, buffer);
+    } else if (update(mBuffers[index], buffer)) {
+      functions().bindBuffer(target, buffer);
+    }
+  }
+
+  // Always issued, but it also binds the generic target, which we track.
+  void bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    issue();
+    functions().bindBufferBase(target, index, buffer);
+
+    if (int bufferSlot = bufferIndex(target); bufferSlot >= 0) {
+      mBuffers[bufferSlot] = buffer;
+    }
+  }
+
+  void activeTexture(GLuint unit) {
+    if (update(mActiveUnit, unit)) {
+      functions().activeTexture(GL_TEXTURE0 + unit);
+    }
+  }
+
+  // Binds a texture to the given unit (a number, not a GL_TEXTUREi enum).
+  void bindTexture(GLuint unit, GLenum target, GLuint texture) {
+    int index = textureTargetIndex(target);
+
+    if (unit >= MAX_TEXTURE_UNITS || index < 0) {
+      activeTexture(unit);
+      issue();
+      functions().bindTexture(target, texture);
+      return;
+    }
+
+    if (mTextures[unit][index] == texture) {
+      mFrameCounters.elided++;
+      return;
+    }
+
+    activeTexture(unit);
+    issue();
+    functions().bindTexture(target, texture);
+    mTextures[unit][index] = texture;
+  }
+
+  void polygonMode(GLenum mode) {
+    if (update(mPolygonMode, mode)) {
+      functions().polygonMode(GL_FRONT_AND_BACK, mode);
+    }
+  }
+
+  // ---------------------------------------------------------
+  // Deleted objects' names can be reused, so we forget them.
+
+  void forgetProgram(GLuint program) { forget(mProgram, program); }
+
+  void forgetVertexArray(GLuint vertexArray) { forget(mVertexArray, vertexArray); }
+
+  void forgetBuffer(GLuint buffer) {
+    for (auto &bound : mBuffers) {
+      forget(bound, buffer);
+    }
+  }
+
+  void forgetTexture(GLuint texture) {
+    for (auto &unit : mTextures) {
+      for (auto &bound : unit) {
+        forget(bound, texture);
+      }
+    }
+  }
+
+private:
+  static constexpr GLuint UNKNOWN = ~0u;
+
+  // Our function table, loaded from glad if nothing was installed. An
+  // installed table is never replaced, even if it has null entries.
+  const GLFunctions &functions() {
+    if (!mInstalled && mFunctions.useProgram == nullptr) {
+      mFunctions = GLFunctions::fromGlad();
+    }
+    return mFunctions;
+  }
+
+  // Records a call, returning whether it needs to be issued.
+  bool update(GLuint &shadow, GLuint value) {
+    if (shadow == value) {
+      mFrameCounters.elided++;
+      return false;
+    }
+    shadow = value;
+    issue();
+    return true;
+  }
+
+  void issue() { mFrameCounters.issued++; }
+
+  static void forget(GLuint &shadow, GLuint name) {
+    if (shadow == name) {
+      shadow = UNKNOWN;
+    }
+  }
+
+  static int bufferIndex(GLenum target) {
+    switch (target) {
+    case GL_ARRAY_BUFFER:
+      return 0;
+    case GL_ELEMENT_ARRAY_BUFFER:
+      return 1;
+    case GL_UNIFORM_BUFFER:
+      return 2;
+    case GL_PIXEL_PACK_BUFFER:
+      return 3;
+    case GL_PIXEL_UNPACK_BUFFER:
+      return 4;
+    default:
+      return -1;
+    }
+  }
+
+  static int textureTargetIndex(GLenum target) {
+    switch (target) {
+    case GL_TEXTURE_2D:
+      return 0;
+    case GL_TEXTURE_2D_ARRAY:
+      return 1;
+    default:
+      return -1;
+    }
+  }
+
+private:
+  GLFunctions mFunctions;
+  bool mInstalled = false;
+
+  // Shadowed state; see invalidate() for initial values.
+  GLuint mProgram;
+  GLuint mVertexArray;
+  std::array<GLuint, 5> mBuffers;
+  GLuint mActiveUnit;
+  std::array<std::array<GLuint, 2>, MAX_TEXTURE_UNITS> mTextures;
+  GLuint mPolygonMode;
+
+  Counters mFrameCounters;
+  Counters mLastFrameCounters;
+};
+
+// The cache used by our draw code. GL state is per context, and we only
+// ever have one context current on one thread.
+inline GLStateCache &glState() {
+  static GLStateCache cache;
+  return cache;
+}
+
+#endif // GL_STATE_H
@@ -7,52 +7,63 @@
 
 #include "glad/glad.h"
 
-#include <stb_image.h>
-
 #include <learnopengl/filesystem.h>
+#include <tools/gl_resources.h>
+#include <tools/gl_state.h>
+#include <tools/mip_chain.h>
+#include <tools/texture_streamer.h>
 
+#include <stdexcept>
 #include <string>
 
 class GLTexture {
 public:
-  explicit  GLTexture(const std::string& filename, GLenum format) {
-    glGenTextures(1, &mGlHandle);
-    glBindTexture(GL_TEXTURE_2D, mGlHandle);
+  // Images are color, so mips are averaged in linear light.
+  explicit  GLTexture(const std::string& filename) {
+    const std::string filepath = FileSystem::getPath(filename);
+    // flip loaded textures on the y-axis, for GL
+    constexpr bool FLIP = true;
+
+    // with --stream-textures, the image arrives over the next few frames
+    if (textureStreamer().enabled()) {
+      mTexture = textureStreamer().request(filepath, FLIP);
+      mIsLoaded = true;
+      return;
+    }
+
+    // load image and its mips, built on the CPU or read from the mip cache
+    MipChain chain;
+    try {
+      chain = loadMipChain(filepath, FLIP);
+    } catch (const std::runtime_error &) {
+      return;
+    }
+
+    mTexture = GLTextureHandle::create();
+    glState().bindTexture(0, GL_TEXTURE_2D, mTexture.get());
+    uploadMipChain(chain);
+    mTexture.setBytes(estimateTextureBytes(chain.front().width, chain.front().height, 4, true));
 
     // set the texture wrapping parameters
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // set texture filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    // set texture filtering parameters, sampling the mips we just uploaded
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    // load image, create texture and generate mipmaps
-    int width, height, nrChannels;
-    const std::string filepath = FileSystem::getPath(filename);
-    stbi_set_flip_vertically_on_load(true); // tell stb_image.h to flip loaded texture's on the y-axis.
-    unsigned char *data = stbi_load(filepath.c_str(),
-                                    &width, &height, &nrChannels, 0);
-
-    if (data) {
-      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-      glGenerateMipmap(GL_TEXTURE_2D);
-      mIsLoaded = true;
-    }
-
-    stbi_image_free(data);
+    mIsLoaded = true;
   }
 
   [[nodiscard]] bool isLoaded() const {
     return mIsLoaded;
   }
 
-  void bind(GLenum textureUnit) const {
-    glActiveTexture(textureUnit);
-    glBindTexture(GL_TEXTURE_2D, mGlHandle);
-  }
+  [[nodiscard]] unsigned int id() const { return mTexture.get(); }
+
+  void bind(GLenum textureUnit) const { glState().bindTexture(textureUnit - GL_TEXTURE0, GL_TEXTURE_2D, mTexture.get()); }
 
 private:
-  unsigned int mGlHandle = 0;
+  GLTextureHandle mTexture;
 
   bool mIsLoaded = false;
 };
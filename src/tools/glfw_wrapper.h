@@ -9,6 +9,10 @@
 #define GLFW_WRAPPER_H
 
 #include <GLFW/glfw3.h>
+#include <tools/alloc_tracker.h>
+#include <tools/gl_resources.h>
+#include <tools/input_state.h>
+#include <tools/profiler.h>
 
 #include <functional>
 #include <iostream>
@@ -20,47 +24,74 @@ class CallbackInterface {
   using ResizeCallback = std::function<void(int width, int height)>;
   using MouseDragCallback = std::function<void(double width, double height)>;
   using MouseScrollCallback = std::function<void(double xDelta, double yDelta)>;
+  using RedrawCallback = std::function<void()>;
 
 public:
   CallbackInterface() = default;
 
-  void resizeCallback(int width, int height) const {
-    // Make sure the viewport matches the new window dimensions.
-    glViewport(0, 0, width, height);
+  // The callbacks below only record input, to be applied once per frame
+  // by dispatchInput().
 
-    // Call the user's resize callback, if any.
-    if (mUserResizeCallback) {
-      mUserResizeCallback(width, height);
+  void resizeCallback(int width, int height) {
+    mInput.addResize(width, height, glfwGetTime());
+    requestRedraw();
+  }
+
+  void cursorPositionClickAndDragCallback(double xpos, double ypos, bool leftButtonDown) {
+    if (mInput.addCursor(xpos, ypos, leftButtonDown, glfwGetTime())) {
+      requestRedraw();
     }
   }
 
-  void cursorPositionClickAndDragCallback(double xpos, double ypos, bool leftButtonDown) const {
-    static bool dragging = false;
-    static double lastX;
-    static double lastY;
-
-    if (!dragging && leftButtonDown) {
-      dragging = true;
-      lastX = xpos;
-      lastY = ypos;
-    } else if (dragging && !leftButtonDown) {
-      dragging = false;
-    } else if (dragging) {
-      if (mUserMouseDragCallback) {
-        double deltaX = xpos - lastX;
-        double deltaY = ypos - lastY;
-
-        mUserMouseDragCallback(deltaX, deltaY);
+  void mouseScrollCallback(double xDelta, double yDelta) {
+    mInput.addScroll(xDelta, yDelta, glfwGetTime());
+    requestRedraw();
+  }
+
+  // Applies input recorded since the last call, calling each user callback
+  // at most once with the combined change. Call once per frame, before
+  // rendering. Returns what was applied.
+  InputSnapshot dispatchInput() {
+    const InputSnapshot input = takeInput();
+    applyInput(input);
+
+    return input;
+  }
+
+  // Returns input recorded since the last call, leaving it to be applied
+  // elsewhere, e.g. on a render thread.
+  InputSnapshot takeInput() { return mInput.takeSnapshot(); }
+
+  // Calls the user callbacks for a snapshot. Runs GL commands, so it must
+  // be called on the thread with the current context.
+  void applyInput(const InputSnapshot &input) const {
+    GLEX_PROFILE_SCOPE("input:apply");
+
+    if (input.resized) {
+      // Make sure the viewport matches the new window dimensions.
+      glViewport(0, 0, input.width, input.height);
+
+      if (mUserResizeCallback) {
+        mUserResizeCallback(input.width, input.height);
       }
+    }
+
+    if (input.dragged() && mUserMouseDragCallback) {
+      mUserMouseDragCallback(input.dragX, input.dragY);
+    }
 
-      lastX = xpos;
-      lastY = ypos;
+    if (input.scrolled() && mUserMouseScrollCallback) {
+      mUserMouseScrollCallback(input.scrollX, input.scrollY);
     }
   }
 
-  void mouseScrollCallback(double xDelta, double yDelta) const {
-    if (mUserMouseScrollCallback) {
-      mUserMouseScrollCallback(xDelta, yDelta);
+  // Called when the window contents are damaged and need redrawing.
+  void refreshCallback() const { requestRedraw(); }
+
+private:
+  void requestRedraw() const {
+    if (mRedrawCallback) {
+      mRedrawCallback();
     }
   }
 
@@ -68,6 +99,13 @@ public:
   ResizeCallback mUserResizeCallback = {};
   MouseDragCallback mUserMouseDragCallback = {};
   MouseScrollCallback mUserMouseScrollCallback = {};
+  // Called whenever input or the window system changes what should be on
+  // screen, e.g. to request a redraw when rendering on demand.
+  RedrawCallback mRedrawCallback = {};
+
+private:
+  // Input for this window since the last dispatch.
+  InputState mInput;
 };
 
 // ---------------------
@@ -78,13 +116,29 @@ public:
   GLFWWrapper() = default;
 
   ~GLFWWrapper() {
+    // Delete what's been dropped while the context still exists; anything
+    // still alive now was never released.
+    glResources().collect();
+    if (glResources().liveObjects() > 0) {
+      glResources().printReport("still alive at exit");
+    }
+
     // Terminate GLFW and release its resources
     glfwTerminate();
   }
 
-  bool init() {
+  // With headless set, we use GLFW's null platform and a context made by
+  // OSMesa or EGL, so we can render (into an FBO) with no display at all,
+  // e.g. with Mesa's llvmpipe on a build host.
+  bool init(bool headless = false) {
     // Initialize and configure glfw
-    glfwInit();
+    if (headless) {
+      glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    }
+    if (!glfwInit()) {
+      std::cout << "Failed to initialize GLFW" << std::endl;
+      return false;
+    }
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -94,7 +148,20 @@ public:
 #endif
 
     // Create window.
-    mWindow = glfwCreateWindow(INIT_SCR_WIDTH, INIT_SCR_HEIGHT, "LearnOpenGL", nullptr, nullptr);
+    if (headless) {
+      glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+      // Use whichever headless context API is available.
+      for (int contextApi : {GLFW_OSMESA_CONTEXT_API, GLFW_EGL_CONTEXT_API}) {
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, contextApi);
+        mWindow = glfwCreateWindow(INIT_SCR_WIDTH, INIT_SCR_HEIGHT, "LearnOpenGL", nullptr, nullptr);
+        if (mWindow != nullptr) {
+          break;
+        }
+      }
+    } else {
+      mWindow = glfwCreateWindow(INIT_SCR_WIDTH, INIT_SCR_HEIGHT, "LearnOpenGL", nullptr, nullptr);
+    }
     if (mWindow == nullptr) {
       std::cout << "Failed to create GLFW window" << std::endl;
       glfwTerminate();
@@ -102,6 +169,7 @@ public:
     }
 
     mDimensions = {INIT_SCR_WIDTH, INIT_SCR_HEIGHT};
+    mHeadless = headless;
 
     glfwMakeContextCurrent(mWindow);
 
@@ -112,6 +180,7 @@ public:
 
     // Set resize callback.
     glfwSetFramebufferSizeCallback(mWindow, [](GLFWwindow *window, int width, int height) -> void {
+      GLEX_PROFILE_SCOPE("input:resize");
       auto thisWindow = static_cast<GLFWWrapper *>(glfwGetWindowUserPointer(window));
       thisWindow->mDimensions = {width, height};
       thisWindow->mCallbackInterface.resizeCallback(width, height);
@@ -119,6 +188,7 @@ public:
 
     // Set callback to handle click and drag.
     glfwSetCursorPosCallback(mWindow, [](GLFWwindow *window, double xpos, double ypos) -> void {
+      GLEX_PROFILE_SCOPE("input:cursor");
       bool leftButtonDown = (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS);
       auto thisWindow = static_cast<GLFWWrapper *>(glfwGetWindowUserPointer(window));
       thisWindow->mCallbackInterface.cursorPositionClickAndDragCallback(xpos, ypos, leftButtonDown);
@@ -126,10 +196,24 @@ public:
 
     // Set mouse scroll wheel callback.
     glfwSetScrollCallback(mWindow, [](GLFWwindow *window, double xDelta, double yDelta) -> void {
+      GLEX_PROFILE_SCOPE("input:scroll");
       auto thisWindow = static_cast<GLFWWrapper *>(glfwGetWindowUserPointer(window));
       thisWindow->mCallbackInterface.mouseScrollCallback(xDelta, yDelta);
     });
 
+    // Set callback for when the window is exposed or otherwise damaged.
+    glfwSetWindowRefreshCallback(mWindow, [](GLFWwindow *window) -> void {
+      auto thisWindow = static_cast<GLFWWrapper *>(glfwGetWindowUserPointer(window));
+      thisWindow->mCallbackInterface.refreshCallback();
+    });
+
+    // Set key callback, for keys that act once per press.
+    glfwSetKeyCallback(mWindow, [](GLFWwindow *, int key, int, int action, int) -> void {
+      if (key == GLFW_KEY_F9 && action == GLFW_PRESS) {
+        allocationTracker().printReport("on request");
+      }
+    });
+
     return true;
   }
 
@@ -141,14 +225,39 @@ public:
       glfwSetWindowShouldClose(mWindow, true);
   }
 
-  void swapBuffers() const { glfwSwapBuffers(mWindow); }
+  void swapBuffers() const {
+    GLEX_PROFILE_SCOPE("swapBuffers");
+    glfwSwapBuffers(mWindow);
+  }
+
+  // Applies the input gathered by our callbacks since last frame.
+  InputSnapshot dispatchInput() { return mCallbackInterface.dispatchInput(); }
+
+  // For handing input to a render thread; see CallbackInterface.
+  InputSnapshot takeInput() { return mCallbackInterface.takeInput(); }
+  void applyInput(const InputSnapshot &input) const { mCallbackInterface.applyInput(input); }
 
-  static void pollEvents() { glfwPollEvents(); }
+  // Moves our GL context to the calling thread, or releases it from the
+  // calling thread if current is false.
+  void makeContextCurrent(bool current = true) const { glfwMakeContextCurrent(current ? mWindow : nullptr); }
+
+  // Blocks until at least one event arrives, then handles it.
+  static void waitEvents() {
+    GLEX_PROFILE_SCOPE("waitEvents");
+    glfwWaitEvents();
+  }
+
+  static void pollEvents() {
+    GLEX_PROFILE_SCOPE("pollEvents");
+    glfwPollEvents();
+  }
 
   [[nodiscard]] const std::pair<float, float> &dimensions() const { return mDimensions; }
 
   [[nodiscard]] float aspectRatio() const { return mDimensions.first / mDimensions.second; }
 
+  [[nodiscard]] bool isHeadless() const { return mHeadless; }
+
   CallbackInterface &callbackInterface() { return mCallbackInterface; }
 
 private:
@@ -159,6 +268,8 @@ private:
   // For efficient use in glm function calls.
   std::pair<float, float> mDimensions;
 
+  bool mHeadless = false;
+
   // Initial window dimensions.
   static constexpr unsigned int INIT_SCR_WIDTH = 800;
   static constexpr unsigned int INIT_SCR_HEIGHT = 600;
@@ -1,5 +1,7 @@
 #include "helpers.h"
 
+#include <chrono>
+#include <cstring>
 #include <stdexcept>
 
 GLuint makeShader(const std::string &source, GLenum type) {
@@ -39,7 +41,7 @@ std::optional<std::string> checkProgramLink(GLuint program) {
   int success;
   char infoLog[512];
 
-  glGetProgramiv(program, GL_COMPILE_STATUS, &success);
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
   if (!success) {
     glGetProgramInfoLog(program, 512, NULL, infoLog);
     return std::string{infoLog};
@@ -47,3 +49,44 @@ std::optional<std::string> checkProgramLink(GLuint program) {
 
   return std::nullopt;
 }
+
+bool hasExtension(const char *name) {
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (GLint i = 0; i < count; i++) {
+    const auto *extension = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+    if (extension != nullptr && std::strcmp(extension, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool waitForFence(GLsync &fence, FenceWaitStats &stats, bool wait) {
+  GLenum status = glClientWaitSync(fence, 0, 0);
+
+  if (status == GL_TIMEOUT_EXPIRED) {
+    if (!wait) {
+      return false;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    // Flush so the fence is sure to be reached, then wait a second at most
+    // per try.
+    status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000'000);
+    while (status == GL_TIMEOUT_EXPIRED) {
+      status = glClientWaitSync(fence, 0, 1'000'000'000);
+    }
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    stats.waits++;
+    stats.waitMs += elapsed.count();
+  }
+
+  glDeleteSync(fence);
+  fence = nullptr;
+
+  if (status == GL_WAIT_FAILED) {
+    throw std::runtime_error("Waiting on a GL fence failed.");
+  }
+  return true;
+}
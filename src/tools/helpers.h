@@ -3,10 +3,14 @@
 
 #include "glad/glad.h"
 
+#include <cstdint>
 #include <iostream>
 #include <optional>
+#include <string>
 #include <vector>
 
+// Issues a compile without waiting for it. To let the driver work on several
+// at once, make all shaders before checking any of them.
 GLuint makeShader(const std::string &source, GLenum type);
 
 std::optional<std::string> checkShaderCompile(GLuint shader);
@@ -15,4 +19,18 @@ GLuint makeProgram(std::vector<GLuint> shaders);
 
 std::optional<std::string> checkProgramLink(GLuint program);
 
+// Whether the current context lists the named extension.
+bool hasExtension(const char *name);
+
+// Times waitForFence() had to block, and for how long.
+struct FenceWaitStats {
+  std::uint64_t waits = 0;
+  double waitMs = 0.0;
+};
+
+// Deletes fence and returns true once it has signaled. If it hasn't yet,
+// returns false, or with wait set flushes and blocks until it does,
+// counting the wait in stats. Throws std::runtime_error if waiting fails.
+bool waitForFence(GLsync &fence, FenceWaitStats &stats, bool wait = true);
+
 #endif
@@ -0,0 +1,94 @@
+// Monotonic arena for data that only lives while a model is imported.
+//
+// Import builds every mesh's vertices and indices, uploads them, and then
+// has no more use for them. Rather than a heap allocation per vector, and
+// more as each one grows, the importer sizes an arena for the whole scene
+// up front, so it takes one block from the heap and hands out pieces of
+// it by bumping a pointer. Everything goes back at once when the arena is
+// destroyed. If the estimate was short it takes another block, which the
+// stats show.
+//
+// Like std::pmr::monotonic_buffer_resource, which it's built on, it isn't
+// thread-safe: allocate on one thread, e.g. reserve every vector first,
+// then fill them in parallel.
+
+#ifndef IMPORT_ARENA_H
+#define IMPORT_ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory_resource>
+
+class ImportArena : public std::pmr::memory_resource {
+public:
+  struct Stats {
+    std::size_t allocations = 0;
+    std::size_t bytes = 0;
+    // Taken from the heap; one, if the arena was sized right.
+    std::size_t blocks = 0;
+    std::size_t blockBytes = 0;
+  };
+
+  // Room for bytes of allocations, with their alignment padding. Blocks
+  // come from upstream.
+  explicit ImportArena(std::size_t bytes, std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+      : mUpstream(upstream), mArena(std::max<std::size_t>(bytes + BOOKKEEPING_BYTES, BOOKKEEPING_BYTES), &mUpstream) {}
+
+  ImportArena(const ImportArena &) = delete;
+  ImportArena &operator=(const ImportArena &) = delete;
+
+  [[nodiscard]] Stats stats() const {
+    Stats stats = mStats;
+    stats.blocks = mUpstream.blocks;
+    stats.blockBytes = mUpstream.bytes;
+    return stats;
+  }
+
+private:
+  // Counts the blocks the arena takes from the heap.
+  struct CountingUpstream : std::pmr::memory_resource {
+    explicit CountingUpstream(std::pmr::memory_resource *resource) : upstream(resource) {}
+
+    std::pmr::memory_resource *upstream;
+    std::size_t blocks = 0;
+    std::size_t bytes = 0;
+
+    void *do_allocate(std::size_t size, std::size_t alignment) override {
+      blocks++;
+      bytes += size;
+      return upstream->allocate(size, alignment);
+    }
+
+    void do_deallocate(void *p, std::size_t size, std::size_t alignment) override {
+      upstream->deallocate(p, size, alignment);
+    }
+
+    [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+      return this == &other;
+    }
+  };
+
+  void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+    mStats.allocations++;
+    mStats.bytes += bytes;
+    return mArena.allocate(bytes, alignment);
+  }
+
+  // Everything goes at once, with the arena.
+  void do_deallocate(void *, std::size_t, std::size_t) override {}
+
+  [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+
+private:
+  // The standard library keeps a little of each block for itself.
+  static constexpr std::size_t BOOKKEEPING_BYTES = 256;
+
+  // Declared first, as mArena allocates from it.
+  CountingUpstream mUpstream;
+  std::pmr::monotonic_buffer_resource mArena;
+  Stats mStats;
+};
+
+#endif // IMPORT_ARENA_H
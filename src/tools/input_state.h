@@ -0,0 +1,126 @@
+// Per-window input, accumulated between frames.
+//
+// GLFW can deliver dozens of cursor events per frame from a high polling
+// rate mouse. Rather than update the camera for each one, our callbacks
+// add them into an InputState, and once per frame, before rendering, we
+// take an InputSnapshot and apply the summed deltas in one go.
+
+#ifndef INPUT_STATE_H
+#define INPUT_STATE_H
+
+#include <cstdint>
+
+// ---------------
+// Input snapshot.
+
+struct InputSnapshot {
+  // Summed cursor motion while dragging with the left button.
+  double dragX = 0.0;
+  double dragY = 0.0;
+
+  // Summed scroll wheel offsets.
+  double scrollX = 0.0;
+  double scrollY = 0.0;
+
+  // Latest framebuffer size, if it changed.
+  bool resized = false;
+  int width = 0;
+  int height = 0;
+
+  // Number of events folded in, and when the first of them arrived,
+  // in seconds on the glfwGetTime clock.
+  std::uint32_t eventCount = 0;
+  double firstEventTime = 0.0;
+
+  [[nodiscard]] bool empty() const { return eventCount == 0; }
+  [[nodiscard]] bool dragged() const { return dragX != 0.0 || dragY != 0.0; }
+  [[nodiscard]] bool scrolled() const { return scrollX != 0.0 || scrollY != 0.0; }
+
+  // Folds a later snapshot into this one.
+  void merge(const InputSnapshot &later) {
+    if (later.empty()) {
+      return;
+    }
+
+    dragX += later.dragX;
+    dragY += later.dragY;
+    scrollX += later.scrollX;
+    scrollY += later.scrollY;
+
+    if (later.resized) {
+      resized = true;
+      width = later.width;
+      height = later.height;
+    }
+
+    if (eventCount == 0) {
+      firstEventTime = later.firstEventTime;
+    }
+    eventCount += later.eventCount;
+  }
+};
+
+// ------------
+// Input state.
+
+class InputState {
+public:
+  // Tracks click-and-drag. Returns whether the cursor moved while dragging.
+  bool addCursor(double xpos, double ypos, bool leftButtonDown, double time) {
+    bool moved = false;
+
+    if (!mDragging && leftButtonDown) {
+      mDragging = true;
+    } else if (mDragging && !leftButtonDown) {
+      mDragging = false;
+    } else if (mDragging) {
+      noteEvent(time);
+      mPending.dragX += xpos - mLastX;
+      mPending.dragY += ypos - mLastY;
+      moved = true;
+    }
+
+    mLastX = xpos;
+    mLastY = ypos;
+
+    return moved;
+  }
+
+  void addScroll(double xDelta, double yDelta, double time) {
+    noteEvent(time);
+    mPending.scrollX += xDelta;
+    mPending.scrollY += yDelta;
+  }
+
+  void addResize(int width, int height, double time) {
+    noteEvent(time);
+    mPending.resized = true;
+    mPending.width = width;
+    mPending.height = height;
+  }
+
+  // Returns everything accumulated since the last call, and starts over.
+  InputSnapshot takeSnapshot() {
+    InputSnapshot snapshot = mPending;
+    mPending = {};
+
+    return snapshot;
+  }
+
+private:
+  void noteEvent(double time) {
+    if (mPending.eventCount++ == 0) {
+      mPending.firstEventTime = time;
+    }
+  }
+
+private:
+  // Click-and-drag state persists across snapshots.
+  bool mDragging = false;
+  double mLastX = 0.0;
+  double mLastY = 0.0;
+
+  InputSnapshot mPending;
+};
+
+#endif // INPUT_STATE_H
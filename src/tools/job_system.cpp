@@ -0,0 +1,521 @@
+// clang-format off
+#include "job_system.h"
+#include "alloc_tracker.h"
+
+#include <algorithm>
+#include <array>
+#include <exception>
+#include <random>
+#include <thread>
+#include <utility>
+// clang-format on
+
+namespace {
+
+// Jobs a worker's deque holds; pushes past this go to the shared queue.
+constexpr std::int64_t DEQUE_CAPACITY = 4096;
+static_assert((DEQUE_CAPACITY & (DEQUE_CAPACITY - 1)) == 0, "Deque capacity must be a power of two.");
+
+// Times an idle worker looks again before going to sleep.
+constexpr int SPIN_TRIES = 64;
+
+// parallelFor aims for about this many chunks per thread, so stealing
+// can even out chunks that take longer than others.
+constexpr std::size_t CHUNKS_PER_THREAD = 8;
+
+// ------------------
+// Chase-Lev deque.
+//
+// After Lê, Pop, Cohen and Zappa Nardelli, "Correct and Efficient
+// Work-Stealing for Weak Memory Models" (2013), with a fixed buffer. Only
+// the owner pushes and pops, at the bottom; anyone steals, from the top.
+
+template <typename T> class ChaseLevDeque {
+public:
+  // Owner only. Returns false if full.
+  bool push(T *item) {
+    const std::int64_t bottom = mBottom.load(std::memory_order_relaxed);
+    const std::int64_t top = mTop.load(std::memory_order_acquire);
+    if (bottom - top >= DEQUE_CAPACITY) {
+      return false;
+    }
+
+    mItems[bottom & (DEQUE_CAPACITY - 1)].store(item, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    mBottom.store(bottom + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Owner only. The newest item, or null if empty.
+  T *pop() {
+    const std::int64_t bottom = mBottom.load(std::memory_order_relaxed) - 1;
+    mBottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::int64_t top = mTop.load(std::memory_order_relaxed);
+
+    T *item = nullptr;
+    if (top <= bottom) {
+      item = mItems[bottom & (DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+      if (top == bottom) {
+        // The last item: race thieves for it.
+        if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+          item = nullptr;
+        }
+        mBottom.store(bottom + 1, std::memory_order_relaxed);
+      }
+    } else {
+      mBottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return item;
+  }
+
+  // Any thread. The oldest item, or null if empty or we lost a race.
+  T *steal() {
+    std::int64_t top = mTop.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const std::int64_t bottom = mBottom.load(std::memory_order_acquire);
+
+    if (top >= bottom) {
+      return nullptr;
+    }
+
+    T *item = mItems[top & (DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+      return nullptr;
+    }
+    return item;
+  }
+
+  // Owner only; a thief may make it smaller at any time.
+  [[nodiscard]] bool empty() const {
+    return mBottom.load(std::memory_order_relaxed) <= mTop.load(std::memory_order_relaxed);
+  }
+
+private:
+  // Apart, so thieves bumping top don't keep taking the owner's line.
+  alignas(64) std::atomic<std::int64_t> mTop{0};
+  alignas(64) std::atomic<std::int64_t> mBottom{0};
+  std::array<std::atomic<T *>, DEQUE_CAPACITY> mItems{};
+};
+
+// For picking steal victims.
+std::minstd_rand &threadRandom() {
+  thread_local std::minstd_rand random{static_cast<unsigned>(std::hash<std::thread::id>{}(std::this_thread::get_id()))};
+  return random;
+}
+
+} // namespace
+
+// ---------------------
+// Job system internals.
+
+struct JobSystem::Job {
+  std::function<void()> fn;
+  // The submitting thread's, so allocations are charged to its subsystem.
+  AllocTag tag = AllocScope::current();
+
+  // Held by handles, by the queue it's in, and by each unfinished job it
+  // depends on.
+  std::atomic<int> refs{1};
+  // Unfinished dependencies; queued when this reaches 0.
+  std::atomic<int> pending{0};
+  std::atomic<bool> finished{false};
+
+  // Guards continuations, and error until the job is queued.
+  std::mutex mutex;
+  // Jobs waiting on this one, each holding a reference.
+  std::vector<Job *> continuations;
+  // From fn, or from a failed dependency.
+  std::exception_ptr error;
+};
+
+struct JobSystem::Worker {
+  JobSystem *system = nullptr;
+  ChaseLevDeque<Job> deque;
+  std::thread thread;
+};
+
+struct JobSystem::ForState {
+  const std::function<void(std::size_t, std::size_t)> *body = nullptr;
+  std::size_t grain = 1;
+  // Items not yet done; the caller waits for this to reach 0.
+  std::atomic<std::size_t> remaining{0};
+
+  std::atomic<bool> failed{false};
+  std::mutex errorMutex;
+  std::exception_ptr error;
+};
+
+thread_local JobSystem::Worker *JobSystem::sCurrentWorker = nullptr;
+
+// -----------------------
+// Handle definitions.
+
+JobSystem::Handle::Handle(const Handle &other) : mJob(other.mJob) {
+  if (mJob) {
+    mJob->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+JobSystem::Handle::Handle(Handle &&other) noexcept : mJob(std::exchange(other.mJob, nullptr)) {}
+
+JobSystem::Handle &JobSystem::Handle::operator=(Handle other) noexcept {
+  std::swap(mJob, other.mJob);
+  return *this;
+}
+
+JobSystem::Handle::~Handle() {
+  if (mJob) {
+    release(mJob);
+  }
+}
+
+bool JobSystem::Handle::done() const { return !mJob || mJob->finished.load(std::memory_order_acquire); }
+
+// -----------------------
+// JobSystem definitions.
+
+JobSystem &jobSystem() {
+  static JobSystem system;
+  return system;
+}
+
+JobSystem::JobSystem(unsigned threads) {
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  mWorkerCount = threads - 1;
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard lock{mSleepMutex};
+    mStopping = true;
+  }
+  mWake.notify_all();
+
+  for (auto &worker : mWorkers) {
+    worker->thread.join();
+  }
+
+  // With no workers, jobs nobody waited on are still queued.
+  while (Job *job = findJob(nullptr)) {
+    execute(job);
+  }
+}
+
+void JobSystem::start() {
+  std::call_once(mStarted, [this]() {
+    // Every worker exists before any runs, since thieves look at them all.
+    mWorkers.reserve(mWorkerCount);
+    for (unsigned i = 0; i < mWorkerCount; i++) {
+      auto worker = std::make_unique<Worker>();
+      worker->system = this;
+      mWorkers.push_back(std::move(worker));
+    }
+
+    for (auto &worker : mWorkers) {
+      worker->thread = std::thread([this, w = worker.get()]() { runWorker(*w); });
+    }
+  });
+}
+
+JobSystem::Worker *JobSystem::currentWorker() const {
+  return sCurrentWorker && sCurrentWorker->system == this ? sCurrentWorker : nullptr;
+}
+
+JobSystem::Handle JobSystem::submit(std::function<void()> fn, const std::vector<Handle> &dependencies) {
+  start();
+
+  auto *job = new Job;
+  job->fn = std::move(fn);
+  // One for the handle, and one for whoever queues it. Until we've wired
+  // up every dependency, we hold one pending count ourselves, so a
+  // dependency finishing meanwhile can't queue it early.
+  job->refs.store(2, std::memory_order_relaxed);
+  job->pending.store(1, std::memory_order_relaxed);
+
+  for (const Handle &dependency : dependencies) {
+    Job *before = dependency.mJob;
+    if (!before) {
+      continue;
+    }
+
+    std::lock_guard lock{before->mutex};
+    if (before->finished.load(std::memory_order_relaxed)) {
+      if (before->error) {
+        std::lock_guard jobLock{job->mutex};
+        if (!job->error) {
+          job->error = before->error;
+        }
+      }
+      continue;
+    }
+
+    job->pending.fetch_add(1, std::memory_order_relaxed);
+    job->refs.fetch_add(1, std::memory_order_relaxed);
+    before->continuations.push_back(job);
+  }
+
+  mSubmitted.fetch_add(1, std::memory_order_relaxed);
+
+  if (job->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    schedule(job);
+  } else {
+    release(job);
+  }
+
+  return Handle{job};
+}
+
+void JobSystem::spawn(std::function<void()> fn) {
+  auto *job = new Job;
+  job->fn = std::move(fn);
+  mSubmitted.fetch_add(1, std::memory_order_relaxed);
+  schedule(job);
+}
+
+void JobSystem::schedule(Job *job) {
+  Worker *worker = currentWorker();
+  if (!worker || !worker->deque.push(job)) {
+    std::lock_guard lock{mInjectedMutex};
+    mInjected.push_back(job);
+    mInjectedCount.fetch_add(1, std::memory_order_release);
+  }
+
+  // Counted before we check for sleepers, and sleepers check the count
+  // after saying they sleep, so one of us always sees the other.
+  mQueued.fetch_add(1, std::memory_order_seq_cst);
+  if (mSleeping.load(std::memory_order_seq_cst) > 0) {
+    std::lock_guard lock{mSleepMutex};
+    mWake.notify_one();
+  }
+}
+
+JobSystem::Job *JobSystem::findJob(Worker *self) {
+  Job *job = nullptr;
+
+  if (self) {
+    job = self->deque.pop();
+  }
+
+  if (!job && mInjectedCount.load(std::memory_order_acquire) > 0) {
+    std::lock_guard lock{mInjectedMutex};
+    if (!mInjected.empty()) {
+      job = mInjected.front();
+      mInjected.pop_front();
+      mInjectedCount.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+
+  if (!job && !mWorkers.empty()) {
+    const std::size_t count = mWorkers.size();
+    const std::size_t first = threadRandom()() % count;
+    for (std::size_t i = 0; i < count && !job; i++) {
+      Worker *victim = mWorkers[(first + i) % count].get();
+      if (victim != self) {
+        job = victim->deque.steal();
+      }
+    }
+    if (job) {
+      mStolen.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  if (job) {
+    mQueued.fetch_sub(1, std::memory_order_relaxed);
+  }
+  return job;
+}
+
+void JobSystem::execute(Job *job) {
+  // Set before we were queued, if a dependency failed.
+  if (!job->error) {
+    try {
+      AllocScope scope{job->tag};
+      job->fn();
+    } catch (...) {
+      job->error = std::current_exception();
+    }
+  }
+  // Let go of whatever fn captured now, not whenever the last handle goes.
+  job->fn = nullptr;
+
+  finish(job);
+  mExecuted.fetch_add(1, std::memory_order_relaxed);
+  release(job);
+}
+
+void JobSystem::finish(Job *job) {
+  std::vector<Job *> continuations;
+  {
+    std::lock_guard lock{job->mutex};
+    job->finished.store(true, std::memory_order_release);
+    continuations.swap(job->continuations);
+  }
+
+  for (Job *next : continuations) {
+    if (job->error) {
+      std::lock_guard lock{next->mutex};
+      if (!next->error) {
+        next->error = job->error;
+      }
+    }
+
+    // Our reference to next goes to its queue if we were the last holdout.
+    if (next->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      schedule(next);
+    } else {
+      release(next);
+    }
+  }
+}
+
+void JobSystem::release(Job *job) {
+  if (job->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    delete job;
+  }
+}
+
+void JobSystem::wait(const Handle &handle) {
+  Job *target = handle.mJob;
+  if (!target) {
+    return;
+  }
+
+  start();
+  Worker *self = currentWorker();
+
+  while (!target->finished.load(std::memory_order_acquire)) {
+    if (Job *job = findJob(self)) {
+      execute(job);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+
+  if (target->error) {
+    std::rethrow_exception(target->error);
+  }
+}
+
+JobSystem::Stats JobSystem::stats() const {
+  Stats stats;
+  stats.submitted = mSubmitted.load(std::memory_order_relaxed);
+  stats.executed = mExecuted.load(std::memory_order_relaxed);
+  stats.stolen = mStolen.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void JobSystem::runWorker(Worker &worker) {
+  sCurrentWorker = &worker;
+
+  while (true) {
+    if (Job *job = findJob(&worker)) {
+      execute(job);
+      continue;
+    }
+
+    // Work often turns up again right away, as a range splits, so look a
+    // few more times before paying for a sleep and a wakeup.
+    bool queued = false;
+    for (int i = 0; i < SPIN_TRIES && !queued; i++) {
+      std::this_thread::yield();
+      queued = mQueued.load(std::memory_order_acquire) > 0;
+    }
+    if (queued) {
+      continue;
+    }
+
+    std::unique_lock lock{mSleepMutex};
+    mSleeping.fetch_add(1, std::memory_order_seq_cst);
+    mWake.wait(lock, [this]() { return mStopping || mQueued.load(std::memory_order_seq_cst) > 0; });
+    mSleeping.fetch_sub(1, std::memory_order_relaxed);
+
+    if (mStopping && mQueued.load(std::memory_order_acquire) <= 0) {
+      break;
+    }
+  }
+
+  sCurrentWorker = nullptr;
+}
+
+// ---------------
+// Parallel loops.
+
+void JobSystem::parallelFor(std::size_t begin, std::size_t end,
+                            const std::function<void(std::size_t, std::size_t)> &body, std::size_t minGrain) {
+  if (end <= begin) {
+    return;
+  }
+
+  const std::size_t count = end - begin;
+  const std::size_t grain = std::max({minGrain, std::size_t{1}, count / (CHUNKS_PER_THREAD * threads())});
+  if (threads() == 1 || count <= grain) {
+    body(begin, end);
+    return;
+  }
+
+  start();
+
+  ForState state;
+  state.body = &body;
+  state.grain = grain;
+  state.remaining.store(count, std::memory_order_relaxed);
+
+  runRange(state, begin, end);
+
+  // Help with the rest; stolen chunks may still be running.
+  Worker *self = currentWorker();
+  while (state.remaining.load(std::memory_order_acquire) > 0) {
+    if (Job *job = findJob(self)) {
+      execute(job);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+
+  if (state.error) {
+    std::rethrow_exception(state.error);
+  }
+}
+
+bool JobSystem::localQueueEmpty() const {
+  if (Worker *worker = currentWorker()) {
+    return worker->deque.empty();
+  }
+  return mInjectedCount.load(std::memory_order_relaxed) == 0;
+}
+
+void JobSystem::runRange(ForState &state, std::size_t begin, std::size_t end) {
+  while (end - begin > state.grain) {
+    if (localQueueEmpty()) {
+      // Nothing of ours for a thief to take, so offer half.
+      const std::size_t middle = begin + (end - begin) / 2;
+      spawn([this, &state, middle, end]() { runRange(state, middle, end); });
+      end = middle;
+    } else {
+      runChunk(state, begin, begin + state.grain);
+      begin += state.grain;
+    }
+  }
+
+  // Our last touch of state: once everything is done, its owner returns.
+  runChunk(state, begin, end);
+}
+
+void JobSystem::runChunk(ForState &state, std::size_t begin, std::size_t end) {
+  if (!state.failed.load(std::memory_order_relaxed)) {
+    try {
+      (*state.body)(begin, end);
+    } catch (...) {
+      std::lock_guard lock{state.errorMutex};
+      if (!state.error) {
+        state.error = std::current_exception();
+      }
+      state.failed.store(true, std::memory_order_relaxed);
+    }
+  }
+
+  state.remaining.fetch_sub(end - begin, std::memory_order_acq_rel);
+}
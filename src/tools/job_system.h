@@ -0,0 +1,159 @@
+// A work-stealing job system.
+//
+// Jobs are small functions run by a pool of worker threads. Each worker
+// has its own Chase-Lev deque: it pushes and pops jobs at the bottom, so
+// jobs it spawns run next while their data is still in its cache, and an
+// idle worker steals from the top of another's, taking the oldest and
+// usually biggest piece of work. Threads outside the pool submit through
+// a shared queue, and help run jobs while they wait on them.
+//
+// A job can depend on others, and is only queued once they've finished.
+// parallelFor() splits a range in halves, but only while the splitting
+// thread's own queue is empty, which is when a thief could take the
+// other half; otherwise it works through the range a chunk at a time.
+// So ranges split as much as idle threads need, and no more.
+//
+// Jobs must not call GL: only the thread with the current context may,
+// so GL work stays on that thread, after waiting on the jobs it needs.
+//
+// Workers start on the first submit, so a program that never uses the
+// system pays nothing for it.
+
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// -----------
+// Job system.
+
+class JobSystem {
+  struct Job;
+  struct Worker;
+  struct ForState;
+
+public:
+  // Refers to a submitted job, to wait on it or make others depend on it.
+  class Handle {
+  public:
+    Handle() = default;
+    Handle(const Handle &other);
+    Handle(Handle &&other) noexcept;
+    Handle &operator=(Handle other) noexcept;
+    ~Handle();
+
+    [[nodiscard]] bool valid() const { return mJob != nullptr; }
+    // Whether the job has run, or been skipped for a failed dependency.
+    [[nodiscard]] bool done() const;
+
+  private:
+    friend class JobSystem;
+
+    // Takes over a reference the caller already holds.
+    explicit Handle(Job *job) : mJob(job) {}
+
+    Job *mJob = nullptr;
+  };
+
+  struct Stats {
+    std::uint64_t submitted = 0;
+    std::uint64_t executed = 0;
+    // Jobs a worker took from another's deque.
+    std::uint64_t stolen = 0;
+  };
+
+  // threads counts a thread waiting on jobs as one of them, so threads - 1
+  // workers are started; 0 for one thread per hardware thread. With one,
+  // jobs only run while someone waits on them.
+  explicit JobSystem(unsigned threads = 0);
+
+  JobSystem(const JobSystem &) = delete;
+  JobSystem &operator=(const JobSystem &) = delete;
+
+  // Runs whatever is still queued, then stops the workers.
+  ~JobSystem();
+
+  [[nodiscard]] unsigned threads() const { return mWorkerCount + 1; }
+
+  /// Queues fn to run once every job in dependencies has finished. If one
+  /// of them threw, fn is skipped, and waiting on it rethrows that.
+  Handle submit(std::function<void()> fn, const std::vector<Handle> &dependencies = {});
+
+  /// Runs other jobs until job has finished, then rethrows whatever job
+  /// threw.
+  void wait(const Handle &job);
+
+  /// Calls body(first, last) for subranges covering [begin, end), in
+  /// parallel, and returns once all are done. Subranges hold at least
+  /// minGrain items, except perhaps the last. If any call throws, the
+  /// rest are skipped and the first exception is rethrown here.
+  void parallelFor(std::size_t begin, std::size_t end, const std::function<void(std::size_t, std::size_t)> &body,
+                   std::size_t minGrain = 1);
+
+  [[nodiscard]] Stats stats() const;
+
+private:
+  // Starts the workers, once.
+  void start();
+
+  Worker *currentWorker() const;
+
+  // Queues a job whose dependencies are done, taking over a reference.
+  void schedule(Job *job);
+  // Queues fn to run anywhere, with no handle.
+  void spawn(std::function<void()> fn);
+
+  // Our own deque first, then the shared queue, then other workers'.
+  Job *findJob(Worker *self);
+  // Runs a job taken from a queue, then releases it.
+  void execute(Job *job);
+  // Marks job done and queues the jobs it was holding up.
+  void finish(Job *job);
+  static void release(Job *job);
+
+  void runWorker(Worker &worker);
+
+  // Whether the thread's own queue is empty, for parallelFor to split.
+  bool localQueueEmpty() const;
+  void runRange(ForState &state, std::size_t begin, std::size_t end);
+  static void runChunk(ForState &state, std::size_t begin, std::size_t end);
+
+private:
+  unsigned mWorkerCount = 0;
+  std::once_flag mStarted;
+  std::vector<std::unique_ptr<Worker>> mWorkers;
+
+  // Jobs from threads outside the pool, and from full deques.
+  std::mutex mInjectedMutex;
+  std::deque<Job *> mInjected;
+  std::atomic<std::size_t> mInjectedCount{0};
+
+  // Jobs queued anywhere but not yet taken, for idle workers to sleep on.
+  std::atomic<std::int64_t> mQueued{0};
+  std::mutex mSleepMutex;
+  std::condition_variable mWake;
+  std::atomic<unsigned> mSleeping{0};
+  bool mStopping = false;
+
+  std::atomic<std::uint64_t> mSubmitted{0};
+  std::atomic<std::uint64_t> mExecuted{0};
+  std::atomic<std::uint64_t> mStolen{0};
+
+  // The worker running on this thread, if any, of whichever system.
+  static thread_local Worker *sCurrentWorker;
+};
+
+using JobHandle = JobSystem::Handle;
+
+// The jobs shared by the whole program.
+JobSystem &jobSystem();
+
+#endif // JOB_SYSTEM_H
@@ -11,8 +11,16 @@
 
 #include <glm/glm.hpp>
 #include <learnopengl/shader_m.h>
-
+#include <tools/gl_resources.h>
+#include <tools/gl_state.h>
+#include <tools/profiler.h>
+#include <tools/render_queue.h>
+
+#include <memory_resource>
+#include <span>
+#include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 // -------------------------------
@@ -27,6 +35,17 @@ struct Texture {
   unsigned int id;
   std::string type;
   std::string path;
+  // If non-negative, id names a GL_TEXTURE_2D_ARRAY and this is our layer in it.
+  int layer = -1;
+};
+
+// A mesh's vertices and indices while it's imported, in whatever memory
+// the importer builds them in, until they're uploaded by Mesh.
+struct MeshGeometry {
+  explicit MeshGeometry(std::pmr::memory_resource *memory) : vertices(memory), indices(memory) {}
+
+  std::pmr::vector<Vertex> vertices;
+  std::pmr::vector<unsigned int> indices;
 };
 
 // ---------------------------------------
@@ -35,77 +54,146 @@ struct Texture {
 
 class Mesh {
 public:
-  Mesh(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices,
-       const std::vector<Texture> &textures)
-      : mVertices{vertices}, mIndices{indices}, mTextures{textures} {
-    setup();
+  // Vertices and indices are uploaded here and not kept, so they can
+  // live in whatever scratch memory the caller built them in.
+  Mesh(std::span<const Vertex> vertices, std::span<const unsigned int> indices, std::vector<Texture> textures)
+      : mIndexCount{static_cast<GLsizei>(indices.size())}, mTextures{std::move(textures)} {
+    assignTextureUnits();
+    computeCenter(vertices);
+    setup(vertices, indices);
   }
 
-  void draw(Shader &shader) const {
-    // Assign my textures to uniforms, in case other
-    // models have assigned their own textures.
-    {
-      // NOTE: We're only using diffuse right now, but later we will add
-      // the other types, so we leave the code here to handle them also.
-      unsigned int diffuseNr = 1;
-      unsigned int specularNr = 1;
-      unsigned int normalNr = 1;
-      unsigned int heightNr = 1;
-
-      // Activate textures here.
-      for (unsigned int i = 0; i < mTextures.size(); i++) {
-        // Activate appropriate loaded texture.
-        glActiveTexture(GL_TEXTURE0 + i);
-
-        // We use these to build name of uniform.
-        std::string number;
-        std::string name = mTextures[i].type;
-
-        if (name == "texture_diffuse")
-          number = std::to_string(diffuseNr++);
-        else if (name == "texture_specular")
-          number = std::to_string(specularNr++);
-        else if (name == "texture_normal")
-          number = std::to_string(normalNr++);
-        else if (name == "texture_height")
-          number = std::to_string(heightNr++);
-
-        // Assign texture unit as uniform.
-        glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-        // and finally bind the texture
-        glBindTexture(GL_TEXTURE_2D, mTextures[i].id);
-      }
+  // Texture unit each sampler uniform of this mesh reads from. Units are a
+  // fixed function of the sampler name, so they only need to be set once per
+  // shader, not once per draw; see Model::draw.
+  [[nodiscard]] const std::vector<std::pair<std::string, int>> &samplerUnits() const { return mSamplerUnits; }
+
+  [[nodiscard]] const std::vector<Texture> &textures() const { return mTextures; }
+
+  void draw() const {
+    GLEX_PROFILE_SCOPE("Mesh::draw");
+
+    // Bind my textures to the units their samplers were assigned. Array
+    // textures are shared by the whole model, so after the first mesh
+    // the state cache skips these.
+    for (const auto &binding : mTextureBindings) {
+      glState().bindTexture(binding.unit, binding.target, binding.texture);
     }
 
     // Bind my VAO.
-    glBindVertexArray(mVAO);
+    glState().bindVertexArray(mVAO.get());
     // Draw my triangles.
-    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(mIndices.size()), GL_UNSIGNED_INT, nullptr);
+    glDrawElements(GL_TRIANGLES, mIndexCount, GL_UNSIGNED_INT, nullptr);
+  }
 
-    // Unbind my VAO.
-    glBindVertexArray(0);
-    // Reset bound texture.
-    glActiveTexture(GL_TEXTURE0);
+  // Record a draw of this mesh with the given program.
+  void submit(RenderQueue &queue, GLuint program) const {
+    DrawCall call{program, mVAO.get(), GL_TRIANGLES, 0, mIndexCount, true};
+    queue.submit(RenderPass::Opaque, call, mCenter, mTextureBindings);
+  }
+
+  // NOTE: We're only using diffuse right now, but later we will add
+  // the other types, so we leave the code here to handle them also.
+  static constexpr const char *TEXTURE_TYPES[] = {"texture_diffuse", "texture_specular", "texture_normal",
+                                                  "texture_height"};
+
+  // Each texture type gets a block of units, so that e.g. "texture_diffuse1"
+  // maps to the same unit no matter which mesh or model it belongs to.
+  static constexpr int UNITS_PER_TEXTURE_TYPE = 4;
+
+  // Index of a texture type in TEXTURE_TYPES, or -1 if it's not one of ours.
+  static int textureTypeIndex(const std::string &type) {
+    for (std::size_t i = 0; i < std::size(TEXTURE_TYPES); i++) {
+      if (type == TEXTURE_TYPES[i]) {
+        return static_cast<int>(i);
+      }
+    }
+    return -1;
+  }
+
+  // Unit for the number-th (1-based) texture of a type, up to
+  // UNITS_PER_TEXTURE_TYPE.
+  static int textureUnit(const std::string &type, int number) {
+    return textureTypeIndex(type) * UNITS_PER_TEXTURE_TYPE + number - 1;
   }
 
 private:
-  void setup() {
-    glGenVertexArrays(1, &mVAO);
-    glGenBuffers(1, &mVBO);
-    glGenBuffers(1, &mEBO);
+  void assignTextureUnits() {
+    int typeCounts[std::size(TEXTURE_TYPES)] = {};
 
-    glBindVertexArray(mVAO);
+    for (const auto &texture : mTextures) {
+      int typeIndex = textureTypeIndex(texture.type);
+      if (typeIndex < 0) {
+        throw std::runtime_error("Mesh has a texture of unknown type: " + texture.type + ".");
+      }
+
+      int number = ++typeCounts[typeIndex];
+      if (number > UNITS_PER_TEXTURE_TYPE) {
+        // It would take the unit of the next type's first texture.
+        throw std::runtime_error("Mesh has more than " + std::to_string(UNITS_PER_TEXTURE_TYPE) + " textures of type " +
+                                 texture.type + ".");
+      }
+      int unit = textureUnit(texture.type, number);
+      mSamplerUnits.emplace_back(texture.type + std::to_string(number), unit);
+
+      if (texture.layer < 0) {
+        mTextureBindings.push_back({static_cast<GLuint>(unit), GL_TEXTURE_2D, texture.id});
+      } else if (number == 1) {
+        // A type's whole array is bound in place of its first texture.
+        mTextureBindings.push_back({static_cast<GLuint>(unit), GL_TEXTURE_2D_ARRAY, texture.id});
+      }
+    }
+  }
+
+  // Layer of each texture type's array, for types packed into arrays;
+  // see TextureArrayPacker. Whether any are.
+  bool computeTextureLayers() {
+    bool packed = false;
+    // Walking backwards leaves the first texture of each type in place.
+    for (auto it = mTextures.rbegin(); it != mTextures.rend(); ++it) {
+      if (it->layer >= 0) {
+        mTextureLayers[textureTypeIndex(it->type)] = static_cast<float>(it->layer);
+        packed = true;
+      }
+    }
+    return packed;
+  }
+
+  // Center of our bounding box, used for depth sorting.
+  void computeCenter(std::span<const Vertex> vertices) {
+    if (vertices.empty()) {
+      return;
+    }
+
+    glm::vec3 lower = vertices[0].mPosition;
+    glm::vec3 upper = vertices[0].mPosition;
+    for (const auto &vertex : vertices) {
+      lower = glm::min(lower, vertex.mPosition);
+      upper = glm::max(upper, vertex.mPosition);
+    }
+
+    mCenter = (lower + upper) * 0.5f;
+  }
+
+private:
+  void setup(std::span<const Vertex> vertices, std::span<const unsigned int> indices) {
+    mVAO = GLVertexArrayHandle::create();
+    mVBO = GLBufferHandle::create();
+    mEBO = GLBufferHandle::create();
+
+    glState().bindVertexArray(mVAO.get());
 
     // NOTE: Assumes that our struct and the glm types are
     // laid out in memory sequentially with no padding.
 
-    glBindBuffer(GL_ARRAY_BUFFER, mVBO);
-    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(mVertices.size()) * sizeof(Vertex), &mVertices[0],
-                 GL_STATIC_DRAW);
+    glState().bindBuffer(GL_ARRAY_BUFFER, mVBO.get());
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertices.size_bytes()), vertices.data(), GL_STATIC_DRAW);
+    mVBO.setBytes(vertices.size_bytes());
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(mIndices.size()) * sizeof(unsigned int),
-                 &mIndices[0], GL_STATIC_DRAW);
+    glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO.get());
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices.size_bytes()), indices.data(),
+                 GL_STATIC_DRAW);
+    mEBO.setBytes(indices.size_bytes());
 
     // TODO: Here we bind vertex and diffuse texture coordinates. If we add other
     // texture types, we need to add additional vertex attrib arrays for them here.
@@ -116,18 +204,43 @@ private:
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, mTextureCoords));
 
+    // Location 2 is reserved for normals.
+
+    // Texture layers are the same for the whole mesh, so rather than
+    // widen every vertex they're one vec4 in a buffer of their own. A
+    // divisor of 1 makes each vertex read the first, as our draws are
+    // instance 0. Meshes without packed textures have no such buffer.
+    if (computeTextureLayers()) {
+      mLayerBuffer = GLBufferHandle::create();
+      glState().bindBuffer(GL_ARRAY_BUFFER, mLayerBuffer.get());
+      glBufferData(GL_ARRAY_BUFFER, sizeof(mTextureLayers), &mTextureLayers, GL_STATIC_DRAW);
+      mLayerBuffer.setBytes(sizeof(mTextureLayers));
+
+      glEnableVertexAttribArray(3);
+      glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 0, static_cast<void *>(nullptr));
+      glVertexAttribDivisor(3, 1);
+    }
+
     // Unbind this VAO since we're done.
-    glBindVertexArray(0);
+    glState().bindVertexArray(0);
   }
 
 private:
-  std::vector<Vertex> mVertices;
-  std::vector<unsigned int> mIndices;
+  GLsizei mIndexCount = 0;
   std::vector<Texture> mTextures;
-
-  unsigned int mVAO = 0;
-  unsigned int mVBO = 0;
-  unsigned int mEBO = 0;
+  // Sampler uniform name and texture unit, parallel to mTextures.
+  std::vector<std::pair<std::string, int>> mSamplerUnits;
+  // What draw() binds: our 2D textures, and one array per packed type.
+  std::vector<TextureBinding> mTextureBindings;
+
+  glm::vec3 mCenter{0.0f};
+  glm::vec4 mTextureLayers{0.0f};
+
+  // Move-only; deleted at the next safe point after we're destroyed.
+  GLVertexArrayHandle mVAO;
+  GLBufferHandle mVBO;
+  GLBufferHandle mEBO;
+  GLBufferHandle mLayerBuffer;
 };
 
 #endif // MESH_DATA_H
@@ -0,0 +1,568 @@
+// clang-format off
+#include "mip_chain.h"
+#include "disk_cache.h"
+
+#include "tools/gl_state.h"
+#include "tools/helpers.h"
+#include "tools/job_system.h"
+
+#include <GLFW/glfw3.h>
+#include <fmt/core.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <numbers>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define GLEX_MIP_SSE 1
+#endif
+// clang-format on
+
+namespace {
+
+constexpr std::size_t CHANNELS = 4;
+
+// What loadMipChain() has done, for mipCacheStats().
+std::mutex cacheStatsMutex;
+MipCacheStats cacheStats;
+
+// Below this many texels, a level isn't worth sharing out.
+constexpr std::size_t MIN_PARALLEL_TEXELS = 64 * 1024;
+// Fewest texels in a band of a shared level.
+constexpr std::size_t MIN_BAND_TEXELS = 16 * 1024;
+
+// ------------------------------
+// Texels as four-float vectors.
+
+#ifdef GLEX_MIP_SSE
+
+struct Texel {
+  __m128 v = _mm_setzero_ps();
+};
+
+inline Texel makeTexel(float r, float g, float b, float a) { return {_mm_setr_ps(r, g, b, a)}; }
+inline Texel operator+(Texel a, Texel b) { return {_mm_add_ps(a.v, b.v)}; }
+inline Texel operator*(Texel a, float s) { return {_mm_mul_ps(a.v, _mm_set1_ps(s))}; }
+
+// Clamps to [0, 1] and scales by scale, rounding to the nearest integer.
+inline std::array<int, 4> quantize(Texel t, Texel scale) {
+  const __m128 clamped = _mm_min_ps(_mm_max_ps(t.v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+  alignas(16) std::array<int, 4> result;
+  _mm_store_si128(reinterpret_cast<__m128i *>(result.data()), _mm_cvtps_epi32(_mm_mul_ps(clamped, scale.v)));
+  return result;
+}
+
+#else
+
+struct Texel {
+  std::array<float, 4> v{};
+};
+
+inline Texel makeTexel(float r, float g, float b, float a) { return {{r, g, b, a}}; }
+
+inline Texel operator+(Texel a, Texel b) {
+  for (std::size_t c = 0; c < CHANNELS; c++) {
+    a.v[c] += b.v[c];
+  }
+  return a;
+}
+
+inline Texel operator*(Texel a, float s) {
+  for (float &value : a.v) {
+    value *= s;
+  }
+  return a;
+}
+
+inline std::array<int, 4> quantize(Texel t, Texel scale) {
+  std::array<int, 4> result;
+  for (std::size_t c = 0; c < CHANNELS; c++) {
+    result[c] = static_cast<int>(std::lround(std::clamp(t.v[c], 0.0f, 1.0f) * scale.v[c]));
+  }
+  return result;
+}
+
+#endif
+
+// ------------------------
+// Color space conversions.
+
+// Linear values are looked up at this many steps when encoding to sRGB:
+// enough that the steepest part of the curve, near black, stays under
+// half an 8-bit step.
+constexpr int ENCODE_STEPS = 8192;
+
+struct ColorTables {
+  // 8-bit value to [0, 1], decoded from sRGB or not.
+  std::array<float, 256> fromSRGB;
+  std::array<float, 256> fromUnorm;
+  // Linear value, times ENCODE_STEPS - 1, to 8-bit sRGB.
+  std::array<std::uint8_t, ENCODE_STEPS> toSRGB;
+};
+
+const ColorTables &colorTables() {
+  static const ColorTables tables = [] {
+    ColorTables t{};
+    for (int i = 0; i < 256; i++) {
+      const double c = i / 255.0;
+      t.fromSRGB[i] = static_cast<float>(c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+      t.fromUnorm[i] = static_cast<float>(c);
+    }
+    for (int i = 0; i < ENCODE_STEPS; i++) {
+      const double l = static_cast<double>(i) / (ENCODE_STEPS - 1);
+      const double c = l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+      t.toSRGB[i] = static_cast<std::uint8_t>(std::lround(c * 255.0));
+    }
+    return t;
+  }();
+  return tables;
+}
+
+// Reads and writes texels of one level in its color space.
+struct TexelCodec {
+  explicit TexelCodec(ColorSpace colorSpace)
+      : tables(colorTables()), srgb(colorSpace == ColorSpace::SRGB),
+        rgbTable(srgb ? tables.fromSRGB.data() : tables.fromUnorm.data()),
+        scale(srgb ? makeTexel(ENCODE_STEPS - 1, ENCODE_STEPS - 1, ENCODE_STEPS - 1, 255.0f)
+                   : makeTexel(255.0f, 255.0f, 255.0f, 255.0f)) {}
+
+  [[nodiscard]] Texel decode(const std::uint8_t *p) const {
+    return makeTexel(rgbTable[p[0]], rgbTable[p[1]], rgbTable[p[2]], tables.fromUnorm[p[3]]);
+  }
+
+  void encode(Texel t, std::uint8_t *p) const {
+    const std::array<int, 4> q = quantize(t, scale);
+    for (std::size_t c = 0; c < 3; c++) {
+      p[c] = srgb ? tables.toSRGB[q[c]] : static_cast<std::uint8_t>(q[c]);
+    }
+    p[3] = static_cast<std::uint8_t>(q[3]);
+  }
+
+  const ColorTables &tables;
+  bool srgb;
+  const float *rgbTable;
+  Texel scale;
+};
+
+// --------
+// Filters.
+
+// Source texels under each destination texel for the Kaiser filter,
+// centered on it: offsets -2.5 to 2.5 source texels.
+constexpr int KAISER_TAPS = 6;
+
+double besselI0(double x) {
+  double sum = 1.0;
+  double term = 1.0;
+  for (int k = 1; k < 32; k++) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+// A sinc cut off at the destination's Nyquist frequency, under a Kaiser
+// window three source texels wide each way, normalized.
+const std::array<float, KAISER_TAPS> &kaiserWeights() {
+  static const std::array<float, KAISER_TAPS> weights = [] {
+    constexpr double ALPHA = 4.0;
+    constexpr double HALF_WIDTH = 3.0;
+
+    std::array<double, KAISER_TAPS> w{};
+    double sum = 0.0;
+    for (int k = 0; k < KAISER_TAPS; k++) {
+      const double d = k - 2.5;
+      const double x = std::numbers::pi * d / 2.0;
+      const double sinc = std::sin(x) / x;
+      const double r = d / HALF_WIDTH;
+      w[k] = sinc * besselI0(ALPHA * std::sqrt(1.0 - r * r)) / besselI0(ALPHA);
+      sum += w[k];
+    }
+
+    std::array<float, KAISER_TAPS> normalized{};
+    for (int k = 0; k < KAISER_TAPS; k++) {
+      normalized[k] = static_cast<float>(w[k] / sum);
+    }
+    return normalized;
+  }();
+  return weights;
+}
+
+int edgeIndex(int i, int size, bool wrap) {
+  if (wrap) {
+    return ((i % size) + size) % size;
+  }
+  return std::clamp(i, 0, size - 1);
+}
+
+// Averages 2x2 blocks, repeating the last row or column of odd sizes.
+void boxRows(const MipLevel &source, MipLevel &target, const TexelCodec &codec, int begin, int end) {
+  const int w = source.width;
+  const int h = source.height;
+  const std::uint8_t *src = source.pixels.data();
+
+  for (int y = begin; y < end; y++) {
+    const std::uint8_t *row0 = src + static_cast<std::size_t>(std::min(2 * y, h - 1)) * w * CHANNELS;
+    const std::uint8_t *row1 = src + static_cast<std::size_t>(std::min(2 * y + 1, h - 1)) * w * CHANNELS;
+    std::uint8_t *out = target.pixels.data() + static_cast<std::size_t>(y) * target.width * CHANNELS;
+
+    for (int x = 0; x < target.width; x++) {
+      const std::size_t x0 = static_cast<std::size_t>(std::min(2 * x, w - 1)) * CHANNELS;
+      const std::size_t x1 = static_cast<std::size_t>(std::min(2 * x + 1, w - 1)) * CHANNELS;
+      const Texel sum =
+          codec.decode(row0 + x0) + codec.decode(row0 + x1) + codec.decode(row1 + x0) + codec.decode(row1 + x1);
+      codec.encode(sum * 0.25f, out + static_cast<std::size_t>(x) * CHANNELS);
+    }
+  }
+}
+
+// Separable Kaiser filter. Each destination row needs six horizontally
+// filtered source rows, four of them shared with the row before, so we
+// keep the last six in a ring.
+void kaiserRows(const MipLevel &source, MipLevel &target, const TexelCodec &codec, bool wrap, int begin,
+                int end) {
+  const auto &weights = kaiserWeights();
+  const int w = source.width;
+  const int h = source.height;
+  const int targetWidth = target.width;
+
+  // Source column of each tap of each destination column.
+  std::vector<int> columns(static_cast<std::size_t>(targetWidth) * KAISER_TAPS);
+  for (int x = 0; x < targetWidth; x++) {
+    for (int k = 0; k < KAISER_TAPS; k++) {
+      columns[x * KAISER_TAPS + k] = edgeIndex(2 * x - 2 + k, w, wrap) * static_cast<int>(CHANNELS);
+    }
+  }
+
+  // Filtered rows, by unwrapped source row; slot i % KAISER_TAPS.
+  std::array<std::vector<Texel>, KAISER_TAPS> ring;
+  std::array<int, KAISER_TAPS> ringRow;
+  ringRow.fill(std::numeric_limits<int>::min());
+  for (auto &row : ring) {
+    row.resize(targetWidth);
+  }
+
+  auto filteredRow = [&](int i) -> const std::vector<Texel> & {
+    const int slot = ((i % KAISER_TAPS) + KAISER_TAPS) % KAISER_TAPS;
+    if (ringRow[slot] != i) {
+      const std::uint8_t *row = source.pixels.data() + static_cast<std::size_t>(edgeIndex(i, h, wrap)) * w * CHANNELS;
+      for (int x = 0; x < targetWidth; x++) {
+        const int *taps = &columns[x * KAISER_TAPS];
+        Texel sum;
+        for (int k = 0; k < KAISER_TAPS; k++) {
+          sum = sum + codec.decode(row + taps[k]) * weights[k];
+        }
+        ring[slot][x] = sum;
+      }
+      ringRow[slot] = i;
+    }
+    return ring[slot];
+  };
+
+  std::vector<Texel> accumulated(targetWidth);
+  for (int y = begin; y < end; y++) {
+    std::fill(accumulated.begin(), accumulated.end(), Texel{});
+    for (int k = 0; k < KAISER_TAPS; k++) {
+      const std::vector<Texel> &row = filteredRow(2 * y - 2 + k);
+      for (int x = 0; x < targetWidth; x++) {
+        accumulated[x] = accumulated[x] + row[x] * weights[k];
+      }
+    }
+
+    std::uint8_t *out = target.pixels.data() + static_cast<std::size_t>(y) * targetWidth * CHANNELS;
+    for (int x = 0; x < targetWidth; x++) {
+      codec.encode(accumulated[x], out + static_cast<std::size_t>(x) * CHANNELS);
+    }
+  }
+}
+
+// Calls rowBand over [0, rows) in contiguous bands, shared out over jobs
+// if texels is enough work to share.
+void forEachRowBand(int rows, std::size_t texels, JobSystem &jobs, const std::function<void(int, int)> &rowBand) {
+  if (texels < MIN_PARALLEL_TEXELS) {
+    rowBand(0, rows);
+    return;
+  }
+
+  // Each band pays to warm up its filter, so none is smaller than this.
+  const std::size_t texelsPerRow = std::max<std::size_t>(1, texels / static_cast<std::size_t>(rows));
+  const std::size_t minRows = std::max<std::size_t>(1, MIN_BAND_TEXELS / texelsPerRow);
+
+  jobs.parallelFor(
+      0, static_cast<std::size_t>(rows),
+      [&](std::size_t first, std::size_t last) { rowBand(static_cast<int>(first), static_cast<int>(last)); },
+      minRows);
+}
+
+// ----------------
+// Decoding images.
+
+MipLevel decodeImage(const std::string &path, bool flipVertically) {
+  // stb's flip setting is global unless set per thread, and we may be on
+  // any thread, so we clear ours and flip rows ourselves.
+  stbi_set_flip_vertically_on_load_thread(0);
+
+  int width = 0;
+  int height = 0;
+  int channels = 0;
+  unsigned char *data = stbi_load(path.c_str(), &width, &height, &channels, CHANNELS);
+  if (!data) {
+    throw std::runtime_error("Texture failed to load at path: " + path + ".");
+  }
+
+  const std::size_t rowBytes = static_cast<std::size_t>(width) * CHANNELS;
+  MipLevel level{width, height, std::vector<std::uint8_t>(rowBytes * height)};
+  for (int row = 0; row < height; row++) {
+    const int sourceRow = flipVertically ? height - 1 - row : row;
+    std::memcpy(level.pixels.data() + row * rowBytes, data + sourceRow * rowBytes, rowBytes);
+  }
+  stbi_image_free(data);
+
+  return level;
+}
+
+// ----------
+// Mip cache.
+
+// Header of our cache files, followed by each level below the first.
+struct CacheHeader {
+  char magic[8];
+  std::uint32_t width;
+  std::uint32_t height;
+  std::uint32_t levels;
+};
+
+constexpr char CACHE_MAGIC[8] = {'G', 'L', 'E', 'X', 'M', 'I', 'P', '1'};
+
+const std::optional<std::filesystem::path> &mipCacheDirectory() {
+  static const std::optional<std::filesystem::path> directory =
+      cacheDirectory("GLEX_MIP_CACHE", ".cache/mips", "mip cache");
+  return directory;
+}
+
+// Cache file for path's chain, from its name, size and modification time
+// and our options, or nothing if we can't tell those.
+std::optional<std::filesystem::path> cachePath(const std::string &path, bool flipVertically,
+                                               const MipOptions &options) {
+  const auto &directory = mipCacheDirectory();
+  if (!directory) {
+    return std::nullopt;
+  }
+
+  std::error_code sizeError;
+  std::error_code timeError;
+  const auto size = std::filesystem::file_size(path, sizeError);
+  const auto modified = std::filesystem::last_write_time(path, timeError);
+  if (sizeError || timeError) {
+    return std::nullopt;
+  }
+
+  const std::string fields = fmt::format("{}\x1f{}\x1f{}\x1f{}\x1f{}\x1f{}", path, size,
+                                         modified.time_since_epoch().count(), flipVertically,
+                                         static_cast<int>(options.filter), static_cast<int>(options.colorSpace));
+  const std::uint64_t key = fnv1a(fields + (options.wrap ? "\x1fwrap" : "\x1f" "clamp"));
+  return *directory / fmt::format("{:016x}.mips", key);
+}
+
+// Reads the levels below base from file into chain, if they match it.
+bool readCache(const std::filesystem::path &file, MipChain &chain) {
+  std::ifstream in{file, std::ios::binary};
+  if (!in) {
+    return false;
+  }
+
+  const MipLevel &base = chain.front();
+  const int levels = mipLevelCount(base.width, base.height);
+
+  CacheHeader header{};
+  in.read(reinterpret_cast<char *>(&header), sizeof(header));
+  if (!in || std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+      header.width != static_cast<std::uint32_t>(base.width) ||
+      header.height != static_cast<std::uint32_t>(base.height) || header.levels != static_cast<std::uint32_t>(levels)) {
+    return false;
+  }
+
+  MipChain cached;
+  int width = base.width;
+  int height = base.height;
+  for (int level = 1; level < levels; level++) {
+    width = std::max(1, width / 2);
+    height = std::max(1, height / 2);
+    MipLevel next{width, height, std::vector<std::uint8_t>(static_cast<std::size_t>(width) * height * CHANNELS)};
+    in.read(reinterpret_cast<char *>(next.pixels.data()), static_cast<std::streamsize>(next.pixels.size()));
+    if (!in) {
+      return false;
+    }
+    cached.push_back(std::move(next));
+  }
+
+  for (auto &level : cached) {
+    chain.push_back(std::move(level));
+  }
+  return true;
+}
+
+// Failures only cost us the next launch, so they're reported and
+// otherwise ignored.
+void writeCache(const std::filesystem::path &file, const MipChain &chain) {
+  CacheHeader header{};
+  std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  header.width = static_cast<std::uint32_t>(chain.front().width);
+  header.height = static_cast<std::uint32_t>(chain.front().height);
+  header.levels = static_cast<std::uint32_t>(chain.size());
+
+  // Write then rename, so a concurrent load never reads half a file. The
+  // thread id keeps two threads writing the same entry apart.
+  std::filesystem::path temporary = file;
+  temporary += fmt::format(".{}.tmp", std::hash<std::thread::id>{}(std::this_thread::get_id()));
+
+  {
+    std::ofstream out{temporary, std::ios::binary | std::ios::trunc};
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (std::size_t level = 1; level < chain.size(); level++) {
+      out.write(reinterpret_cast<const char *>(chain[level].pixels.data()),
+                static_cast<std::streamsize>(chain[level].pixels.size()));
+    }
+    if (!out) {
+      fmt::print("[mip cache] Failed to write {}\n", temporary.string());
+      return;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(temporary, file, error);
+  if (error) {
+    fmt::print("[mip cache] Failed to write {}: {}\n", file.string(), error.message());
+  }
+}
+
+// ------------
+// GL uploads.
+
+using TexStorage2DFn = void(APIENTRYP)(GLenum, GLsizei, GLenum, GLsizei, GLsizei);
+
+TexStorage2DFn texStorage2D() {
+  static const auto function = reinterpret_cast<TexStorage2DFn>(glfwGetProcAddress("glTexStorage2D"));
+  return function;
+}
+
+} // namespace
+
+// ---------------------
+// Mip chain definitions.
+
+int mipLevelCount(int width, int height) {
+  int levels = 1;
+  for (int size = std::max(width, height); size > 1; size /= 2) {
+    levels++;
+  }
+  return levels;
+}
+
+MipChain buildMipChain(MipLevel base, const MipOptions &options) {
+  const TexelCodec codec{options.colorSpace};
+  const int levels = mipLevelCount(base.width, base.height);
+
+  MipChain chain;
+  chain.reserve(levels);
+  chain.push_back(std::move(base));
+
+  for (int level = 1; level < levels; level++) {
+    const MipLevel &source = chain.back();
+    MipLevel target{std::max(1, source.width / 2), std::max(1, source.height / 2), {}};
+    target.pixels.resize(static_cast<std::size_t>(target.width) * target.height * CHANNELS);
+
+    const std::size_t texels = static_cast<std::size_t>(target.width) * target.height;
+    forEachRowBand(target.height, texels, options.jobs ? *options.jobs : jobSystem(), [&](int begin, int end) {
+      if (options.filter == MipFilter::Kaiser) {
+        kaiserRows(source, target, codec, options.wrap, begin, end);
+      } else {
+        boxRows(source, target, codec, begin, end);
+      }
+    });
+
+    chain.push_back(std::move(target));
+  }
+
+  return chain;
+}
+
+MipChain loadMipChain(const std::string &path, bool flipVertically, const MipOptions &options) {
+  const auto start = std::chrono::steady_clock::now();
+
+  MipChain chain;
+  chain.push_back(decodeImage(path, flipVertically));
+
+  const auto file = cachePath(path, flipVertically, options);
+  const bool hit = file && readCache(*file, chain);
+  if (!hit) {
+    chain = buildMipChain(std::move(chain.front()), options);
+    if (file) {
+      writeCache(*file, chain);
+    }
+  }
+
+  const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  {
+    std::lock_guard lock{cacheStatsMutex};
+    (hit ? cacheStats.loaded : cacheStats.built)++;
+    cacheStats.ms += elapsed.count();
+  }
+
+  return chain;
+}
+
+MipCacheStats mipCacheStats() {
+  std::lock_guard lock{cacheStatsMutex};
+  return cacheStats;
+}
+
+// ----------------------
+// Mip upload definitions.
+
+bool textureStorageSupported() {
+  static const bool supported = hasExtension("GL_ARB_texture_storage") && texStorage2D() != nullptr;
+  return supported;
+}
+
+void allocateTextureStorage(int levels, int width, int height) {
+  if (textureStorageSupported()) {
+    texStorage2D()(GL_TEXTURE_2D, levels, GL_RGBA8, width, height);
+    return;
+  }
+
+  for (int level = 0; level < levels; level++) {
+    glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, std::max(1, width >> level), std::max(1, height >> level), 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  }
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+}
+
+void uploadMipChain(const MipChain &chain) {
+  const MipLevel &base = chain.front();
+  allocateTextureStorage(static_cast<int>(chain.size()), base.width, base.height);
+
+  glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  for (std::size_t level = 0; level < chain.size(); level++) {
+    const MipLevel &mip = chain[level];
+    glTexSubImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), 0, 0, mip.width, mip.height, GL_RGBA,
+                    GL_UNSIGNED_BYTE, mip.pixels.data());
+  }
+}
@@ -0,0 +1,95 @@
+// Mip chains built on the CPU.
+//
+// glGenerateMipmap is slow on software GL, averages sRGB color as if it
+// were linear, which darkens and shifts every level below the first, and
+// leaves nothing we could cache. Instead we build chains ourselves:
+//
+//  - Each level is filtered from the one above with a 2x2 box or a
+//    6-tap Kaiser-windowed sinc, which keeps detail a box blurs away.
+//  - sRGB color is averaged in linear light and encoded back; alpha and
+//    data textures are averaged as they are.
+//  - Texels are filtered as four-float vectors, with SSE where we have
+//    it, and a level's rows are shared out over the job system when it's
+//    big enough to be worth it. Levels depend on the level above, so they're
+//    built in turn.
+//
+// loadMipChain() also keeps generated levels in an on-disk cache, keyed on
+// the file and options, so a texture's chain is built once rather than on
+// every launch. Set GLEX_MIP_CACHE to a directory to move the cache, or
+// to "off" to disable it.
+
+#ifndef MIP_CHAIN_H
+#define MIP_CHAIN_H
+
+#include "glad/glad.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+// ----------
+// Mip chain.
+
+enum class MipFilter : std::uint8_t { Box, Kaiser };
+
+enum class ColorSpace : std::uint8_t { Linear, SRGB };
+
+struct MipOptions {
+  MipFilter filter = MipFilter::Kaiser;
+  // Of the RGB channels; alpha is always linear.
+  ColorSpace colorSpace = ColorSpace::SRGB;
+  // Whether filters wrap around edges, as for GL_REPEAT, or clamp.
+  bool wrap = true;
+  // Jobs to share a level's rows out over; null for jobSystem().
+  JobSystem *jobs = nullptr;
+};
+
+struct MipLevel {
+  int width = 0;
+  int height = 0;
+  // Tightly packed RGBA8.
+  std::vector<std::uint8_t> pixels;
+};
+
+// Full size first, down to 1x1.
+using MipChain = std::vector<MipLevel>;
+
+// Levels in a full chain for a width x height image.
+int mipLevelCount(int width, int height);
+
+// Builds the chain below base, which becomes its first level.
+MipChain buildMipChain(MipLevel base, const MipOptions &options = {});
+
+/// Decodes the image at path as RGBA8 and builds its chain, taking the
+/// levels below the first from the cache if they're there. Safe to call
+/// from any thread. Throws std::runtime_error on failure to load.
+MipChain loadMipChain(const std::string &path, bool flipVertically, const MipOptions &options = {});
+
+// Chains loadMipChain() has found in the cache or built, and the time it
+// took, summed over threads.
+struct MipCacheStats {
+  std::uint64_t loaded = 0;
+  std::uint64_t built = 0;
+  double ms = 0.0;
+};
+
+// Counts since the program started; subtract an earlier snapshot for a
+// span, such as one model's import.
+MipCacheStats mipCacheStats();
+
+// -------------
+// Mip uploads.
+
+// Whether the driver has glTexStorage2D, through ARB_texture_storage.
+bool textureStorageSupported();
+
+// Gives the bound GL_TEXTURE_2D RGBA8 storage for levels levels,
+// immutable where the driver allows.
+void allocateTextureStorage(int levels, int width, int height);
+
+// Allocates storage for the bound GL_TEXTURE_2D and uploads each level.
+void uploadMipChain(const MipChain &chain);
+
+#endif // MIP_CHAIN_H
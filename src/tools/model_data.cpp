@@ -4,45 +4,61 @@
 
 // clang-format off
 #include "model_data.h"
+#include "mip_chain.h"
+#include "texture_streamer.h"
 
-#include <stb_image.h>
+#include <string_view>
 // clang-format on
 
+// -------------------
+// Option definitions.
+
+ModelOptions parseModelOptions(int argc, char **argv) {
+  ModelOptions options;
+
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+
+    if (arg == "--assimp") {
+      options.fastObj = false;
+    }
+  }
+
+  return options;
+}
+
 // -----------------------------------------------------
 // Borrowed directly from www.learnopengl.com `model.h`.
 
-unsigned int textureFromFile(const char *path, const std::string &directory, bool) {
-  std::string filename = std::string(path);
-  filename = directory + "/textures/" + filename;
-
-  unsigned int textureID;
-  glGenTextures(1, &textureID);
-
-  int width, height, nrComponents;
-  unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-  if (data) {
-    GLenum format;
-    if (nrComponents == 1)
-      format = GL_RED;
-    else if (nrComponents == 3)
-      format = GL_RGB;
-    else if (nrComponents == 4)
-      format = GL_RGBA;
-
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    stbi_image_free(data);
-  } else {
-    stbi_image_free(data);
-    throw std::runtime_error("Texture failed to load at path: " + filename + ".");
+std::string textureFilePath(const char *path, const std::string &directory) {
+  return directory + "/textures/" + std::string(path);
+}
+
+GLTextureHandle textureFromFile(const char *path, const std::string &directory, bool gamma) {
+  std::string filename = textureFilePath(path, directory);
+
+  // Color maps are sRGB, so their mips are averaged in linear light.
+  MipOptions options;
+  options.colorSpace = gamma ? ColorSpace::SRGB : ColorSpace::Linear;
+
+  if (textureStreamer().enabled()) {
+    return textureStreamer().request(filename, false, options);
   }
 
-  return textureID;
+  // Built on the CPU, or read from the mip cache. Throws on failure.
+  return textureFromMipChain(loadMipChain(filename, false, options));
+}
+
+GLTextureHandle textureFromMipChain(const MipChain &chain) {
+  GLTextureHandle texture = GLTextureHandle::create();
+  glState().bindTexture(0, GL_TEXTURE_2D, texture.get());
+  uploadMipChain(chain);
+  texture.setBytes(estimateTextureBytes(chain.front().width, chain.front().height, 4, true));
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+  return texture;
 }
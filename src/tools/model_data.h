@@ -1,6 +1,6 @@
 // Some model loading infrastructure for loading, storing, and drawing
-// data for a model loaded with Assimp. Modeled very closely from the
-// mesh class on www.learnopengl.com.
+// data for a model loaded with Assimp, or for .obj files, our own loader.
+// Modeled very closely from the mesh class on www.learnopengl.com.
 //
 // Created by sean on 12/22/24.
 //
@@ -11,7 +11,15 @@
 // clang-format off
 #include "glad/glad.h"
 
+#include "alloc_tracker.h"
+#include "gl_resources.h"
+#include "import_arena.h"
+#include "job_system.h"
 #include "mesh_data.h"
+#include "mip_chain.h"
+#include "obj_loader.h"
+#include "texture_array.h"
+#include "texture_streamer.h"
 
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
@@ -23,6 +31,9 @@
 #include <learnopengl/shader_m.h>
 
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <set>
 // clang-format on
 
 // --------------
@@ -30,30 +41,97 @@
 
 constexpr bool EXTRA_DEBUG_OUTPUT = false;
 
+// Import-time options.
+struct ModelOptions {
+  // Pack each texture type into one array texture, so the
+  // model draws without any per-mesh texture binds.
+  bool packTextureArrays = false;
+  // Jobs to decode textures and build meshes on; null for jobSystem().
+  JobSystem *jobs = nullptr;
+  // Read .obj files with our own loader; see obj_loader.h. Other formats,
+  // or all of them without this, go through Assimp.
+  bool fastObj = true;
+};
+
+ModelOptions parseModelOptions(int argc, char **argv);
+
 // --------------------------------------
 // Model class -- holds a model's meshes.
 //  Based heavily on Joey DeVries' model class.
 
-unsigned int textureFromFile(const char *path, const std::string &directory, bool gamma = false);
+std::string textureFilePath(const char *path, const std::string &directory);
+
+GLTextureHandle textureFromFile(const char *path, const std::string &directory, bool gamma = false);
+
+// A texture with the levels of chain, from loadMipChain().
+GLTextureHandle textureFromMipChain(const MipChain &chain);
 
 class Model {
 public:
   /// Throws on failure to load.
-  explicit Model(const std::string &path) {
-    if (!load(path)) {
+  explicit Model(const std::string &path, ModelOptions options = {})
+      : mJobs(options.jobs ? *options.jobs : jobSystem()) {
+    if (options.packTextureArrays) {
+      mTexturePacker = std::make_unique<TextureArrayPacker>();
+    }
+
+    if (!load(path, options.fastObj)) {
       throw std::runtime_error("Failed to load model.");
     }
   }
 
   // Draw each mesh.
   void draw(Shader &shader) {
+    GLEX_PROFILE_SCOPE("Model::draw");
+    assignSamplerUnits(shader);
+
+    for (const auto &mesh : mMeshes) {
+      mesh.draw();
+    }
+  }
+
+  // Record a draw of each mesh.
+  void submit(RenderQueue &queue, Shader &shader) {
+    GLEX_PROFILE_SCOPE("Model::submit");
+    assignSamplerUnits(shader);
+
     for (const auto &mesh : mMeshes) {
-      mesh.draw(shader);
+      mesh.submit(queue, shader.ID);
     }
   }
 
+  [[nodiscard]] const std::vector<Mesh> &meshes() const { return mMeshes; }
+
 private:
-  bool load(const std::string &path) {
+  bool load(const std::string &path, bool fastObj) {
+    // Whatever isn't more specifically tagged below, e.g. Assimp's scene.
+    AllocScope importScope{AllocTag::Import};
+    const MipCacheStats mipsBefore = mipCacheStats();
+
+    mDirectory = path.substr(0, path.find_last_of('/'));
+
+    if (fastObj && isObjPath(path)) {
+      loadObj(path);
+    } else if (!loadWithAssimp(path)) {
+      return false;
+    }
+
+    for (const auto &mesh : mMeshes) {
+      mSamplerUnits.insert(mesh.samplerUnits().begin(), mesh.samplerUnits().end());
+    }
+
+    if (mTexturePacker) {
+      for (auto &array : mTexturePacker->build()) {
+        mOwnedTextures.push_back(std::move(array));
+      }
+      mTexturePacker.reset();
+    }
+
+    printMipCacheStats(mipsBefore);
+    return true;
+  }
+
+  bool loadWithAssimp(const std::string &path) {
     Assimp::Importer importer;
     const aiScene *scene = importer.ReadFile(path.c_str(), aiProcess_Triangulate | aiProcess_FlipUVs);
 
@@ -63,60 +141,169 @@ private:
       return false;
     }
 
-    mDirectory = path.substr(0, path.find_last_of('/'));
+    std::vector<const aiMesh *> sources;
+    collectMeshes(scene->mRootNode, scene, sources);
 
-    processNode(scene->mRootNode, scene);
+    std::vector<std::string> diffuseMaps;
+    for (const aiMesh *source : sources) {
+      for (auto &map : texturePaths(scene->mMaterials[source->mMaterialIndex], aiTextureType_DIFFUSE)) {
+        diffuseMaps.push_back(std::move(map));
+      }
+    }
+    decodeTextures(diffuseMaps);
+
+    // Textures are shared between meshes and live in GL, so we gather
+    // them here, in node order, uploading what decodeTextures() decoded.
+    std::vector<std::vector<Texture>> textures;
+    textures.reserve(sources.size());
+    for (const aiMesh *source : sources) {
+      textures.push_back(processMaterial(scene->mMaterials[source->mMaterialIndex]));
+    }
+    mDecodedTextures.clear();
+
+    // Geometry is only needed until it's uploaded, so it lives in one
+    // arena, sized for the whole scene and freed when we return. The
+    // arena isn't thread-safe, so every mesh's storage is reserved here.
+    TaggedResource geometryMemory{AllocTag::Meshes};
+    ImportArena arena{geometryBytes(sources), &geometryMemory};
+    std::vector<MeshGeometry> geometry;
+    geometry.reserve(sources.size());
+    for (const aiMesh *source : sources) {
+      MeshGeometry &mesh = geometry.emplace_back(&arena);
+      mesh.vertices.reserve(source->mNumVertices);
+      // Triangulated, so no face has more than three indices.
+      mesh.indices.reserve(static_cast<std::size_t>(source->mNumFaces) * 3);
+    }
+
+    // Each mesh's geometry is its own, so we build meshes in parallel.
+    mJobs.parallelFor(0, sources.size(), [&](std::size_t first, std::size_t last) {
+      for (std::size_t i = first; i < last; i++) {
+        processMesh(*sources[i], geometry[i]);
+      }
+    });
+
+    // Buffers are made back here, on the GL thread.
+    mMeshes.reserve(sources.size());
+    for (std::size_t i = 0; i < sources.size(); i++) {
+      mMeshes.emplace_back(geometry[i].vertices, geometry[i].indices, std::move(textures[i]));
+    }
 
+    printGeometryStats(mMeshes.size(), arena.stats());
     return true;
   }
 
-  void processNode(aiNode *node, const aiScene *scene) {
-    for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-      aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
+  // Throws if the file can't be read.
+  void loadObj(const std::string &path) {
+    ObjModel obj = loadObjModel(path, mJobs);
+    fmt::print("Loaded {} with our OBJ loader: {} triangles, {} positions welded to {} vertices.\n", path,
+               obj.stats.triangles, obj.stats.positions, obj.stats.vertices);
+
+    // Each mesh's diffuse map, if it has one.
+    std::vector<std::vector<std::string>> diffuseMaps;
+    diffuseMaps.reserve(obj.meshes.size());
+    std::vector<std::string> allDiffuseMaps;
+    for (const ObjMesh &mesh : obj.meshes) {
+      std::vector<std::string> &maps = diffuseMaps.emplace_back();
+      if (mesh.material != ObjMesh::NO_MATERIAL && !obj.materials[mesh.material].diffuseMap.empty()) {
+        maps.push_back(obj.materials[mesh.material].diffuseMap);
+        allDiffuseMaps.push_back(maps.back());
+      }
+    }
+    decodeTextures(allDiffuseMaps);
 
-      mMeshes.push_back(processMesh(mesh, scene));
+    std::vector<std::vector<Texture>> textures;
+    textures.reserve(obj.meshes.size());
+    for (const auto &maps : diffuseMaps) {
+      textures.push_back(loadTextures(maps, "texture_diffuse"));
     }
+    mDecodedTextures.clear();
 
-    for (unsigned int i = 0; i < node->mNumChildren; i++) {
-      processNode(node->mChildren[i], scene);
+    mMeshes.reserve(obj.meshes.size());
+    for (std::size_t i = 0; i < obj.meshes.size(); i++) {
+      const MeshGeometry &geometry = obj.meshes[i].geometry;
+      mMeshes.emplace_back(geometry.vertices, geometry.indices, std::move(textures[i]));
     }
+
+    printGeometryStats(mMeshes.size(), obj.arena->stats());
   }
 
-  Mesh processMesh(aiMesh *mesh, const aiScene *scene) {
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
+  static void printGeometryStats(std::size_t meshes, const ImportArena::Stats &arenaStats) {
+    fmt::print("Imported {} meshes: {:.1f} MiB of geometry in {} allocations from {} heap block(s).\n", meshes,
+               static_cast<double>(arenaStats.bytes) / (1024.0 * 1024.0), arenaStats.allocations, arenaStats.blocks);
+  }
 
-    for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-      Vertex vertex = {};
-      glm::vec3 vector;
+  // Mip chains this import loaded from the cache or built, since before.
+  static void printMipCacheStats(const MipCacheStats &before) {
+    const MipCacheStats after = mipCacheStats();
+    const std::uint64_t loaded = after.loaded - before.loaded;
+    const std::uint64_t built = after.built - before.built;
+    if (loaded + built > 0) {
+      fmt::print("[mip cache] Loaded {} and built {} mip chains in {:.1f} ms over all threads.\n", loaded, built,
+                 after.ms - before.ms);
+    }
+  }
 
-      vector.x = mesh->mVertices[i].x;
-      vector.y = mesh->mVertices[i].y;
-      vector.z = mesh->mVertices[i].z;
-      vertex.mPosition = vector;
+  // Sampler units never change, so we only assign them the first time
+  // we draw with a given shader.
+  void assignSamplerUnits(Shader &shader) {
+    if (shader.ID == mSamplerProgram) {
+      return;
+    }
 
-      // We always use the first set of texture coords.
-      if (mesh->mTextureCoords[0]) {
-        glm::vec2 vec;
-        vec.x = mesh->mTextureCoords[0][i].x;
-        vec.y = mesh->mTextureCoords[0][i].y;
-        vertex.mTextureCoords = vec;
-      }
+    shader.use();
+    for (const auto &[name, unit] : mSamplerUnits) {
+      shader.setInt(name, unit);
+    }
+    mSamplerProgram = shader.ID;
+  }
 
-      vertices.push_back(vertex);
+  // Every mesh under node, depth first, which is the order we draw them in.
+  static void collectMeshes(const aiNode *node, const aiScene *scene, std::vector<const aiMesh *> &meshes) {
+    for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+      meshes.push_back(scene->mMeshes[node->mMeshes[i]]);
     }
 
-    for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-      aiFace &face = mesh->mFaces[i];
+    for (unsigned int i = 0; i < node->mNumChildren; i++) {
+      collectMeshes(node->mChildren[i], scene, meshes);
+    }
+  }
 
-      for (unsigned int j = 0; j < face.mNumIndices; j++) {
-        indices.push_back(face.mIndices[j]);
+  // Decodes the diffuse maps not loaded yet, in parallel, for
+  // loadTextures() to upload. Streamed and packed textures are decoded
+  // by the streamer and the packer instead.
+  void decodeTextures(const std::vector<std::string> &diffuseMaps) {
+    if (mTexturePacker || textureStreamer().enabled()) {
+      return;
+    }
+
+    std::vector<std::string> paths;
+    std::set<std::string> seen;
+    for (const std::string &map : diffuseMaps) {
+      if (!mLoadedMeshPaths.contains(map) && seen.insert(map).second) {
+        paths.push_back(map);
       }
     }
 
-    std::vector<Texture> textures;
-    aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
+    // As textureFromFile() loads diffuse maps.
+    MipOptions options;
+    options.colorSpace = ColorSpace::SRGB;
+    options.jobs = &mJobs;
+
+    // Jobs take on our tag, so the decoding is charged to textures.
+    AllocScope textureScope{AllocTag::Textures};
+    std::vector<MipChain> chains(paths.size());
+    mJobs.parallelFor(0, paths.size(), [&](std::size_t first, std::size_t last) {
+      for (std::size_t i = first; i < last; i++) {
+        chains[i] = loadMipChain(textureFilePath(paths[i].c_str(), mDirectory), false, options);
+      }
+    });
+
+    for (std::size_t i = 0; i < paths.size(); i++) {
+      mDecodedTextures.emplace(std::move(paths[i]), std::move(chains[i]));
+    }
+  }
 
+  std::vector<Texture> processMaterial(aiMaterial *material) {
     { // NOTE: For testing and debugging.
       auto numDiffuseTextures = material->GetTextureCount(aiTextureType_DIFFUSE);
       auto numSpecularTextures = material->GetTextureCount(aiTextureType_SPECULAR);
@@ -130,33 +317,95 @@ private:
       }
     }
 
-    std::vector<Texture> diffuseMaps = loadTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-    textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+    // Diffuse maps are all we use so far.
+    return loadTextures(texturePaths(material, aiTextureType_DIFFUSE), "texture_diffuse");
+  }
+
+  // Files of a material's textures of a type, as written in the model.
+  static std::vector<std::string> texturePaths(const aiMaterial *material, aiTextureType type) {
+    std::vector<std::string> paths;
+    paths.reserve(material->GetTextureCount(type));
 
-    // Return new mesh.
+    for (unsigned int i = 0; i < material->GetTextureCount(type); i++) {
+      aiString str;
+      material->GetTexture(type, i, &str);
+      paths.emplace_back(str.C_Str());
+    }
 
-    return {vertices, indices, textures};
+    return paths;
   }
 
-  std::vector<Texture> loadTextures(aiMaterial *mat, aiTextureType type, std::string typeName) {
-    std::vector<Texture> textures;
+  // Bytes of geometry in meshes, with room for each vector's alignment.
+  static std::size_t geometryBytes(const std::vector<const aiMesh *> &meshes) {
+    std::size_t bytes = 0;
+    for (const aiMesh *mesh : meshes) {
+      bytes += mesh->mNumVertices * sizeof(Vertex);
+      bytes += static_cast<std::size_t>(mesh->mNumFaces) * 3 * sizeof(unsigned int);
+      bytes += 2 * alignof(std::max_align_t);
+    }
+    return bytes;
+  }
 
-    for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
-      aiString str;
-      mat->GetTexture(type, i, &str);
+  // Fills geometry, which has room reserved for mesh, so this allocates
+  // nothing. Touches no GL and no shared state, so runs on any thread.
+  static void processMesh(const aiMesh &mesh, MeshGeometry &geometry) {
+    for (unsigned int i = 0; i < mesh.mNumVertices; i++) {
+      Vertex vertex = {};
+      glm::vec3 vector;
 
-      if (mLoadedMeshPaths.contains(str.C_Str())) {
-        const Texture &texture = mLoadedTextures[mLoadedMeshPaths[str.C_Str()]];
-        mLoadedTextures.push_back(texture);
+      vector.x = mesh.mVertices[i].x;
+      vector.y = mesh.mVertices[i].y;
+      vector.z = mesh.mVertices[i].z;
+      vertex.mPosition = vector;
+
+      // We always use the first set of texture coords.
+      if (mesh.mTextureCoords[0]) {
+        glm::vec2 vec;
+        vec.x = mesh.mTextureCoords[0][i].x;
+        vec.y = mesh.mTextureCoords[0][i].y;
+        vertex.mTextureCoords = vec;
+      }
+
+      geometry.vertices.push_back(vertex);
+    }
+
+    for (unsigned int i = 0; i < mesh.mNumFaces; i++) {
+      const aiFace &face = mesh.mFaces[i];
+
+      for (unsigned int j = 0; j < face.mNumIndices; j++) {
+        geometry.indices.push_back(face.mIndices[j]);
+      }
+    }
+  }
+
+  std::vector<Texture> loadTextures(const std::vector<std::string> &paths, const std::string &typeName) {
+    std::vector<Texture> textures;
+    textures.reserve(paths.size());
+
+    for (const std::string &path : paths) {
+      if (mLoadedMeshPaths.contains(path)) {
+        const Texture &texture = mLoadedTextures[mLoadedMeshPaths[path]];
+        textures.push_back(texture);
       } else {
         Texture texture;
-        texture.id = textureFromFile(str.C_Str(), this->mDirectory);
+        if (mTexturePacker) {
+          auto [arrayId, layer] = mTexturePacker->add(typeName, textureFilePath(path.c_str(), mDirectory));
+          texture.id = arrayId;
+          texture.layer = layer;
+        } else if (auto decoded = mDecodedTextures.find(path); decoded != mDecodedTextures.end()) {
+          mOwnedTextures.push_back(textureFromMipChain(decoded->second));
+          texture.id = mOwnedTextures.back().get();
+        } else {
+          // Diffuse maps are color; the rest are data.
+          mOwnedTextures.push_back(textureFromFile(path.c_str(), this->mDirectory, typeName == "texture_diffuse"));
+          texture.id = mOwnedTextures.back().get();
+        }
         texture.type = typeName;
-        texture.path = str.C_Str();
+        texture.path = path;
 
         textures.push_back(texture);
         mLoadedTextures.push_back(texture);
-        mLoadedMeshPaths[str.C_Str()] = mLoadedTextures.size() - 1;
+        mLoadedMeshPaths[path] = mLoadedTextures.size() - 1;
       }
     }
 
@@ -168,6 +417,20 @@ private:
   std::map<std::string, std::size_t> mLoadedMeshPaths;
   std::vector<Texture> mLoadedTextures;
   std::string mDirectory;
+  // Our textures and texture arrays, which meshes refer to by name.
+  std::vector<GLTextureHandle> mOwnedTextures;
+
+  // All sampler uniforms used by our meshes, with their texture units.
+  std::map<std::string, int> mSamplerUnits;
+  // Shader we last assigned sampler units on.
+  unsigned int mSamplerProgram = 0;
+
+  // Only alive while loading, if we're packing textures.
+  std::unique_ptr<TextureArrayPacker> mTexturePacker;
+  // Only filled while loading, by decodeTextures().
+  std::map<std::string, MipChain> mDecodedTextures;
+
+  JobSystem &mJobs;
 };
 
 #endif // MODEL_DATA_H
@@ -0,0 +1,822 @@
+// clang-format off
+#include "obj_loader.h"
+#include "alloc_tracker.h"
+
+#include <fmt/core.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define GLEX_HAVE_MMAP
+#endif
+// clang-format on
+
+namespace {
+
+// Bytes of the file each parsing job takes, up to the next line break.
+constexpr std::size_t CHUNK_BYTES = 256 * 1024;
+// Corners each welding job takes.
+constexpr std::size_t WELD_BLOCK = 16 * 1024;
+// So a corner's slot in the weld table fits in 31 bits.
+constexpr std::size_t MAX_MESH_CORNERS = std::size_t{1} << 29;
+
+// -------------
+// File access.
+
+// A whole file, read-only: mapped where we can, and read in otherwise.
+class MappedFile {
+public:
+  explicit MappedFile(const std::string &path) {
+#ifdef GLEX_HAVE_MMAP
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("Failed to open " + path + ".");
+    }
+
+    struct stat info = {};
+    if (::fstat(fd, &info) != 0) {
+      ::close(fd);
+      throw std::runtime_error("Failed to read " + path + ".");
+    }
+
+    mSize = static_cast<std::size_t>(info.st_size);
+    if (mSize > 0) {
+      void *mapping = ::mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+      ::close(fd);
+      if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Failed to map " + path + ".");
+      }
+      // Every part is about to be read at once, by different threads.
+      ::madvise(mapping, mSize, MADV_WILLNEED);
+      mMapping = mapping;
+      mData = static_cast<const char *>(mapping);
+    } else {
+      ::close(fd);
+    }
+#else
+    std::ifstream file{path, std::ios::binary};
+    if (!file) {
+      throw std::runtime_error("Failed to open " + path + ".");
+    }
+    mBuffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    mData = mBuffer.data();
+    mSize = mBuffer.size();
+#endif
+  }
+
+  ~MappedFile() {
+#ifdef GLEX_HAVE_MMAP
+    if (mMapping != nullptr) {
+      ::munmap(mMapping, mSize);
+    }
+#endif
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  [[nodiscard]] std::string_view text() const { return {mData, mSize}; }
+
+private:
+  const char *mData = nullptr;
+  std::size_t mSize = 0;
+#ifdef GLEX_HAVE_MMAP
+  void *mMapping = nullptr;
+#else
+  std::string mBuffer;
+#endif
+};
+
+// --------------
+// Text scanning.
+
+// Carriage returns count as blanks, so files with CRLF line ends work.
+bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+const char *skipBlanks(const char *p, const char *end) {
+  while (p < end && isBlank(*p)) {
+    p++;
+  }
+  return p;
+}
+
+const char *lineEnd(const char *p, const char *end) {
+  const void *newline = std::memchr(p, '\n', static_cast<std::size_t>(end - p));
+  return newline != nullptr ? static_cast<const char *>(newline) : end;
+}
+
+// The rest of the line, without blanks at either end.
+std::string_view trimmed(const char *p, const char *end) {
+  p = skipBlanks(p, end);
+  while (end > p && isBlank(end[-1])) {
+    end--;
+  }
+  return {p, static_cast<std::size_t>(end - p)};
+}
+
+// The word at p, moving p past it.
+std::string_view nextWord(const char *&p, const char *end) {
+  p = skipBlanks(p, end);
+  const char *start = p;
+  while (p < end && !isBlank(*p)) {
+    p++;
+  }
+  return {start, static_cast<std::size_t>(p - start)};
+}
+
+constexpr float POWERS_OF_TEN[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+// Parses the number at p into value, returning where it ends, or null if
+// there isn't one. Values in .obj files rarely have more than seven
+// significant digits, and then the digits as an integer and the power of
+// ten are both exact floats, so one multiply or divide rounds correctly.
+// Anything else goes to std::from_chars, which is exact but slower.
+const char *parseFloat(const char *p, const char *end, float &value) {
+  p = skipBlanks(p, end);
+  if (p < end && *p == '+') {
+    p++;
+  }
+  const char *start = p;
+  const bool negative = p < end && *p == '-';
+  if (negative) {
+    p++;
+  }
+
+  std::uint64_t mantissa = 0;
+  int exponent = 0;
+  int digits = 0;
+  // Digits we couldn't fit in mantissa, which only from_chars handles.
+  bool truncated = false;
+
+  for (; p < end && isDigit(*p); p++, digits++) {
+    if (mantissa < (std::uint64_t{1} << 59)) {
+      mantissa = mantissa * 10 + static_cast<std::uint64_t>(*p - '0');
+    } else {
+      truncated = true;
+    }
+  }
+  if (p < end && *p == '.') {
+    for (p++; p < end && isDigit(*p); p++, digits++) {
+      if (mantissa < (std::uint64_t{1} << 59)) {
+        mantissa = mantissa * 10 + static_cast<std::uint64_t>(*p - '0');
+        exponent--;
+      } else {
+        truncated = true;
+      }
+    }
+  }
+  if (digits == 0) {
+    return nullptr;
+  }
+
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    const char *q = p + 1;
+    const bool negativeExponent = q < end && *q == '-';
+    if (q < end && (*q == '-' || *q == '+')) {
+      q++;
+    }
+    if (q == end || !isDigit(*q)) {
+      return nullptr;
+    }
+
+    int written = 0;
+    for (; q < end && isDigit(*q); q++) {
+      written = std::min(written * 10 + (*q - '0'), 100000);
+    }
+    exponent += negativeExponent ? -written : written;
+    p = q;
+  }
+
+  if (p < end && !isBlank(*p) && *p != '\n') {
+    return nullptr;
+  }
+
+  if (!truncated && mantissa <= (std::uint64_t{1} << 24) && exponent >= -10 && exponent <= 10) {
+    const auto exact = static_cast<float>(mantissa);
+    value = exponent < 0 ? exact / POWERS_OF_TEN[-exponent] : exact * POWERS_OF_TEN[exponent];
+    value = negative ? -value : value;
+    return p;
+  }
+
+  const auto [last, error] = std::from_chars(start, p, value);
+  return error == std::errc{} || error == std::errc::result_out_of_range ? last : nullptr;
+}
+
+// Parses the integer at p, returning where it ends, or null if there isn't one.
+const char *parseIndex(const char *p, const char *end, std::int64_t &value) {
+  const bool negative = p < end && *p == '-';
+  if (negative || (p < end && *p == '+')) {
+    p++;
+  }
+  if (p == end || !isDigit(*p)) {
+    return nullptr;
+  }
+
+  value = 0;
+  for (; p < end && isDigit(*p); p++) {
+    value = std::min<std::int64_t>(value * 10 + (*p - '0'), std::int64_t{1} << 40);
+  }
+  value = negative ? -value : value;
+  return p;
+}
+
+// -----------------
+// Chunked parsing.
+
+constexpr std::int32_t NO_TEX_COORD = std::numeric_limits<std::int32_t>::min();
+
+// A triangle corner, as 0-based position and texture coordinate indices.
+struct Corner {
+  std::int32_t position;
+  std::int32_t texCoord;
+};
+
+struct Statement {
+  enum class Kind : std::uint8_t {
+    // "o" or "g", which start a mesh.
+    Object,
+    // "usemtl", which starts a mesh if the material changes.
+    Material,
+  };
+
+  // The chunk's corner count when we reached it.
+  std::size_t corner;
+  Kind kind;
+  // Points into the file.
+  std::string_view name;
+};
+
+struct Chunk {
+  std::string_view text;
+
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec2> texCoords;
+  // Every face's triangles, three corners each.
+  std::vector<Corner> corners;
+  // Corners with negative indices, which count back from the last position
+  // or coordinate read, so hold an index counted from this chunk's first
+  // until we know where that is. Each is the corner's index times two, plus
+  // one for the texture coordinate, or zero for the position.
+  std::vector<std::size_t> relative;
+  std::vector<Statement> statements;
+  std::vector<std::string_view> materialLibraries;
+
+  // Lines read so far, so the last one if parsing failed.
+  std::size_t lines = 0;
+  std::string error;
+
+  // Where this chunk's data starts in the whole file's.
+  std::size_t positionBase = 0;
+  std::size_t texCoordBase = 0;
+  std::size_t cornerBase = 0;
+};
+
+std::vector<Chunk> splitChunks(std::string_view text) {
+  std::vector<Chunk> chunks;
+  chunks.reserve(text.size() / CHUNK_BYTES + 1);
+
+  std::size_t begin = 0;
+  while (begin < text.size()) {
+    std::size_t end = std::min(text.size(), begin + CHUNK_BYTES);
+    if (end < text.size()) {
+      // Take the rest of the line we ended in.
+      const std::size_t newline = text.find('\n', end - 1);
+      end = newline == std::string_view::npos ? text.size() : newline + 1;
+    }
+
+    chunks.emplace_back().text = text.substr(begin, end - begin);
+    begin = end;
+  }
+
+  return chunks;
+}
+
+// Reads an index written in a face, as an index into everything read so
+// far, of which there are count.
+bool resolveIndex(std::int64_t written, std::size_t count, std::int32_t &index, bool &relative) {
+  if (written == 0 || written > std::numeric_limits<std::int32_t>::max() ||
+      written < -std::int64_t{std::numeric_limits<std::int32_t>::max()}) {
+    return false;
+  }
+
+  relative = written < 0;
+  index = static_cast<std::int32_t>(relative ? static_cast<std::int64_t>(count) + written : written - 1);
+  return true;
+}
+
+struct FaceCorner {
+  Corner corner = {0, NO_TEX_COORD};
+  bool relativePosition = false;
+  bool relativeTexCoord = false;
+};
+
+void addCorner(const FaceCorner &face, Chunk &chunk) {
+  const std::size_t index = chunk.corners.size();
+  chunk.corners.push_back(face.corner);
+  if (face.relativePosition) {
+    chunk.relative.push_back(index * 2);
+  }
+  if (face.relativeTexCoord) {
+    chunk.relative.push_back(index * 2 + 1);
+  }
+}
+
+// Reads a face's corners, e.g. "1/2/3 4//6 7/8", and adds it as a fan of
+// triangles. Normal indices are checked, but otherwise ignored.
+bool parseFace(const char *p, const char *end, Chunk &chunk) {
+  FaceCorner first;
+  FaceCorner previous;
+  int count = 0;
+
+  for (p = skipBlanks(p, end); p < end; p = skipBlanks(p, end)) {
+    FaceCorner current;
+    std::int64_t written = 0;
+
+    p = parseIndex(p, end, written);
+    if (p == nullptr ||
+        !resolveIndex(written, chunk.positions.size(), current.corner.position, current.relativePosition)) {
+      return false;
+    }
+
+    if (p < end && *p == '/') {
+      p++;
+      if (p < end && *p != '/') {
+        p = parseIndex(p, end, written);
+        if (p == nullptr ||
+            !resolveIndex(written, chunk.texCoords.size(), current.corner.texCoord, current.relativeTexCoord)) {
+          return false;
+        }
+      }
+      if (p < end && *p == '/') {
+        p = parseIndex(p + 1, end, written);
+        if (p == nullptr) {
+          return false;
+        }
+      }
+    }
+
+    if (p < end && !isBlank(*p)) {
+      return false;
+    }
+
+    if (count >= 2) {
+      addCorner(first, chunk);
+      addCorner(previous, chunk);
+      addCorner(current, chunk);
+    }
+    (count == 0 ? first : previous) = current;
+    count++;
+  }
+
+  return true;
+}
+
+bool parseLine(const char *p, const char *end, Chunk &chunk) {
+  const std::string_view keyword = nextWord(p, end);
+
+  if (keyword == "v") {
+    glm::vec3 &position = chunk.positions.emplace_back();
+    for (int i = 0; i < 3; i++) {
+      if ((p = parseFloat(p, end, position[i])) == nullptr) {
+        return false;
+      }
+    }
+    // Any w or vertex color that follows is ignored.
+  } else if (keyword == "vt") {
+    glm::vec2 &texCoord = chunk.texCoords.emplace_back(0.0f);
+    if ((p = parseFloat(p, end, texCoord.x)) == nullptr) {
+      return false;
+    }
+    // v is optional, and any w is ignored.
+    if (skipBlanks(p, end) < end && parseFloat(p, end, texCoord.y) == nullptr) {
+      return false;
+    }
+  } else if (keyword == "f") {
+    return parseFace(p, end, chunk);
+  } else if (keyword == "o" || keyword == "g") {
+    chunk.statements.push_back({chunk.corners.size(), Statement::Kind::Object, trimmed(p, end)});
+  } else if (keyword == "usemtl") {
+    chunk.statements.push_back({chunk.corners.size(), Statement::Kind::Material, trimmed(p, end)});
+  } else if (keyword == "mtllib") {
+    chunk.materialLibraries.push_back(trimmed(p, end));
+  }
+  // Anything else, e.g. normals, smoothing groups or comments, we skip.
+
+  return true;
+}
+
+void parseChunk(Chunk &chunk) {
+  const char *p = chunk.text.data();
+  const char *end = p + chunk.text.size();
+
+  while (p < end) {
+    const char *eol = lineEnd(p, end);
+    chunk.lines++;
+
+    if (!parseLine(p, eol, chunk)) {
+      chunk.error = fmt::format("can't read \"{}\"", trimmed(p, eol));
+      return;
+    }
+    p = eol < end ? eol + 1 : end;
+  }
+}
+
+// Moves a chunk's data into the whole file's, now we know where it goes.
+void gatherChunk(Chunk &chunk, const std::string &path, std::vector<glm::vec3> &positions,
+                 std::vector<glm::vec2> &texCoords, std::vector<Corner> &corners) {
+  for (const std::size_t entry : chunk.relative) {
+    Corner &corner = chunk.corners[entry / 2];
+    if (entry % 2 == 0) {
+      corner.position += static_cast<std::int32_t>(chunk.positionBase);
+    } else {
+      corner.texCoord += static_cast<std::int32_t>(chunk.texCoordBase);
+    }
+  }
+
+  for (const Corner &corner : chunk.corners) {
+    const bool validPosition = corner.position >= 0 && static_cast<std::size_t>(corner.position) < positions.size();
+    const bool validTexCoord = corner.texCoord == NO_TEX_COORD ||
+                               (corner.texCoord >= 0 && static_cast<std::size_t>(corner.texCoord) < texCoords.size());
+    if (!validPosition || !validTexCoord) {
+      throw std::runtime_error(path + ": a face refers to a vertex that isn't there.");
+    }
+  }
+
+  std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.positionBase);
+  std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), texCoords.begin() + chunk.texCoordBase);
+  std::copy(chunk.corners.begin(), chunk.corners.end(), corners.begin() + chunk.cornerBase);
+
+  chunk.positions = {};
+  chunk.texCoords = {};
+  chunk.corners = {};
+  chunk.relative = {};
+}
+
+// ----------
+// Materials.
+
+// The file a map statement names, after any options, e.g. "-bm 0.5 a.png".
+// Names without options may have spaces.
+std::string_view mapFile(std::string_view rest) {
+  if (!rest.starts_with('-')) {
+    return rest;
+  }
+  const std::size_t lastBlank = rest.find_last_of(" \t");
+  return lastBlank == std::string_view::npos ? rest : rest.substr(lastBlank + 1);
+}
+
+// Adds the materials of an .mtl file. As with Assimp, a missing library
+// only costs us its textures.
+void readMaterialLibrary(const std::string &path, std::vector<ObjMaterial> &materials) {
+  std::ifstream file{path};
+  if (!file) {
+    fmt::print("Failed to open material library {}; its materials will be untextured.\n", path);
+    return;
+  }
+
+  std::string line;
+  while (std::getline(file, line)) {
+    const char *p = line.data();
+    const char *end = p + line.size();
+    const std::string_view keyword = nextWord(p, end);
+
+    if (keyword == "newmtl") {
+      materials.push_back({std::string(trimmed(p, end)), {}});
+    } else if (keyword == "map_Kd" && !materials.empty()) {
+      materials.back().diffuseMap = mapFile(trimmed(p, end));
+    }
+  }
+}
+
+// ----------
+// Welding.
+
+// Open-addressed, lock-free table from a corner's indices to the first
+// corner with them, and then to their vertex. Any number of threads can
+// insert at once, with relaxed atomics, as the phases of a weld are
+// separated by parallelFor() returning.
+class WeldTable {
+public:
+  explicit WeldTable(std::size_t corners)
+      : mMask(std::bit_ceil(std::max<std::size_t>(2 * corners, 16)) - 1),
+        mKeys(new std::atomic<std::uint64_t>[mMask + 1]()), mValues(new std::atomic<std::uint32_t>[mMask + 1]()) {}
+
+  // Never 0, which marks an empty slot.
+  static std::uint64_t key(const Corner &corner) {
+    const auto texCoord = corner.texCoord == NO_TEX_COORD ? 0u : static_cast<std::uint32_t>(corner.texCoord) + 1;
+    return (static_cast<std::uint64_t>(corner.position) + 1) << 32 | texCoord;
+  }
+
+  // Slot of key, which we take if no one has yet.
+  std::uint32_t insert(std::uint64_t key) {
+    for (std::size_t slot = hash(key) & mMask;; slot = (slot + 1) & mMask) {
+      std::uint64_t current = mKeys[slot].load(std::memory_order_relaxed);
+      if (current == 0 && mKeys[slot].compare_exchange_strong(current, key, std::memory_order_relaxed)) {
+        return static_cast<std::uint32_t>(slot);
+      }
+      // Whether or not we lost a race for it, the slot may have our key now.
+      if (current == key) {
+        return static_cast<std::uint32_t>(slot);
+      }
+    }
+  }
+
+  // Keeps the lowest corner offered for a slot, stored plus one, as 0
+  // means none yet.
+  void offerFirst(std::uint32_t slot, std::uint32_t corner) {
+    const std::uint32_t offered = corner + 1;
+    std::uint32_t held = mValues[slot].load(std::memory_order_relaxed);
+    while ((held == 0 || offered < held) &&
+           !mValues[slot].compare_exchange_weak(held, offered, std::memory_order_relaxed)) {
+    }
+  }
+
+  [[nodiscard]] bool isFirst(std::uint32_t slot, std::uint32_t corner) const {
+    return mValues[slot].load(std::memory_order_relaxed) == corner + 1;
+  }
+
+  // Once firsts are known, the slot's value becomes its vertex.
+  void setVertex(std::uint32_t slot, std::uint32_t vertex) { mValues[slot].store(vertex, std::memory_order_relaxed); }
+
+  [[nodiscard]] std::uint32_t vertex(std::uint32_t slot) const { return mValues[slot].load(std::memory_order_relaxed); }
+
+private:
+  static std::uint64_t hash(std::uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+  }
+
+private:
+  std::size_t mMask;
+  std::unique_ptr<std::atomic<std::uint64_t>[]> mKeys;
+  std::unique_ptr<std::atomic<std::uint32_t>[]> mValues;
+};
+
+// A mesh's corners, [begin, end) of the file's, while they're welded.
+struct Weld {
+  std::size_t begin = 0;
+  std::size_t end = 0;
+  std::size_t material = ObjMesh::NO_MATERIAL;
+
+  std::unique_ptr<WeldTable> table;
+  // Each corner's slot, with FIRST set if it's the first with its key.
+  std::vector<std::uint32_t> slots;
+  // Vertices made by the blocks before each one.
+  std::vector<std::uint32_t> blockVertices;
+  std::size_t vertices = 0;
+
+  static constexpr std::uint32_t FIRST = 1u << 31;
+
+  [[nodiscard]] std::size_t corners() const { return end - begin; }
+  [[nodiscard]] std::size_t blocks() const { return (corners() + WELD_BLOCK - 1) / WELD_BLOCK; }
+};
+
+// Finds the first corner with each key, each of which makes a vertex, and
+// counts them, so the mesh's storage can be allocated.
+void countVertices(Weld &weld, const std::vector<Corner> &corners, JobSystem &jobs) {
+  weld.table = std::make_unique<WeldTable>(weld.corners());
+  weld.slots.resize(weld.corners());
+  weld.blockVertices.resize(weld.blocks());
+
+  WeldTable &table = *weld.table;
+  const Corner *meshCorners = corners.data() + weld.begin;
+
+  jobs.parallelFor(0, weld.blocks(), [&](std::size_t first, std::size_t last) {
+    for (std::size_t c = first * WELD_BLOCK; c < std::min(last * WELD_BLOCK, weld.corners()); c++) {
+      const std::uint32_t slot = table.insert(WeldTable::key(meshCorners[c]));
+      weld.slots[c] = slot;
+      table.offerFirst(slot, static_cast<std::uint32_t>(c));
+    }
+  });
+
+  jobs.parallelFor(0, weld.blocks(), [&](std::size_t first, std::size_t last) {
+    for (std::size_t block = first; block < last; block++) {
+      std::uint32_t count = 0;
+      for (std::size_t c = block * WELD_BLOCK; c < std::min((block + 1) * WELD_BLOCK, weld.corners()); c++) {
+        if (table.isFirst(weld.slots[c], static_cast<std::uint32_t>(c))) {
+          weld.slots[c] |= Weld::FIRST;
+          count++;
+        }
+      }
+      weld.blockVertices[block] = count;
+    }
+  });
+
+  // Vertices are numbered in the order their first corners come.
+  std::uint32_t vertices = 0;
+  for (auto &count : weld.blockVertices) {
+    vertices += std::exchange(count, vertices);
+  }
+  weld.vertices = vertices;
+}
+
+// Fills geometry, which has room reserved for the weld, so this allocates
+// nothing.
+void buildGeometry(Weld &weld, const std::vector<Corner> &corners, const std::vector<glm::vec3> &positions,
+                   const std::vector<glm::vec2> &texCoords, MeshGeometry &geometry, JobSystem &jobs) {
+  geometry.vertices.resize(weld.vertices);
+  geometry.indices.resize(weld.corners());
+
+  WeldTable &table = *weld.table;
+  const Corner *meshCorners = corners.data() + weld.begin;
+
+  jobs.parallelFor(0, weld.blocks(), [&](std::size_t first, std::size_t last) {
+    for (std::size_t block = first; block < last; block++) {
+      std::uint32_t next = weld.blockVertices[block];
+      for (std::size_t c = block * WELD_BLOCK; c < std::min((block + 1) * WELD_BLOCK, weld.corners()); c++) {
+        if ((weld.slots[c] & Weld::FIRST) == 0) {
+          continue;
+        }
+
+        const Corner &corner = meshCorners[c];
+        Vertex &vertex = geometry.vertices[next];
+        vertex.mPosition = positions[static_cast<std::size_t>(corner.position)];
+        vertex.mTextureCoords = glm::vec2(0.0f);
+        if (corner.texCoord != NO_TEX_COORD) {
+          // Flipped, as with aiProcess_FlipUVs.
+          const glm::vec2 &texCoord = texCoords[static_cast<std::size_t>(corner.texCoord)];
+          vertex.mTextureCoords = {texCoord.x, 1.0f - texCoord.y};
+        }
+
+        table.setVertex(weld.slots[c] & ~Weld::FIRST, next++);
+      }
+    }
+  });
+
+  jobs.parallelFor(
+      0, weld.corners(),
+      [&](std::size_t first, std::size_t last) {
+        for (std::size_t c = first; c < last; c++) {
+          geometry.indices[c] = table.vertex(weld.slots[c] & ~Weld::FIRST);
+        }
+      },
+      WELD_BLOCK);
+
+  weld.table.reset();
+  weld.slots = {};
+}
+
+std::pmr::memory_resource *geometryMemory() {
+  static TaggedResource memory{AllocTag::Meshes};
+  return &memory;
+}
+
+} // namespace
+
+// ------------------------
+// OBJ loader definitions.
+
+bool isObjPath(const std::string &path) {
+  if (path.size() < 4) {
+    return false;
+  }
+  std::string extension = path.substr(path.size() - 4);
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+  return extension == ".obj";
+}
+
+ObjModel loadObjModel(const std::string &path, JobSystem &jobs) {
+  const MappedFile file{path};
+  const std::string_view text = file.text();
+
+  ObjModel model;
+  model.stats.bytes = text.size();
+
+  std::vector<Chunk> chunks = splitChunks(text);
+  model.stats.chunks = chunks.size();
+
+  jobs.parallelFor(0, chunks.size(), [&](std::size_t first, std::size_t last) {
+    for (std::size_t i = first; i < last; i++) {
+      parseChunk(chunks[i]);
+    }
+  });
+
+  // Where each chunk's data goes, now we know how much came before it.
+  std::size_t lines = 0;
+  for (Chunk &chunk : chunks) {
+    if (!chunk.error.empty()) {
+      throw std::runtime_error(fmt::format("{}:{}: {}.", path, lines + chunk.lines, chunk.error));
+    }
+    lines += chunk.lines;
+
+    chunk.positionBase = model.stats.positions;
+    chunk.texCoordBase = model.stats.texCoords;
+    chunk.cornerBase = model.stats.triangles * 3;
+    model.stats.positions += chunk.positions.size();
+    model.stats.texCoords += chunk.texCoords.size();
+    model.stats.triangles += chunk.corners.size() / 3;
+  }
+
+  std::vector<glm::vec3> positions(model.stats.positions);
+  std::vector<glm::vec2> texCoords(model.stats.texCoords);
+  std::vector<Corner> corners(model.stats.triangles * 3);
+  jobs.parallelFor(0, chunks.size(), [&](std::size_t first, std::size_t last) {
+    for (std::size_t i = first; i < last; i++) {
+      gatherChunk(chunks[i], path, positions, texCoords, corners);
+    }
+  });
+
+  // Materials are few, and their files small.
+  const std::string directory = path.substr(0, path.find_last_of('/') + 1);
+  for (const Chunk &chunk : chunks) {
+    for (const std::string_view library : chunk.materialLibraries) {
+      readMaterialLibrary(directory + std::string(library), model.materials);
+    }
+  }
+  std::map<std::string, std::size_t, std::less<>> materialIndices;
+  for (std::size_t i = 0; i < model.materials.size(); i++) {
+    materialIndices.emplace(model.materials[i].name, i);
+  }
+
+  // Split the corners into meshes.
+  std::vector<Weld> welds;
+  std::size_t material = ObjMesh::NO_MATERIAL;
+  std::size_t meshStart = 0;
+  const auto endMesh = [&](std::size_t corner) {
+    if (corner > meshStart) {
+      Weld &weld = welds.emplace_back();
+      weld.begin = meshStart;
+      weld.end = corner;
+      weld.material = material;
+    }
+    meshStart = corner;
+  };
+  for (const Chunk &chunk : chunks) {
+    for (const Statement &statement : chunk.statements) {
+      const std::size_t corner = chunk.cornerBase + statement.corner;
+      if (statement.kind == Statement::Kind::Object) {
+        endMesh(corner);
+        continue;
+      }
+
+      const auto found = materialIndices.find(statement.name);
+      const std::size_t next = found == materialIndices.end() ? ObjMesh::NO_MATERIAL : found->second;
+      if (next != material) {
+        endMesh(corner);
+        material = next;
+      }
+    }
+  }
+  endMesh(corners.size());
+
+  for (const Weld &weld : welds) {
+    if (weld.corners() > MAX_MESH_CORNERS) {
+      throw std::runtime_error(path + ": a mesh has too many faces to index.");
+    }
+  }
+
+  jobs.parallelFor(0, welds.size(), [&](std::size_t first, std::size_t last) {
+    for (std::size_t i = first; i < last; i++) {
+      countVertices(welds[i], corners, jobs);
+    }
+  });
+
+  // With every size known, the arena is allocated once, here, as it isn't
+  // thread-safe.
+  std::size_t bytes = 0;
+  for (const Weld &weld : welds) {
+    bytes += weld.vertices * sizeof(Vertex) + weld.corners() * sizeof(unsigned int);
+    bytes += 2 * alignof(std::max_align_t);
+  }
+  model.arena = std::make_unique<ImportArena>(bytes, geometryMemory());
+
+  model.meshes.reserve(welds.size());
+  for (const Weld &weld : welds) {
+    ObjMesh &mesh = model.meshes.emplace_back(model.arena.get());
+    mesh.material = weld.material;
+    mesh.geometry.vertices.reserve(weld.vertices);
+    mesh.geometry.indices.reserve(weld.corners());
+    model.stats.vertices += weld.vertices;
+  }
+
+  jobs.parallelFor(0, welds.size(), [&](std::size_t first, std::size_t last) {
+    for (std::size_t i = first; i < last; i++) {
+      buildGeometry(welds[i], corners, positions, texCoords, model.meshes[i].geometry, jobs);
+    }
+  });
+
+  return model;
+}
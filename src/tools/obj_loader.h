@@ -0,0 +1,75 @@
+// A fast loader for Wavefront .obj files, and their .mtl materials.
+//
+// Assimp reads an .obj a line at a time on one thread, and leaves every
+// face corner its own vertex. Here we map the file into memory, split it
+// into chunks at line breaks, and parse the chunks in parallel. Then each
+// mesh's corners are welded, so corners with the same position and
+// texture coordinates share a vertex, through a lock-free hash table that
+// all threads insert into at once. Vertices are numbered in the order
+// they first appear, as a serial weld would number them, so the result
+// doesn't depend on the thread count.
+//
+// The result is what Model gives Mesh: Vertex and index arrays, built in
+// an ImportArena, with texture coordinates flipped as Assimp's
+// aiProcess_FlipUVs would. Faces with more than three corners are split
+// into fans, and a mesh starts at each "o", "g" or change of "usemtl", as
+// with Assimp. Normals, lines and points are skipped, since Mesh has no
+// use for them. Of the materials, we only keep diffuse maps.
+//
+// Throws std::runtime_error if the file can't be read or is malformed.
+
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include "import_arena.h"
+#include "job_system.h"
+#include "mesh_data.h"
+
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct ObjMaterial {
+  std::string name;
+  // The map_Kd file, as written in the .mtl; empty if there's none.
+  std::string diffuseMap;
+};
+
+struct ObjMesh {
+  static constexpr std::size_t NO_MATERIAL = std::numeric_limits<std::size_t>::max();
+
+  explicit ObjMesh(std::pmr::memory_resource *memory) : geometry(memory) {}
+
+  // Index into ObjModel::materials, or NO_MATERIAL.
+  std::size_t material = NO_MATERIAL;
+  MeshGeometry geometry;
+};
+
+struct ObjModel {
+  struct Stats {
+    std::size_t bytes = 0;
+    std::size_t chunks = 0;
+    std::size_t positions = 0;
+    std::size_t texCoords = 0;
+    std::size_t triangles = 0;
+    // After welding; without it, three per triangle.
+    std::size_t vertices = 0;
+  };
+
+  std::vector<ObjMaterial> materials;
+  // Holds the meshes' geometry, so it's declared before them.
+  std::unique_ptr<ImportArena> arena;
+  std::vector<ObjMesh> meshes;
+  Stats stats;
+};
+
+/// Reads the .obj file at path, and the .mtl files it names, parsing and
+/// welding on jobs.
+ObjModel loadObjModel(const std::string &path, JobSystem &jobs);
+
+// Whether path names an .obj file, which loadObjModel() reads.
+bool isObjPath(const std::string &path);
+
+#endif // OBJ_LOADER_H
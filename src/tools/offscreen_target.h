@@ -0,0 +1,63 @@
+// Framebuffer object with color and depth renderbuffers, for rendering
+// without a visible window.
+
+#ifndef OFFSCREEN_TARGET_H
+#define OFFSCREEN_TARGET_H
+
+#include "glad/glad.h"
+
+#include <tools/gl_resources.h>
+
+#include <stdexcept>
+
+class OffscreenTarget {
+public:
+  /// Throws if the framebuffer is incomplete.
+  OffscreenTarget(int width, int height) : mWidth(width), mHeight(height) {
+    mFBO = GLFramebufferHandle::create();
+    mColorRBO = GLRenderbufferHandle::create();
+    mDepthRBO = GLRenderbufferHandle::create();
+
+    glBindRenderbuffer(GL_RENDERBUFFER, mColorRBO.get());
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, mDepthRBO.get());
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    mColorRBO.setBytes(estimateTextureBytes(width, height, 4, false));
+    mDepthRBO.setBytes(estimateTextureBytes(width, height, 4, false));
+
+    glBindFramebuffer(GL_FRAMEBUFFER, mFBO.get());
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, mColorRBO.get());
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, mDepthRBO.get());
+
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (!complete) {
+      throw std::runtime_error("Offscreen framebuffer is incomplete.");
+    }
+  }
+
+  OffscreenTarget(const OffscreenTarget &) = delete;
+  OffscreenTarget &operator=(const OffscreenTarget &) = delete;
+
+  // Direct rendering into this target.
+  void bind() const {
+    glBindFramebuffer(GL_FRAMEBUFFER, mFBO.get());
+    glViewport(0, 0, mWidth, mHeight);
+  }
+
+  [[nodiscard]] unsigned int FBO() const { return mFBO.get(); }
+  [[nodiscard]] int width() const { return mWidth; }
+  [[nodiscard]] int height() const { return mHeight; }
+
+private:
+  GLFramebufferHandle mFBO;
+  GLRenderbufferHandle mColorRBO;
+  GLRenderbufferHandle mDepthRBO;
+
+  int mWidth;
+  int mHeight;
+};
+
+#endif // OFFSCREEN_TARGET_H
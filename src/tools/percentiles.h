@@ -0,0 +1,44 @@
+// Summary statistics of a sample, e.g. frame times: mean, max and
+// nearest-rank percentiles. Used by FrameLoop, FrameBenchmark, the
+// profiler and our benchmarks, so they all report the same thing.
+
+#ifndef PERCENTILES_H
+#define PERCENTILES_H
+
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+class Percentiles {
+public:
+  // Copies and sorts values.
+  explicit Percentiles(std::span<const double> values) : mSorted(values.begin(), values.end()) {
+    std::sort(mSorted.begin(), mSorted.end());
+
+    double total = 0.0;
+    for (double value : mSorted) {
+      total += value;
+    }
+    mMean = mSorted.empty() ? 0.0 : total / static_cast<double>(mSorted.size());
+  }
+
+  // The nearest-rank p-th percentile, for p in [0, 100]; 0 if empty.
+  [[nodiscard]] double at(double p) const {
+    if (mSorted.empty()) {
+      return 0.0;
+    }
+    const auto rank = static_cast<std::size_t>(p / 100.0 * static_cast<double>(mSorted.size() - 1) + 0.5);
+    return mSorted[std::min(rank, mSorted.size() - 1)];
+  }
+
+  [[nodiscard]] std::size_t count() const { return mSorted.size(); }
+  [[nodiscard]] double mean() const { return mMean; }
+  [[nodiscard]] double max() const { return mSorted.empty() ? 0.0 : mSorted.back(); }
+
+private:
+  std::vector<double> mSorted;
+  double mMean = 0.0;
+};
+
+#endif // PERCENTILES_H
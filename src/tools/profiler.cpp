@@ -0,0 +1,207 @@
+// clang-format off
+#include "profiler.h"
+#include "percentiles.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <string_view>
+#include <thread>
+// clang-format on
+
+namespace {
+
+// Thread id used for GPU events in traces.
+constexpr std::uint32_t GPU_THREAD = 0xFFFF;
+
+std::uint32_t currentThread() {
+  return static_cast<std::uint32_t>(std::hash<std::thread::id>{}(std::this_thread::get_id()) & 0xFFF);
+}
+
+} // namespace
+
+// ---------------------------
+// Option definitions.
+
+ProfileOptions parseProfileOptions(int argc, char **argv) {
+  ProfileOptions options;
+
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+
+    if (arg == "--profile") {
+      options.enabled = true;
+    } else if (arg == "--trace" && i + 1 < argc) {
+      options.enabled = true;
+      options.tracePath = argv[++i];
+    }
+  }
+
+  return options;
+}
+
+// --------------------
+// Profiler definitions.
+
+Profiler &Profiler::instance() {
+  static Profiler profiler;
+  return profiler;
+}
+
+void Profiler::beginFrame() {
+  if (!enabled()) {
+    return;
+  }
+
+  if (!mGpuQueriesCreated) {
+    for (auto &set : mGpuQueries) {
+      for (auto &gpuQuery : set) {
+        glGenQueries(1, &gpuQuery.begin);
+        glGenQueries(1, &gpuQuery.end);
+      }
+    }
+    mGpuQueriesCreated = true;
+  }
+
+  // Reuse the oldest set, harvesting whatever of it has finished.
+  mGpuSet = mFrame % GPU_QUERY_SETS;
+  collectGpuResults(mGpuSet);
+  mGpuQueryCounts[mGpuSet] = 0;
+  mGpuDepth = 0;
+
+  mFrameStart = Clock::now();
+}
+
+void Profiler::endFrame() {
+  if (!enabled()) {
+    return;
+  }
+
+  const auto frameEnd = Clock::now();
+  recordCpu("frame", mFrameStart, frameEnd);
+
+  std::chrono::duration<double, std::milli> frameMs = frameEnd - mFrameStart;
+  mFrameMs[mFrame % WINDOW_FRAMES] = frameMs.count();
+  // Filled in when this frame's queries are read back.
+  mGpuMs[mFrame % WINDOW_FRAMES] = 0.0;
+
+  mFrame++;
+
+  if (mFrame % WINDOW_FRAMES == 0) {
+    printSummary();
+  }
+}
+
+void Profiler::recordCpu(const char *name, Clock::time_point start, Clock::time_point end) {
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+
+  std::lock_guard lock{mEventMutex};
+
+  if (mEvents.size() < MAX_EVENTS) {
+    mEvents.push_back({name, duration_cast<microseconds>(start - mEpoch).count(),
+                       duration_cast<microseconds>(end - start).count(), currentThread()});
+  }
+}
+
+std::size_t Profiler::beginGpu(const char *name) {
+  if (!mGpuQueriesCreated || mGpuQueryCounts[mGpuSet] == MAX_GPU_SCOPES) {
+    return NO_GPU_SCOPE;
+  }
+
+  const std::size_t slot = mGpuQueryCounts[mGpuSet]++;
+  GpuQuery &gpuQuery = mGpuQueries[mGpuSet][slot];
+  gpuQuery.name = name;
+  gpuQuery.startUs = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - mEpoch).count();
+  gpuQuery.depth = mGpuDepth++;
+  gpuQuery.ended = false;
+
+  glQueryCounter(gpuQuery.begin, GL_TIMESTAMP);
+  return slot;
+}
+
+void Profiler::endGpu(std::size_t slot) {
+  GpuQuery &gpuQuery = mGpuQueries[mGpuSet][slot];
+
+  glQueryCounter(gpuQuery.end, GL_TIMESTAMP);
+  gpuQuery.ended = true;
+  mGpuDepth--;
+}
+
+void Profiler::collectGpuResults(std::size_t set) {
+  // The frame these queries were issued in.
+  if (mFrame < GPU_QUERY_SETS) {
+    return;
+  }
+  const std::uint64_t frame = mFrame - GPU_QUERY_SETS;
+
+  double totalMs = 0.0;
+
+  for (std::size_t i = 0; i < mGpuQueryCounts[set]; i++) {
+    const GpuQuery &gpuQuery = mGpuQueries[set][i];
+    if (!gpuQuery.ended) {
+      continue;
+    }
+
+    // The end timestamp was issued last, so once it's ready both are.
+    GLint available = 0;
+    glGetQueryObjectiv(gpuQuery.end, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+      // Dropping a sample beats stalling the frame.
+      continue;
+    }
+
+    GLuint64 beginNs = 0;
+    GLuint64 endNs = 0;
+    glGetQueryObjectui64v(gpuQuery.begin, GL_QUERY_RESULT, &beginNs);
+    glGetQueryObjectui64v(gpuQuery.end, GL_QUERY_RESULT, &endNs);
+    const GLuint64 elapsedNs = endNs > beginNs ? endNs - beginNs : 0;
+
+    if (gpuQuery.depth == 0) {
+      totalMs += static_cast<double>(elapsedNs) / 1.0e6;
+    }
+
+    std::lock_guard lock{mEventMutex};
+    if (mEvents.size() < MAX_EVENTS) {
+      mEvents.push_back({gpuQuery.name, gpuQuery.startUs, static_cast<std::int64_t>(elapsedNs / 1000), GPU_THREAD});
+    }
+  }
+
+  mGpuMs[frame % WINDOW_FRAMES] = totalMs;
+}
+
+bool Profiler::exportChromeTrace(const std::string &path) const {
+  std::ofstream file{path};
+
+  file << "{\"traceEvents\": [\n";
+  file << R"(  {"name": "thread_name", "ph": "M", "pid": 0, "tid": )" << GPU_THREAD
+       << R"(, "args": {"name": "GPU"}})";
+
+  std::lock_guard lock{mEventMutex};
+  for (const Event &event : mEvents) {
+    file << fmt::format(",\n  {{\"name\": \"{}\", \"ph\": \"X\", \"ts\": {}, \"dur\": {}, \"pid\": 0, \"tid\": {}}}",
+                        event.name, event.startUs, event.durationUs, event.thread);
+  }
+
+  file << "\n]}\n";
+
+  return static_cast<bool>(file);
+}
+
+void Profiler::printSummary() const {
+  const std::size_t count = std::min<std::uint64_t>(mFrame, WINDOW_FRAMES);
+  if (count == 0) {
+    return;
+  }
+
+  auto percentiles = [count](const std::array<double, WINDOW_FRAMES> &window) {
+    const Percentiles sorted{std::span(window).first(count)};
+    return fmt::format("p50 {:6.2f}  p95 {:6.2f}  p99 {:6.2f}  max {:6.2f}", sorted.at(50), sorted.at(95),
+                       sorted.at(99), sorted.max());
+  };
+
+  fmt::print("[profiler] last {} frames (ms)  cpu: {}\n", count, percentiles(mFrameMs));
+  fmt::print("[profiler] last {} frames (ms)  gpu: {}\n", count, percentiles(mGpuMs));
+}
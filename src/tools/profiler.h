@@ -0,0 +1,208 @@
+// Lightweight frame profiler.
+//
+// CPU work is measured with RAII scopes, and GPU work with pairs of
+// GL_TIMESTAMP queries that are double-buffered: a frame's queries are
+// only read back two frames later, and skipped if still not ready, so
+// reading them never stalls. Unlike GL_TIME_ELAPSED queries, timestamps
+// can nest, and can be taken while FrameBenchmark's query is active.
+// Recorded events export to Chrome's trace format (load them in
+// chrome://tracing or Perfetto), and frame times are summarized as rolling
+// percentiles on the console.
+//
+// When the profiler is disabled at runtime a scope costs one relaxed
+// atomic load. Defining GLEX_DISABLE_PROFILER compiles the scopes out.
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "glad/glad.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// ---------------------------
+// Command line profiler options.
+
+struct ProfileOptions {
+  // Print rolling frame-time percentiles.
+  bool enabled = false;
+  // Where to write a Chrome trace at exit, if anywhere.
+  std::string tracePath;
+};
+
+// Recognizes `--profile` and `--trace <path>`, which implies `--profile`.
+ProfileOptions parseProfileOptions(int argc, char **argv);
+
+// ---------
+// Profiler.
+
+class Profiler {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  static Profiler &instance();
+
+  Profiler(const Profiler &) = delete;
+  Profiler &operator=(const Profiler &) = delete;
+
+  void setEnabled(bool enabled) { mEnabled.store(enabled, std::memory_order_relaxed); }
+  [[nodiscard]] bool enabled() const { return mEnabled.load(std::memory_order_relaxed); }
+
+  // Bracket each frame. GPU scopes need a current GL context.
+  void beginFrame();
+  void endFrame();
+
+  // CPU scope, named by a string literal.
+  void recordCpu(const char *name, Clock::time_point start, Clock::time_point end);
+
+  // GPU scopes may nest. beginGpu() returns the scope's slot, to be
+  // given to endGpu(), or NO_GPU_SCOPE if the frame has no room left.
+  static constexpr std::size_t NO_GPU_SCOPE = ~std::size_t{0};
+  std::size_t beginGpu(const char *name);
+  void endGpu(std::size_t slot);
+
+  // Writes all recorded events as Chrome trace JSON. Returns success.
+  bool exportChromeTrace(const std::string &path) const;
+
+  // Console summary of the rolling frame-time window.
+  void printSummary() const;
+
+private:
+  Profiler() = default;
+
+  void collectGpuResults(std::size_t set);
+
+private:
+  struct Event {
+    const char *name;
+    std::int64_t startUs;
+    std::int64_t durationUs;
+    std::uint32_t thread;
+  };
+
+  struct GpuQuery {
+    // GL_TIMESTAMP queries at the start and end of the scope.
+    GLuint begin = 0;
+    GLuint end = 0;
+    const char *name = nullptr;
+    std::int64_t startUs = 0;
+    // Scopes open around this one; only outermost scopes add to the frame's GPU time.
+    std::uint32_t depth = 0;
+    bool ended = false;
+  };
+
+  // Maximum GPU scopes per frame, and how many frames of them we keep in flight.
+  static constexpr std::size_t MAX_GPU_SCOPES = 16;
+  static constexpr std::size_t GPU_QUERY_SETS = 2;
+  // Frames in the rolling window, and how often we print it.
+  static constexpr std::size_t WINDOW_FRAMES = 240;
+  // Stop recording trace events past this many, so long sessions stay bounded.
+  static constexpr std::size_t MAX_EVENTS = 1 << 20;
+
+  std::atomic<bool> mEnabled = false;
+
+  Clock::time_point mEpoch = Clock::now();
+
+  mutable std::mutex mEventMutex;
+  std::vector<Event> mEvents;
+
+  // GPU queries for the last GPU_QUERY_SETS frames.
+  std::array<std::array<GpuQuery, MAX_GPU_SCOPES>, GPU_QUERY_SETS> mGpuQueries = {};
+  std::array<std::size_t, GPU_QUERY_SETS> mGpuQueryCounts = {};
+  bool mGpuQueriesCreated = false;
+  std::uint32_t mGpuDepth = 0;
+  std::size_t mGpuSet = 0;
+
+  std::uint64_t mFrame = 0;
+  Clock::time_point mFrameStart;
+
+  // Rolling window of frame times, and of total GPU time per frame.
+  std::array<double, WINDOW_FRAMES> mFrameMs = {};
+  std::array<double, WINDOW_FRAMES> mGpuMs = {};
+};
+
+// ------------------------------------------------------------
+// Enables the profiler for a program run per the command line,
+// and writes the trace, if one was asked for, when it goes away.
+
+class ProfileSession {
+public:
+  explicit ProfileSession(ProfileOptions options) : mOptions(std::move(options)) {
+    Profiler::instance().setEnabled(mOptions.enabled);
+  }
+
+  ProfileSession(const ProfileSession &) = delete;
+  ProfileSession &operator=(const ProfileSession &) = delete;
+
+  ~ProfileSession() {
+    if (!mOptions.tracePath.empty() && !Profiler::instance().exportChromeTrace(mOptions.tracePath)) {
+      std::cerr << "Failed to write trace to " << mOptions.tracePath << std::endl;
+    }
+  }
+
+private:
+  ProfileOptions mOptions;
+};
+
+// ---------------------------
+// RAII scopes and macros.
+
+class ProfileScope {
+public:
+  explicit ProfileScope(const char *name) : mName(Profiler::instance().enabled() ? name : nullptr) {
+    if (mName) {
+      mStart = Profiler::Clock::now();
+    }
+  }
+
+  ProfileScope(const ProfileScope &) = delete;
+  ProfileScope &operator=(const ProfileScope &) = delete;
+
+  ~ProfileScope() {
+    if (mName) {
+      Profiler::instance().recordCpu(mName, mStart, Profiler::Clock::now());
+    }
+  }
+
+private:
+  const char *mName;
+  Profiler::Clock::time_point mStart;
+};
+
+class ProfileGpuScope {
+public:
+  explicit ProfileGpuScope(const char *name)
+      : mSlot(Profiler::instance().enabled() ? Profiler::instance().beginGpu(name) : Profiler::NO_GPU_SCOPE) {}
+
+  ProfileGpuScope(const ProfileGpuScope &) = delete;
+  ProfileGpuScope &operator=(const ProfileGpuScope &) = delete;
+
+  ~ProfileGpuScope() {
+    if (mSlot != Profiler::NO_GPU_SCOPE) {
+      Profiler::instance().endGpu(mSlot);
+    }
+  }
+
+private:
+  std::size_t mSlot;
+};
+
+#define GLEX_PROFILE_CONCAT_INNER(a, b) a##b
+#define GLEX_PROFILE_CONCAT(a, b) GLEX_PROFILE_CONCAT_INNER(a, b)
+
+#ifdef GLEX_DISABLE_PROFILER
+  #define GLEX_PROFILE_SCOPE(name)
+  #define GLEX_PROFILE_GPU_SCOPE(name)
+#else
+  #define GLEX_PROFILE_SCOPE(name) ProfileScope GLEX_PROFILE_CONCAT(profileScope, __LINE__){name}
+  #define GLEX_PROFILE_GPU_SCOPE(name) ProfileGpuScope GLEX_PROFILE_CONCAT(profileGpuScope, __LINE__){name}
+#endif
+
+#endif // PROFILER_H
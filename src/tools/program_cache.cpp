@@ -0,0 +1,229 @@
+// clang-format off
+#include "program_cache.h"
+#include "disk_cache.h"
+
+#include <GLFW/glfw3.h>
+#include <fmt/core.h>
+
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <system_error>
+#include <vector>
+// clang-format on
+
+// Only defined by GL 4.1 headers, or with ARB_get_program_binary.
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+namespace {
+
+// Header of our cache files, followed by the binary itself.
+struct FileHeader {
+  char magic[8];
+  std::uint32_t format;
+  std::uint32_t length;
+};
+
+constexpr char MAGIC[8] = {'G', 'L', 'E', 'X', 'P', 'B', '0', '1'};
+
+std::string glString(GLenum name) {
+  const auto *value = reinterpret_cast<const char *>(glGetString(name));
+  return value != nullptr ? value : "";
+}
+
+} // namespace
+
+// -------------------------
+// ProgramCache definitions.
+
+ProgramCache &ProgramCache::instance() {
+  static ProgramCache cache;
+  return cache;
+}
+
+bool ProgramCache::enabled() {
+  if (!mInitialized) {
+    initialize();
+  }
+  return mEnabled;
+}
+
+void ProgramCache::initialize() {
+  mInitialized = true;
+
+  mProgramBinary = reinterpret_cast<ProgramBinaryFn>(glfwGetProcAddress("glProgramBinary"));
+  mGetProgramBinary = reinterpret_cast<GetProgramBinaryFn>(glfwGetProcAddress("glGetProgramBinary"));
+  mProgramParameteri = reinterpret_cast<ProgramParameteriFn>(glfwGetProcAddress("glProgramParameteri"));
+
+  if (mProgramBinary == nullptr || mGetProgramBinary == nullptr || mProgramParameteri == nullptr) {
+    return;
+  }
+
+  // Drivers without the extension flag the query as an invalid enum.
+  GLint formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+  while (glGetError() != GL_NO_ERROR) {
+  }
+  if (formats <= 0) {
+    return;
+  }
+
+  const auto directory = cacheDirectory("GLEX_SHADER_CACHE", ".cache/shaders", "shader cache");
+  if (!directory) {
+    return;
+  }
+  mDirectory = *directory;
+
+  mDriverId = glString(GL_VENDOR) + '\n' + glString(GL_RENDERER) + '\n' + glString(GL_VERSION);
+  mEnabled = true;
+}
+
+ProgramCache::Key ProgramCache::makeKey(std::string_view vertexSource, std::string_view fragmentSource,
+                                        std::string_view defines) {
+  // Makes sure we know the driver.
+  if (!mInitialized) {
+    initialize();
+  }
+
+  // Separators keep e.g. ("ab", "c") and ("a", "bc") apart.
+  Key key = fnv1a(mDriverId);
+  for (std::string_view part : {vertexSource, fragmentSource, defines}) {
+    key = fnv1a(part, fnv1a("\x1f", key));
+  }
+  return key;
+}
+
+std::filesystem::path ProgramCache::pathFor(Key key) const { return mDirectory / fmt::format("{:016x}.bin", key); }
+
+GLuint ProgramCache::load(Key key) {
+  if (!enabled()) {
+    return 0;
+  }
+
+  const std::filesystem::path path = pathFor(key);
+  std::error_code error;
+  const std::uintmax_t fileSize = std::filesystem::file_size(path, error);
+  if (error) {
+    return 0;
+  }
+
+  std::ifstream file{path, std::ios::binary};
+  if (!file) {
+    return 0;
+  }
+
+  FileHeader header{};
+  file.read(reinterpret_cast<char *>(&header), sizeof(header));
+  if (!file || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+    return 0;
+  }
+
+  // A truncated or corrupt file mustn't make us allocate or read past it.
+  if (header.length == 0 || header.length != fileSize - sizeof(header)) {
+    std::filesystem::remove(path, error);
+    return 0;
+  }
+
+  std::vector<char> binary(header.length);
+  file.read(binary.data(), static_cast<std::streamsize>(binary.size()));
+  if (!file) {
+    return 0;
+  }
+
+  GLuint program = glCreateProgram();
+  mProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+  GLint linked = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if (linked != GL_TRUE) {
+    // The driver changed under us. Drop the stale binary; the caller
+    // compiles from source and stores a fresh one.
+    glDeleteProgram(program);
+    std::filesystem::remove(path, error);
+    return 0;
+  }
+
+  return program;
+}
+
+void ProgramCache::prepareForStore(GLuint program) {
+  if (enabled()) {
+    mProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+}
+
+void ProgramCache::store(Key key, GLuint program) {
+  if (!enabled()) {
+    return;
+  }
+
+  // Don't cache a failed link.
+  GLint linked = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if (linked != GL_TRUE) {
+    return;
+  }
+
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+
+  std::vector<char> binary(length);
+  GLenum format = 0;
+  mGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+  FileHeader header{};
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.format = format;
+  header.length = static_cast<std::uint32_t>(length);
+
+  // Write then rename, so a concurrent launch never reads half a file.
+  // The temporary name is our own, so launches storing the same program
+  // at once don't write into one file.
+  const std::filesystem::path path = pathFor(key);
+  std::filesystem::path temporary = path;
+  temporary += fmt::format(".{:08x}.tmp", std::random_device{}());
+
+  {
+    std::ofstream file{temporary, std::ios::binary | std::ios::trunc};
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(binary.data(), length);
+    if (!file) {
+      fmt::print("[shader cache] Failed to write {}\n", temporary.string());
+      file.close();
+      std::error_code error;
+      std::filesystem::remove(temporary, error);
+      return;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(temporary, path, error);
+  if (error) {
+    fmt::print("[shader cache] Failed to write {}: {}\n", path.string(), error.message());
+    std::filesystem::remove(temporary, error);
+  }
+}
+
+void ProgramCache::report(const std::string &label, bool hit, double milliseconds) {
+  if (hit) {
+    mStats.hits++;
+    mStats.hitMs += milliseconds;
+  } else {
+    mStats.misses++;
+    mStats.missMs += milliseconds;
+  }
+
+  fmt::print("[shader cache] {} {}: {:.2f} ms ({})\n", hit ? "loaded" : "compiled", label, milliseconds,
+             hit ? "binary" : enabled() ? "from source, stored" : "from source, cache off");
+}
@@ -0,0 +1,94 @@
+// On-disk cache of linked shader program binaries.
+//
+// Compiling and linking our programs from source on every launch is most
+// of our startup time on some drivers. Instead, after linking we save
+// glGetProgramBinary output under a key hashed from the program's
+// sources, its defines and the driver's vendor, renderer and version
+// strings, and on later launches load it back with glProgramBinary. The
+// driver can still reject a binary (say, after an update that kept the
+// version string); then load() fails and we compile from source as usual.
+//
+// Program binaries are core in GL 4.1 and an extension before that, so we
+// load the entry points ourselves and the cache disables itself if the
+// driver offers no binary formats. Set GLEX_SHADER_CACHE to a directory
+// to move the cache, or to "off" to disable it.
+
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include "glad/glad.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+// --------------
+// Program cache.
+
+class ProgramCache {
+public:
+  using Key = std::uint64_t;
+
+  struct Stats {
+    unsigned hits = 0;
+    unsigned misses = 0;
+    double hitMs = 0.0;
+    double missMs = 0.0;
+  };
+
+  static ProgramCache &instance();
+
+  ProgramCache(const ProgramCache &) = delete;
+  ProgramCache &operator=(const ProgramCache &) = delete;
+
+  // False if the driver can't give us binaries, or we're switched off.
+  // Needs a current GL context the first time.
+  [[nodiscard]] bool enabled();
+
+  // Hashes the program's sources and defines with the driver's identity.
+  Key makeKey(std::string_view vertexSource, std::string_view fragmentSource, std::string_view defines);
+
+  // Returns a linked program made from the cached binary for key, or 0 if
+  // there isn't one or the driver rejected it.
+  GLuint load(Key key);
+
+  // Call before linking a program we'll want to store.
+  void prepareForStore(GLuint program);
+
+  // Saves a linked program's binary under key. Failures only cost us the
+  // next warm start, so they're reported and otherwise ignored.
+  void store(Key key, GLuint program);
+
+  // Records and prints how long getting a program took, either way.
+  void report(const std::string &label, bool hit, double milliseconds);
+
+  [[nodiscard]] const Stats &stats() const { return mStats; }
+
+private:
+  ProgramCache() = default;
+
+  void initialize();
+
+  [[nodiscard]] std::filesystem::path pathFor(Key key) const;
+
+private:
+  using ProgramBinaryFn = void(APIENTRYP)(GLuint, GLenum, const void *, GLsizei);
+  using GetProgramBinaryFn = void(APIENTRYP)(GLuint, GLsizei, GLsizei *, GLenum *, void *);
+  using ProgramParameteriFn = void(APIENTRYP)(GLuint, GLenum, GLint);
+
+  bool mInitialized = false;
+  bool mEnabled = false;
+
+  ProgramBinaryFn mProgramBinary = nullptr;
+  GetProgramBinaryFn mGetProgramBinary = nullptr;
+  ProgramParameteriFn mProgramParameteri = nullptr;
+
+  // Vendor, renderer and version, hashed into every key.
+  std::string mDriverId;
+  std::filesystem::path mDirectory;
+
+  Stats mStats;
+};
+
+#endif // PROGRAM_CACHE_H
@@ -0,0 +1,192 @@
+// clang-format off
+#include "render_queue.h"
+#include "gl_state.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+// clang-format on
+
+namespace {
+
+constexpr unsigned int PASS_BITS = 2;
+constexpr unsigned int PROGRAM_BITS = 12;
+constexpr unsigned int TEXTURE_SET_BITS = 14;
+constexpr unsigned int VERTEX_ARRAY_BITS = 12;
+constexpr unsigned int DEPTH_BITS = 24;
+
+static_assert(PASS_BITS + PROGRAM_BITS + TEXTURE_SET_BITS + VERTEX_ARRAY_BITS + DEPTH_BITS == 64);
+
+// Opaque keys split depth around the VAO: 256 depth bands, then the VAO,
+// then depth within the band.
+constexpr unsigned int COARSE_DEPTH_BITS = 8;
+constexpr unsigned int FINE_DEPTH_BITS = DEPTH_BITS - COARSE_DEPTH_BITS;
+
+constexpr std::uint64_t mask(unsigned int bits) { return (std::uint64_t{1} << bits) - 1; }
+
+// Folds a packet's texture bindings into TEXTURE_SET_BITS. Collisions
+// only cost some sorting quality, never correctness.
+std::uint32_t textureSetId(std::span<const TextureBinding> textures) {
+  std::uint32_t hash = 2166136261u;
+  for (const auto &binding : textures) {
+    hash = (hash ^ binding.unit) * 16777619u;
+    hash = (hash ^ binding.texture) * 16777619u;
+  }
+  return static_cast<std::uint32_t>((hash ^ (hash >> TEXTURE_SET_BITS)) & mask(TEXTURE_SET_BITS));
+}
+
+struct SortEntry {
+  std::uint64_t key;
+  std::uint32_t index;
+};
+
+} // namespace
+
+// -----------------------
+// RenderQueue definitions.
+
+std::uint64_t RenderQueue::makeKey(RenderPass pass, GLuint program, std::uint32_t textureSet, GLuint vertexArray,
+                                   std::uint32_t depth) {
+  const std::uint64_t material =
+      ((program & mask(PROGRAM_BITS)) << TEXTURE_SET_BITS) | (textureSet & mask(TEXTURE_SET_BITS));
+  const std::uint64_t vao = vertexArray & mask(VERTEX_ARRAY_BITS);
+  const std::uint64_t passBits = static_cast<std::uint64_t>(pass) << (64 - PASS_BITS);
+  depth &= mask(DEPTH_BITS);
+
+  if (pass == RenderPass::Transparent) {
+    // Blending needs back-to-front order, so depth (inverted) comes first.
+    const std::uint64_t state = (material << VERTEX_ARRAY_BITS) | vao;
+    return passBits | ((mask(DEPTH_BITS) - depth) << (64 - PASS_BITS - DEPTH_BITS)) | state;
+  }
+
+  // Otherwise program and texture changes matter most. Within them we go
+  // front-to-back, so early depth testing rejects as much as possible,
+  // by coarse depth first: VAO binds are cheap next to overdraw, so
+  // draws sharing a VAO are only kept together within a depth band.
+  const std::uint64_t coarse = depth >> FINE_DEPTH_BITS;
+  const std::uint64_t fine = depth & mask(FINE_DEPTH_BITS);
+  return passBits | (material << (COARSE_DEPTH_BITS + VERTEX_ARRAY_BITS + FINE_DEPTH_BITS)) |
+         (coarse << (VERTEX_ARRAY_BITS + FINE_DEPTH_BITS)) | (vao << FINE_DEPTH_BITS) | fine;
+}
+
+std::uint32_t RenderQueue::quantizeDepth(const glm::vec3 &center) const {
+  // The camera looks down -z in view space.
+  float distance = -(mViewModel * glm::vec4(center, 1.0f)).z;
+  float normalized = std::clamp((distance - mNear) / (mFar - mNear), 0.0f, 1.0f);
+
+  return static_cast<std::uint32_t>(normalized * static_cast<float>(mask(DEPTH_BITS)));
+}
+
+void RenderQueue::submit(RenderPass pass, const DrawCall &call, const glm::vec3 &center,
+                         std::span<const TextureBinding> textures, std::span<const UniformValue> uniforms) {
+  if (mNumPackets == mPackets.size()) {
+    throw std::runtime_error("RenderQueue is full.");
+  }
+
+  DrawPacket &packet = mPackets[mNumPackets++];
+  packet.key = makeKey(pass, call.program, textureSetId(textures), call.vertexArray, quantizeDepth(center));
+  packet.call = call;
+
+  // Copy our bindings into the frame arena, since callers' storage may not outlive the frame.
+  auto *packetTextures = mArena.allocateArray<TextureBinding>(textures.size());
+  std::copy(textures.begin(), textures.end(), packetTextures);
+  packet.textures = packetTextures;
+  packet.numTextures = static_cast<std::uint8_t>(textures.size());
+
+  auto *packetUniforms = mArena.allocateArray<UniformValue>(uniforms.size());
+  std::copy(uniforms.begin(), uniforms.end(), packetUniforms);
+  packet.uniforms = packetUniforms;
+  packet.numUniforms = static_cast<std::uint8_t>(uniforms.size());
+}
+
+const std::uint32_t *RenderQueue::sortPackets() {
+  const std::size_t count = mNumPackets;
+
+  auto *entries = mArena.allocateArray<SortEntry>(count);
+  auto *scratch = mArena.allocateArray<SortEntry>(count);
+
+  for (std::size_t i = 0; i < count; i++) {
+    entries[i] = {mPackets[i].key, static_cast<std::uint32_t>(i)};
+  }
+
+  // LSD radix sort, one byte at a time. Stable, so equal keys keep
+  // their submission order.
+  for (unsigned int shift = 0; shift < 64; shift += 8) {
+    std::size_t offsets[256] = {};
+    for (std::size_t i = 0; i < count; i++) {
+      offsets[(entries[i].key >> shift) & 0xFF]++;
+    }
+
+    // Skip bytes that are the same in every key, which is most of them.
+    if (count == 0 || offsets[(entries[0].key >> shift) & 0xFF] == count) {
+      continue;
+    }
+
+    std::size_t total = 0;
+    for (auto &offset : offsets) {
+      std::size_t bucketSize = offset;
+      offset = total;
+      total += bucketSize;
+    }
+
+    for (std::size_t i = 0; i < count; i++) {
+      scratch[offsets[(entries[i].key >> shift) & 0xFF]++] = entries[i];
+    }
+    std::swap(entries, scratch);
+  }
+
+  auto *order = mArena.allocateArray<std::uint32_t>(count);
+  for (std::size_t i = 0; i < count; i++) {
+    order[i] = entries[i].index;
+  }
+
+  return order;
+}
+
+void RenderQueue::execute() {
+  GLEX_PROFILE_SCOPE("RenderQueue::execute");
+  GLEX_PROFILE_GPU_SCOPE("render");
+
+  const std::uint32_t *order = sortPackets();
+
+  mStats = {static_cast<std::uint32_t>(mNumPackets), 0};
+
+  GLStateCache &state = glState();
+
+  for (std::size_t i = 0; i < mNumPackets; i++) {
+    const DrawPacket &packet = mPackets[order[i]];
+    const DrawCall &call = packet.call;
+
+    state.useProgram(call.program);
+
+    for (std::uint8_t t = 0; t < packet.numTextures; t++) {
+      const TextureBinding &binding = packet.textures[t];
+      state.bindTexture(binding.unit, binding.target, binding.texture);
+    }
+
+    for (std::uint8_t u = 0; u < packet.numUniforms; u++) {
+      const UniformValue &uniform = packet.uniforms[u];
+
+      switch (uniform.type) {
+      case UniformValue::Type::Int:
+        glUniform1i(uniform.location, uniform.intValue);
+        break;
+      case UniformValue::Type::Vec4:
+        glUniform4fv(uniform.location, 1, uniform.vec4Value);
+        break;
+      }
+    }
+
+    state.bindVertexArray(call.vertexArray);
+
+    if (call.indexed) {
+      const auto offset = static_cast<std::uintptr_t>(call.first) * sizeof(GLuint);
+      glDrawElements(call.mode, call.count, GL_UNSIGNED_INT, reinterpret_cast<const void *>(offset));
+    } else {
+      glDrawArrays(call.mode, call.first, call.count);
+    }
+
+    mStats.draws++;
+  }
+}
@@ -0,0 +1,152 @@
+// Render queue that decouples recording draws from submitting them to GL.
+//
+// Drawables submit compact packets, each with a 64-bit sort key encoding
+// its pass, program, texture set, VAO and quantized depth. Opaque draws
+// sort front-to-back within a program and texture set, transparent ones
+// back-to-front before anything else. execute()
+// radix-sorts the keys and issues every packet in one loop, so draws
+// sharing state end up next to each other and the state cache can skip
+// most of the binds between them.
+//
+// Recording is allocation-free: packets live in a buffer sized once at
+// construction, and their textures and uniforms are copied into a
+// per-frame arena.
+
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include "glad/glad.h"
+
+#include <glm/glm.hpp>
+#include <tools/frame_arena.h>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// -------------
+// Packet parts.
+
+// Passes run in this order.
+enum class RenderPass : std::uint8_t {
+  Opaque = 0,
+  Transparent = 1,
+  Overlay = 2,
+};
+
+struct TextureBinding {
+  GLuint unit;
+  GLenum target;
+  GLuint texture;
+};
+
+// A uniform to set before a draw, for the program of its packet.
+struct UniformValue {
+  enum class Type : std::uint8_t { Int, Vec4 };
+
+  GLint location;
+  Type type;
+  union {
+    int intValue;
+    float vec4Value[4];
+  };
+
+  static UniformValue makeInt(GLint location, int value) {
+    UniformValue uniform{location, Type::Int, {}};
+    uniform.intValue = value;
+    return uniform;
+  }
+
+  static UniformValue makeVec4(GLint location, const glm::vec4 &value) {
+    UniformValue uniform{location, Type::Vec4, {}};
+    for (int i = 0; i < 4; i++) {
+      uniform.vec4Value[i] = value[i];
+    }
+    return uniform;
+  }
+};
+
+// What to draw; for indexed draws first is an offset in indices.
+struct DrawCall {
+  GLuint program;
+  GLuint vertexArray;
+  GLenum mode;
+  GLint first;
+  GLsizei count;
+  bool indexed;
+};
+
+struct DrawPacket {
+  std::uint64_t key;
+  DrawCall call;
+  const TextureBinding *textures;
+  const UniformValue *uniforms;
+  std::uint8_t numTextures;
+  std::uint8_t numUniforms;
+};
+
+// -------------
+// Render queue.
+
+class RenderQueue {
+public:
+  struct Stats {
+    std::uint32_t packets = 0;
+    std::uint32_t draws = 0;
+  };
+
+  static constexpr std::size_t DEFAULT_MAX_PACKETS = 4096;
+  static constexpr std::size_t DEFAULT_ARENA_BYTES = 1 << 20;
+
+  explicit RenderQueue(std::size_t maxPackets = DEFAULT_MAX_PACKETS, std::size_t arenaBytes = DEFAULT_ARENA_BYTES)
+      : mPackets(maxPackets), mArena(arenaBytes) {}
+
+  // Starts recording a new frame. Depths are measured in the space given by
+  // viewModel, and quantized over the [near, far] range of the projection.
+  void reset(const glm::mat4 &viewModel, float near, float far) {
+    mNumPackets = 0;
+    mArena.reset();
+    mViewModel = viewModel;
+    mNear = near;
+    mFar = far;
+  }
+
+  /// Records a draw. Depth is taken at a point in model coordinates,
+  /// typically the drawable's center. Throws if the queue is full.
+  void submit(RenderPass pass, const DrawCall &call, const glm::vec3 &center,
+              std::span<const TextureBinding> textures = {}, std::span<const UniformValue> uniforms = {});
+
+  // Sorts the recorded packets and issues them.
+  void execute();
+
+  [[nodiscard]] const Stats &stats() const { return mStats; }
+  [[nodiscard]] const FrameArena &arena() const { return mArena; }
+  // For this frame's transient draw data, e.g. in std::pmr containers;
+  // freed by the next reset().
+  FrameArena &arena() { return mArena; }
+
+  // Exposed for inspection and testing.
+  static std::uint64_t makeKey(RenderPass pass, GLuint program, std::uint32_t textureSet, GLuint vertexArray,
+                               std::uint32_t depth);
+
+private:
+  // Depth in [0, 2^DEPTH_BITS), increasing away from the camera.
+  [[nodiscard]] std::uint32_t quantizeDepth(const glm::vec3 &center) const;
+
+  // Returns packet indices in key order; the result lives in the arena.
+  const std::uint32_t *sortPackets();
+
+private:
+  std::vector<DrawPacket> mPackets;
+  std::size_t mNumPackets = 0;
+
+  FrameArena mArena;
+
+  glm::mat4 mViewModel{1.0f};
+  float mNear = 0.1f;
+  float mFar = 100.0f;
+
+  Stats mStats;
+};
+
+#endif // RENDER_QUEUE_H
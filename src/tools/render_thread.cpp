@@ -0,0 +1,108 @@
+// clang-format off
+#include "glad/glad.h"
+
+#include "render_thread.h"
+
+#include <algorithm>
+#include <utility>
+// clang-format on
+
+// --------------------------
+// RenderThread definitions.
+
+RenderThread::RenderThread(GLFWWrapper &window, FrameLoop &frameLoop) : mWindow(window), mFrameLoop(frameLoop) {}
+
+RenderThread::~RenderThread() {
+  if (mThread.joinable()) {
+    // Errors were ours to report from stop(); here we only clean up.
+    try {
+      stop();
+    } catch (...) {
+    }
+  }
+}
+
+void RenderThread::start(FrameFunction renderFrame) {
+  mRenderFrame = std::move(renderFrame);
+
+  // A context can only be current on one thread at a time.
+  mWindow.makeContextCurrent(false);
+  mThread = std::thread([this]() { run(); });
+}
+
+void RenderThread::pushInput(const InputSnapshot &input) {
+  mPendingInput.merge(input);
+
+  if (mPendingInput.empty()) {
+    return;
+  }
+
+  if (mInputQueue.tryPush(mPendingInput)) {
+    mPendingInput = {};
+  } else {
+    // Keep it, and try again with the next input.
+    mLatency.queueFull++;
+  }
+
+  // Requested after the push, so the frame it wakes will see the input.
+  mFrameLoop.requestRedraw();
+}
+
+void RenderThread::stop() {
+  if (!mThread.joinable()) {
+    return;
+  }
+
+  mStopRequested.store(true, std::memory_order_release);
+  // Wake the render thread if it's idle, waiting for a redraw.
+  mFrameLoop.requestRedraw();
+
+  mThread.join();
+  mWindow.makeContextCurrent();
+
+  if (mError) {
+    std::rethrow_exception(std::exchange(mError, nullptr));
+  }
+}
+
+void RenderThread::run() {
+  mWindow.makeContextCurrent();
+
+  try {
+    while (!mStopRequested.load(std::memory_order_acquire)) {
+      mFrameLoop.awaitRedrawRequest();
+      if (mStopRequested.load(std::memory_order_acquire)) {
+        break;
+      }
+
+      // Everything that arrived since last frame, applied at once.
+      InputSnapshot input;
+      InputSnapshot next;
+      while (mInputQueue.tryPop(next)) {
+        input.merge(next);
+      }
+
+      mRenderFrame(input);
+
+      if (!input.empty()) {
+        const double latencyMs = (glfwGetTime() - input.firstEventTime) * 1000.0;
+
+        mLatency.frames++;
+        mLatency.events += input.eventCount;
+        mLatency.lastMs = latencyMs;
+        mLatency.maxMs = std::max(mLatency.maxMs, latencyMs);
+        mLatencyTotalMs += latencyMs;
+        mLatency.meanMs = mLatencyTotalMs / static_cast<double>(mLatency.frames);
+      }
+    }
+  } catch (...) {
+    mError = std::current_exception();
+    mFailed.store(true, std::memory_order_release);
+    // Wake the event thread, so it notices.
+    glfwPostEmptyEvent();
+  }
+
+  // Make sure our last commands are done before handing the context back.
+  glFinish();
+  mWindow.makeContextCurrent(false);
+}
@@ -0,0 +1,101 @@
+// Runs rendering on a thread of its own.
+//
+// GLFW has to handle events on the main thread, so with a render thread
+// the main thread does nothing else: it pumps events and hands the input
+// they produce to the render thread through a lock-free queue. The render
+// thread owns the GL context, and each frame merges whatever input has
+// arrived, applies it, and draws. A stall while drawing (say, regenerating
+// a mesh) then no longer holds up event handling.
+//
+// Shutdown: stop() raises a flag and wakes the render thread, which
+// finishes its current frame, releases the context and exits. Once it's
+// joined the context is made current on the calling thread again, so GL
+// objects can be destroyed there as usual.
+//
+// For each frame that applied input we also measure latency, from the
+// first of its events arriving to the frame's buffer swap returning.
+
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include <tools/frame_loop.h>
+#include <tools/glfw_wrapper.h>
+#include <tools/input_state.h>
+#include <tools/spsc_queue.h>
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <thread>
+
+// --------------
+// Render thread.
+
+class RenderThread {
+public:
+  // Draws and presents one frame, after applying its input.
+  using FrameFunction = std::function<void(const InputSnapshot &input)>;
+
+  struct LatencyStats {
+    // Frames that applied input, and input events they applied.
+    std::uint64_t frames = 0;
+    std::uint64_t events = 0;
+    double lastMs = 0.0;
+    double meanMs = 0.0;
+    double maxMs = 0.0;
+    // Times the queue was full and input waited for the next push.
+    std::uint64_t queueFull = 0;
+  };
+
+  RenderThread(GLFWWrapper &window, FrameLoop &frameLoop);
+
+  RenderThread(const RenderThread &) = delete;
+  RenderThread &operator=(const RenderThread &) = delete;
+
+  // Stops the thread if it's still running.
+  ~RenderThread();
+
+  // Releases the context on this thread and starts rendering frames.
+  void start(FrameFunction renderFrame);
+
+  // Event thread: hands input to the render thread and requests a redraw.
+  void pushInput(const InputSnapshot &input);
+
+  // True once the render thread has exited with an error.
+  [[nodiscard]] bool failed() const { return mFailed.load(std::memory_order_acquire); }
+
+  // Shuts the render thread down as described above, and rethrows any
+  // exception it exited with.
+  void stop();
+
+  // Read only after stop().
+  [[nodiscard]] const LatencyStats &latency() const { return mLatency; }
+
+private:
+  void run();
+
+private:
+  // Snapshots in flight. The render thread drains all of them each frame,
+  // so this only fills if it stalls for a long time.
+  static constexpr std::size_t INPUT_QUEUE_SIZE = 64;
+
+  GLFWWrapper &mWindow;
+  FrameLoop &mFrameLoop;
+  FrameFunction mRenderFrame;
+
+  SpscQueue<InputSnapshot, INPUT_QUEUE_SIZE> mInputQueue;
+  // Event thread only: input that didn't fit in the queue yet.
+  InputSnapshot mPendingInput;
+
+  std::thread mThread;
+  std::atomic<bool> mStopRequested = false;
+  std::atomic<bool> mFailed = false;
+  std::exception_ptr mError;
+
+  // Written by the render thread, except queueFull by the event thread.
+  LatencyStats mLatency;
+  double mLatencyTotalMs = 0.0;
+};
+
+#endif // RENDER_THREAD_H
@@ -0,0 +1,183 @@
+// clang-format off
+#include "shader_batch.h"
+
+#include "tools/helpers.h"
+
+#include <GLFW/glfw3.h>
+#include <fmt/core.h>
+
+#include <utility>
+// clang-format on
+
+// Only defined with KHR_parallel_shader_compile.
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// -------------------------
+// ShaderBatch definitions.
+
+bool ShaderBatch::parallelCompileSupported() {
+  static const bool supported =
+      hasExtension("GL_KHR_parallel_shader_compile") || hasExtension("GL_ARB_parallel_shader_compile");
+  return supported;
+}
+
+ShaderBatch::ShaderBatch() : mParallel(parallelCompileSupported()) {
+  if (!mParallel) {
+    return;
+  }
+
+  // Let the driver pick how many threads to use.
+  using MaxThreadsFn = void(APIENTRYP)(GLuint);
+  auto maxThreads = reinterpret_cast<MaxThreadsFn>(glfwGetProcAddress("glMaxShaderCompilerThreadsKHR"));
+  if (maxThreads == nullptr) {
+    maxThreads = reinterpret_cast<MaxThreadsFn>(glfwGetProcAddress("glMaxShaderCompilerThreadsARB"));
+  }
+  if (maxThreads != nullptr) {
+    maxThreads(0xFFFFFFFF);
+  }
+}
+
+ShaderBatch::Handle ShaderBatch::add(std::string label, std::string vertexCode, std::string fragmentCode,
+                                     std::string defines) {
+  Entry entry;
+  entry.label = std::move(label);
+  entry.vertexCode = std::move(vertexCode);
+  entry.fragmentCode = std::move(fragmentCode);
+  entry.defines = std::move(defines);
+
+  mEntries.push_back(std::move(entry));
+  return mEntries.size() - 1;
+}
+
+void ShaderBatch::submit() {
+  // Time from when the batch was last idle.
+  if (mFinished == mSubmitted) {
+    mSubmitTime = Clock::now();
+  }
+
+  ProgramCache &cache = ProgramCache::instance();
+
+  // Compiles first, cached programs aside...
+  for (Entry &entry : mEntries) {
+    if (entry.submitted) {
+      continue;
+    }
+
+    entry.key = cache.makeKey(entry.vertexCode, entry.fragmentCode, entry.defines);
+    entry.program = cache.load(entry.key);
+    entry.cached = entry.program != 0;
+    if (entry.cached) {
+      continue;
+    }
+
+    const char *vertexCode = entry.vertexCode.c_str();
+    entry.vertex = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(entry.vertex, 1, &vertexCode, nullptr);
+    glCompileShader(entry.vertex);
+
+    const char *fragmentCode = entry.fragmentCode.c_str();
+    entry.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(entry.fragment, 1, &fragmentCode, nullptr);
+    glCompileShader(entry.fragment);
+  }
+
+  // ...then links, which the driver queues behind their compiles.
+  for (Entry &entry : mEntries) {
+    if (entry.submitted) {
+      continue;
+    }
+    entry.submitted = true;
+    mSubmitted++;
+
+    if (entry.cached) {
+      continue;
+    }
+
+    entry.program = glCreateProgram();
+    glAttachShader(entry.program, entry.vertex);
+    glAttachShader(entry.program, entry.fragment);
+    cache.prepareForStore(entry.program);
+    glLinkProgram(entry.program);
+  }
+}
+
+bool ShaderBatch::isReady(const Entry &entry) const {
+  if (entry.cached || !mParallel) {
+    return true;
+  }
+
+  GLint complete = GL_FALSE;
+  glGetProgramiv(entry.program, GL_COMPLETION_STATUS_KHR, &complete);
+  return complete == GL_TRUE;
+}
+
+bool ShaderBatch::poll() {
+  for (Entry &entry : mEntries) {
+    if (!entry.submitted || entry.shader || !isReady(entry)) {
+      continue;
+    }
+
+    complete(entry);
+
+    // Without completion queries, each one we finish may block.
+    if (!mParallel) {
+      break;
+    }
+  }
+
+  return done();
+}
+
+void ShaderBatch::finish() {
+  // Anything still queued goes out first.
+  submit();
+
+  for (Entry &entry : mEntries) {
+    if (entry.submitted && !entry.shader) {
+      complete(entry);
+    }
+  }
+}
+
+void ShaderBatch::complete(Entry &entry) {
+  ProgramCache &cache = ProgramCache::instance();
+
+  if (!entry.cached) {
+    // Only now do we ask for results, once the driver is done anyway.
+    if (auto error = checkProgramLink(entry.program); error) {
+      for (auto [shader, stage] : {std::pair{entry.vertex, "VERTEX"}, std::pair{entry.fragment, "FRAGMENT"}}) {
+        if (auto compileError = checkShaderCompile(shader); compileError) {
+          fmt::print("ERROR::SHADER_COMPILATION_ERROR of type: {} in {}\n{}\n", stage, entry.label,
+                     compileError.value());
+        }
+      }
+      fmt::print("ERROR::PROGRAM_LINKING_ERROR in {}\n{}\n", entry.label, error.value());
+    } else {
+      cache.store(entry.key, entry.program);
+    }
+
+    glDeleteShader(entry.vertex);
+    glDeleteShader(entry.fragment);
+  }
+
+  entry.shader = std::make_shared<Shader>(entry.program);
+
+  // Sources aren't needed any more.
+  entry.vertexCode = {};
+  entry.fragmentCode = {};
+
+  mFinished++;
+  const std::chrono::duration<double, std::milli> elapsed = Clock::now() - mSubmitTime;
+  cache.report(entry.label, entry.cached, elapsed.count());
+
+  if (done()) {
+    mWallMs = elapsed.count();
+    fmt::print("[shader batch] {} programs ready in {:.2f} ms (parallel compile {})\n", mEntries.size(), mWallMs,
+               mParallel ? "on" : "unavailable");
+  }
+}
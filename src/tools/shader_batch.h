@@ -0,0 +1,96 @@
+// Compiles a batch of shader programs together, without waiting on each.
+//
+// Checking a shader's compile status right after glCompileShader forces
+// the driver to finish that compile before we can issue the next, so we
+// issue every compile, then every link, and only then look at results.
+// Where the driver has KHR_parallel_shader_compile (or the ARB version)
+// it compiles on its own threads and poll() asks GL_COMPLETION_STATUS_KHR
+// which programs are done, never blocking; the app can keep rendering
+// (or loading) meanwhile. Without it, poll() finishes one program per
+// call, which blocks on that program only.
+//
+// Programs found in the ProgramCache skip compiling entirely, and newly
+// linked ones are stored there.
+
+#ifndef SHADER_BATCH_H
+#define SHADER_BATCH_H
+
+#include "glad/glad.h"
+
+#include <learnopengl/shader_m.h>
+#include <tools/program_cache.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+// -------------
+// Shader batch.
+
+class ShaderBatch {
+public:
+  using Handle = std::size_t;
+  using Clock = std::chrono::steady_clock;
+
+  // Turns on the driver's compiler threads, if it has them.
+  ShaderBatch();
+
+  ShaderBatch(const ShaderBatch &) = delete;
+  ShaderBatch &operator=(const ShaderBatch &) = delete;
+
+  // Queues a program, from preprocessed code, for the next submit().
+  Handle add(std::string label, std::string vertexCode, std::string fragmentCode, std::string defines = "");
+
+  // Issues every queued compile, then every link, without waiting.
+  void submit();
+
+  // Finishes programs the driver is done with. Returns true once all are.
+  bool poll();
+
+  // Submits anything still queued, then blocks until every program is finished.
+  void finish();
+
+  // The finished program for handle, or null if it isn't finished yet. As
+  // with Shader, a program that failed to build has had its errors printed.
+  [[nodiscard]] std::shared_ptr<Shader> get(Handle handle) const { return mEntries[handle].shader; }
+
+  [[nodiscard]] bool done() const { return mFinished == mEntries.size(); }
+
+  // From submit() until the last program finished.
+  [[nodiscard]] double wallMs() const { return mWallMs; }
+
+  [[nodiscard]] static bool parallelCompileSupported();
+
+private:
+  struct Entry {
+    std::string label;
+    std::string vertexCode;
+    std::string fragmentCode;
+    std::string defines;
+
+    ProgramCache::Key key = 0;
+    GLuint vertex = 0;
+    GLuint fragment = 0;
+    GLuint program = 0;
+    bool cached = false;
+    bool submitted = false;
+
+    std::shared_ptr<Shader> shader;
+  };
+
+  [[nodiscard]] bool isReady(const Entry &entry) const;
+  void complete(Entry &entry);
+
+private:
+  std::vector<Entry> mEntries;
+  std::size_t mSubmitted = 0;
+  std::size_t mFinished = 0;
+
+  bool mParallel = false;
+
+  Clock::time_point mSubmitTime;
+  double mWallMs = 0.0;
+};
+
+#endif // SHADER_BATCH_H
@@ -0,0 +1,132 @@
+// clang-format off
+#include "shader_preprocessor.h"
+
+#include <fmt/core.h>
+#include <learnopengl/filesystem.h>
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+// clang-format on
+
+namespace {
+
+std::string_view trimStart(std::string_view line) {
+  const auto start = line.find_first_not_of(" \t");
+  return start == std::string_view::npos ? std::string_view{} : line.substr(start);
+}
+
+// Returns the quoted file name if line is an #include directive.
+bool parseInclude(std::string_view line, std::string &name) {
+  line = trimStart(line);
+  if (!line.starts_with("#")) {
+    return false;
+  }
+  line = trimStart(line.substr(1));
+  if (!line.starts_with("include")) {
+    return false;
+  }
+
+  const auto open = line.find('"');
+  const auto close = open == std::string_view::npos ? open : line.find('"', open + 1);
+  if (close == std::string_view::npos) {
+    throw std::runtime_error(fmt::format("Malformed shader include: {}", line));
+  }
+
+  name = line.substr(open + 1, close - open - 1);
+  return true;
+}
+
+bool isVersion(std::string_view line) { return trimStart(line).starts_with("#version"); }
+
+} // namespace
+
+// --------------------------------
+// ShaderPreprocessor definitions.
+
+PreprocessedSource ShaderPreprocessor::process(const std::filesystem::path &path, const std::string &defines) {
+  ShaderPreprocessor preprocessor;
+  preprocessor.append(path, defines, 0);
+
+  return std::move(preprocessor.mResult);
+}
+
+std::filesystem::path ShaderPreprocessor::sharedIncludeDirectory() {
+  static const std::filesystem::path directory = FileSystem::getPath("src/shaders");
+  return directory;
+}
+
+std::filesystem::path ShaderPreprocessor::resolveInclude(const std::filesystem::path &includer,
+                                                         const std::string &name) const {
+  for (const auto &directory : {includer.parent_path(), sharedIncludeDirectory()}) {
+    std::filesystem::path candidate = directory / name;
+    if (std::filesystem::exists(candidate)) {
+      return candidate;
+    }
+  }
+
+  throw std::runtime_error(fmt::format("Can't find shader include \"{}\" from {}", name, includer.string()));
+}
+
+void ShaderPreprocessor::append(const std::filesystem::path &path, const std::string &defines, int depth) {
+  if (depth > MAX_INCLUDE_DEPTH) {
+    throw std::runtime_error(fmt::format("Shader includes nested too deeply at {}", path.string()));
+  }
+
+  const std::filesystem::path file = std::filesystem::weakly_canonical(path);
+
+  // Include each file once.
+  auto &files = mResult.files;
+  if (std::find(files.begin(), files.end(), file) != files.end()) {
+    return;
+  }
+  const auto index = files.size();
+  files.push_back(file);
+
+  std::ifstream stream{file};
+  if (!stream) {
+    throw std::runtime_error(fmt::format("Can't read shader file {}", file.string()));
+  }
+
+  std::string &code = mResult.code;
+  if (depth > 0) {
+    code += fmt::format("#line 1 {}\n", index);
+  }
+
+  std::string line;
+  std::string includeName;
+  int lineNumber = 0;
+  bool definesPending = depth == 0;
+
+  while (std::getline(stream, line)) {
+    lineNumber++;
+
+    if (isVersion(line)) {
+      // Only meaningful at the very top of the outermost file.
+      if (depth == 0) {
+        code += line + '\n';
+      }
+      continue;
+    }
+
+    if (definesPending) {
+      code += defines;
+      code += fmt::format("#line {} {}\n", lineNumber, index);
+      definesPending = false;
+    }
+
+    if (parseInclude(line, includeName)) {
+      append(resolveInclude(file, includeName), "", depth + 1);
+      // Back to numbering our own lines.
+      code += fmt::format("#line {} {}\n", lineNumber + 1, index);
+      continue;
+    }
+
+    code += line + '\n';
+  }
+
+  if (definesPending) {
+    code += defines;
+  }
+}
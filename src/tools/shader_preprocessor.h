@@ -0,0 +1,58 @@
+// Preprocessing for our GLSL sources, before they reach the driver.
+//
+// GLSL has no #include, so shared pieces (like the Camera uniform block)
+// used to be copied into every shader. We resolve `#include "file"`
+// ourselves: relative to the including file first, then in src/shaders.
+// Each file is included at most once per source, as if it had
+// `#pragma once`. Feature defines are injected right after the #version
+// line, which has to stay first.
+//
+// We emit `#line` directives with a file index as the source string
+// number, so driver errors like "1(12)" can be traced back through
+// files().
+
+#ifndef SHADER_PREPROCESSOR_H
+#define SHADER_PREPROCESSOR_H
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// ---------------------
+// Preprocessed sources.
+
+struct PreprocessedSource {
+  std::string code;
+  // Files that went into code, indexed by #line source string number.
+  std::vector<std::filesystem::path> files;
+};
+
+// --------------------
+// Shader preprocessor.
+
+class ShaderPreprocessor {
+public:
+  // Reads path and everything it includes, putting defines (complete
+  // "#define NAME" lines) after its #version line. Throws
+  // std::runtime_error if a file can't be read.
+  static PreprocessedSource process(const std::filesystem::path &path, const std::string &defines = "");
+
+  // Directory searched for includes not found next to the includer.
+  static std::filesystem::path sharedIncludeDirectory();
+
+private:
+  ShaderPreprocessor() = default;
+
+  void append(const std::filesystem::path &path, const std::string &defines, int depth);
+
+  [[nodiscard]] std::filesystem::path resolveInclude(const std::filesystem::path &includer,
+                                                     const std::string &name) const;
+
+private:
+  // Deeper than this is surely a cycle our include-once check missed.
+  static constexpr int MAX_INCLUDE_DEPTH = 16;
+
+  PreprocessedSource mResult;
+};
+
+#endif // SHADER_PREPROCESSOR_H
@@ -0,0 +1,162 @@
+// Lazily compiled permutations of one vertex/fragment shader pair.
+//
+// Rather than keep a copy of a shader for each combination of features,
+// the sources use `#ifdef FEATURE` blocks, and we compile a variant with
+// the matching defines the first time someone asks for that combination.
+// Variants are memoized by feature bitmask, so we only ever pay for the
+// combinations we actually draw with.
+//
+// Variants can also be requested ahead of time into a ShaderBatch, so
+// they compile alongside other work; get() collects them, waiting if it
+// must, and tryGet() only once they're done.
+
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <learnopengl/shader_m.h>
+#include <tools/shader_batch.h>
+#include <tools/shader_preprocessor.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// ----------------
+// Shader variants.
+
+class ShaderVariants {
+public:
+  // Bit i of a mask turns on features[i].
+  using FeatureMask = std::uint32_t;
+  // Run once on each new variant, e.g. to attach uniform blocks.
+  using SetupFunction = std::function<void(const Shader &)>;
+
+  ShaderVariants(std::filesystem::path vertexPath, std::filesystem::path fragmentPath,
+                 std::vector<std::string> features, SetupFunction setup = {})
+      : mVertexPath(std::move(vertexPath)), mFragmentPath(std::move(fragmentPath)), mFeatures(std::move(features)),
+        mSetup(std::move(setup)) {
+    if (mFeatures.size() > 8 * sizeof(FeatureMask)) {
+      throw std::runtime_error("Too many shader features for our mask");
+    }
+  }
+
+  // Returns the variant for mask, compiling it on first use, or finishing
+  // its batch if it was requested. Throws std::runtime_error if its
+  // sources can't be read.
+  std::shared_ptr<Shader> get(FeatureMask mask) {
+    if (auto it = mVariants.find(mask); it != mVariants.end()) {
+      return it->second;
+    }
+
+    if (auto it = mRequested.find(mask); it != mRequested.end()) {
+      auto [batch, handle] = it->second;
+      mRequested.erase(it);
+      batch->finish();
+      return adopt(mask, batch->get(handle));
+    }
+
+    const std::string defines = definesFor(mask);
+    const PreprocessedSource vertex = ShaderPreprocessor::process(mVertexPath, defines);
+    const PreprocessedSource fragment = ShaderPreprocessor::process(mFragmentPath, defines);
+
+    return adopt(mask, std::make_shared<Shader>(vertex.code, fragment.code, labelFor(mask), defines));
+  }
+
+  // As get(), but for a requested variant, polls its batch rather than
+  // finishing it, and returns null until the driver is done with it. Call
+  // it once a frame to pick the variant up without stalling.
+  std::shared_ptr<Shader> tryGet(FeatureMask mask) {
+    auto it = mRequested.find(mask);
+    if (it == mRequested.end()) {
+      return get(mask);
+    }
+
+    auto [batch, handle] = it->second;
+    batch->poll();
+    std::shared_ptr<Shader> shader = batch->get(handle);
+    if (!shader) {
+      return nullptr;
+    }
+
+    mRequested.erase(it);
+    return adopt(mask, std::move(shader));
+  }
+
+  // Queues the variant for mask in batch, unless we have it already. The
+  // batch must outlive our get() for it.
+  void request(FeatureMask mask, ShaderBatch &batch) {
+    if (mVariants.contains(mask) || mRequested.contains(mask)) {
+      return;
+    }
+
+    const std::string defines = definesFor(mask);
+    const PreprocessedSource vertex = ShaderPreprocessor::process(mVertexPath, defines);
+    const PreprocessedSource fragment = ShaderPreprocessor::process(mFragmentPath, defines);
+
+    mRequested.emplace(mask, std::pair{&batch, batch.add(labelFor(mask), vertex.code, fragment.code, defines)});
+  }
+
+  // Mask with just the named feature set.
+  [[nodiscard]] FeatureMask feature(const std::string &name) const {
+    for (std::size_t i = 0; i < mFeatures.size(); i++) {
+      if (mFeatures[i] == name) {
+        return FeatureMask{1} << i;
+      }
+    }
+    throw std::runtime_error("Unknown shader feature " + name);
+  }
+
+  [[nodiscard]] std::size_t compiledCount() const { return mVariants.size(); }
+
+private:
+  // Finishes a newly built variant and remembers it.
+  std::shared_ptr<Shader> adopt(FeatureMask mask, std::shared_ptr<Shader> shader) {
+    // So a ShaderWatcher can rebuild it.
+    shader->setSources({mVertexPath, mFragmentPath, definesFor(mask)});
+
+    if (mSetup) {
+      mSetup(*shader);
+    }
+
+    mVariants.emplace(mask, shader);
+    return shader;
+  }
+
+  [[nodiscard]] std::string definesFor(FeatureMask mask) const {
+    std::string defines;
+    for (std::size_t i = 0; i < mFeatures.size(); i++) {
+      if (mask & (FeatureMask{1} << i)) {
+        defines += "#define " + mFeatures[i] + "\n";
+      }
+    }
+    return defines;
+  }
+
+  [[nodiscard]] std::string labelFor(FeatureMask mask) const {
+    std::string label = mVertexPath.stem().string();
+    for (std::size_t i = 0; i < mFeatures.size(); i++) {
+      if (mask & (FeatureMask{1} << i)) {
+        label += " +" + mFeatures[i];
+      }
+    }
+    return label;
+  }
+
+private:
+  std::filesystem::path mVertexPath;
+  std::filesystem::path mFragmentPath;
+  std::vector<std::string> mFeatures;
+  SetupFunction mSetup;
+
+  std::unordered_map<FeatureMask, std::shared_ptr<Shader>> mVariants;
+  // Variants queued in a batch, not yet collected.
+  std::unordered_map<FeatureMask, std::pair<ShaderBatch *, ShaderBatch::Handle>> mRequested;
+};
+
+#endif // SHADER_VARIANTS_H
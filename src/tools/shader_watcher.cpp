@@ -0,0 +1,375 @@
+// clang-format off
+#include "shader_watcher.h"
+
+#include "tools/shader_preprocessor.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <optional>
+#include <regex>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+// clang-format on
+
+namespace {
+
+// Where we are in preprocessed code, going by its #line directives.
+struct SourceLocation {
+  std::size_t file = 0;
+  int line = 1;
+};
+
+std::string describe(const PreprocessedSource &source, SourceLocation location) {
+  const std::string file =
+      location.file < source.files.size() ? source.files[location.file].filename().string() : "?";
+  return fmt::format("{}:{}", file, location.line);
+}
+
+// The checks we can make without a compiler: main() is there, and
+// brackets outside comments pair up. Returns the first problem found.
+std::optional<std::string> checkSource(const PreprocessedSource &source) {
+  static const std::regex mainPattern{R"(\bvoid\s+main\s*\()"};
+  if (!std::regex_search(source.code, mainPattern)) {
+    return fmt::format("{} has no main()", source.files.empty() ? "?" : source.files.front().filename().string());
+  }
+
+  struct Open {
+    char bracket;
+    SourceLocation location;
+  };
+  std::vector<Open> open;
+
+  SourceLocation location;
+  bool inBlockComment = false;
+  std::string_view code = source.code;
+
+  while (!code.empty()) {
+    const auto end = code.find('\n');
+    const std::string_view line = code.substr(0, end);
+    code = end == std::string_view::npos ? std::string_view{} : code.substr(end + 1);
+
+    // "#line N F" numbers the line after it.
+    if (!inBlockComment && line.starts_with("#line ")) {
+      int number = 0;
+      std::size_t file = 0;
+      const char *first = line.data() + 6;
+      const char *last = line.data() + line.size();
+      auto result = std::from_chars(first, last, number);
+      if (result.ec == std::errc{} && result.ptr < last) {
+        std::from_chars(result.ptr + 1, last, file);
+      }
+      location = {file, number};
+      continue;
+    }
+
+    for (std::size_t i = 0; i < line.size(); i++) {
+      if (inBlockComment) {
+        if (line.compare(i, 2, "*/") == 0) {
+          inBlockComment = false;
+          i++;
+        }
+        continue;
+      }
+      if (line.compare(i, 2, "//") == 0) {
+        break;
+      }
+      if (line.compare(i, 2, "/*") == 0) {
+        inBlockComment = true;
+        i++;
+        continue;
+      }
+
+      const char c = line[i];
+      if (c == '{' || c == '(' || c == '[') {
+        open.push_back({c, location});
+      } else if (c == '}' || c == ')' || c == ']') {
+        const char expected = c == '}' ? '{' : c == ')' ? '(' : '[';
+        if (open.empty() || open.back().bracket != expected) {
+          return fmt::format("{}: unmatched '{}'", describe(source, location), c);
+        }
+        open.pop_back();
+      }
+    }
+
+    location.line++;
+  }
+
+  if (!open.empty()) {
+    return fmt::format("{}: '{}' is never closed", describe(source, open.back().location), open.back().bracket);
+  }
+  return std::nullopt;
+}
+
+// "model_viewer_assimp.vs + .fs [TEXTURE_ARRAY]" and the like.
+std::string labelFor(const Shader::Sources &sources) {
+  std::string label = sources.vertexPath.filename().string() + " + " + sources.fragmentPath.filename().string();
+
+  std::string features;
+  std::string_view defines = sources.defines;
+  static constexpr std::string_view DEFINE = "#define ";
+  for (auto at = defines.find(DEFINE); at != std::string_view::npos; at = defines.find(DEFINE, at + 1)) {
+    const auto start = at + DEFINE.size();
+    const auto end = defines.find_first_of(" \n", start);
+    features += (features.empty() ? "" : " ") + std::string(defines.substr(start, end - start));
+  }
+
+  return features.empty() ? label : label + " [" + features + "]";
+}
+
+} // namespace
+
+// ------------------------------
+// Command line option parsing.
+
+ShaderWatchOptions parseShaderWatchOptions(int argc, char **argv) {
+  ShaderWatchOptions options;
+
+  for (int i = 1; i < argc; i++) {
+    if (std::string_view(argv[i]) == "--watch-shaders") {
+      options.enabled = true;
+    }
+  }
+
+  return options;
+}
+
+// ---------------------------
+// ShaderWatcher definitions.
+
+ShaderWatcher::ShaderWatcher(const ShaderWatchOptions &options, ReadyFunction onReady)
+    : mOnReady(std::move(onReady)) {
+  if (!options.enabled) {
+    return;
+  }
+
+#ifdef __linux__
+  mInotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  mWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (mInotifyFd < 0 || mWakeFd < 0) {
+    fmt::print("[shader watch] Can't watch files (errno {}); shaders won't reload.\n", errno);
+    return;
+  }
+
+  mEnabled = true;
+  mThread = std::thread([this]() { run(); });
+#else
+  fmt::print("[shader watch] Only supported on Linux; shaders won't reload.\n");
+#endif
+}
+
+ShaderWatcher::~ShaderWatcher() {
+#ifdef __linux__
+  if (mThread.joinable()) {
+    mStopRequested.store(true, std::memory_order_release);
+    const std::uint64_t wake = 1;
+    [[maybe_unused]] auto written = write(mWakeFd, &wake, sizeof(wake));
+    mThread.join();
+  }
+
+  for (int fd : {mInotifyFd, mWakeFd}) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+#endif
+}
+
+void ShaderWatcher::watch(std::shared_ptr<Shader> shader) {
+  if (!mEnabled || !shader || shader->sources().vertexPath.empty()) {
+    return;
+  }
+
+  Watched watched;
+  watched.sources = shader->sources();
+  watched.label = labelFor(watched.sources);
+  watched.shader = std::move(shader);
+
+  // If the sources are broken now, still watch them so a fix reloads.
+  try {
+    for (const auto &path : {watched.sources.vertexPath, watched.sources.fragmentPath}) {
+      for (auto &file : ShaderPreprocessor::process(path, watched.sources.defines).files) {
+        watched.files.push_back(std::move(file));
+      }
+    }
+  } catch (const std::runtime_error &e) {
+    fmt::print("[shader watch] {}: {}\n", watched.label, e.what());
+    watched.files = {std::filesystem::weakly_canonical(watched.sources.vertexPath),
+                     std::filesystem::weakly_canonical(watched.sources.fragmentPath)};
+  }
+
+  std::lock_guard lock{mWatchMutex};
+  watchDirectoriesOf(watched.files);
+  mWatched.push_back(std::move(watched));
+}
+
+int ShaderWatcher::applyPending() {
+  if (!mEnabled) {
+    return 0;
+  }
+
+  std::vector<Ready> ready;
+  {
+    std::lock_guard lock{mReadyMutex};
+    ready.swap(mReady);
+  }
+
+  int applied = 0;
+  for (Ready &entry : ready) {
+    const auto start = Clock::now();
+    const bool reloaded = entry.shader->reload(entry.vertexCode, entry.fragmentCode);
+    const auto end = Clock::now();
+
+    if (!reloaded) {
+      fmt::print("[shader watch] {} failed to build; keeping the previous program.\n", entry.label);
+      continue;
+    }
+
+    applied++;
+    const std::chrono::duration<double, std::milli> buildMs = end - start;
+    const std::chrono::duration<double, std::milli> totalMs = end - entry.changeTime;
+    fmt::print("[shader watch] Reloaded {} {:.0f} ms after the change (check {:.2f} ms, build {:.2f} ms)\n",
+               entry.label, totalMs.count(), entry.validateMs, buildMs.count());
+  }
+
+  return applied;
+}
+
+// Caller holds mWatchMutex.
+void ShaderWatcher::watchDirectoriesOf(const std::vector<std::filesystem::path> &files) {
+#ifdef __linux__
+  for (const auto &file : files) {
+    const std::filesystem::path directory = file.parent_path();
+    const bool known = std::any_of(mDirectories.begin(), mDirectories.end(),
+                                   [&](const auto &entry) { return entry.second == directory; });
+    if (known) {
+      continue;
+    }
+
+    // Editors either write in place or rename a new file over the old one.
+    const int descriptor = inotify_add_watch(mInotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (descriptor < 0) {
+      fmt::print("[shader watch] Can't watch {} (errno {})\n", directory.string(), errno);
+      continue;
+    }
+    mDirectories.emplace(descriptor, directory);
+  }
+#else
+  (void)files;
+#endif
+}
+
+void ShaderWatcher::run() {
+#ifdef __linux__
+  alignas(inotify_event) std::array<char, 4096> buffer;
+  std::vector<std::filesystem::path> changed;
+  Clock::time_point changeTime;
+
+  while (!mStopRequested.load(std::memory_order_acquire)) {
+    std::array<pollfd, 2> fds{{{mInotifyFd, POLLIN, 0}, {mWakeFd, POLLIN, 0}}};
+
+    // Sleep until something's written, then until writes settle.
+    const int count = poll(fds.data(), fds.size(), changed.empty() ? -1 : SETTLE_MS);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      fmt::print("[shader watch] poll failed (errno {}); no longer watching.\n", errno);
+      return;
+    }
+
+    if (fds[1].revents & POLLIN) {
+      return;
+    }
+
+    if (count == 0) {
+      rebuild(changed, changeTime);
+      changed.clear();
+      continue;
+    }
+
+    const ssize_t length = read(mInotifyFd, buffer.data(), buffer.size());
+    for (ssize_t offset = 0; offset < length;) {
+      const auto *event = reinterpret_cast<const inotify_event *>(buffer.data() + offset);
+      offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+      if (event->len == 0) {
+        continue;
+      }
+
+      std::filesystem::path file;
+      {
+        std::lock_guard lock{mWatchMutex};
+        auto it = mDirectories.find(event->wd);
+        if (it == mDirectories.end()) {
+          continue;
+        }
+        file = it->second / event->name;
+      }
+
+      if (changed.empty()) {
+        changeTime = Clock::now();
+      }
+      if (std::find(changed.begin(), changed.end(), file) == changed.end()) {
+        changed.push_back(std::move(file));
+      }
+    }
+  }
+#endif
+}
+
+void ShaderWatcher::rebuild(const std::vector<std::filesystem::path> &changed, Clock::time_point changeTime) {
+  bool anyReady = false;
+
+  std::lock_guard lock{mWatchMutex};
+  for (Watched &watched : mWatched) {
+    const bool affected = std::any_of(changed.begin(), changed.end(), [&](const auto &file) {
+      return std::find(watched.files.begin(), watched.files.end(), file) != watched.files.end();
+    });
+    if (!affected) {
+      continue;
+    }
+
+    const auto start = Clock::now();
+    try {
+      const Shader::Sources &sources = watched.sources;
+      PreprocessedSource vertex = ShaderPreprocessor::process(sources.vertexPath, sources.defines);
+      PreprocessedSource fragment = ShaderPreprocessor::process(sources.fragmentPath, sources.defines);
+
+      for (const PreprocessedSource *source : {&vertex, &fragment}) {
+        if (auto problem = checkSource(*source); problem) {
+          throw std::runtime_error(problem.value());
+        }
+      }
+
+      // Includes may have come or gone.
+      watched.files = std::move(vertex.files);
+      watched.files.insert(watched.files.end(), fragment.files.begin(), fragment.files.end());
+      watchDirectoriesOf(watched.files);
+
+      const std::chrono::duration<double, std::milli> validateMs = Clock::now() - start;
+      std::lock_guard readyLock{mReadyMutex};
+      mReady.push_back({watched.shader, watched.label, std::move(vertex.code), std::move(fragment.code), changeTime,
+                        validateMs.count()});
+      anyReady = true;
+    } catch (const std::runtime_error &e) {
+      fmt::print("[shader watch] {}: {}; keeping the previous program.\n", watched.label, e.what());
+    }
+  }
+
+  // Wake the GL thread, which may be asleep waiting for a redraw.
+  if (anyReady && mOnReady) {
+    mOnReady();
+  }
+}
@@ -0,0 +1,113 @@
+// Reloads shaders when their source files change.
+//
+// A background thread watches the directories holding each watched
+// program's files, includes too, with inotify. When one is written it
+// waits for writes to settle (editors often save in several steps), then
+// preprocesses the affected programs and checks them for the mistakes we
+// can catch without a GL context: missing includes, no main(), unbalanced
+// brackets. Only programs that pass are handed to the GL thread, which
+// picks them up in applyPending() and swaps them in with Shader::reload().
+// A program that fails anywhere along the way has its errors printed and
+// the previous program stays in use, so a typo never tears down the scene.
+//
+// Watching is Linux-only; elsewhere the watcher does nothing.
+
+#ifndef SHADER_WATCHER_H
+#define SHADER_WATCHER_H
+
+#include <learnopengl/shader_m.h>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// --------------------------------
+// Command line shader watch options.
+
+struct ShaderWatchOptions {
+  // Watch shader sources and reload them on change.
+  bool enabled = false;
+};
+
+// Recognizes `--watch-shaders`.
+ShaderWatchOptions parseShaderWatchOptions(int argc, char **argv);
+
+// ---------------
+// Shader watcher.
+
+class ShaderWatcher {
+public:
+  using Clock = std::chrono::steady_clock;
+  // Called on the watcher thread when a reload is ready to apply.
+  using ReadyFunction = std::function<void()>;
+
+  ShaderWatcher(const ShaderWatchOptions &options, ReadyFunction onReady);
+
+  ShaderWatcher(const ShaderWatcher &) = delete;
+  ShaderWatcher &operator=(const ShaderWatcher &) = delete;
+
+  ~ShaderWatcher();
+
+  // Starts watching shader's source files. Shaders built from code alone,
+  // without sources, are ignored.
+  void watch(std::shared_ptr<Shader> shader);
+
+  // GL thread: swaps in every program that's ready. Returns how many were.
+  int applyPending();
+
+  [[nodiscard]] bool enabled() const { return mEnabled; }
+
+private:
+  struct Watched {
+    std::shared_ptr<Shader> shader;
+    Shader::Sources sources;
+    std::string label;
+    // Every file the last good preprocess read, canonical.
+    std::vector<std::filesystem::path> files;
+  };
+
+  // Checked code, waiting for the GL thread.
+  struct Ready {
+    std::shared_ptr<Shader> shader;
+    std::string label;
+    std::string vertexCode;
+    std::string fragmentCode;
+    Clock::time_point changeTime;
+    double validateMs = 0.0;
+  };
+
+  void run();
+  void watchDirectoriesOf(const std::vector<std::filesystem::path> &files);
+  void rebuild(const std::vector<std::filesystem::path> &changed, Clock::time_point changeTime);
+
+private:
+  // How long files must go unwritten before we rebuild.
+  static constexpr int SETTLE_MS = 50;
+
+  bool mEnabled = false;
+  ReadyFunction mOnReady;
+
+  int mInotifyFd = -1;
+  // Written to wake the thread for shutdown.
+  int mWakeFd = -1;
+  std::thread mThread;
+  std::atomic<bool> mStopRequested = false;
+
+  // Guards mWatched and mDirectories, shared by watch() and the thread.
+  std::mutex mWatchMutex;
+  std::vector<Watched> mWatched;
+  // inotify watch descriptor to directory.
+  std::unordered_map<int, std::filesystem::path> mDirectories;
+
+  std::mutex mReadyMutex;
+  std::vector<Ready> mReady;
+};
+
+#endif // SHADER_WATCHER_H
@@ -0,0 +1,782 @@
+// clang-format off
+#include "software_rasterizer.h"
+#include "job_system.h"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define GLEX_RASTER_SSE2
+#endif
+// clang-format on
+
+namespace {
+
+// ----------------------
+// Four lanes of floats.
+
+// Comparisons give masks, with each lane all ones or all zeros.
+
+#ifdef GLEX_RASTER_SSE2
+
+struct Float4 {
+  __m128 v;
+};
+
+inline Float4 splat(float x) { return {_mm_set1_ps(x)}; }
+inline Float4 lanes(float a, float b, float c, float d) { return {_mm_setr_ps(a, b, c, d)}; }
+inline Float4 load(const float *p) { return {_mm_loadu_ps(p)}; }
+inline void store(float *p, Float4 a) { _mm_storeu_ps(p, a.v); }
+
+inline Float4 operator+(Float4 a, Float4 b) { return {_mm_add_ps(a.v, b.v)}; }
+inline Float4 operator*(Float4 a, Float4 b) { return {_mm_mul_ps(a.v, b.v)}; }
+inline Float4 operator/(Float4 a, Float4 b) { return {_mm_div_ps(a.v, b.v)}; }
+inline Float4 max(Float4 a, Float4 b) { return {_mm_max_ps(a.v, b.v)}; }
+
+inline Float4 greater(Float4 a, Float4 b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+inline Float4 greaterEqual(Float4 a, Float4 b) { return {_mm_cmpge_ps(a.v, b.v)}; }
+inline Float4 less(Float4 a, Float4 b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+inline Float4 operator&(Float4 a, Float4 b) { return {_mm_and_ps(a.v, b.v)}; }
+inline Float4 operator|(Float4 a, Float4 b) { return {_mm_or_ps(a.v, b.v)}; }
+inline Float4 select(Float4 mask, Float4 a, Float4 b) {
+  return {_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v))};
+}
+inline int laneBits(Float4 mask) { return _mm_movemask_ps(mask.v); }
+
+#else
+
+struct Float4 {
+  std::array<float, 4> v;
+};
+
+template <typename F>
+inline Float4 perLane(Float4 a, Float4 b, F f) {
+  return {{f(a.v[0], b.v[0]), f(a.v[1], b.v[1]), f(a.v[2], b.v[2]), f(a.v[3], b.v[3])}};
+}
+
+inline float maskLane(bool set) { return std::bit_cast<float>(set ? 0xFFFFFFFFu : 0u); }
+inline std::uint32_t bits(float x) { return std::bit_cast<std::uint32_t>(x); }
+
+inline Float4 splat(float x) { return {{x, x, x, x}}; }
+inline Float4 lanes(float a, float b, float c, float d) { return {{a, b, c, d}}; }
+inline Float4 load(const float *p) { return {{p[0], p[1], p[2], p[3]}}; }
+inline void store(float *p, Float4 a) { std::memcpy(p, a.v.data(), sizeof(a.v)); }
+
+inline Float4 operator+(Float4 a, Float4 b) { return perLane(a, b, [](float x, float y) { return x + y; }); }
+inline Float4 operator*(Float4 a, Float4 b) { return perLane(a, b, [](float x, float y) { return x * y; }); }
+inline Float4 operator/(Float4 a, Float4 b) { return perLane(a, b, [](float x, float y) { return x / y; }); }
+inline Float4 max(Float4 a, Float4 b) { return perLane(a, b, [](float x, float y) { return x > y ? x : y; }); }
+
+inline Float4 greater(Float4 a, Float4 b) { return perLane(a, b, [](float x, float y) { return maskLane(x > y); }); }
+inline Float4 greaterEqual(Float4 a, Float4 b) {
+  return perLane(a, b, [](float x, float y) { return maskLane(x >= y); });
+}
+inline Float4 less(Float4 a, Float4 b) { return perLane(a, b, [](float x, float y) { return maskLane(x < y); }); }
+inline Float4 operator&(Float4 a, Float4 b) {
+  return perLane(a, b, [](float x, float y) { return std::bit_cast<float>(bits(x) & bits(y)); });
+}
+inline Float4 operator|(Float4 a, Float4 b) {
+  return perLane(a, b, [](float x, float y) { return std::bit_cast<float>(bits(x) | bits(y)); });
+}
+inline Float4 select(Float4 mask, Float4 a, Float4 b) {
+  Float4 result;
+  for (int i = 0; i < 4; i++) {
+    result.v[i] = bits(mask.v[i]) ? a.v[i] : b.v[i];
+  }
+  return result;
+}
+inline int laneBits(Float4 mask) {
+  int result = 0;
+  for (int i = 0; i < 4; i++) {
+    result |= (bits(mask.v[i]) ? 1 : 0) << i;
+  }
+  return result;
+}
+
+#endif
+
+inline Float4 allLanes(bool set) {
+  const float lane = std::bit_cast<float>(set ? 0xFFFFFFFFu : 0u);
+  return splat(lane);
+}
+
+inline float horizontalMax(Float4 a) {
+  alignas(16) float values[4];
+  store(values, a);
+  return std::max(std::max(values[0], values[1]), std::max(values[2], values[3]));
+}
+
+// ---------------
+// Pixel helpers.
+
+std::uint32_t packColor(const glm::vec4 &color) {
+  std::uint32_t packed = 0;
+  for (int i = 0; i < 4; i++) {
+    const auto channel = static_cast<std::uint32_t>(std::clamp(color[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+    packed |= channel << (8 * i);
+  }
+  return packed;
+}
+
+// Blends two packed colors, weight out of 256 towards b, two channels at a time.
+inline std::uint32_t lerpColor(std::uint32_t a, std::uint32_t b, std::uint32_t weight) {
+  const std::uint32_t inverse = 256 - weight;
+  const std::uint32_t redBlue = (((a & 0x00FF00FF) * inverse + (b & 0x00FF00FF) * weight) >> 8) & 0x00FF00FF;
+  const std::uint32_t greenAlpha = (((a >> 8) & 0x00FF00FF) * inverse + ((b >> 8) & 0x00FF00FF) * weight) & 0xFF00FF00;
+  return redBlue | greenAlpha;
+}
+
+// GL_LINEAR filtering with GL_REPEAT wrapping, as our textures use.
+std::uint32_t sampleBilinear(const SoftwareTexture &texture, float u, float v) {
+  if (!std::isfinite(u) || !std::isfinite(v)) {
+    return 0;
+  }
+
+  // Texel centers sit at half-integers.
+  const float x = (u - std::floor(u)) * static_cast<float>(texture.width) - 0.5f;
+  const float y = (v - std::floor(v)) * static_cast<float>(texture.height) - 0.5f;
+  const float floorX = std::floor(x);
+  const float floorY = std::floor(y);
+
+  int x0 = static_cast<int>(floorX);
+  int y0 = static_cast<int>(floorY);
+  int x1 = x0 + 1;
+  int y1 = y0 + 1;
+  x0 = x0 < 0 ? texture.width - 1 : x0;
+  y0 = y0 < 0 ? texture.height - 1 : y0;
+  x1 = x1 >= texture.width ? 0 : x1;
+  y1 = y1 >= texture.height ? 0 : y1;
+
+  const auto weightX = static_cast<std::uint32_t>((x - floorX) * 256.0f);
+  const auto weightY = static_cast<std::uint32_t>((y - floorY) * 256.0f);
+
+  const std::uint32_t *row0 = texture.texels.data() + static_cast<std::size_t>(y0) * texture.width;
+  const std::uint32_t *row1 = texture.texels.data() + static_cast<std::size_t>(y1) * texture.width;
+
+  return lerpColor(lerpColor(row0[x0], row0[x1], weightX), lerpColor(row1[x0], row1[x1], weightX), weightY);
+}
+
+// ----------------------
+// Clipping and setup.
+
+struct ClipVertex {
+  glm::vec4 position;
+  glm::vec2 textureCoords;
+};
+
+// Entirely outside one of the view volume's planes.
+bool outsideViewVolume(const std::array<ClipVertex, 3> &vertices) {
+  for (int axis = 0; axis < 3; axis++) {
+    bool allBelow = true;
+    bool allAbove = true;
+    for (const auto &vertex : vertices) {
+      allBelow = allBelow && vertex.position[axis] < -vertex.position.w;
+      allAbove = allAbove && vertex.position[axis] > vertex.position.w;
+    }
+    if (allBelow || allAbove) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Distance inside the near plane, z = -w.
+inline float nearDistance(const ClipVertex &vertex) { return vertex.position.z + vertex.position.w; }
+
+// Clips a triangle against the near plane, giving a polygon of up to four vertices.
+std::size_t clipNear(const std::array<ClipVertex, 3> &vertices, std::array<ClipVertex, 4> &polygon) {
+  std::size_t count = 0;
+  for (std::size_t i = 0; i < 3; i++) {
+    const ClipVertex &current = vertices[i];
+    const ClipVertex &next = vertices[(i + 1) % 3];
+    const float currentDistance = nearDistance(current);
+    const float nextDistance = nearDistance(next);
+
+    if (currentDistance >= 0.0f) {
+      polygon[count++] = current;
+    }
+    if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f)) {
+      const float t = currentDistance / (currentDistance - nextDistance);
+      polygon[count++] = {current.position + t * (next.position - current.position),
+                          current.textureCoords + t * (next.textureCoords - current.textureCoords)};
+    }
+  }
+  return count;
+}
+
+} // namespace
+
+// ----------------------------------------
+// Internal types of the software rasterizer.
+
+// Plane equation f(x, y) = a x + b y + c over pixel coordinates. Doubles,
+// since c can be large far from the triangle; we step in floats only
+// within a block.
+struct Plane {
+  double a = 0.0;
+  double b = 0.0;
+  double c = 0.0;
+
+  [[nodiscard]] double at(double x, double y) const { return a * x + b * y + c; }
+};
+
+struct SoftwareRasterizer::Triangle {
+  std::uint32_t draw = 0;
+
+  // Edge functions, positive inside. Each is zero along the edge opposite
+  // its vertex, and equals twice the triangle's area at that vertex.
+  std::array<Plane, 3> edges;
+  // Whether pixels exactly on each edge are ours, by the top-left rule.
+  std::array<bool, 3> topLeft = {};
+
+  // Depth interpolates linearly on screen; texture coordinates over w.
+  Plane depth;
+  Plane inverseW;
+  Plane uOverW;
+  Plane vOverW;
+  float minDepth = 0.0f;
+
+  // Pixels whose centers may be inside, clamped to the framebuffer.
+  int minX = 0;
+  int minY = 0;
+  int maxX = 0;
+  int maxY = 0;
+};
+
+struct SoftwareRasterizer::Chunk {
+  std::vector<Triangle> triangles;
+  // Per tile, indices of our triangles touching it, in submission order.
+  std::vector<std::vector<std::uint32_t>> bins;
+};
+
+struct SoftwareRasterizer::DrawState {
+  const SoftwareTexture *texture = nullptr;
+  std::uint32_t color = 0;
+};
+
+// -----------------------------
+// SoftwareTexture definitions.
+
+SoftwareTexture SoftwareTexture::load(const std::string &path, bool flipVertically) {
+  // Per thread, since textures also decode on worker threads.
+  stbi_set_flip_vertically_on_load_thread(flipVertically);
+
+  int width = 0;
+  int height = 0;
+  int channels = 0;
+  unsigned char *data = stbi_load(path.c_str(), &width, &height, &channels, 4);
+  if (!data) {
+    throw std::runtime_error("Failed to load texture " + path + ".");
+  }
+
+  SoftwareTexture texture;
+  texture.width = width;
+  texture.height = height;
+  texture.texels.resize(static_cast<std::size_t>(width) * height);
+  std::memcpy(texture.texels.data(), data, texture.texels.size() * sizeof(std::uint32_t));
+
+  stbi_image_free(data);
+  return texture;
+}
+
+// --------------------------
+// SoftwareMesh definitions.
+
+SoftwareMesh SoftwareMesh::fromInterleaved(std::span<const float> vertices) {
+  SoftwareMesh mesh;
+  const std::size_t count = vertices.size() / 5;
+  mesh.positions.reserve(count);
+  mesh.textureCoords.reserve(count);
+
+  for (std::size_t i = 0; i < count; i++) {
+    const float *vertex = vertices.data() + 5 * i;
+    mesh.positions.emplace_back(vertex[0], vertex[1], vertex[2]);
+    mesh.textureCoords.emplace_back(vertex[3], vertex[4]);
+  }
+
+  return mesh;
+}
+
+// --------------------------------
+// SoftwareRasterizer definitions.
+
+SoftwareRasterizer::SoftwareRasterizer(int width, int height, JobSystem *jobs)
+    : mJobs(jobs ? *jobs : jobSystem()) {
+  mChunks.resize(mJobs.threads());
+  mStats.resize(mJobs.threads());
+
+  resize(width, height);
+}
+
+SoftwareRasterizer::~SoftwareRasterizer() = default;
+
+unsigned SoftwareRasterizer::threads() const { return mJobs.threads(); }
+
+void SoftwareRasterizer::resize(int width, int height) {
+  if (width <= 0 || height <= 0) {
+    throw std::runtime_error("Software framebuffer needs a positive size.");
+  }
+
+  mWidth = width;
+  mHeight = height;
+  mTilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+  mTilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+  mStride = mTilesX * TILE_SIZE;
+
+  const std::size_t pixels = static_cast<std::size_t>(mStride) * mTilesY * TILE_SIZE;
+  mColor.assign(pixels, 0);
+  mDepth.assign(pixels, 1.0f);
+  mBlockMaxDepth.assign(pixels / (BLOCK_SIZE * BLOCK_SIZE), 1.0f);
+  mTileMaxDepth.assign(static_cast<std::size_t>(mTilesX) * mTilesY, 1.0f);
+
+  mTileStats.assign(mTileMaxDepth.size(), {});
+
+  for (Chunk &chunk : mChunks) {
+    chunk.bins.assign(mTileMaxDepth.size(), {});
+  }
+}
+
+void SoftwareRasterizer::beginFrame(const glm::vec4 &clearColor) {
+  mClearColor = packColor(clearColor);
+  mDraws.clear();
+
+  for (Chunk &chunk : mChunks) {
+    chunk.triangles.clear();
+    for (auto &bin : chunk.bins) {
+      bin.clear();
+    }
+  }
+
+  std::fill(mStats.begin(), mStats.end(), Stats{});
+  std::fill(mTileStats.begin(), mTileStats.end(), Stats{});
+}
+
+void SoftwareRasterizer::draw(const SoftwareMesh &mesh, const glm::mat4 &mvp, const SoftwareTexture *texture,
+                              const glm::vec4 &color) {
+  const std::size_t vertexCount = mesh.positions.size();
+  if (vertexCount == 0) {
+    return;
+  }
+
+  const auto draw = static_cast<std::uint32_t>(mDraws.size());
+  mDraws.push_back({texture, packColor(color)});
+
+  // Transform vertices in batches.
+  constexpr std::size_t VERTEX_BATCH = 4096;
+  mClipPositions.resize(vertexCount);
+  mJobs.parallelFor(
+      0, vertexCount,
+      [&](std::size_t first, std::size_t last) {
+        for (std::size_t i = first; i < last; i++) {
+          mClipPositions[i] = mvp * glm::vec4(mesh.positions[i], 1.0f);
+        }
+      },
+      VERTEX_BATCH);
+
+  // Then set up and bin triangles, in a chunk per thread, unless there are
+  // too few to be worth splitting.
+  constexpr std::size_t MIN_CHUNK_TRIANGLES = 256;
+  const std::size_t triangleCount = (mesh.indices.empty() ? vertexCount : mesh.indices.size()) / 3;
+  const std::size_t chunks =
+      std::clamp<std::size_t>(triangleCount / MIN_CHUNK_TRIANGLES, 1, mChunks.size());
+
+  mJobs.parallelFor(0, chunks, [&](std::size_t firstChunk, std::size_t lastChunk) {
+    for (std::size_t chunk = firstChunk; chunk < lastChunk; chunk++) {
+      const std::size_t first = triangleCount * chunk / chunks;
+      const std::size_t last = triangleCount * (chunk + 1) / chunks;
+      setupTriangles(mesh, draw, first, last, mChunks[chunk], mStats[chunk]);
+    }
+  });
+}
+
+void SoftwareRasterizer::setupTriangles(const SoftwareMesh &mesh, std::uint32_t draw, std::size_t first,
+                                        std::size_t last, Chunk &chunk, Stats &stats) const {
+  const std::size_t vertexCount = mesh.positions.size();
+  const bool hasTextureCoords = mesh.textureCoords.size() == vertexCount;
+
+  // Snap to 1/256 pixel, so shared edges see identical coordinates.
+  constexpr double SUBPIXELS = 256.0;
+
+  auto emit = [&](const ClipVertex &v0, const ClipVertex &v1, const ClipVertex &v2) {
+    const std::array<const ClipVertex *, 3> vertices = {&v0, &v1, &v2};
+
+    std::array<double, 3> x{};
+    std::array<double, 3> y{};
+    std::array<double, 3> z{};
+    std::array<double, 3> inverseW{};
+    for (std::size_t i = 0; i < 3; i++) {
+      const glm::vec4 &position = vertices[i]->position;
+      inverseW[i] = 1.0 / position.w;
+      x[i] = std::round((position.x * inverseW[i] * 0.5 + 0.5) * mWidth * SUBPIXELS) / SUBPIXELS;
+      y[i] = std::round((position.y * inverseW[i] * 0.5 + 0.5) * mHeight * SUBPIXELS) / SUBPIXELS;
+      z[i] = position.z * inverseW[i] * 0.5 + 0.5;
+    }
+
+    double area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (!(std::abs(area) > 0.0) || !std::isfinite(area)) {
+      stats.culled++;
+      return;
+    }
+
+    // We don't cull back faces, but wind every triangle counterclockwise.
+    std::array<std::size_t, 3> order = {0, 1, 2};
+    if (area < 0.0) {
+      std::swap(order[1], order[2]);
+      area = -area;
+    }
+
+    Triangle triangle;
+    triangle.draw = draw;
+
+    // Pixels whose centers lie within the bounds.
+    const auto [minX, maxX] = std::minmax({x[0], x[1], x[2]});
+    const auto [minY, maxY] = std::minmax({y[0], y[1], y[2]});
+    triangle.minX = std::max(0, static_cast<int>(std::ceil(minX - 0.5)));
+    triangle.minY = std::max(0, static_cast<int>(std::ceil(minY - 0.5)));
+    triangle.maxX = std::min(mWidth - 1, static_cast<int>(std::floor(maxX - 0.5)));
+    triangle.maxY = std::min(mHeight - 1, static_cast<int>(std::floor(maxY - 0.5)));
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+      stats.culled++;
+      return;
+    }
+
+    for (std::size_t i = 0; i < 3; i++) {
+      const std::size_t from = order[(i + 1) % 3];
+      const std::size_t to = order[(i + 2) % 3];
+      triangle.edges[i] = {y[from] - y[to], x[to] - x[from], x[from] * y[to] - y[from] * x[to]};
+      // Going counterclockwise with y up, left edges point down and top edges point left.
+      triangle.topLeft[i] = y[to] < y[from] || (y[to] == y[from] && x[to] < x[from]);
+    }
+
+    // Interpolates per-vertex values through the edge functions, which are
+    // barycentric coordinates scaled by twice the area.
+    auto interpolate = [&](const std::array<double, 3> &values) {
+      Plane plane;
+      for (std::size_t i = 0; i < 3; i++) {
+        const double value = values[order[i]] / area;
+        plane.a += value * triangle.edges[i].a;
+        plane.b += value * triangle.edges[i].b;
+        plane.c += value * triangle.edges[i].c;
+      }
+      return plane;
+    };
+
+    std::array<double, 3> uOverW{};
+    std::array<double, 3> vOverW{};
+    for (std::size_t i = 0; i < 3; i++) {
+      uOverW[i] = vertices[i]->textureCoords.x * inverseW[i];
+      vOverW[i] = vertices[i]->textureCoords.y * inverseW[i];
+    }
+
+    triangle.depth = interpolate(z);
+    triangle.inverseW = interpolate(inverseW);
+    triangle.uOverW = interpolate(uOverW);
+    triangle.vOverW = interpolate(vOverW);
+    triangle.minDepth = static_cast<float>(std::max(0.0, std::min({z[0], z[1], z[2]})));
+
+    // Bin into every tile the triangle may touch.
+    const auto index = static_cast<std::uint32_t>(chunk.triangles.size());
+    bool binned = false;
+    for (int tileY = triangle.minY / TILE_SIZE; tileY <= triangle.maxY / TILE_SIZE; tileY++) {
+      for (int tileX = triangle.minX / TILE_SIZE; tileX <= triangle.maxX / TILE_SIZE; tileX++) {
+        // Skip tiles wholly outside an edge, going by the tile's corner
+        // pixel that's farthest inside it.
+        const double centerX = tileX * TILE_SIZE + 0.5;
+        const double centerY = tileY * TILE_SIZE + 0.5;
+        const bool outside = std::any_of(triangle.edges.begin(), triangle.edges.end(), [&](const Plane &edge) {
+          constexpr double SPAN = TILE_SIZE - 1;
+          return edge.at(centerX, centerY) + std::max(edge.a, 0.0) * SPAN + std::max(edge.b, 0.0) * SPAN < 0.0;
+        });
+        if (outside) {
+          continue;
+        }
+
+        chunk.bins[tileY * mTilesX + tileX].push_back(index);
+        stats.binned++;
+        binned = true;
+      }
+    }
+
+    if (binned) {
+      chunk.triangles.push_back(triangle);
+    }
+  };
+
+  for (std::size_t t = first; t < last; t++) {
+    stats.triangles++;
+
+    std::array<ClipVertex, 3> vertices;
+    bool valid = true;
+    for (std::size_t i = 0; i < 3; i++) {
+      const std::size_t index = mesh.indices.empty() ? 3 * t + i : mesh.indices[3 * t + i];
+      if (index >= vertexCount) {
+        valid = false;
+        break;
+      }
+      vertices[i] = {mClipPositions[index], hasTextureCoords ? mesh.textureCoords[index] : glm::vec2{0.0f}};
+    }
+
+    if (!valid || outsideViewVolume(vertices)) {
+      stats.culled++;
+      continue;
+    }
+
+    const bool crossesNear = std::any_of(vertices.begin(), vertices.end(),
+                                         [](const ClipVertex &vertex) { return nearDistance(vertex) < 0.0f; });
+    if (!crossesNear) {
+      emit(vertices[0], vertices[1], vertices[2]);
+      continue;
+    }
+
+    stats.clipped++;
+    std::array<ClipVertex, 4> polygon;
+    const std::size_t count = clipNear(vertices, polygon);
+    for (std::size_t i = 2; i < count; i++) {
+      emit(polygon[0], polygon[i - 1], polygon[i]);
+    }
+  }
+}
+
+void SoftwareRasterizer::endFrame() {
+  mJobs.parallelFor(0, mTileMaxDepth.size(), [this](std::size_t first, std::size_t last) {
+    for (std::size_t tile = first; tile < last; tile++) {
+      rasterizeTile(static_cast<int>(tile), mTileStats[tile]);
+    }
+  });
+}
+
+void SoftwareRasterizer::rasterizeTile(int tile, Stats &stats) {
+  const int tileX = (tile % mTilesX) * TILE_SIZE;
+  const int tileY = (tile / mTilesX) * TILE_SIZE;
+
+  // Clear while the tile is ours and about to be in cache anyway.
+  for (int y = tileY; y < tileY + TILE_SIZE; y++) {
+    const std::size_t row = static_cast<std::size_t>(y) * mStride + tileX;
+    std::fill_n(mColor.begin() + row, TILE_SIZE, mClearColor);
+    std::fill_n(mDepth.begin() + row, TILE_SIZE, 1.0f);
+  }
+
+  const int blocksPerRow = mStride / BLOCK_SIZE;
+  for (int blockY = tileY / BLOCK_SIZE; blockY < (tileY + TILE_SIZE) / BLOCK_SIZE; blockY++) {
+    std::fill_n(mBlockMaxDepth.begin() + blockY * blocksPerRow + tileX / BLOCK_SIZE, TILE_SIZE / BLOCK_SIZE, 1.0f);
+  }
+  mTileMaxDepth[tile] = 1.0f;
+
+  // Merge the chunks' bins back into submission order: draw by draw, and
+  // within a draw, chunk by chunk.
+  std::vector<std::size_t> cursors(mChunks.size(), 0);
+  while (true) {
+    std::uint32_t draw = UINT32_MAX;
+    for (std::size_t c = 0; c < mChunks.size(); c++) {
+      const auto &bin = mChunks[c].bins[tile];
+      if (cursors[c] < bin.size()) {
+        draw = std::min(draw, mChunks[c].triangles[bin[cursors[c]]].draw);
+      }
+    }
+    if (draw == UINT32_MAX) {
+      break;
+    }
+
+    for (std::size_t c = 0; c < mChunks.size(); c++) {
+      const Chunk &chunk = mChunks[c];
+      const auto &bin = chunk.bins[tile];
+      for (; cursors[c] < bin.size() && chunk.triangles[bin[cursors[c]]].draw == draw; cursors[c]++) {
+        rasterizeTriangle(chunk.triangles[bin[cursors[c]]], tile, stats);
+      }
+    }
+  }
+}
+
+void SoftwareRasterizer::rasterizeTriangle(const Triangle &triangle, int tile, Stats &stats) {
+  const int tileX = (tile % mTilesX) * TILE_SIZE;
+  const int tileY = (tile / mTilesX) * TILE_SIZE;
+
+  // Blocks of this tile within the triangle's bounds.
+  const int firstX = std::max(tileX, triangle.minX) & ~(BLOCK_SIZE - 1);
+  const int firstY = std::max(tileY, triangle.minY) & ~(BLOCK_SIZE - 1);
+  const int lastX = std::min(tileX + TILE_SIZE - 1, triangle.maxX);
+  const int lastY = std::min(tileY + TILE_SIZE - 1, triangle.maxY);
+
+  // Hidden behind everything in the tile.
+  if (triangle.minDepth >= mTileMaxDepth[tile]) {
+    stats.blocksHidden += static_cast<std::uint64_t>((lastX - firstX) / BLOCK_SIZE + 1) *
+                          static_cast<std::uint64_t>((lastY - firstY) / BLOCK_SIZE + 1);
+    return;
+  }
+
+  const int blocksPerRow = mStride / BLOCK_SIZE;
+  bool wrote = false;
+
+  for (int blockY = firstY; blockY <= lastY; blockY += BLOCK_SIZE) {
+    for (int blockX = firstX; blockX <= lastX; blockX += BLOCK_SIZE) {
+      float &blockMaxDepth = mBlockMaxDepth[(blockY / BLOCK_SIZE) * blocksPerRow + blockX / BLOCK_SIZE];
+      if (triangle.minDepth >= blockMaxDepth) {
+        stats.blocksHidden++;
+        continue;
+      }
+
+      // Each edge's extremes over the block's pixel centers.
+      const double centerX = blockX + 0.5;
+      const double centerY = blockY + 0.5;
+      constexpr double SPAN = BLOCK_SIZE - 1;
+      bool outside = false;
+      bool covered = true;
+      for (const Plane &edge : triangle.edges) {
+        const double value = edge.at(centerX, centerY);
+        outside = outside || value + std::max(edge.a, 0.0) * SPAN + std::max(edge.b, 0.0) * SPAN < 0.0;
+        covered = covered && value + std::min(edge.a, 0.0) * SPAN + std::min(edge.b, 0.0) * SPAN > 0.0;
+      }
+      if (outside) {
+        continue;
+      }
+
+      stats.blocks++;
+      stats.blocksCovered += covered ? 1 : 0;
+
+      if (rasterizeBlock(triangle, blockX, blockY, covered, stats)) {
+        // Our writes can only have brought the block's farthest depth nearer.
+        Float4 farthest = splat(0.0f);
+        for (int row = 0; row < BLOCK_SIZE; row++) {
+          const float *depth = mDepth.data() + static_cast<std::size_t>(blockY + row) * mStride + blockX;
+          farthest = max(farthest, max(load(depth), load(depth + 4)));
+        }
+        blockMaxDepth = horizontalMax(farthest);
+        wrote = true;
+      }
+    }
+  }
+
+  if (wrote) {
+    float farthest = 0.0f;
+    for (int blockY = tileY / BLOCK_SIZE; blockY < (tileY + TILE_SIZE) / BLOCK_SIZE; blockY++) {
+      const float *row = mBlockMaxDepth.data() + blockY * blocksPerRow + tileX / BLOCK_SIZE;
+      farthest = std::max(farthest, *std::max_element(row, row + TILE_SIZE / BLOCK_SIZE));
+    }
+    mTileMaxDepth[tile] = farthest;
+  }
+}
+
+bool SoftwareRasterizer::rasterizeBlock(const Triangle &triangle, int blockX, int blockY, bool covered,
+                                        Stats &stats) {
+  static_assert(BLOCK_SIZE == 8, "Blocks are rasterized as two quads per row.");
+
+  const double centerX = blockX + 0.5;
+  const double centerY = blockY + 0.5;
+  const DrawState &draw = mDraws[triangle.draw];
+
+  // Values of a plane at the two quads of the block's first row, and its step per row.
+  struct Stepper {
+    std::array<Float4, 2> quads;
+    Float4 rowStep;
+  };
+  const Float4 ramp = lanes(0.0f, 1.0f, 2.0f, 3.0f);
+  auto stepper = [&](const Plane &plane) {
+    const auto a = static_cast<float>(plane.a);
+    const Float4 first = splat(static_cast<float>(plane.at(centerX, centerY))) + splat(a) * ramp;
+    return Stepper{{first, first + splat(4.0f * a)}, splat(static_cast<float>(plane.b))};
+  };
+
+  std::array<Stepper, 3> edges = {stepper(triangle.edges[0]), stepper(triangle.edges[1]),
+                                  stepper(triangle.edges[2])};
+  const std::array<Float4, 3> topLeft = {allLanes(triangle.topLeft[0]), allLanes(triangle.topLeft[1]),
+                                         allLanes(triangle.topLeft[2])};
+  Stepper depth = stepper(triangle.depth);
+  Stepper inverseW = stepper(triangle.inverseW);
+  Stepper uOverW = stepper(triangle.uOverW);
+  Stepper vOverW = stepper(triangle.vOverW);
+
+  const Float4 zero = splat(0.0f);
+  bool wrote = false;
+
+  for (int row = 0; row < BLOCK_SIZE; row++) {
+    const std::size_t offset = static_cast<std::size_t>(blockY + row) * mStride + blockX;
+    float *depthRow = mDepth.data() + offset;
+    std::uint32_t *colorRow = mColor.data() + offset;
+
+    for (std::size_t quad = 0; quad < 2; quad++) {
+      Float4 mask = allLanes(true);
+      if (!covered) {
+        for (std::size_t i = 0; i < 3; i++) {
+          const Float4 value = edges[i].quads[quad];
+          mask = mask & (greater(value, zero) | (greaterEqual(value, zero) & topLeft[i]));
+        }
+      }
+
+      const Float4 z = depth.quads[quad];
+      const Float4 stored = load(depthRow + 4 * quad);
+      mask = mask & less(z, stored);
+
+      const int lanesSet = laneBits(mask);
+      if (lanesSet == 0) {
+        continue;
+      }
+
+      store(depthRow + 4 * quad, select(mask, z, stored));
+      stats.pixels += static_cast<std::uint64_t>(std::popcount(static_cast<unsigned>(lanesSet)));
+      wrote = true;
+
+      std::uint32_t *colors = colorRow + 4 * quad;
+      if (!draw.texture) {
+        for (int lane = 0; lane < 4; lane++) {
+          if (lanesSet & (1 << lane)) {
+            colors[lane] = draw.color;
+          }
+        }
+        continue;
+      }
+
+      // Perspective-correct texture coordinates.
+      const Float4 w = splat(1.0f) / inverseW.quads[quad];
+      alignas(16) float u[4];
+      alignas(16) float v[4];
+      store(u, uOverW.quads[quad] * w);
+      store(v, vOverW.quads[quad] * w);
+      for (int lane = 0; lane < 4; lane++) {
+        if (lanesSet & (1 << lane)) {
+          colors[lane] = sampleBilinear(*draw.texture, u[lane], v[lane]);
+        }
+      }
+    }
+
+    // On to the next row.
+    for (Stepper *plane : {&edges[0], &edges[1], &edges[2], &depth, &inverseW, &uOverW, &vOverW}) {
+      plane->quads[0] = plane->quads[0] + plane->rowStep;
+      plane->quads[1] = plane->quads[1] + plane->rowStep;
+    }
+  }
+
+  return wrote;
+}
+
+void SoftwareRasterizer::readPixels(std::vector<std::uint8_t> &rgba) const {
+  // Texels are packed red-first in memory on the little-endian machines we run on.
+  const std::size_t rowBytes = static_cast<std::size_t>(mWidth) * sizeof(std::uint32_t);
+  rgba.resize(rowBytes * mHeight);
+  for (int y = 0; y < mHeight; y++) {
+    std::memcpy(rgba.data() + y * rowBytes, mColor.data() + static_cast<std::size_t>(y) * mStride, rowBytes);
+  }
+}
+
+SoftwareRasterizer::Stats SoftwareRasterizer::stats() const {
+  Stats total;
+  for (const auto *parts : {&mStats, &mTileStats}) {
+    for (const Stats &stats : *parts) {
+      total.triangles += stats.triangles;
+      total.culled += stats.culled;
+      total.clipped += stats.clipped;
+      total.binned += stats.binned;
+      total.blocks += stats.blocks;
+      total.blocksHidden += stats.blocksHidden;
+      total.blocksCovered += stats.blocksCovered;
+      total.pixels += stats.pixels;
+    }
+  }
+  return total;
+}
@@ -0,0 +1,173 @@
+// Tile-based software rasterizer, for rendering on machines with no GPU.
+//
+// It draws the same vertex and index data as our GL meshes, with the same
+// model-view-projection matrices, and matches what our shaders do: a flat
+// color or a bilinearly filtered texture, with a less-than depth test and
+// no face culling. Output goes to an in-memory framebuffer.
+//
+// A frame goes through three stages:
+//
+//  - draw() transforms vertices, clips triangles against the near plane,
+//    sets up their edge and attribute equations, and bins each into the
+//    screen tiles it touches. Triangles are split into a fixed chunk per
+//    job system thread, each binning into bins of its own.
+//  - endFrame() hands tiles out as jobs. Each clears its tile, then
+//    rasterizes the tile's triangles in submission order, so tiles need no
+//    locking and results don't depend on scheduling.
+//  - Within a tile we walk 8x8 blocks. A block is skipped if it's outside
+//    an edge, or if the triangle's nearest depth is behind everything the
+//    block already holds (a max-depth per block, and per tile, kept up to
+//    date as we write). Blocks fully inside the triangle skip edge tests.
+//    Pixels are tested four at a time with SIMD edge functions.
+//
+// Like GL, row 0 of the framebuffer is the bottom of the image.
+
+#ifndef SOFTWARE_RASTERIZER_H
+#define SOFTWARE_RASTERIZER_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+// -----------------
+// Software texture.
+
+// A decoded RGBA8 image. Rows are in upload order, as with glTexImage2D,
+// so texture coordinates sample it the way GL samples the same data.
+struct SoftwareTexture {
+  int width = 0;
+  int height = 0;
+  // Packed RGBA, red in the low byte.
+  std::vector<std::uint32_t> texels;
+
+  // Decodes an image file. Pass flipVertically to match textures loaded
+  // flipped for GL, as GLTexture does. Throws std::runtime_error on failure.
+  static SoftwareTexture load(const std::string &path, bool flipVertically);
+};
+
+// --------------
+// Software mesh.
+
+// Positions, texture coordinates and triangle indices.
+struct SoftwareMesh {
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec2> textureCoords;
+  std::vector<std::uint32_t> indices;
+
+  // From x, y, z, u, v vertices, as TexturedMesh and FunctionMesh hold
+  // them, drawn as a plain triangle list.
+  static SoftwareMesh fromInterleaved(std::span<const float> vertices);
+};
+
+class JobSystem;
+
+// --------------------
+// Software rasterizer.
+
+class SoftwareRasterizer {
+public:
+  struct Stats {
+    // Triangles submitted, after index assembly.
+    std::uint64_t triangles = 0;
+    // Outside the view volume, or with no area.
+    std::uint64_t culled = 0;
+    // Crossing the near plane, and clipped against it.
+    std::uint64_t clipped = 0;
+    // Triangle and tile pairs.
+    std::uint64_t binned = 0;
+    // 8x8 blocks rasterized, and skipped for being hidden.
+    std::uint64_t blocks = 0;
+    std::uint64_t blocksHidden = 0;
+    // Blocks fully inside their triangle, that skipped edge tests.
+    std::uint64_t blocksCovered = 0;
+    // Pixels that passed the depth test and were shaded.
+    std::uint64_t pixels = 0;
+  };
+
+  static constexpr int TILE_SIZE = 64;
+  static constexpr int BLOCK_SIZE = 8;
+
+  // Runs its work on jobs, or on jobSystem() if null.
+  SoftwareRasterizer(int width, int height, JobSystem *jobs = nullptr);
+
+  SoftwareRasterizer(const SoftwareRasterizer &) = delete;
+  SoftwareRasterizer &operator=(const SoftwareRasterizer &) = delete;
+
+  ~SoftwareRasterizer();
+
+  void resize(int width, int height);
+
+  // Starts a frame, to be cleared to clearColor and a depth of 1.
+  void beginFrame(const glm::vec4 &clearColor);
+
+  // Bins mesh's triangles, transformed by mvp, shaded with texture if
+  // given and with color otherwise. The mesh and texture must outlive
+  // endFrame().
+  void draw(const SoftwareMesh &mesh, const glm::mat4 &mvp, const SoftwareTexture *texture,
+            const glm::vec4 &color = glm::vec4{1.0f});
+
+  // Rasterizes everything drawn since beginFrame().
+  void endFrame();
+
+  [[nodiscard]] int width() const { return mWidth; }
+  [[nodiscard]] int height() const { return mHeight; }
+  [[nodiscard]] unsigned threads() const;
+
+  // Packed RGBA, as with texels.
+  [[nodiscard]] std::uint32_t pixel(int x, int y) const { return mColor[y * mStride + x]; }
+  [[nodiscard]] float depth(int x, int y) const { return mDepth[y * mStride + x]; }
+
+  // Copies the image out as tightly packed RGBA bytes, bottom row first,
+  // the way glReadPixels would.
+  void readPixels(std::vector<std::uint8_t> &rgba) const;
+
+  // Totals over the last frame.
+  [[nodiscard]] Stats stats() const;
+
+private:
+  struct Triangle;
+  struct Chunk;
+  struct DrawState;
+
+  void setupTriangles(const SoftwareMesh &mesh, std::uint32_t draw, std::size_t first, std::size_t last, Chunk &chunk,
+                      Stats &stats) const;
+  void rasterizeTile(int tile, Stats &stats);
+  void rasterizeTriangle(const Triangle &triangle, int tile, Stats &stats);
+  bool rasterizeBlock(const Triangle &triangle, int blockX, int blockY, bool covered, Stats &stats);
+
+private:
+  int mWidth = 0;
+  int mHeight = 0;
+  // Buffers are padded to whole tiles.
+  int mStride = 0;
+  int mTilesX = 0;
+  int mTilesY = 0;
+
+  std::vector<std::uint32_t> mColor;
+  std::vector<float> mDepth;
+  // Farthest depth in each block, and in each tile.
+  std::vector<float> mBlockMaxDepth;
+  std::vector<float> mTileMaxDepth;
+
+  std::uint32_t mClearColor = 0;
+
+  JobSystem &mJobs;
+
+  // The current frame's draws, and transformed vertices for the one
+  // being binned.
+  std::vector<DrawState> mDraws;
+  std::vector<glm::vec4> mClipPositions;
+
+  // One per job system thread, each binning a share of every draw's
+  // triangles.
+  std::vector<Chunk> mChunks;
+  // For the current frame: from each chunk's binning, and each tile's
+  // rasterizing.
+  std::vector<Stats> mStats;
+  std::vector<Stats> mTileStats;
+};
+
+#endif // SOFTWARE_RASTERIZER_H
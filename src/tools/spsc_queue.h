@@ -0,0 +1,70 @@
+// Bounded lock-free queue for one producer thread and one consumer thread.
+//
+// The producer only writes mTail and the consumer only writes mHead, each
+// on its own cache line, so the two threads never contend on a lock or
+// false-share. Each side caches its last view of the other's index and
+// only reloads it when the queue looks full (or empty).
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+template <typename T, std::size_t Capacity> class SpscQueue {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+  static_assert(std::is_nothrow_copy_assignable_v<T>, "Pushing must not be able to throw halfway");
+
+public:
+  // Producer side. Returns false, leaving the queue alone, if it's full.
+  bool tryPush(const T &value) {
+    const std::size_t tail = mTail.load(std::memory_order_relaxed);
+
+    if (tail - mHeadCache == Capacity) {
+      mHeadCache = mHead.load(std::memory_order_acquire);
+      if (tail - mHeadCache == Capacity) {
+        return false;
+      }
+    }
+
+    mSlots[tail & MASK] = value;
+    mTail.store(tail + 1, std::memory_order_release);
+
+    return true;
+  }
+
+  // Consumer side. Returns false if there's nothing to take.
+  bool tryPop(T &value) {
+    const std::size_t head = mHead.load(std::memory_order_relaxed);
+
+    if (head == mTailCache) {
+      mTailCache = mTail.load(std::memory_order_acquire);
+      if (head == mTailCache) {
+        return false;
+      }
+    }
+
+    value = mSlots[head & MASK];
+    mHead.store(head + 1, std::memory_order_release);
+
+    return true;
+  }
+
+private:
+  static constexpr std::size_t MASK = Capacity - 1;
+  static constexpr std::size_t CACHE_LINE = 64;
+
+  std::array<T, Capacity> mSlots = {};
+
+  // Consumer's index, and the producer's copy of it.
+  alignas(CACHE_LINE) std::atomic<std::size_t> mHead = 0;
+  alignas(CACHE_LINE) std::size_t mHeadCache = 0;
+
+  // Producer's index, and the consumer's copy of it.
+  alignas(CACHE_LINE) std::atomic<std::size_t> mTail = 0;
+  alignas(CACHE_LINE) std::size_t mTailCache = 0;
+};
+
+#endif // SPSC_QUEUE_H
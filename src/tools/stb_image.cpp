@@ -0,0 +1,7 @@
+// stb_image's implementation, compiled once for everything linking our
+// tools, which is where images are decoded.
+
+// clang-format off
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+// clang-format on
@@ -0,0 +1,153 @@
+// clang-format off
+#include "stream_buffer.h"
+
+#include "tools/gl_state.h"
+#include "tools/helpers.h"
+
+#include <GLFW/glfw3.h>
+
+#include <cstdlib>
+#include <stdexcept>
+#include <string_view>
+// clang-format on
+
+// Only defined with ARB_buffer_storage.
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+namespace {
+
+using BufferStorageFn = void(APIENTRYP)(GLenum, GLsizeiptr, const void *, GLbitfield);
+
+BufferStorageFn bufferStorage() {
+  static const auto function = reinterpret_cast<BufferStorageFn>(glfwGetProcAddress("glBufferStorage"));
+  return function;
+}
+
+} // namespace
+
+// --------------------------
+// StreamBuffer definitions.
+
+bool StreamBuffer::persistentMappingSupported() {
+  static const bool supported = [] {
+    const char *setting = std::getenv("GLEX_PERSISTENT_MAPPING");
+    if (setting != nullptr && std::string_view(setting) == "off") {
+      return false;
+    }
+    return hasExtension("GL_ARB_buffer_storage") && bufferStorage() != nullptr;
+  }();
+  return supported;
+}
+
+StreamBuffer::StreamBuffer(std::size_t bytesPerFrame)
+    : mBytesPerFrame(bytesPerFrame), mPersistent(persistentMappingSupported()) {
+  const auto totalBytes = static_cast<GLsizeiptr>(bytesPerFrame * FRAMES);
+
+  mBuffer = GLBufferHandle::create();
+  glState().bindBuffer(GL_ARRAY_BUFFER, mBuffer.get());
+
+  if (mPersistent) {
+    constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    bufferStorage()(GL_ARRAY_BUFFER, totalBytes, nullptr, flags);
+    mPersistentData = static_cast<std::uint8_t *>(glMapBufferRange(GL_ARRAY_BUFFER, 0, totalBytes, flags));
+    if (!mPersistentData) {
+      throw std::runtime_error("Failed to map stream buffer.");
+    }
+  } else {
+    glBufferData(GL_ARRAY_BUFFER, totalBytes, nullptr, GL_STREAM_DRAW);
+  }
+
+  mBuffer.setBytes(static_cast<std::size_t>(totalBytes));
+}
+
+StreamBuffer::~StreamBuffer() {
+  // The buffer is unmapped when it's deleted.
+  for (GLsync fence : mFences) {
+    if (fence) {
+      glDeleteSync(fence);
+    }
+  }
+}
+
+void StreamBuffer::beginFrame() {
+  if (mInFrame) {
+    flush();
+    mFences[mRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    mRegion = (mRegion + 1) % FRAMES;
+  }
+
+  mInFrame = true;
+  mUsed = 0;
+  mStats.frames++;
+
+  GLsync &fence = mFences[mRegion];
+  if (!fence) {
+    return;
+  }
+
+  waitForFence(fence, mStats.stalls);
+}
+
+StreamBuffer::Allocation StreamBuffer::allocate(std::size_t bytes, std::size_t alignment) {
+  if (!mInFrame) {
+    throw std::runtime_error("StreamBuffer::allocate() called before beginFrame().");
+  }
+
+  // Align from the start of the buffer, so draws can index from offset / stride.
+  const std::size_t base = mRegion * mBytesPerFrame;
+  const std::size_t offset = (base + mUsed + alignment - 1) / alignment * alignment;
+
+  if (offset + bytes > base + mBytesPerFrame) {
+    throw std::runtime_error("StreamBuffer region is out of space.");
+  }
+
+  std::uint8_t *data = mappedData(offset);
+
+  mUsed = offset + bytes - base;
+  mStats.allocations++;
+  mStats.bytes += bytes;
+  mStats.highWater = mUsed > mStats.highWater ? mUsed : mStats.highWater;
+
+  return {data, offset};
+}
+
+void StreamBuffer::flush() {
+  // Coherent persistent writes need nothing more.
+  if (!mMappedRegion) {
+    return;
+  }
+
+  // Unmapping can fail if the contents were lost (say, on a mode switch);
+  // that frame draws garbage, and the next one rewrites it.
+  glState().bindBuffer(GL_ARRAY_BUFFER, mBuffer.get());
+  glUnmapBuffer(GL_ARRAY_BUFFER);
+  mMappedRegion = nullptr;
+}
+
+std::uint8_t *StreamBuffer::mappedData(std::size_t offset) {
+  if (mPersistent) {
+    return mPersistentData + offset;
+  }
+
+  if (!mMappedRegion) {
+    // The region's fence has signaled, so there's nothing to synchronize
+    // with. Only the part from offset on is invalidated: what's before it
+    // was flushed this frame, for draws already issued.
+    const std::size_t end = (mRegion + 1) * mBytesPerFrame;
+    glState().bindBuffer(GL_ARRAY_BUFFER, mBuffer.get());
+    mMappedRegion = static_cast<std::uint8_t *>(
+        glMapBufferRange(GL_ARRAY_BUFFER, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(end - offset),
+                         GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT));
+    if (!mMappedRegion) {
+      throw std::runtime_error("Failed to map stream buffer region.");
+    }
+    mMappedOffset = offset;
+  }
+
+  return mMappedRegion + (offset - mMappedOffset);
+}
@@ -0,0 +1,113 @@
+// Ring buffer for vertex data rewritten every frame.
+//
+// Meshes upload once with GL_STATIC_DRAW, so changing their geometry means
+// reallocating. Streamed data instead goes into one buffer split into
+// FRAMES regions, one per frame in flight. Each frame writes into its own
+// region, straight into mapped memory, and a fence after its draws tells
+// us when the GPU is done with it. By the time we come back around to a
+// region its fence has almost always signaled; when it hasn't, we wait and
+// count a stall.
+//
+// Where the driver has ARB_buffer_storage we map the buffer once, with
+// persistent and coherent mapping, and never unmap it. Otherwise each
+// frame maps its region unsynchronized, which is safe since the fence has
+// already told us the GPU is done with it, and unmaps it before drawing.
+// Allocating again after a flush maps only the rest of the region, so the
+// data already flushed for this frame's earlier draws is kept.
+//
+// Draws address their data by offset into buffer(): a VAO set up once
+// with offset 0 draws an allocation aligned to its vertex stride from
+// first vertex offset / stride.
+
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include "glad/glad.h"
+
+#include <tools/gl_resources.h>
+#include <tools/helpers.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+class StreamBuffer {
+public:
+  struct Stats {
+    // Frames that found their region still in use, and time spent waiting.
+    FenceWaitStats stalls;
+    std::uint64_t frames = 0;
+    std::uint64_t allocations = 0;
+    std::uint64_t bytes = 0;
+    // Most bytes used in one frame, for sizing regions.
+    std::size_t highWater = 0;
+  };
+
+  // Where to write an allocation, and where GL will read it.
+  struct Allocation {
+    void *data = nullptr;
+    // From the start of buffer().
+    std::size_t offset = 0;
+  };
+
+  // Regions, so the GPU may be up to two frames behind without a stall.
+  static constexpr std::size_t FRAMES = 3;
+
+  // Allocates FRAMES regions of bytesPerFrame each.
+  explicit StreamBuffer(std::size_t bytesPerFrame);
+
+  StreamBuffer(const StreamBuffer &) = delete;
+  StreamBuffer &operator=(const StreamBuffer &) = delete;
+
+  ~StreamBuffer();
+
+  // Fences the previous frame's draws, then moves on to the next region,
+  // waiting if the GPU still reads from it.
+  void beginFrame();
+
+  /// Reserves bytes in this frame's region, at an offset that's a multiple
+  /// of alignment, which needn't be a power of two. Write to data before
+  /// flush(). Throws if the region is full.
+  Allocation allocate(std::size_t bytes, std::size_t alignment = 4);
+
+  // Makes this frame's writes visible to GL. Call before issuing the draws
+  // that read them.
+  void flush();
+
+  [[nodiscard]] GLuint buffer() const { return mBuffer.get(); }
+  [[nodiscard]] bool persistent() const { return mPersistent; }
+  [[nodiscard]] std::size_t bytesPerFrame() const { return mBytesPerFrame; }
+  [[nodiscard]] const Stats &stats() const { return mStats; }
+
+  // Whether the driver can map buffers persistently, and we haven't been
+  // told not to with GLEX_PERSISTENT_MAPPING=off.
+  static bool persistentMappingSupported();
+
+private:
+  // Where to write at offset into the buffer: the persistent mapping, or
+  // a mapping from offset to the end of this frame's region, made on first
+  // use after a flush.
+  std::uint8_t *mappedData(std::size_t offset);
+
+private:
+  GLBufferHandle mBuffer;
+  std::size_t mBytesPerFrame;
+  bool mPersistent = false;
+
+  // The whole buffer, while persistently mapped.
+  std::uint8_t *mPersistentData = nullptr;
+  // The rest of this frame's region from mMappedOffset, while mapped
+  // without persistence.
+  std::uint8_t *mMappedRegion = nullptr;
+  std::size_t mMappedOffset = 0;
+
+  std::array<GLsync, FRAMES> mFences{};
+  // Region of the current frame, and bytes used in it.
+  std::size_t mRegion = 0;
+  std::size_t mUsed = 0;
+  bool mInFrame = false;
+
+  Stats mStats;
+};
+
+#endif // STREAM_BUFFER_H
@@ -0,0 +1,91 @@
+// clang-format off
+#include "texture_array.h"
+#include "gl_state.h"
+#include "mip_chain.h"
+
+#include <fmt/core.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+// clang-format on
+
+namespace {
+
+constexpr int CHANNELS = 4;
+
+} // namespace
+
+// ------------------------------
+// TextureArrayPacker definitions.
+
+TextureArrayPacker::Layer TextureArrayPacker::add(const std::string &type, const std::string &filename) {
+  int width, height, nrComponents;
+  unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, CHANNELS);
+
+  if (!data) {
+    throw std::runtime_error("Texture failed to load at path: " + filename + ".");
+  }
+
+  Group &group = mGroups[{type, width, height}];
+  if (!group.texture) {
+    // Create the name now so meshes can refer to it before build().
+    group.texture = GLTextureHandle::create();
+  }
+
+  group.layers.emplace_back(data, data + static_cast<std::size_t>(width) * height * CHANNELS);
+
+  stbi_image_free(data);
+
+  return {group.texture.get(), static_cast<int>(group.layers.size()) - 1};
+}
+
+std::vector<GLTextureHandle> TextureArrayPacker::build() {
+  std::vector<GLTextureHandle> arrays;
+  GLint maxLayers = 0;
+  glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+  for (auto &[key, group] : mGroups) {
+    const auto &[type, width, height] = key;
+    const auto numLayers = static_cast<GLsizei>(group.layers.size());
+    if (numLayers > maxLayers) {
+      throw std::runtime_error(fmt::format("Too many {}x{} {} textures to pack into one array.", width, height, type));
+    }
+
+    const int levels = mipLevelCount(width, height);
+    glState().bindTexture(0, GL_TEXTURE_2D_ARRAY, group.texture.get());
+    for (int level = 0; level < levels; level++) {
+      glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, std::max(1, width >> level), std::max(1, height >> level),
+                   numLayers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+    glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    // Diffuse maps are color; the rest are data.
+    MipOptions options;
+    options.colorSpace = type == "texture_diffuse" ? ColorSpace::SRGB : ColorSpace::Linear;
+
+    for (GLsizei layer = 0; layer < numLayers; layer++) {
+      // Each layer's mips are built from it alone, as glGenerateMipmap would.
+      const MipChain chain = buildMipChain({width, height, std::move(group.layers[layer])}, options);
+      for (int level = 0; level < levels; level++) {
+        const MipLevel &mip = chain[level];
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, mip.width, mip.height, 1, GL_RGBA,
+                        GL_UNSIGNED_BYTE, mip.pixels.data());
+      }
+    }
+
+    // We don't need our copies anymore.
+    group.layers = {};
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    group.texture.setBytes(estimateTextureBytes(width, height, CHANNELS, true, numLayers));
+    arrays.push_back(std::move(group.texture));
+  }
+
+  return arrays;
+}
@@ -0,0 +1,67 @@
+// Packs a model's textures into GL_TEXTURE_2D_ARRAYs, one per texture
+// type and image size, so meshes whose textures share a size can be drawn
+// without rebinding textures. Meshes select their layer through a vertex
+// attribute, from a buffer holding one value per mesh.
+//
+// Layers of an array must share a size and format, so every image is
+// decoded as RGBA8 and goes into the array of its own size. Models mostly
+// use a few sizes, so that's a few arrays per type, and no image is
+// resampled or takes more memory than it would on its own.
+
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include "glad/glad.h"
+
+#include <tools/gl_resources.h>
+
+#include <compare>
+#include <map>
+#include <string>
+#include <vector>
+
+// ---------------------
+// Texture array packer.
+
+class TextureArrayPacker {
+public:
+  // Where a packed texture lives.
+  struct Layer {
+    unsigned int arrayId;
+    int layer;
+  };
+
+  TextureArrayPacker() = default;
+
+  TextureArrayPacker(const TextureArrayPacker &) = delete;
+  TextureArrayPacker &operator=(const TextureArrayPacker &) = delete;
+
+  /// Decodes the image and assigns it the next layer of the array for its
+  /// type and size.
+  /// The array's storage is only created in build(). Throws on failure to load.
+  Layer add(const std::string &type, const std::string &filename);
+
+  /// Uploads all queued images, then releases the CPU copies.
+  /// Returns the arrays, for the caller to own.
+  std::vector<GLTextureHandle> build();
+
+private:
+  // Images of one type and size.
+  struct GroupKey {
+    std::string type;
+    int width;
+    int height;
+
+    auto operator<=>(const GroupKey &) const = default;
+  };
+
+  struct Group {
+    GLTextureHandle texture;
+    // Each layer's RGBA8 pixels, until build().
+    std::vector<std::vector<unsigned char>> layers;
+  };
+
+  std::map<GroupKey, Group> mGroups;
+};
+
+#endif // TEXTURE_ARRAY_H
@@ -0,0 +1,284 @@
+// clang-format off
+#include "texture_streamer.h"
+#include "alloc_tracker.h"
+
+#include "tools/gl_state.h"
+
+#include <stb_image.h>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+// clang-format on
+
+namespace {
+
+constexpr std::size_t BYTES_PER_TEXEL = 4;
+
+} // namespace
+
+// ------------------------------
+// Command line option parsing.
+
+TextureStreamOptions parseTextureStreamOptions(int argc, char **argv) {
+  TextureStreamOptions options;
+
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+
+    if (arg == "--stream-textures") {
+      options.enabled = true;
+    } else if (arg == "--upload-budget" && i + 1 < argc) {
+      options.uploadBudget = static_cast<std::size_t>(std::max(1, std::atoi(argv[++i]))) * 1024;
+    }
+  }
+
+  return options;
+}
+
+// ------------------------------
+// TextureStreamer definitions.
+
+TextureStreamer &textureStreamer() {
+  static TextureStreamer streamer;
+  return streamer;
+}
+
+TextureStreamer::~TextureStreamer() {
+  {
+    std::lock_guard lock{mMutex};
+    mStopping = true;
+  }
+  mWork.notify_all();
+
+  if (mDecoder.joinable()) {
+    mDecoder.join();
+  }
+}
+
+void TextureStreamer::configure(const TextureStreamOptions &options) { mOptions = options; }
+
+GLTextureHandle TextureStreamer::request(const std::string &path, bool flipVertically, const MipOptions &options) {
+  int width = 0;
+  int height = 0;
+  int channels = 0;
+  if (!stbi_info(path.c_str(), &width, &height, &channels)) {
+    throw std::runtime_error("Texture failed to load at path: " + path + ".");
+  }
+
+  const int levels = mipLevelCount(width, height);
+  const int smallest = levels - 1;
+
+  GLTextureHandle texture = GLTextureHandle::create();
+  glState().bindTexture(0, GL_TEXTURE_2D, texture.get());
+
+  // Everything is streamed as RGBA8, whatever the file holds.
+  allocateTextureStorage(levels, width, height);
+  texture.setBytes(estimateTextureBytes(width, height, BYTES_PER_TEXEL, true));
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  // Sample only the placeholder until real levels arrive.
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, smallest);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, smallest);
+
+  const std::uint8_t placeholder[BYTES_PER_TEXEL] = {128, 128, 128, 255};
+  glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glTexSubImage2D(GL_TEXTURE_2D, smallest, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+
+  auto job = std::make_unique<Job>();
+  job->texture = texture.get();
+  job->generation = glResources().generation(GLResourceKind::Texture, texture.get());
+  job->path = path;
+  job->flip = flipVertically;
+  job->options = options;
+  job->width = width;
+  job->height = height;
+  job->requested = Clock::now();
+
+  startDecoder();
+  {
+    std::lock_guard lock{mMutex};
+    mPending.push_back(std::move(job));
+    mStats.requested++;
+  }
+  mWork.notify_one();
+
+  return texture;
+}
+
+bool TextureStreamer::update() {
+  takeDecoded();
+  if (mUploads.empty()) {
+    return !idle();
+  }
+
+  const auto start = Clock::now();
+  upload(mOptions.uploadBudget);
+  const std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+
+  {
+    std::lock_guard lock{mMutex};
+    mStats.uploadFrames++;
+    mStats.maxUploadMs = std::max(mStats.maxUploadMs, elapsed.count());
+  }
+
+  if (idle()) {
+    const Stats s = stats();
+    fmt::print("Streamed {} textures, {:.1f} MiB over {} frames, at most {:.2f} ms uploading per frame; the slowest "
+               "took {:.1f} ms from request to last level.\n",
+               s.completed, static_cast<double>(s.bytesUploaded) / (1024.0 * 1024.0), s.uploadFrames, s.maxUploadMs,
+               s.maxStreamMs);
+    return false;
+  }
+
+  return true;
+}
+
+void TextureStreamer::finish() {
+  {
+    std::unique_lock lock{mMutex};
+    mDecoded.wait(lock, [this]() { return mPending.empty() && mDecoding == 0; });
+  }
+
+  takeDecoded();
+  upload(0);
+}
+
+bool TextureStreamer::idle() const {
+  std::lock_guard lock{mMutex};
+  return mPending.empty() && mDecoding == 0 && mReady.empty() && mUploads.empty();
+}
+
+TextureStreamer::Stats TextureStreamer::stats() const {
+  std::lock_guard lock{mMutex};
+  return mStats;
+}
+
+void TextureStreamer::startDecoder() {
+  if (!mDecoder.joinable()) {
+    mDecoder = std::thread([this]() { runDecoder(); });
+  }
+}
+
+void TextureStreamer::runDecoder() {
+  // Everything this thread allocates is decoded images.
+  AllocScope scope{AllocTag::Textures};
+
+  while (true) {
+    std::unique_ptr<Job> job;
+    {
+      std::unique_lock lock{mMutex};
+      mWork.wait(lock, [this]() { return mStopping || !mPending.empty(); });
+      if (mStopping) {
+        return;
+      }
+      job = std::move(mPending.front());
+      mPending.pop_front();
+      mDecoding++;
+    }
+
+    try {
+      MipChain levels = loadMipChain(job->path, job->flip, job->options);
+      // The file could have changed since we read its header.
+      if (levels.front().width == job->width && levels.front().height == job->height) {
+        job->levels = std::move(levels);
+        job->level = static_cast<int>(job->levels.size()) - 1;
+      }
+    } catch (const std::runtime_error &) {
+      // Reported when we take the job back.
+    }
+
+    {
+      std::lock_guard lock{mMutex};
+      mReady.push_back(std::move(job));
+      mDecoding--;
+    }
+    mDecoded.notify_all();
+  }
+}
+
+void TextureStreamer::takeDecoded() {
+  std::deque<std::unique_ptr<Job>> ready;
+  {
+    std::lock_guard lock{mMutex};
+    ready.swap(mReady);
+  }
+
+  for (auto &job : ready) {
+    if (job->levels.empty()) {
+      fmt::print("Texture failed to stream from {}; keeping its placeholder.\n", job->path);
+      std::lock_guard lock{mMutex};
+      mStats.failed++;
+      continue;
+    }
+    mUploads.push_back(std::move(job));
+  }
+}
+
+void TextureStreamer::upload(std::size_t budget) {
+  std::size_t used = 0;
+
+  // Unpack rows are tightly packed RGBA8, which any alignment allows.
+  glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  while (!mUploads.empty() && (budget == 0 || used < budget)) {
+    Job &job = *mUploads.front();
+
+    // Drop jobs for textures released while streaming. Their names may
+    // have been deleted and made again since, for some other texture.
+    if (glResources().generation(GLResourceKind::Texture, job.texture) != job.generation) {
+      mUploads.pop_front();
+      continue;
+    }
+
+    // Always upload something, so a small budget still makes progress.
+    const std::size_t remaining = budget == 0 ? 0 : std::max<std::size_t>(budget - used, 1);
+    used += uploadRows(job, remaining);
+
+    if (job.level < 0) {
+      const std::chrono::duration<double, std::milli> elapsed = Clock::now() - job.requested;
+      mUploads.pop_front();
+
+      std::lock_guard lock{mMutex};
+      mStats.completed++;
+      mStats.maxStreamMs = std::max(mStats.maxStreamMs, elapsed.count());
+    }
+  }
+
+  std::lock_guard lock{mMutex};
+  mStats.bytesUploaded += used;
+}
+
+std::size_t TextureStreamer::uploadRows(Job &job, std::size_t budget) {
+  const MipLevel &level = job.levels[job.level];
+  const std::size_t rowBytes = static_cast<std::size_t>(level.width) * BYTES_PER_TEXEL;
+
+  int rows = level.height - job.row;
+  if (budget > 0) {
+    rows = std::clamp(static_cast<int>(budget / rowBytes), 1, rows);
+  }
+
+  glState().bindTexture(0, GL_TEXTURE_2D, job.texture);
+  glTexSubImage2D(GL_TEXTURE_2D, job.level, 0, job.row, level.width, rows, GL_RGBA, GL_UNSIGNED_BYTE,
+                  level.pixels.data() + job.row * rowBytes);
+  job.row += rows;
+
+  if (job.row == level.height) {
+    // The whole level is in, so sampling can use it. The chain is only
+    // complete down from here, so the base level moves one at a time.
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, job.level);
+    // Done with this level's CPU copy.
+    job.levels[job.level].pixels = {};
+    job.level--;
+    job.row = 0;
+  }
+
+  return static_cast<std::size_t>(rows) * rowBytes;
+}
@@ -0,0 +1,147 @@
+// Progressive texture streaming, so large textures don't hold up startup.
+//
+// Loading a texture the usual way decodes the whole image, uploads it
+// and builds its mips before the first frame can draw with it. A
+// streamed texture instead gets storage for its full mip chain up front,
+// immutable with glTexStorage2D where the driver has it, and a single
+// placeholder texel in its smallest mip, so it can be drawn from the
+// start. A worker thread decodes the image and builds its mips (see
+// mip_chain.h); then each frame, update() uploads them smallest first,
+// within a byte budget, lowering GL_TEXTURE_BASE_LEVEL as each mip
+// lands. Textures sharpen over a few frames while frame time stays flat.
+//
+// Levels bigger than the budget go up a band of rows at a time, so no
+// single frame pays for a whole 2K upload.
+
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include "glad/glad.h"
+
+#include <tools/gl_resources.h>
+#include <tools/mip_chain.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ----------------------------------------
+// Command line texture streaming options.
+
+struct TextureStreamOptions {
+  bool enabled = false;
+  // Most bytes uploaded per frame.
+  std::size_t uploadBudget = 4 * 1024 * 1024;
+};
+
+// Recognizes `--stream-textures` and `--upload-budget <KiB>`.
+TextureStreamOptions parseTextureStreamOptions(int argc, char **argv);
+
+// ------------------
+// Texture streamer.
+
+class TextureStreamer {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Stats {
+    std::size_t requested = 0;
+    std::size_t completed = 0;
+    std::size_t failed = 0;
+    std::uint64_t bytesUploaded = 0;
+    // Frames that uploaded anything, and the longest time one spent doing so.
+    std::uint64_t uploadFrames = 0;
+    double maxUploadMs = 0.0;
+    // Longest a texture took from its request to its last level uploaded.
+    double maxStreamMs = 0.0;
+  };
+
+  TextureStreamer() = default;
+
+  TextureStreamer(const TextureStreamer &) = delete;
+  TextureStreamer &operator=(const TextureStreamer &) = delete;
+
+  // Stops the decoder, dropping whatever hasn't been uploaded.
+  ~TextureStreamer();
+
+  void configure(const TextureStreamOptions &options);
+  [[nodiscard]] bool enabled() const { return mOptions.enabled; }
+
+  /// GL thread: makes a texture for the image at path, drawable at once,
+  /// and queues the image to stream in, with mips built as options say.
+  /// Reads only the image's header here. Throws std::runtime_error if
+  /// that fails.
+  GLTextureHandle request(const std::string &path, bool flipVertically, const MipOptions &options = {});
+
+  // GL thread, at the start of each frame, right after
+  // glResources().collect(): uploads what fits in the budget. Returns
+  // whether anything is still streaming, so callers keep drawing frames.
+  bool update();
+
+  // GL thread: waits for every decode and uploads everything, ignoring
+  // the budget, e.g. before a benchmark or batch render.
+  void finish();
+
+  [[nodiscard]] bool idle() const;
+  [[nodiscard]] Stats stats() const;
+
+private:
+  struct Job {
+    GLuint texture = 0;
+    // Of texture when requested, to tell if the name has since been reused.
+    std::uint64_t generation = 0;
+    std::string path;
+    bool flip = false;
+    MipOptions options;
+    int width = 0;
+    int height = 0;
+    Clock::time_point requested;
+
+    // Mips from the decoder; empty if decoding failed.
+    MipChain levels;
+    // Next level to upload, counting down to 0, and rows of it done.
+    int level = 0;
+    int row = 0;
+  };
+
+  void startDecoder();
+  void runDecoder();
+
+  // Uploads from the front of mUploads until budget bytes are used,
+  // always making some progress. No budget if budget is 0.
+  void upload(std::size_t budget);
+  // Uploads up to budget bytes of job's current level. Returns bytes used.
+  std::size_t uploadRows(Job &job, std::size_t budget);
+
+  // Moves decoded jobs over to mUploads.
+  void takeDecoded();
+
+private:
+  TextureStreamOptions mOptions;
+
+  std::thread mDecoder;
+  mutable std::mutex mMutex;
+  std::condition_variable mWork;
+  std::condition_variable mDecoded;
+  // Waiting for the decoder, then decoded and waiting for us.
+  std::deque<std::unique_ptr<Job>> mPending;
+  std::deque<std::unique_ptr<Job>> mReady;
+  std::size_t mDecoding = 0;
+  bool mStopping = false;
+
+  // GL thread only.
+  std::deque<std::unique_ptr<Job>> mUploads;
+  Stats mStats;
+};
+
+// The streamer for our one GL context.
+TextureStreamer &textureStreamer();
+
+#endif // TEXTURE_STREAMER_H
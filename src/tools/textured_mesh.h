@@ -11,9 +11,14 @@
 #include "glad/glad.h"
 
 #include <learnopengl/shader_m.h>
+#include <tools/gl_resources.h>
+#include <tools/gl_state.h>
 #include <tools/gl_texture.h>
+#include <tools/profiler.h>
+#include <tools/render_queue.h>
 
 #include <memory>
+#include <span>
 #include <vector>
 // clang-format on
 
@@ -30,13 +35,14 @@ public:
   explicit TexturedMesh(const std::shared_ptr<GLTexture> &texture, const std::vector<float> &model) {
     const float *vertices = model.data();
 
-    glGenVertexArrays(1, &mVAO);
-    glGenBuffers(1, &mVBO);
-    glBindVertexArray(mVAO);
+    mVAO = GLVertexArrayHandle::create();
+    mVBO = GLBufferHandle::create();
+    glState().bindVertexArray(mVAO.get());
 
     // Put vertex data in buffer
-    glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+    glState().bindBuffer(GL_ARRAY_BUFFER, mVBO.get());
     glBufferData(GL_ARRAY_BUFFER, model.size() * sizeof(float), vertices, GL_STATIC_DRAW);
+    mVBO.setBytes(model.size() * sizeof(float));
 
     // position attribute
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)0);
@@ -47,17 +53,23 @@ public:
 
     mCount = static_cast<int>(std::size(model) / 5);
     mTexture = texture;
+
+    // Center of our bounding box, for depth sorting.
+    if (mCount > 0) {
+      glm::vec3 lower{model[0], model[1], model[2]};
+      glm::vec3 upper = lower;
+      for (std::size_t i = 0; i < model.size(); i += 5) {
+        glm::vec3 position{model[i], model[i + 1], model[i + 2]};
+        lower = glm::min(lower, position);
+        upper = glm::max(upper, position);
+      }
+      mCenter = (lower + upper) * 0.5f;
+    }
   }
 
   TexturedMesh(const TexturedMesh &) = delete;
 
-  ~TexturedMesh() {
-    // de-allocate now
-    glDeleteVertexArrays(1, &mVAO);
-    glDeleteBuffers(1, &mVBO);
-  }
-
-  [[nodiscard]] unsigned int VAO() const { return mVAO; }
+  [[nodiscard]] unsigned int VAO() const { return mVAO.get(); }
 
   [[nodiscard]] int vertexCount() const { return mCount; }
 
@@ -73,25 +85,69 @@ public:
   // Draw my triangles.
 
   void draw(Shader *shader) const {
+    GLEX_PROFILE_SCOPE("TexturedMesh::draw");
+
     if (mTexture) {
       // Pass our texture number as uniform on shader.
-      shader->setInt("texture1", mTextureNum);
+      shader->setInt(textureUniform(*shader), mTextureNum);
     }
 
-    // Bind VAO.
-    glBindVertexArray(mVAO);
+    // Bind VAO, if it isn't already.
+    glState().bindVertexArray(mVAO.get());
 
     // Draw the model.
     glDrawArrays(GL_TRIANGLES, 0, mCount);
   }
 
+  // Record a draw of our triangles, setting any extra uniforms given.
+  void submit(RenderQueue &queue, const Shader &shader, std::span<const UniformValue> uniforms = {}) const {
+    constexpr std::size_t MAX_UNIFORMS = 4;
+    UniformValue packetUniforms[MAX_UNIFORMS];
+    std::size_t numUniforms = 0;
+
+    TextureBinding binding{};
+    std::size_t numTextures = 0;
+
+    if (mTexture) {
+      packetUniforms[numUniforms++] = UniformValue::makeInt(shader.location(textureUniform(shader)), mTextureNum);
+      binding = {static_cast<GLuint>(mTextureNum), GL_TEXTURE_2D, mTexture->id()};
+      numTextures = 1;
+    }
+
+    for (const auto &uniform : uniforms) {
+      if (numUniforms == MAX_UNIFORMS) {
+        throw std::runtime_error("Too many uniforms for one TexturedMesh draw.");
+      }
+      packetUniforms[numUniforms++] = uniform;
+    }
+
+    DrawCall call{shader.ID, mVAO.get(), GL_TRIANGLES, 0, mCount, false};
+    queue.submit(RenderPass::Opaque, call, mCenter, {&binding, numTextures}, {packetUniforms, numUniforms});
+  }
+
+private:
+  // Handle for our sampler uniform, looked up again only when the shader changes.
+  Shader::Uniform textureUniform(const Shader &shader) const {
+    if (shader.ID != mUniformProgram) {
+      mTextureUniform = shader.uniform("texture1");
+      mUniformProgram = shader.ID;
+    }
+    return mTextureUniform;
+  }
+
 private:
-  unsigned int mVAO = 0;
-  unsigned int mVBO = 0;
+  // Deleted at the next safe point after we're destroyed.
+  GLVertexArrayHandle mVAO;
+  GLBufferHandle mVBO;
   int mCount = 0;
 
   int mTextureNum = -1;
   std::shared_ptr<GLTexture> mTexture;
+
+  glm::vec3 mCenter{0.0f};
+
+  mutable Shader::Uniform mTextureUniform{};
+  mutable unsigned int mUniformProgram = 0;
 };
 
 #endif // TEXTURED_MODEL_H
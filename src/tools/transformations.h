@@ -3,8 +3,8 @@
 //
 // Following www.learnopengl.com, it uses a model,
 // view, and projection matrix to do this, and passes
-// these to the active shader through uniforms with
-// the same names.
+// these to our shaders through the shared Camera
+// uniform block.
 //
 // Created by sean on 12/10/24.
 //
@@ -16,74 +16,132 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <learnopengl/shader_m.h>
+#include <tools/camera_uniforms.h>
+#include <tools/profiler.h>
 
 #include <algorithm>
-#include <memory>
 
 // ----------------
 // Transformations.
 
-// Class representing coordinate transformations that
-// are passed to a shader via uniform variables.
+// Class representing coordinate transformations that are
+// passed to shaders via a uniform buffer. Updates are batched:
+// call flushUniforms() once per frame, before drawing.
 
 class Transformations {
 public:
-  Transformations(const std::shared_ptr<Shader> &shader, float aspectRatio) : mShader(shader) {
-    setupMatrices(aspectRatio);
+  // Clip planes of our perspective projection.
+  static constexpr float NEAR_PLANE = 0.1f;
+  static constexpr float FAR_PLANE = 100.0f;
+
+  // Model spin for constant rotation, in degrees per second.
+  static constexpr double MODEL_SPIN_RATE = 24.0;
+
+  // Limits of the field of view, in degrees.
+  static constexpr double FOV_MIN = 1.0;
+  static constexpr double FOV_MAX = 60.0;
+
+  explicit Transformations(float aspectRatio) { setupMatrices(aspectRatio); }
+
+  // Makes a shader read its matrices from our uniform buffer.
+  static void attachShader(const Shader &shader) { CameraUniformBuffer::attach(shader); }
+
+  // Uploads matrices changed since the last call, if any, and binds our
+  // uniform buffer for drawing.
+  bool flushUniforms() {
+    GLEX_PROFILE_SCOPE("transformations:flush");
+    return mCameraUniforms.flush();
   }
 
   void updateProjectionTransformation(float aspectRatio) {
-    mProjectionMatrix = glm::perspective(glm::radians(static_cast<float>(mFoV)), aspectRatio, 0.1f, 100.0f);
-    mShader->setMat4("projection", mProjectionMatrix);
+    mAspectRatio = aspectRatio;
+    updateProjectionTransformation();
   }
 
-  void updateFoV(double delta) {
-    mFoV -= delta;
+  // Recomputes the projection for the current field of view, keeping the
+  // last aspect ratio we were given.
+  void updateProjectionTransformation() {
+    GLEX_PROFILE_SCOPE("transformations:updateProjection");
+
+    mProjectionMatrix =
+        glm::perspective(glm::radians(static_cast<float>(mFoV)), mAspectRatio, NEAR_PLANE, FAR_PLANE);
+    mCameraUniforms.setProjection(mProjectionMatrix);
+  }
 
-    constexpr double FOV_MIN = 1.0;
-    constexpr double FOV_MAX = 60.0;
+  [[nodiscard]] const glm::mat4 &projectionMatrix() const { return mProjectionMatrix; }
+  [[nodiscard]] const glm::mat4 &viewMatrix() const { return mViewMatrix; }
+  [[nodiscard]] const glm::mat4 &modelMatrix() const { return mModelMatrix; }
 
+  void updateFoV(double delta) {
+    GLEX_PROFILE_SCOPE("transformations:updateFoV");
+
+    mFoV -= delta;
     mFoV = std::clamp(mFoV, FOV_MIN, FOV_MAX);
   }
 
-  void updateModelTransformation() {
-    constexpr float increment = 0.4f;
-    constexpr unsigned int mod = 360 / increment;
-    static unsigned int step = 0;
+  void setFoV(double fov) { mFoV = std::clamp(fov, FOV_MIN, FOV_MAX); }
 
-    // Update model matrix.
+  // Advances the model's spin by one fixed simulation step of dt seconds.
+  void advanceModelAnimation(double dt) {
+    GLEX_PROFILE_SCOPE("transformations:advanceModel");
 
-    float angle = 20.0f + increment * step;
+    mPreviousModelAngle = mModelAngle;
+    mModelAngle += MODEL_SPIN_RATE * dt;
+
+    // Keep angles small, shifting both so interpolation is unaffected.
+    if (mModelAngle >= 360.0) {
+      mModelAngle -= 360.0;
+      mPreviousModelAngle -= 360.0;
+    }
+  }
+
+  // Sets the model matrix between the last two simulation steps, with
+  // alpha in [0, 1) the fraction of a step since the latest one.
+  void interpolateModelTransformation(double alpha) {
+    GLEX_PROFILE_SCOPE("transformations:interpolateModel");
+
+    const double angle = mPreviousModelAngle + alpha * (mModelAngle - mPreviousModelAngle);
     glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f);
 
     mModelMatrix = glm::mat4(1.0f);
-    makeModelMatrix(mModelMatrix, position, angle);
-    mShader->setMat4("model", mModelMatrix);
-
-    // Update "time" step.
-    step = (step + 1) % mod;
+    makeModelMatrix(mModelMatrix, position, static_cast<float>(angle));
+    mCameraUniforms.setModel(mModelMatrix);
   }
 
   void updateViewTransformation() {
+    GLEX_PROFILE_SCOPE("transformations:updateView");
+
     // Update view matrix.
 
     mViewMatrix = glm::mat4(1.0f);
     mViewMatrix = glm::translate(mViewMatrix, mCameraPosition) * glm::inverse(mViewRotation);
-    mShader->setMat4("view", mViewMatrix);
+    mCameraUniforms.setView(mViewMatrix);
   }
 
   void rotateViewTransformation(float xAngle, float yAngle) {
+    GLEX_PROFILE_SCOPE("transformations:rotateView");
+
     mViewRotation = glm::rotate(mViewRotation, -xAngle, glm::vec3(1.0f, 0.0f, 0.0f));
     mViewRotation = glm::rotate(mViewRotation, -yAngle, glm::vec3(0.0f, 1.0f, 0.0f));
   }
 
+  // Replaces the accumulated rotation with pitch about the x-axis then yaw
+  // about the y-axis, in degrees.
+  void setViewOrientation(float yaw, float pitch) {
+    mViewRotation = glm::mat4(1.0f);
+    rotateViewTransformation(glm::radians(pitch), glm::radians(yaw));
+  }
+
 private:
   // Creates initial model, view, projection matrices.
   void setupMatrices(const float aspectRatio) {
     // Matrices are based on www.learnopengl.com coordinate systems example.
 
+    mAspectRatio = aspectRatio;
+
     // Performs perspective projection.
-    mProjectionMatrix = glm::perspective(glm::radians(static_cast<float>(mFoV)), aspectRatio, 0.1f, 100.0f);
+    mProjectionMatrix =
+        glm::perspective(glm::radians(static_cast<float>(mFoV)), aspectRatio, NEAR_PLANE, FAR_PLANE);
 
     // Converts world coordinates to camera viewpoint coordinates.
     mViewMatrix = glm::translate(mViewMatrix, glm::vec3(0.0f, 0.0f, -3.0f));
@@ -94,10 +152,10 @@ private:
     // Converts model local coordinates to world coordinates.
     makeModelMatrix(mModelMatrix, position, angle);
 
-    // Pass matrices to shader as uniforms.
-    mShader->setMat4("projection", mProjectionMatrix);
-    mShader->setMat4("view", mViewMatrix);
-    mShader->setMat4("model", mModelMatrix);
+    // Stage matrices for the first upload.
+    mCameraUniforms.setProjection(mProjectionMatrix);
+    mCameraUniforms.setView(mViewMatrix);
+    mCameraUniforms.setModel(mModelMatrix);
   }
 
   // Helper for constructing the model matrix.
@@ -108,13 +166,20 @@ private:
   }
 
 private:
-  std::shared_ptr<Shader> mShader;
+  // Shared by every shader attached to us.
+  CameraUniformBuffer mCameraUniforms;
 
   // Camera field of view.
   double mFoV = 45.0f;
+  // Viewport width over height.
+  float mAspectRatio = 1.0f;
   // Model scale factor.
   float mScaleFactor = 0.2f;
 
+  // Model spin angle at the latest and previous simulation steps.
+  double mModelAngle = 20.0;
+  double mPreviousModelAngle = 20.0;
+
   // Position of camera relative to object in world.
   glm::vec3 mCameraPosition = glm::vec3(0.0f, 0.0f, -3.0f);
 